@@ -67,6 +67,9 @@
 /* Define to 1 if you have the 'm' library (-lm). */
 #define HAVE_LIBM 1
 
+/* Define to 1 if you have the 'pthread' library (-lpthread). */
+#define HAVE_LIBPTHREAD 1
+
 /* Define to 1 if you have the 'z' library (-lz). */
 #define HAVE_LIBZ 1
 
@@ -76,6 +76,11 @@ static long		keyboard_change[KEYBOARD_STORE],
 			keyboard_update[KEYBOARD_STORE],
 			keyboard_acktime[KEYBOARD_STORE];
 static char		talk_str[MAX_CHARS];
+static delta_history_t	delta_frames;
+static unsigned char	delta_buf[DELTA_FRAME_SIZE];
+static sack_receiver_t	sack;
+static int		delta_len;
+static char		*frame_packets;
 
 
 
@@ -135,6 +140,7 @@ static void Receive_init(void)
     receive_tbl[PKT_ASTEROID]	= Receive_asteroid;
     receive_tbl[PKT_WORMHOLE]	= Receive_wormhole;
     receive_tbl[PKT_POLYSTYLE]	= Receive_polystyle;
+    receive_tbl[PKT_DELTA_FRAME] = Receive_delta_frame;
     for (i = 0; i < DEBRIS_TYPES; i++)
 	receive_tbl[PKT_DEBRIS + i] = Receive_debris;
 
@@ -461,7 +467,7 @@ int Net_verify(char *user_name, char *nick_name, char *disp)
  */
 int Net_init(char *server, int port)
 {
-    int			i;
+    int			i, rcvbuf, csize;
     size_t		size;
     sock_t		sock;
 
@@ -510,8 +516,18 @@ int Net_init(char *server, int port)
     if (sock_set_send_buffer_size(&sock, CLIENT_SEND_SIZE + 256) == -1)
 	error("Can't set send buffer size to %d", CLIENT_SEND_SIZE + 256);
 
-    if (sock_set_receive_buffer_size(&sock, CLIENT_RECV_SIZE + 256) == -1)
-	error("Can't set receive buffer size to %d", CLIENT_RECV_SIZE + 256);
+    /*
+     * Servers which get selective acknowledgements may send a window
+     * of reliable data at once, which the buffers must be able to hold.
+     */
+    rcvbuf = CLIENT_RECV_SIZE + 256;
+    csize = CLIENT_RECV_SIZE;
+    if (version >= 0x4F17) {
+	rcvbuf += 2 * RELIABLE_WINDOW;
+	csize += RELIABLE_WINDOW;
+    }
+    if (sock_set_receive_buffer_size(&sock, rcvbuf) == -1)
+	error("Can't set receive buffer size to %d", rcvbuf);
 
     size = receive_window_size * sizeof(frame_buf_t);
     if ((Frames = (frame_buf_t *) malloc(size)) == NULL) {
@@ -528,9 +544,9 @@ int Net_init(char *server, int port)
     }
 
     /* reliable data buffer, not a valid socket filedescriptor needed */
-    if (Sockbuf_init(&cbuf, NULL, CLIENT_RECV_SIZE,
+    if (Sockbuf_init(&cbuf, NULL, csize,
 		     SOCKBUF_WRITE | SOCKBUF_READ | SOCKBUF_LOCK) == -1) {
-	error("No memory for control buffer (%u)", CLIENT_RECV_SIZE);
+	error("No memory for control buffer (%u)", csize);
 	return -1;
     }
 
@@ -547,6 +563,18 @@ int Net_init(char *server, int port)
     /* reliable data byte stream offset */
     reliable_offset = 0;
 
+    /* reliable data which arrived out of order */
+    if (version >= 0x4F17 && Sack_init(&sack) == -1) {
+	error("No memory for reliable data window");
+	return -1;
+    }
+
+    /* frames that later frames may be deltas against */
+    if (Delta_init(&delta_frames) == -1) {
+	error("No memory for delta frames");
+	return -1;
+    }
+
     /* reset talk status */
     talk_sequence_num = 0;
     talk_pending = 0;
@@ -585,6 +613,8 @@ void Net_cleanup(void)
     }
     Sockbuf_cleanup(&cbuf);
     Sockbuf_cleanup(&wbuf);
+    Delta_cleanup(&delta_frames);
+    Sack_cleanup(&sack);
     XFREE(Setup);
     if (sock.fd > 2) {
 	ch = PKT_QUIT;
@@ -803,16 +833,14 @@ void Net_init_lag_measurement(void)
 }
 
 /*
- * Process a packet which most likely is a frame update,
- * perhaps with some reliable data in it.
+ * Process the frame update packets in rbuf.  Returns -1 on error,
+ * 0 if the rest of the packets were dropped and 1 otherwise.
  */
-static int Net_packet(void)
+static int Net_frame_packets(void)
 {
     int		type,
 		prev_type = 0,
-		result,
-		replyto,
-		status;
+		result;
 
     while (rbuf.buf + rbuf.len > rbuf.ptr) {
 	type = (*rbuf.ptr & 0xFF);
@@ -821,7 +849,7 @@ static int Net_packet(void)
 	    warn("Received unknown packet type (%d, %d), "
 		 "dropping frame.", type, prev_type);
 	    Sockbuf_clear(&rbuf);
-	    break;
+	    return 0;
 	}
 	else if ((result = (*receive_tbl[type])()) <= 0) {
 	    if (result == -1) {
@@ -832,10 +860,26 @@ static int Net_packet(void)
 	    }
 	    /* Drop rest of incomplete packet */
 	    Sockbuf_clear(&rbuf);
-	    break;
+	    return 0;
 	}
 	prev_type = type;
     }
+    return 1;
+}
+
+/*
+ * Process a packet which most likely is a frame update,
+ * perhaps with some reliable data in it.
+ */
+static int Net_packet(void)
+{
+    int		type,
+		result,
+		replyto,
+		status;
+
+    if (Net_frame_packets() == -1)
+	return -1;
     while (cbuf.buf + cbuf.len > cbuf.ptr) {
 	type = (*cbuf.ptr & 0xFF);
 	if (type == PKT_REPLY) {
@@ -1267,12 +1311,9 @@ int Receive_start(void)
 {
     int		n;
     long	loops_num;
-    u_byte	ch;
     long	key_ack;
 
-    if ((n = Packet_scanf(&rbuf,
-			  "%c%ld%ld",
-			  &ch, &loops_num, &key_ack)) <= 0)
+    if ((n = Packet_get_start(&rbuf, &loops_num, &key_ack)) <= 0)
 	return n;
 
     if (last_loops >= loops_num) {
@@ -1298,6 +1339,8 @@ int Receive_start(void)
 	    last_keyboard_ack = key_ack;
     }
     Net_lag_measurement(key_ack);
+    frame_packets = rbuf.ptr;
+    delta_len = -1;
     if ((n = Handle_start(loops_num)) == -1)
 	return -1;
     return 1;
@@ -1313,10 +1356,24 @@ int Receive_end(void)
 {
     int		n;
     long	loops_num;
-    u_byte	ch;
+    char	*end = rbuf.ptr;
 
-    if ((n = Packet_scanf(&rbuf, "%c%ld", &ch, &loops_num)) <= 0)
+    if ((n = Packet_get_end(&rbuf, &loops_num)) <= 0)
 	return n;
+    if (version >= 0x4F16 && loops_num == last_loops) {
+	/*
+	 * Remember the frame and tell the server that we have it,
+	 * so that it may send the next frames as deltas against it.
+	 */
+	if (delta_len >= 0)
+	    Delta_store(&delta_frames, loops_num, delta_buf, delta_len);
+	else if (frame_packets != NULL && frame_packets <= end)
+	    Delta_store(&delta_frames, loops_num,
+			(unsigned char *)frame_packets,
+			(int)(end - frame_packets));
+	Packet_put_ack_frame(&wbuf, loops_num);
+    }
+    frame_packets = NULL;
     Net_measurement(loops_num, PACKET_DRAW);
     if ((n = Handle_end(loops_num)) == -1)
 	return -1;
@@ -1361,11 +1418,10 @@ int Receive_time_left(void)
  */
 int Receive_eyes(void)
 {
-    int			n,
-			id;
-    u_byte		ch;
+    int			n;
+    short		id;
 
-    if ((n = Packet_scanf(&rbuf, "%c%hd", &ch, &id)) <= 0)
+    if ((n = Packet_get_eyes(&rbuf, &id)) <= 0)
 	return n;
     if ((n = Handle_eyes(id)) == -1)
 	return -1;
@@ -1457,37 +1513,25 @@ int Receive_self(void)
     int		n;
     short	x, y, vx, vy, lockId, lockDist,
 		sFuelSum, sFuelMax, sViewWidth, sViewHeight;
-    u_byte	ch, sNumSparkColors, sHeading, sPower, sTurnSpeed,
+    u_byte	sNumSparkColors, sHeading, sPower, sTurnSpeed,
 		sTurnResistance, sNextCheckPoint, lockDir, sAutopilotLight,
 		currentTank, sStat;
     u_byte	num_items[NUM_ITEMS];
 
-    n = Packet_scanf(&rbuf,
-		     "%c"
-		     "%hd%hd%hd%hd%c"
-		     "%c%c%c"
-		     "%hd%hd%c%c",
-		     &ch,
-		     &x, &y, &vx, &vy, &sHeading,
-		     &sPower, &sTurnSpeed, &sTurnResistance,
-		     &lockId, &lockDist, &lockDir, &sNextCheckPoint);
+    n = Packet_get_self(&rbuf,
+			&x, &y, &vx, &vy, &sHeading,
+			&sPower, &sTurnSpeed, &sTurnResistance,
+			&lockId, &lockDist, &lockDir, &sNextCheckPoint,
+
+			&currentTank, &sFuelSum, &sFuelMax,
+			&sViewWidth, &sViewHeight, &sNumSparkColors,
+			&sStat, &sAutopilotLight
+			);
     if (n <= 0)
 	return n;
 
     memset(num_items, 0, sizeof num_items);
 
-    n = Packet_scanf(&rbuf,
-		     "%c%hd%hd"
-		     "%hd%hd%c"
-		     "%c%c",
-
-		     &currentTank, &sFuelSum, &sFuelMax,
-		     &sViewWidth, &sViewHeight, &sNumSparkColors,
-		     &sStat, &sAutopilotLight
-		     );
-    if (n <= 0)
-	return n;
-
     /*
      * These assignments are done here because the server_display
      * structure members are not of the type that Packet_scanf()
@@ -1536,10 +1580,8 @@ int Receive_refuel(void)
 {
     int		n;
     short	x_0, y_0, x_1, y_1;
-    u_byte	ch;
 
-    if ((n = Packet_scanf(&rbuf, "%c%hd%hd%hd%hd",
-			  &ch, &x_0, &y_0, &x_1, &y_1)) <= 0)
+    if ((n = Packet_get_refuel(&rbuf, &x_0, &y_0, &x_1, &y_1)) <= 0)
 	return n;
     if ((n = Handle_refuel(x_0, y_0, x_1, y_1)) == -1)
 	return -1;
@@ -1550,10 +1592,9 @@ int Receive_connector(void)
 {
     int		n;
     short	x_0, y_0, x_1, y_1;
-    u_byte	ch, tractor;
+    u_byte	tractor;
 
-    n = Packet_scanf(&rbuf, "%c%hd%hd%hd%hd%c",
-		     &ch, &x_0, &y_0, &x_1, &y_1, &tractor);
+    n = Packet_get_connector(&rbuf, &x_0, &y_0, &x_1, &y_1, &tractor);
     if (n <= 0)
 	return n;
     if ((n = Handle_connector(x_0, y_0, x_1, y_1, tractor)) == -1)
@@ -1565,10 +1606,9 @@ int Receive_laser(void)
 {
     int		n;
     short	x, y, len;
-    u_byte	ch, color, dir;
+    u_byte	color, dir;
 
-    if ((n = Packet_scanf(&rbuf, "%c%c%hd%hd%hd%c",
-			  &ch, &color, &x, &y, &len, &dir)) <= 0)
+    if ((n = Packet_get_laser(&rbuf, &color, &x, &y, &len, &dir)) <= 0)
 	return n;
     if ((n = Handle_laser(color, x, y, len, dir)) == -1)
 	return -1;
@@ -1579,10 +1619,9 @@ int Receive_missile(void)
 {
     int		n;
     short	x, y;
-    u_byte	ch, dir, len;
+    u_byte	dir, len;
 
-    if ((n = Packet_scanf(&rbuf, "%c%hd%hd%c%c", &ch, &x, &y, &len, &dir))
-	<= 0)
+    if ((n = Packet_get_missile(&rbuf, &x, &y, &len, &dir)) <= 0)
 	return n;
 
     if ((n = Handle_missile(x, y, len, dir)) == -1)
@@ -1594,14 +1633,13 @@ int Receive_ball(void)
 {
     int		n;
     short	x, y, id;
-    u_byte	ch, style = 0xff /* no style */;
+    u_byte	style = 0xff /* no style */;
 
     if (version < 0x4F14) {
-	if ((n = Packet_scanf(&rbuf, "%c%hd%hd%hd", &ch, &x, &y, &id)) <= 0)
+	if ((n = Packet_get_ball(&rbuf, &x, &y, &id)) <= 0)
 	    return n;
     } else {
-	if ((n = Packet_scanf(&rbuf, "%c%hd%hd%hd%c", &ch, &x, &y, &id,
-			      &style)) <= 0)
+	if ((n = Packet_get_ballstyle(&rbuf, &x, &y, &id, &style)) <= 0)
 	    return n;
     }
     if ((n = Handle_ball(x, y, id, style)) == -1)
@@ -1613,12 +1651,9 @@ int Receive_ship(void)
 {
     int		n, shield, cloak, eshield, phased, deflector;
     short	x, y, id;
-    u_byte	ch, dir, flags;
+    u_byte	dir, flags;
 
-    if ((n = Packet_scanf(&rbuf,
-			  "%c%hd%hd%hd" "%c%c",
-			  &ch, &x, &y, &id,
-			  &dir, &flags)) <= 0)
+    if ((n = Packet_get_ship(&rbuf, &x, &y, &id, &dir, &flags)) <= 0)
 	return n;
     shield = ((flags & 1) != 0);
     cloak = ((flags & 2) != 0);
@@ -1636,9 +1671,9 @@ int Receive_mine(void)
 {
     int		n;
     short	x, y, id;
-    u_byte	ch, teammine;
+    u_byte	teammine;
 
-    n = Packet_scanf(&rbuf, "%c%hd%hd%c%hd", &ch, &x, &y, &teammine, &id);
+    n = Packet_get_mine(&rbuf, &x, &y, &teammine, &id);
     if (n <= 0)
 	return n;
     if ((n = Handle_mine(x, y, teammine, id)) == -1)
@@ -1650,9 +1685,9 @@ int Receive_item(void)
 {
     int		n;
     short	x, y;
-    u_byte	ch, type;
+    u_byte	type;
 
-    if ((n = Packet_scanf(&rbuf, "%c%hd%hd%c", &ch, &x, &y, &type)) <= 0)
+    if ((n = Packet_get_item(&rbuf, &x, &y, &type)) <= 0)
 	return n;
     if (type < NUM_ITEMS) {
 	if ((n = Handle_item(x, y, type)) == -1)
@@ -1665,9 +1700,8 @@ int Receive_destruct(void)
 {
     int		n;
     short	count;
-    u_byte	ch;
 
-    if ((n = Packet_scanf(&rbuf, "%c%hd", &ch, &count)) <= 0)
+    if ((n = Packet_get_destruct(&rbuf, &count)) <= 0)
 	return n;
     if ((n = Handle_destruct(count)) == -1)
 	return -1;
@@ -1678,9 +1712,8 @@ int Receive_shutdown(void)
 {
     int		n;
     short	count, delay;
-    u_byte	ch;
 
-    if ((n = Packet_scanf(&rbuf, "%c%hd%hd", &ch, &count, &delay)) <= 0)
+    if ((n = Packet_get_shutdown(&rbuf, &count, &delay)) <= 0)
 	return n;
     if ((n = Handle_shutdown(count, delay)) == -1)
 	return -1;
@@ -1691,9 +1724,8 @@ int Receive_thrusttime(void)
 {
     int		n;
     short	count, max;
-    u_byte	ch;
 
-    if ((n = Packet_scanf(&rbuf, "%c%hd%hd", &ch, &count, &max)) <= 0)
+    if ((n = Packet_get_thrusttime(&rbuf, &count, &max)) <= 0)
 	return n;
     if ((n = Handle_thrusttime(count, max)) == -1)
 	return -1;
@@ -1704,9 +1736,8 @@ int Receive_shieldtime(void)
 {
     int		n;
     short	count, max;
-    u_byte	ch;
 
-    if ((n = Packet_scanf(&rbuf, "%c%hd%hd", &ch, &count, &max)) <= 0)
+    if ((n = Packet_get_shieldtime(&rbuf, &count, &max)) <= 0)
 	return n;
     if ((n = Handle_shieldtime(count, max)) == -1)
 	return -1;
@@ -1717,9 +1748,8 @@ int Receive_phasingtime(void)
 {
     int		n;
     short	count, max;
-    u_byte	ch;
 
-    if ((n = Packet_scanf(&rbuf, "%c%hd%hd", &ch, &count, &max)) <= 0)
+    if ((n = Packet_get_phasingtime(&rbuf, &count, &max)) <= 0)
 	return n;
     if ((n = Handle_phasingtime(count, max)) == -1)
 	return -1;
@@ -1777,10 +1807,10 @@ int Receive_wreckage(void)	/* since 3.8.0 */
 {
     int			n;
     short		x, y;
-    u_byte		ch, wrecktype, size, rot;
+    u_byte		wrecktype, size, rot;
 
-    if ((n = Packet_scanf(&rbuf, "%c%hd%hd%c%c%c", &ch, &x, &y,
-			  &wrecktype, &size, &rot)) <= 0)
+    if ((n = Packet_get_wreckage(&rbuf, &x, &y,
+				     &wrecktype, &size, &rot)) <= 0)
 	return n;
     if ((n = Handle_wreckage(x, y, wrecktype, size, rot)) == -1)
 	return -1;
@@ -1791,10 +1821,9 @@ int Receive_asteroid(void)	/* since 4.4.0 */
 {
     int			n;
     short		x, y;
-    u_byte		ch, type_size, type, size, rot;
+    u_byte		type_size, type, size, rot;
 
-    if ((n = Packet_scanf(&rbuf, "%c%hd%hd%c%c", &ch, &x, &y,
-			  &type_size, &rot)) <= 0)
+    if ((n = Packet_get_asteroid(&rbuf, &x, &y, &type_size, &rot)) <= 0)
 	return n;
 
     type = ((type_size >> 4) & 0x0F);
@@ -1809,9 +1838,8 @@ int Receive_wormhole(void)	/* since 4.5.0 */
 {
     int			n;
     short		x, y;
-    u_byte		ch;
 
-    if ((n = Packet_scanf(&rbuf, "%c%hd%hd", &ch, &x, &y)) <= 0)
+    if ((n = Packet_get_wormhole(&rbuf, &x, &y)) <= 0)
 	return n;
 
     if ((n = Handle_wormhole(x, y)) == -1)
@@ -1823,9 +1851,8 @@ int Receive_ecm(void)
 {
     int			n;
     short		x, y, size;
-    u_byte		ch;
 
-    if ((n = Packet_scanf(&rbuf, "%c%hd%hd%hd", &ch, &x, &y, &size)) <= 0)
+    if ((n = Packet_get_ecm(&rbuf, &x, &y, &size)) <= 0)
 	return n;
     if ((n = Handle_ecm(x, y, size)) == -1)
 	return -1;
@@ -1836,10 +1863,8 @@ int Receive_trans(void)
 {
     int			n;
     short		x_1, y_1, x_2, y_2;
-    u_byte		ch;
 
-    if ((n = Packet_scanf(&rbuf, "%c%hd%hd%hd%hd",
-			  &ch, &x_1, &y_1, &x_2, &y_2)) <= 0)
+    if ((n = Packet_get_trans(&rbuf, &x_1, &y_1, &x_2, &y_2)) <= 0)
 	return n;
     if ((n = Handle_trans(x_1, y_1, x_2, y_2)) == -1)
 	return -1;
@@ -1850,9 +1875,8 @@ int Receive_paused(void)
 {
     int			n;
     short		x, y, count;
-    u_byte		ch;
 
-    if ((n = Packet_scanf(&rbuf, "%c%hd%hd%hd", &ch, &x, &y, &count)) <= 0)
+    if ((n = Packet_get_paused(&rbuf, &x, &y, &count)) <= 0)
 	return n;
     if ((n = Handle_paused(x, y, count)) == -1)
 	return -1;
@@ -1863,9 +1887,7 @@ int Receive_appearing(void)
 {
     int			n;
     short		x, y, id, count;
-    u_byte		ch;
-    if ((n = Packet_scanf(&rbuf, "%c%hd%hd%hd%hd", &ch, &x, &y, &id,
-			  &count)) <= 0)
+    if ((n = Packet_get_appearing(&rbuf, &x, &y, &id, &count)) <= 0)
 	return n;
     if ((n = Handle_appearing(x, y, id, count)) == -1)
 	return -1;
@@ -1876,9 +1898,9 @@ int Receive_radar(void)
 {
     int			n;
     short		x, y;
-    u_byte		ch, size;
+    u_byte		size;
 
-    if ((n = Packet_scanf(&rbuf, "%c%hd%hd%c", &ch, &x, &y, &size)) <= 0)
+    if ((n = Packet_get_radar(&rbuf, &x, &y, &size)) <= 0)
 	return n;
 
     if ((n = Handle_radar(x, y, size)) == -1)
@@ -1917,12 +1939,50 @@ int Receive_fastradar(void)
     return (r == -1) ? -1 : 1;
 }
 
+/*
+ * The rest of the frame is a delta against an earlier frame.
+ * Make the packets of the frame from it and process them.
+ */
+int Receive_delta_frame(void)
+{
+    int			n, base_len;
+    long		base_loops;
+    unsigned short	len;
+    const unsigned char	*base;
+    sockbuf_t		frame;
+
+    if ((n = Packet_get_delta_frame(&rbuf, &base_loops, &len)) <= 0)
+	return n;
+    if (rbuf.ptr - rbuf.buf + len > rbuf.len)
+	return 0;
+    if ((base = Delta_find(&delta_frames, base_loops, &base_len)) == NULL)
+	/* Too old, the server will soon stop using it. */
+	return 0;
+    n = Delta_decode(base, base_len, (unsigned char *)rbuf.ptr, len,
+		     delta_buf, sizeof(delta_buf));
+    rbuf.ptr += len;
+    if (n == -1) {
+	warn("Bad delta frame (%ld, %ld)", last_loops, base_loops);
+	return 0;
+    }
+
+    frame = rbuf;
+    rbuf.buf = rbuf.ptr = (char *)delta_buf;
+    rbuf.len = n;
+    rbuf.size = sizeof(delta_buf);
+    if ((n = Net_frame_packets()) == 1)
+	delta_len = rbuf.len;
+    rbuf = frame;
+
+    return n;
+}
+
 int Receive_damaged(void)
 {
     int			n;
-    u_byte		ch, dmgd;
+    u_byte		dmgd;
 
-    if ((n = Packet_scanf(&rbuf, "%c%c", &ch, &dmgd)) <= 0)
+    if ((n = Packet_get_damaged(&rbuf, &dmgd)) <= 0)
 	return n;
     if ((n = Handle_damaged(dmgd)) == -1)
 	return -1;
@@ -2111,9 +2171,8 @@ int Receive_fuel(void)
 {
     int			n;
     unsigned short	num, fuel;
-    u_byte		ch;
 
-    if ((n = Packet_scanf(&rbuf, "%c%hu%hu", &ch, &num, &fuel)) <= 0)
+    if ((n = Packet_get_fuel(&rbuf, &num, &fuel)) <= 0)
 	return n;
     if ((n = Handle_fuel(num, (double)fuel)) == -1)
 	return -1;
@@ -2126,9 +2185,8 @@ int Receive_cannon(void)
 {
     int			n;
     unsigned short	num, dead_time;
-    u_byte		ch;
 
-    if ((n = Packet_scanf(&rbuf, "%c%hu%hu", &ch, &num, &dead_time)) <= 0)
+    if ((n = Packet_get_cannon(&rbuf, &num, &dead_time)) <= 0)
 	return n;
     if ((n = Handle_cannon(num, dead_time)) == -1)
 	return -1;
@@ -2143,10 +2201,8 @@ int Receive_target(void)
     unsigned short	num,
 			dead_time,
 			damage;
-    u_byte		ch;
 
-    if ((n = Packet_scanf(&rbuf, "%c%hu%hu%hu", &ch,
-			  &num, &dead_time, &damage)) <= 0)
+    if ((n = Packet_get_target(&rbuf, &num, &dead_time, &damage)) <= 0)
 	return n;
     if ((n = Handle_target(num, dead_time, (double)damage / 256.0)) == -1)
 	return -1;
@@ -2159,9 +2215,8 @@ int Receive_polystyle(void)	/* since ng 4.7.0 */
 {
     int			n;
     unsigned short	num, newstyle;
-    u_byte		ch;
 
-    if ((n = Packet_scanf(&rbuf, "%c%hu%hu", &ch, &num, &newstyle)) <= 0)
+    if ((n = Packet_get_polystyle(&rbuf, &num, &newstyle)) <= 0)
 	return n;
     if ((n = Handle_polystyle(num, newstyle)) == -1)
 	return -1;
@@ -2226,8 +2281,7 @@ int Send_ack(long rel_loops)
 {
     int			n;
 
-    if ((n = Packet_printf(&wbuf, "%c%ld%ld", PKT_ACK,
-			   reliable_offset, rel_loops)) <= 0) {
+    if ((n = Packet_put_ack(&wbuf, reliable_offset, rel_loops)) <= 0) {
 	if (n == 0)
 	    return 0;
 	error("Can't ack reliable data");
@@ -2267,6 +2321,27 @@ int Receive_reliable(void)
 	Sockbuf_advance(&rbuf, rbuf.ptr - rbuf.buf);
 	return -1;
     }
+    if (version >= 0x4F17) {
+	/*
+	 * Keep data which arrives out of order until the data before
+	 * it arrives, and tell the server which data we have.
+	 */
+	if (cbuf.ptr > cbuf.buf)
+	    Sockbuf_advance(&cbuf, cbuf.ptr - cbuf.buf);
+	n = Sack_receive(&sack, rel, rbuf.ptr, len, &cbuf);
+	rbuf.ptr += len;
+	Sockbuf_advance(&rbuf, rbuf.ptr - rbuf.buf);
+	if (n == -1) {
+	    warn("Can't copy reliable data to buffer");
+	    return -1;
+	}
+	reliable_offset = sack.offset;
+	if (Sack_put_ack(&sack, &wbuf, rel_loops) == -1) {
+	    error("Can't ack reliable data");
+	    return -1;
+	}
+	return 1;
+    }
     if (rel > reliable_offset) {
 	/*
 	 * We miss one or more packets.
@@ -2335,7 +2410,7 @@ int Send_keyboard(u_byte *keyboard_vector)
     if (wbuf.size - wbuf.len < size + 1 + 4)
 	/* Not enough write buffer space for keyboard state */
 	return 0;
-    Packet_printf(&wbuf, "%c%ld", PKT_KEYBOARD, last_keyboard_change);
+    Packet_put_keyboard(&wbuf, last_keyboard_change);
     memcpy(&wbuf.buf[wbuf.len], keyboard_vector, (size_t)size);
     wbuf.len += size;
     last_keyboard_update = last_loops;
@@ -2568,7 +2643,7 @@ int Send_pointer_move(int movement)
 	movement = total;
     }
 
-    if (Packet_printf(&wbuf, "%c%hd", PKT_POINTER_MOVE, movement) == -1)
+    if (Packet_put_pointer_move(&wbuf, movement) == -1)
 	return -1;
     
     if (dirPrediction)
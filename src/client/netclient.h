@@ -105,6 +105,7 @@ int Receive_paused(void);
 int Receive_appearing(void);
 int Receive_radar(void);
 int Receive_fastradar(void);
+int Receive_delta_frame(void);
 int Receive_damaged(void);
 int Receive_leave(void);
 int Receive_war(void);
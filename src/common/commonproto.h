@@ -30,14 +30,17 @@
 extern void seedMT(unsigned int seed);
 extern unsigned int reloadMT(void);
 extern unsigned int randomMT(void);
+extern void randomMT_fill(unsigned int *buf, int n);
 
 /* math.c */
 extern double rfrac(void);
+extern void rfrac_fill(double *buf, int n);
 extern int mod(int x, int y);
 extern void Make_table(void);
 extern int ON(const char *optval);
 extern int OFF(const char *optval);
 extern double findDir(double x, double y);
+extern int findDir_rounded(double x, double y);
 
 /* strdup.c */
 extern char *xp_strdup(const char *);
@@ -0,0 +1,313 @@
+/*
+ * XPilot NG, a multiplayer space war game.
+ *
+ * Copyright (C) 2026 by
+ *
+ *      The XPilot NG Authors, see the AUTHORS file.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Delta compression of frames, see delta.h.
+ */
+
+#include "xpcommon.h"
+
+static int packet_sizes[256];
+
+static void Delta_init_sizes(void)
+{
+#define DELTA_SIZE(name, type, fields)	packet_sizes[type] = 1 fields(PF_SIZE);
+    PACKET_FORMATS(DELTA_SIZE)
+#undef DELTA_SIZE
+    /* Clients which get delta frames always get the ball style. */
+    packet_sizes[PKT_BALL] = 1 PF_BALLSTYLE(PF_SIZE);
+    packet_sizes[PKT_TIME_LEFT] = 5;
+    packet_sizes[PKT_LOSEITEM] = 2;
+    packet_sizes[PKT_AUDIO] = 3;
+    /* Deltas don't nest. */
+    packet_sizes[PKT_DELTA_FRAME] = 0;
+}
+
+/*
+ * Returns the size of the frame packet at p, or -1 if it is
+ * not a packet that a frame may have or if it is incomplete.
+ */
+static int Delta_packet_size(const unsigned char *p, int len)
+{
+    int i, n, type = p[0];
+    const unsigned char *nul;
+
+    if (type >= PKT_DEBRIS)
+	n = (len >= 2) ? 2 + 2 * p[1] : -1;
+    else if (type == PKT_FASTSHOT)
+	n = (len >= 3) ? 3 + 2 * p[2] : -1;
+    else if (type == PKT_FASTRADAR)
+	n = (len >= 2) ? 2 + 3 * p[1] : -1;
+    else if (type == PKT_SELF_ITEMS) {
+	if (len < 5)
+	    return -1;
+	n = 5;
+	for (i = 1; i < 5; i++) {
+	    unsigned bits = p[i];
+
+	    for (; bits != 0; bits &= bits - 1)
+		n++;
+	}
+    }
+    else if (type == PKT_MODIFIERS) {
+	if ((nul = memchr(p + 1, '\0', (size_t)(len - 1))) == NULL)
+	    return -1;
+	n = nul - p + 1;
+    }
+    else if ((n = packet_sizes[type]) == 0)
+	return -1;
+
+    return (n <= len) ? n : -1;
+}
+
+int Delta_init(delta_history_t *dh)
+{
+    if (packet_sizes[PKT_START] == 0)
+	Delta_init_sizes();
+
+    memset(dh, 0, sizeof(*dh));
+    if ((dh->buf = XMALLOC(unsigned char,
+			   DELTA_FRAMES * DELTA_FRAME_SIZE)) == NULL)
+	return -1;
+    return 0;
+}
+
+void Delta_cleanup(delta_history_t *dh)
+{
+    XFREE(dh->buf);
+    memset(dh, 0, sizeof(*dh));
+}
+
+/*
+ * Remember the packets of a frame, forgetting the oldest frame.
+ */
+void Delta_store(delta_history_t *dh, long loops,
+		 const unsigned char *buf, int len)
+{
+    int i = dh->next;
+
+    if (dh->buf == NULL)
+	return;
+    dh->next = (i + 1) % DELTA_FRAMES;
+    if (len < 0 || len > DELTA_FRAME_SIZE) {
+	dh->loops[i] = 0;
+	return;
+    }
+    dh->loops[i] = loops;
+    dh->len[i] = len;
+    memcpy(dh->buf + i * DELTA_FRAME_SIZE, buf, (size_t)len);
+}
+
+const unsigned char *Delta_find(delta_history_t *dh, long loops, int *len)
+{
+    int i;
+
+    if (dh->buf == NULL || loops <= 0)
+	return NULL;
+    for (i = 0; i < DELTA_FRAMES; i++) {
+	if (dh->loops[i] == loops) {
+	    *len = dh->len[i];
+	    return dh->buf + i * DELTA_FRAME_SIZE;
+	}
+    }
+    return NULL;
+}
+
+/*
+ * Find the next packet of a type in the base, starting from *pos.
+ * Returns its offset and sets *size, or returns -1 if there are
+ * no more.  Every packet of the frame calls this once for its type,
+ * both when encoding and when decoding.
+ */
+static int Delta_next(const unsigned char *base, int base_len,
+		      int *pos, int type, int *size)
+{
+    int off, n;
+
+    while (*pos < base_len) {
+	off = *pos;
+	if ((n = Delta_packet_size(base + off, base_len - off)) <= 0) {
+	    *pos = base_len;
+	    break;
+	}
+	*pos += n;
+	if (base[off] == type) {
+	    *size = n;
+	    return off;
+	}
+    }
+    return -1;
+}
+
+/*
+ * Write the delta of the packets in buf against the packets in base.
+ * Returns the size of the delta, or -1 if buf has packets which can't
+ * be delta compressed or if the delta doesn't fit in out_size bytes.
+ */
+int Delta_encode(const unsigned char *base, int base_len,
+		 const unsigned char *buf, int len,
+		 unsigned char *out, int out_size)
+{
+    int pos[256], i, j, n, o = 0, ref, ref_n, mask_len, changed, same = -1;
+    const unsigned char *p, *q;
+
+    memset(pos, 0, sizeof(pos));
+
+    for (i = 0; i < len; i += n) {
+	p = buf + i;
+	if ((n = Delta_packet_size(p, len - i)) <= 0)
+	    return -1;
+	ref = Delta_next(base, base_len, &pos[p[0]], p[0], &ref_n);
+	if (ref == -1 || ref_n != n) {
+	    if (o + 1 + n > out_size)
+		return -1;
+	    out[o++] = DELTA_LITERAL;
+	    memcpy(out + o, p, (size_t)n);
+	    o += n;
+	    same = -1;
+	    continue;
+	}
+
+	q = base + ref;
+	if (memcmp(p, q, (size_t)n) == 0) {
+	    if (same != -1 && out[same + 1] == p[0]
+		&& (out[same] & DELTA_MAX_SAME) < DELTA_MAX_SAME)
+		out[same]++;
+	    else {
+		if (o + 2 > out_size)
+		    return -1;
+		same = o;
+		out[o++] = DELTA_SAME | 1;
+		out[o++] = p[0];
+	    }
+	    continue;
+	}
+	same = -1;
+
+	mask_len = (n - 1 + 7) / 8;
+	for (changed = 0, j = 1; j < n; j++) {
+	    if (p[j] != q[j])
+		changed++;
+	}
+	if (2 + mask_len + changed >= 1 + n) {
+	    if (o + 1 + n > out_size)
+		return -1;
+	    out[o++] = DELTA_LITERAL;
+	    memcpy(out + o, p, (size_t)n);
+	    o += n;
+	    continue;
+	}
+	if (o + 2 + mask_len + changed > out_size)
+	    return -1;
+	out[o++] = DELTA_XOR;
+	out[o++] = p[0];
+	memset(out + o, 0, (size_t)mask_len);
+	for (j = 1; j < n; j++) {
+	    if (p[j] != q[j])
+		out[o + (j - 1) / 8] |= 1 << ((j - 1) % 8);
+	}
+	o += mask_len;
+	for (j = 1; j < n; j++) {
+	    if (p[j] != q[j])
+		out[o++] = p[j];
+	}
+    }
+
+    return o;
+}
+
+/*
+ * Make the packets of a frame from a delta against the packets in base.
+ * Returns their size, or -1 if the delta is bad or they don't fit in
+ * out_size bytes.
+ */
+int Delta_decode(const unsigned char *base, int base_len,
+		 const unsigned char *delta, int delta_len,
+		 unsigned char *out, int out_size)
+{
+    int pos[256], i = 0, j, k, n, o = 0, ref, ref_n, mask_len, type;
+    const unsigned char *mask;
+
+    memset(pos, 0, sizeof(pos));
+
+    while (i < delta_len) {
+	switch (delta[i] & ~DELTA_MAX_SAME) {
+	case DELTA_LITERAL:
+	    if (delta[i] != DELTA_LITERAL)
+		return -1;
+	    i++;
+	    if (i >= delta_len
+		|| (n = Delta_packet_size(delta + i, delta_len - i)) <= 0
+		|| o + n > out_size)
+		return -1;
+	    Delta_next(base, base_len, &pos[delta[i]], delta[i], &ref_n);
+	    memcpy(out + o, delta + i, (size_t)n);
+	    o += n;
+	    i += n;
+	    break;
+
+	case DELTA_SAME:
+	    if (i + 2 > delta_len)
+		return -1;
+	    k = delta[i] & DELTA_MAX_SAME;
+	    type = delta[i + 1];
+	    i += 2;
+	    for (; k > 0; k--) {
+		ref = Delta_next(base, base_len, &pos[type], type, &ref_n);
+		if (ref == -1 || o + ref_n > out_size)
+		    return -1;
+		memcpy(out + o, base + ref, (size_t)ref_n);
+		o += ref_n;
+	    }
+	    break;
+
+	case DELTA_XOR:
+	    if (delta[i] != DELTA_XOR || i + 2 > delta_len)
+		return -1;
+	    type = delta[i + 1];
+	    i += 2;
+	    ref = Delta_next(base, base_len, &pos[type], type, &ref_n);
+	    if (ref == -1 || o + ref_n > out_size)
+		return -1;
+	    mask_len = (ref_n - 1 + 7) / 8;
+	    if (i + mask_len > delta_len)
+		return -1;
+	    mask = delta + i;
+	    i += mask_len;
+	    memcpy(out + o, base + ref, (size_t)ref_n);
+	    for (j = 1; j < ref_n; j++) {
+		if (mask[(j - 1) / 8] & (1 << ((j - 1) % 8))) {
+		    if (i >= delta_len)
+			return -1;
+		    out[o + j] = delta[i++];
+		}
+	    }
+	    o += ref_n;
+	    break;
+
+	default:
+	    return -1;
+	}
+    }
+
+    return o;
+}
@@ -0,0 +1,78 @@
+/*
+ * XPilot NG, a multiplayer space war game.
+ *
+ * Copyright (C) 2026 by
+ *
+ *      The XPilot NG Authors, see the AUTHORS file.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef DELTA_H
+#define DELTA_H
+
+#ifndef NET_H
+#include "net.h"
+#endif
+
+/*
+ * Delta compressed frames, since 4.F.1.6.
+ *
+ * The packets of a frame between the start and the end of frame
+ * packets may be replaced by a PKT_DELTA_FRAME packet, which says
+ * how to make them from the packets of an earlier frame, the base.
+ * The n:th packet of some type in the frame is compared to the n:th
+ * packet of that type in the base.  The delta is a list of
+ *
+ *	DELTA_LITERAL packet	the next packet as it is
+ *	DELTA_SAME|n type	the next n packets of this type are the
+ *				same as in the base, n is 1 to 63
+ *	DELTA_XOR type mask bytes
+ *				the next packet of this type is the one in
+ *				the base with the bytes in mask changed,
+ *				one mask bit for each byte after the type
+ *
+ * The base is a frame which the client has acknowledged with a
+ * PKT_ACK_FRAME packet, so both sides remember the last DELTA_FRAMES
+ * frames they have sent or received.
+ */
+#define DELTA_LITERAL		0x00
+#define DELTA_SAME		0x40
+#define DELTA_XOR		0x80
+#define DELTA_MAX_SAME		0x3F
+
+#define DELTA_FRAMES		16
+#define DELTA_FRAME_SIZE	SERVER_SEND_SIZE
+
+typedef struct {
+    long		loops[DELTA_FRAMES];	/* frame number or 0 */
+    int			len[DELTA_FRAMES];	/* size of the packets */
+    unsigned char	*buf;			/* the packets of the frames */
+    int			next;			/* slot to use next */
+} delta_history_t;
+
+int Delta_init(delta_history_t *dh);
+void Delta_cleanup(delta_history_t *dh);
+void Delta_store(delta_history_t *dh, long loops,
+		 const unsigned char *buf, int len);
+const unsigned char *Delta_find(delta_history_t *dh, long loops, int *len);
+int Delta_encode(const unsigned char *base, int base_len,
+		 const unsigned char *buf, int len,
+		 unsigned char *out, int out_size);
+int Delta_decode(const unsigned char *base, int base_len,
+		 const unsigned char *delta, int delta_len,
+		 unsigned char *out, int out_size);
+
+#endif
@@ -33,6 +33,9 @@
 double		tbl_sin[TABLE_SIZE];
 double		tbl_cos[TABLE_SIZE];
 
+/* Tangents of the borders between the directions in the first octant. */
+static double	tbl_dir_border[RES / 8];
+
 int ON(const char *optval)
 {
     return (strncasecmp(optval, "true", 4) == 0
@@ -75,6 +78,40 @@ double findDir(double x, double y)
 }
 
 
+/*
+ * Same as MOD2((int)(findDir(x, y) + 0.5), RES), the direction of
+ * (x, y) rounded to the nearest one, but instead of atan2() this
+ * looks up which directions the angle is between in a table.
+ */
+int findDir_rounded(double x, double y)
+{
+    double ax = ABS(x), ay = ABS(y), a, b;
+    int lo = 0, hi = RES / 8, mid, dir;
+
+    if (ax == 0.0 && ay == 0.0)
+	return 0;
+
+    /* Angle from the nearest axis, as the first octant. */
+    a = MIN(ax, ay);
+    b = MAX(ax, ay);
+    while (lo < hi) {
+	mid = (lo + hi) / 2;
+	if (a >= tbl_dir_border[mid] * b)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    dir = (ax >= ay) ? lo : RES / 4 - lo;
+
+    if (x < 0)
+	dir = RES / 2 - dir;
+    if (y < 0)
+	dir = RES - dir;
+
+    return MOD2(dir, RES);
+}
+
+
 double rfrac(void)
 {
     /*
@@ -85,6 +122,26 @@ double rfrac(void)
 }
 
 
+void rfrac_fill(double *buf, int n)
+{
+    /*
+     * Fill buf with the next n values rfrac() would return.
+     * The raw values are drawn a chunk at a time and then scaled.
+     */
+    unsigned int u[256];
+    int i, k;
+
+    while (n > 0) {
+	k = MIN(n, NELEM(u));
+	randomMT_fill(u, k);
+	for (i = 0; i < k; i++)
+	    buf[i] = (double) (u[i] * 0.00000000023283064365386962890625);
+	buf += k;
+	n -= k;
+    }
+}
+
+
 void Make_table(void)
 {
     int i;
@@ -93,4 +150,6 @@ void Make_table(void)
 	tbl_sin[i] = sin(i * (2.0 * PI / TABLE_SIZE));
 	tbl_cos[i] = cos(i * (2.0 * PI / TABLE_SIZE));
     }
+    for (i = 0; i < RES / 8; i++)
+	tbl_dir_border[i] = tan((i + 0.5) * (2.0 * PI / RES));
 }
@@ -210,7 +210,7 @@ int Sockbuf_flush(sockbuf_t *sbuf)
     return len;
 }
 
-int Sockbuf_write(sockbuf_t *sbuf, char *buf, int len)
+int Sockbuf_write(sockbuf_t *sbuf, const char *buf, int len)
 {
     if (BIT(sbuf->state, SOCKBUF_WRITE) == 0) {
 	warn("No write to non-writable socket buffer");
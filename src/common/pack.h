@@ -110,9 +110,11 @@
  * 4.F.1.3: cumulative turning
  * 4.F.1.4: balls use polygon styles
  * 4.F.1.5: Possibility to change polygon styles.
+ * 4.F.1.6: Delta compressed frames.
+ * 4.F.1.7: Windowed reliable data with selective acknowledgements.
  */
 #define MAGIC_WORD		0xF4ED
-#define POLYGON_VERSION		0x4F15
+#define POLYGON_VERSION		0x4F17
 #define OLD_VERSION		0x4501
 #ifdef SERVER
 #define	MAGIC (is_polygon_map \
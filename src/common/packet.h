@@ -132,9 +132,9 @@
 /* packet types: 80 - 89 */
 #define PKT_ASTEROID		80
 #define PKT_WORMHOLE		81
-#define PKT_NOT_USED_82		82
-#define PKT_NOT_USED_83		83
-#define PKT_NOT_USED_84		84
+#define PKT_DELTA_FRAME		82	/* since 4.F.1.6 */
+#define PKT_ACK_FRAME		83	/* since 4.F.1.6 */
+#define PKT_SACK		84	/* since 4.F.1.7 */
 #define PKT_NOT_USED_85		85
 #define PKT_NOT_USED_86		86
 #define PKT_NOT_USED_87		87
@@ -0,0 +1,250 @@
+/*
+ * XPilot NG, a multiplayer space war game.
+ *
+ * Copyright (C) 2026 by
+ *
+ *      The XPilot NG Authors, see the AUTHORS file.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PACKETFMT_H
+#define PACKETFMT_H
+
+#ifndef NET_H
+#include "net.h"
+#endif
+#ifndef PACKET_H
+#include "packet.h"
+#endif
+
+/*
+ * Formats of the fixed size packets that are sent most often.
+ *
+ * For every packet below there is an encoder
+ *	int Packet_put_<name>(sockbuf_t *sbuf, field values...);
+ * and a decoder
+ *	int Packet_get_<name>(sockbuf_t *sbuf, field pointers...);
+ * which write and read exactly the same bytes as Packet_printf()
+ * and Packet_scanf() with the format Packet_fmt_<name>, and return
+ * the same values.  The packet type byte is written by the encoder
+ * and skipped by the decoder.  The fields are
+ *
+ *	c	8 bits, passed as int, read into unsigned char
+ *	hd hu	16 bits, passed as int or unsigned, read into short
+ *		or unsigned short
+ *	d u	32 bits, passed as int or unsigned, read into int
+ *		or unsigned
+ *	ld lu	32 bits, passed as long or unsigned long, read into
+ *		long or unsigned long
+ *
+ * When the format of one of these packets changes, change it here
+ * and both the client and the server follow.
+ */
+#define PF_START(F)	F(ld, loops) F(ld, key_ack)
+#define PF_END(F)	F(ld, loops)
+#define PF_SELF(F)	F(hd, x) F(hd, y) F(hd, vx) F(hd, vy) F(c, dir) \
+			F(c, power) F(c, turnspeed) F(c, turnresistance) \
+			F(hd, lock_id) F(hd, lock_dist) F(c, lock_dir) \
+			F(c, check) F(c, fuel_current) F(hd, fuel_sum) \
+			F(hd, fuel_max) F(hd, view_width) \
+			F(hd, view_height) F(c, debris_colors) \
+			F(c, status) F(c, autopilotlight)
+#define PF_DAMAGED(F)	F(c, damaged)
+#define PF_DESTRUCT(F)	F(hd, count)
+#define PF_SHUTDOWN(F)	F(hd, count) F(hd, delay)
+#define PF_TIME(F)	F(hd, count) F(hd, max)
+#define PF_EYES(F)	F(hd, id)
+#define PF_FUEL(F)	F(hu, num) F(hu, fuel)
+#define PF_CANNON(F)	F(hu, num) F(hu, dead_ticks)
+#define PF_TARGET(F)	F(hu, num) F(hu, dead_ticks) F(hu, damage)
+#define PF_POLYSTYLE(F)	F(hu, polyind) F(hu, newstyle)
+#define PF_SHIP(F)	F(hd, x) F(hd, y) F(hd, id) F(c, dir) F(c, flags)
+#define PF_REFUEL(F)	F(hd, x0) F(hd, y0) F(hd, x1) F(hd, y1)
+#define PF_CONNECTOR(F)	F(hd, x0) F(hd, y0) F(hd, x1) F(hd, y1) \
+			F(c, tractor)
+#define PF_TRANS(F)	F(hd, x1) F(hd, y1) F(hd, x2) F(hd, y2)
+#define PF_LASER(F)	F(c, color) F(hd, x) F(hd, y) F(hd, len) F(c, dir)
+#define PF_MISSILE(F)	F(hd, x) F(hd, y) F(c, len) F(c, dir)
+#define PF_BALL(F)	F(hd, x) F(hd, y) F(hd, id)
+#define PF_BALLSTYLE(F)	F(hd, x) F(hd, y) F(hd, id) F(c, style)
+#define PF_MINE(F)	F(hd, x) F(hd, y) F(c, teammine) F(hd, id)
+#define PF_ITEM(F)	F(hd, x) F(hd, y) F(c, type)
+#define PF_WRECKAGE(F)	F(hd, x) F(hd, y) F(c, wrtype) F(c, size) F(c, rot)
+#define PF_ASTEROID(F)	F(hd, x) F(hd, y) F(c, type_size) F(c, rot)
+#define PF_WORMHOLE(F)	F(hd, x) F(hd, y)
+#define PF_ECM(F)	F(hd, x) F(hd, y) F(hd, size)
+#define PF_PAUSED(F)	F(hd, x) F(hd, y) F(hd, count)
+#define PF_APPEARING(F)	F(hd, x) F(hd, y) F(hd, id) F(hd, count)
+#define PF_RADAR(F)	F(hd, x) F(hd, y) F(c, size)
+#define PF_KEYBOARD(F)	F(ld, change)
+#define PF_ACK(F)	F(ld, offset) F(ld, loops)
+#define PF_POINTER(F)	F(hd, movement)
+#define PF_DELTA(F)	F(ld, base) F(hu, len)
+#define PF_ACK_FRAME(F)	F(ld, loops)
+
+#define PACKET_FORMATS(P) \
+    P(start,		PKT_START,		PF_START) \
+    P(end,		PKT_END,		PF_END) \
+    P(self,		PKT_SELF,		PF_SELF) \
+    P(damaged,		PKT_DAMAGED,		PF_DAMAGED) \
+    P(destruct,		PKT_DESTRUCT,		PF_DESTRUCT) \
+    P(shutdown,		PKT_SHUTDOWN,		PF_SHUTDOWN) \
+    P(thrusttime,	PKT_THRUSTTIME,		PF_TIME) \
+    P(shieldtime,	PKT_SHIELDTIME,		PF_TIME) \
+    P(phasingtime,	PKT_PHASINGTIME,	PF_TIME) \
+    P(eyes,		PKT_EYES,		PF_EYES) \
+    P(fuel,		PKT_FUEL,		PF_FUEL) \
+    P(cannon,		PKT_CANNON,		PF_CANNON) \
+    P(target,		PKT_TARGET,		PF_TARGET) \
+    P(polystyle,	PKT_POLYSTYLE,		PF_POLYSTYLE) \
+    P(ship,		PKT_SHIP,		PF_SHIP) \
+    P(refuel,		PKT_REFUEL,		PF_REFUEL) \
+    P(connector,	PKT_CONNECTOR,		PF_CONNECTOR) \
+    P(trans,		PKT_TRANS,		PF_TRANS) \
+    P(laser,		PKT_LASER,		PF_LASER) \
+    P(missile,		PKT_MISSILE,		PF_MISSILE) \
+    P(ball,		PKT_BALL,		PF_BALL) \
+    P(ballstyle,	PKT_BALL,		PF_BALLSTYLE) \
+    P(mine,		PKT_MINE,		PF_MINE) \
+    P(item,		PKT_ITEM,		PF_ITEM) \
+    P(wreckage,		PKT_WRECKAGE,		PF_WRECKAGE) \
+    P(asteroid,		PKT_ASTEROID,		PF_ASTEROID) \
+    P(wormhole,		PKT_WORMHOLE,		PF_WORMHOLE) \
+    P(ecm,		PKT_ECM,		PF_ECM) \
+    P(paused,		PKT_PAUSED,		PF_PAUSED) \
+    P(appearing,	PKT_APPEARING,		PF_APPEARING) \
+    P(radar,		PKT_RADAR,		PF_RADAR) \
+    P(keyboard,		PKT_KEYBOARD,		PF_KEYBOARD) \
+    P(ack,		PKT_ACK,		PF_ACK) \
+    P(pointer_move,	PKT_POINTER_MOVE,	PF_POINTER) \
+    P(delta_frame,	PKT_DELTA_FRAME,	PF_DELTA) \
+    P(ack_frame,	PKT_ACK_FRAME,		PF_ACK_FRAME)
+
+/* Per field type: argument type, pointer type, size, put and get. */
+#define PF_ARG_c	int
+#define PF_ARG_hd	int
+#define PF_ARG_hu	unsigned
+#define PF_ARG_d	int
+#define PF_ARG_u	unsigned
+#define PF_ARG_ld	long
+#define PF_ARG_lu	unsigned long
+
+#define PF_PTR_c	unsigned char
+#define PF_PTR_hd	short
+#define PF_PTR_hu	unsigned short
+#define PF_PTR_d	int
+#define PF_PTR_u	unsigned
+#define PF_PTR_ld	long
+#define PF_PTR_lu	unsigned long
+
+#define PF_SIZE_c	1
+#define PF_SIZE_hd	2
+#define PF_SIZE_hu	2
+#define PF_SIZE_d	4
+#define PF_SIZE_u	4
+#define PF_SIZE_ld	4
+#define PF_SIZE_lu	4
+
+#define PF_PUT8(b, v)	(*(b)++ = (char)(v))
+#define PF_PUT16(b, v)	((b)[0] = (char)((v) >> 8), (b)[1] = (char)(v), \
+			 (b) += 2)
+#define PF_PUT32(b, v)	((b)[0] = (char)((v) >> 24), \
+			 (b)[1] = (char)((v) >> 16), \
+			 (b)[2] = (char)((v) >> 8), (b)[3] = (char)(v), \
+			 (b) += 4)
+#define PF_PUT_c	PF_PUT8
+#define PF_PUT_hd	PF_PUT16
+#define PF_PUT_hu	PF_PUT16
+#define PF_PUT_d	PF_PUT32
+#define PF_PUT_u	PF_PUT32
+#define PF_PUT_ld	PF_PUT32
+#define PF_PUT_lu	PF_PUT32
+
+#define PF_U16(b)	((unsigned)((b)[0] & 0xFF) << 8 | ((b)[1] & 0xFF))
+#define PF_U32(b)	((unsigned)((b)[0] & 0xFF) << 24 \
+			 | (unsigned)((b)[1] & 0xFF) << 16 \
+			 | (unsigned)((b)[2] & 0xFF) << 8 | ((b)[3] & 0xFF))
+#define PF_GET_c(b, p)	(*(p) = (b)[0], (b) += 1)
+#define PF_GET_hd(b, p)	(*(p) = (short)PF_U16(b), (b) += 2)
+#define PF_GET_hu(b, p)	(*(p) = (unsigned short)PF_U16(b), (b) += 2)
+#define PF_GET_d(b, p)	(*(p) = (int)PF_U32(b), (b) += 4)
+#define PF_GET_u(b, p)	(*(p) = PF_U32(b), (b) += 4)
+#define PF_GET_ld(b, p)	(*(p) = (long)(int)PF_U32(b), (b) += 4)
+#define PF_GET_lu(b, p)	(*(p) = (unsigned long)PF_U32(b), (b) += 4)
+
+#define PF_FMT(t, n)		"%" #t
+#define PF_SIZE(t, n)		+ PF_SIZE_##t
+#define PF_COUNT(t, n)		+ 1
+#define PF_ARG(t, n)		, PF_ARG_##t n
+#define PF_PTR(t, n)		, PF_PTR_##t *n
+#define PF_PASS(t, n)		, n
+#define PF_PUT(t, n)		PF_PUT_##t(buf, n);
+#define PF_GET(t, n)		PF_GET_##t(buf, n);
+
+/*
+ * Is there room to write size bytes, checked like Packet_printf()
+ * does: 1 if there is, 0 if a datagram buffer is full and -1 on
+ * error.
+ */
+static inline int Packet_room(sockbuf_t *sbuf, int size)
+{
+    int end = sbuf->size;
+
+    if (sbuf->buf == NULL)
+	return -1;
+    if (last_packet_of_frame != 1)
+	end -= SOCKBUF_WRITE_SPARE;
+    if (sbuf->len + size >= end)
+	return (sbuf->state & SOCKBUF_DGRAM) ? 0 : -1;
+    return 1;
+}
+
+#define PACKET_CODEC(name, type, fields)				\
+static const char Packet_fmt_##name[] = "%c" fields(PF_FMT);		\
+									\
+static inline int Packet_put_##name(sockbuf_t *sbuf fields(PF_ARG))	\
+{									\
+    int n = 1 fields(PF_SIZE), room;					\
+    char *buf;								\
+									\
+    if ((room = Packet_room(sbuf, n)) <= 0)				\
+	return room;							\
+    buf = sbuf->buf + sbuf->len;					\
+    *buf++ = (type);							\
+    fields(PF_PUT)							\
+    sbuf->len += n;							\
+    return n;								\
+}									\
+									\
+static inline int Packet_get_##name(sockbuf_t *sbuf fields(PF_PTR))	\
+{									\
+    char *buf = sbuf->ptr + 1;						\
+									\
+    if (sbuf->ptr + (1 fields(PF_SIZE)) > sbuf->buf + sbuf->len) {	\
+	unsigned char ch;						\
+									\
+	if (sbuf->state & (SOCKBUF_DGRAM | SOCKBUF_LOCK))		\
+	    return 0;							\
+	return Packet_scanf(sbuf, Packet_fmt_##name, &ch fields(PF_PASS)); \
+    }									\
+    fields(PF_GET)							\
+    sbuf->ptr = buf;							\
+    return 1 fields(PF_COUNT);						\
+}
+
+PACKET_FORMATS(PACKET_CODEC)
+
+#endif
@@ -169,6 +169,41 @@ unsigned int randomMT(void)
 }
 
 
+/*
+** Store the next n values of randomMT() in buf, in the same order
+** and with the same effect on the generator state as n calls would
+** have.  The tempering runs over whole stretches of the state vector
+** so the compiler can keep it in a tight loop.
+*/
+void randomMT_fill(unsigned int *buf, int n)
+{
+    uint32 y;
+    int j, k;
+
+    while (n > 0) {
+	if (--left < 0) {
+	    *buf++ = reloadMT();
+	    n--;
+	    continue;
+	}
+	left++;
+
+	k = (left < n) ? left : n;
+	for (j = 0; j < k; j++) {
+	    y = next[j];
+	    y ^= (y >> 11);
+	    y ^= (y << 7) & 0x9D2C5680U;
+	    y ^= (y << 15) & 0xEFC60000U;
+	    buf[j] = (y ^ (y >> 18));
+	}
+	next += k;
+	left -= k;
+	buf += k;
+	n -= k;
+    }
+}
+
+
 #ifdef MT_MAIN
 
 #include <stdio.h>
@@ -0,0 +1,163 @@
+/*
+ * XPilot NG, a multiplayer space war game.
+ *
+ * Copyright (C) 2026 by
+ *
+ *      The XPilot NG Authors, see the AUTHORS file.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/*
+ * Keeping reliable data which arrives out of order, see sack.h.
+ */
+
+#include "xpcommon.h"
+
+int Sack_init(sack_receiver_t *sr)
+{
+    memset(sr, 0, sizeof(*sr));
+    if ((sr->buf = XMALLOC(char, RELIABLE_WINDOW)) == NULL)
+	return -1;
+    return 0;
+}
+
+void Sack_cleanup(sack_receiver_t *sr)
+{
+    XFREE(sr->buf);
+    memset(sr, 0, sizeof(*sr));
+}
+
+/*
+ * Remember the data from rel to end which comes after a gap.
+ */
+static void Sack_keep(sack_receiver_t *sr, long rel, const char *data,
+		      long end)
+{
+    int i, j, pos, n;
+
+    if (end > sr->offset + RELIABLE_WINDOW)
+	end = sr->offset + RELIABLE_WINDOW;
+    if (rel >= end)
+	return;
+
+    /* Ranges i to j - 1 overlap or touch the new data. */
+    for (i = 0; i < sr->num && sr->end[i] < rel; i++)
+	;
+    for (j = i; j < sr->num && sr->start[j] <= end; j++)
+	;
+    if (i == j) {
+	if (sr->num == SACK_RANGES)
+	    /* Too many gaps, the server sends this again. */
+	    return;
+	memmove(&sr->start[i + 1], &sr->start[i],
+		(sr->num - i) * sizeof(sr->start[0]));
+	memmove(&sr->end[i + 1], &sr->end[i],
+		(sr->num - i) * sizeof(sr->end[0]));
+	sr->start[i] = rel;
+	sr->end[i] = end;
+	sr->num++;
+    } else {
+	sr->start[i] = MIN(sr->start[i], rel);
+	sr->end[i] = MAX(sr->end[j - 1], end);
+	memmove(&sr->start[i + 1], &sr->start[j],
+		(sr->num - j) * sizeof(sr->start[0]));
+	memmove(&sr->end[i + 1], &sr->end[j],
+		(sr->num - j) * sizeof(sr->end[0]));
+	sr->num -= j - i - 1;
+    }
+    sr->newest = i;
+
+    pos = rel % RELIABLE_WINDOW;
+    n = MIN(end - rel, RELIABLE_WINDOW - pos);
+    memcpy(sr->buf + pos, data, (size_t)n);
+    memcpy(sr->buf, data + n, (size_t)(end - rel - n));
+}
+
+/*
+ * Take the reliable data of a packet, which starts at offset rel.
+ * Data which is next in order is written to sb, and so is the data
+ * kept after it which is now in order.  Returns how many bytes were
+ * written to sb, or -1 if they didn't fit.
+ */
+int Sack_receive(sack_receiver_t *sr, long rel, const char *data, int len,
+		 sockbuf_t *sb)
+{
+    long end = rel + len;
+    int done, pos, n;
+
+    if (sr->buf == NULL || end <= sr->offset)
+	return 0;
+    if (rel < sr->offset) {
+	data += sr->offset - rel;
+	rel = sr->offset;
+    }
+    if (rel > sr->offset) {
+	Sack_keep(sr, rel, data, end);
+	return 0;
+    }
+
+    if (Sockbuf_write(sb, data, (int)(end - rel)) != end - rel)
+	return -1;
+    done = end - rel;
+    sr->offset = end;
+
+    while (sr->num > 0 && sr->start[0] <= sr->offset) {
+	if (sr->end[0] > sr->offset) {
+	    len = sr->end[0] - sr->offset;
+	    pos = sr->offset % RELIABLE_WINDOW;
+	    n = MIN(len, RELIABLE_WINDOW - pos);
+	    if (Sockbuf_write(sb, sr->buf + pos, n) != n
+		|| Sockbuf_write(sb, sr->buf, len - n) != len - n)
+		return -1;
+	    done += len;
+	    sr->offset = sr->end[0];
+	}
+	sr->num--;
+	memmove(&sr->start[0], &sr->start[1], sr->num * sizeof(sr->start[0]));
+	memmove(&sr->end[0], &sr->end[1], sr->num * sizeof(sr->end[0]));
+	if (sr->newest > 0)
+	    sr->newest--;
+    }
+
+    return done;
+}
+
+/*
+ * Acknowledge the data received so far, with the loops of the
+ * reliable data packet which made us send this.  Returns like
+ * Packet_printf().
+ */
+int Sack_put_ack(sack_receiver_t *sr, sockbuf_t *sb, long loops)
+{
+    int i, j, r, n = MIN(sr->num, SACK_BLOCKS), len = sb->len;
+
+    if ((r = Packet_printf(sb, "%c%ld%ld%c",
+			   PKT_SACK, sr->offset, loops, n)) <= 0)
+	return r;
+    for (i = 0; i < n; i++) {
+	/* The newest range first, then the others from the start. */
+	if (i == 0)
+	    j = sr->newest;
+	else if ((j = i - 1) >= sr->newest)
+	    j++;
+	if ((r = Packet_printf(sb, "%ld%ld", sr->start[j], sr->end[j])) <= 0) {
+	    sb->len = len;
+	    return r;
+	}
+    }
+    return 1;
+}
@@ -0,0 +1,65 @@
+/*
+ * XPilot NG, a multiplayer space war game.
+ *
+ * Copyright (C) 2026 by
+ *
+ *      The XPilot NG Authors, see the AUTHORS file.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef SACK_H
+#define SACK_H
+
+#ifndef NET_H
+#include "net.h"
+#endif
+
+/*
+ * Selective acknowledgement of reliable data, since 4.F.1.7.
+ *
+ * A client which gets reliable data out of order keeps it until
+ * the data before it arrives and acknowledges with a PKT_SACK
+ * packet instead of a PKT_ACK packet:
+ *
+ *	PKT_SACK offset loops n start1 end1 ... startn endn
+ *
+ * offset and loops are like in PKT_ACK, the n (at most SACK_BLOCKS)
+ * blocks are byte ranges after offset which the client also has.
+ * The block with the newest data comes first.  The server keeps at
+ * most RELIABLE_WINDOW bytes after offset unacknowledged, and the
+ * client keeps only data within that window.
+ */
+#define RELIABLE_WINDOW		(32*1024)
+#define SACK_BLOCKS		4
+#define SACK_RANGES		16
+
+typedef struct {
+    long	offset;			/* data received in order */
+    int		num;			/* ranges kept after offset */
+    long	start[SACK_RANGES];	/* sorted, not touching */
+    long	end[SACK_RANGES];
+    int		newest;			/* range with the newest data */
+    char	*buf;			/* RELIABLE_WINDOW bytes, a ring */
+} sack_receiver_t;
+
+int Sack_init(sack_receiver_t *sr);
+void Sack_cleanup(sack_receiver_t *sr);
+int Sack_receive(sack_receiver_t *sr, long rel, const char *data, int len,
+		 sockbuf_t *sb);
+int Sack_put_ack(sack_receiver_t *sr, sockbuf_t *sb, long loops);
+
+#endif
@@ -260,6 +260,7 @@ typedef int socklen_t;
 #include "click.h"
 #include "commonproto.h"
 #include "const.h"
+#include "delta.h"
 #include "error.h"
 #include "item.h"
 #include "list.h"
@@ -267,8 +268,10 @@ typedef int socklen_t;
 #include "net.h"
 #include "pack.h"
 #include "packet.h"
+#include "packetfmt.h"
 #include "portability.h"
 #include "rules.h"
+#include "sack.h"
 #include "setup.h"
 #include "shipshape.h"
 #include "socklib.h"
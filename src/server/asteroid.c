@@ -227,7 +227,7 @@ static void Make_asteroid(clpos_t pos, int size, int dir, double speed)
     double radius;
     shape_t *shape;
 
-    if (NumObjs >= MAX_TOTAL_SHOTS)
+    if (Object_room(OBJ_ASTEROID) == 0)
 	return;
 
     if (size < 1 || size > ASTEROID_MAX_SIZE)
@@ -249,7 +249,7 @@ static void Make_asteroid(clpos_t pos, int size, int dir, double speed)
 			dir) != NO_GROUP)
 	return;
 
-    asteroid = WIRE_PTR(Object_allocate());
+    asteroid = WIRE_PTR(Object_allocate(OBJ_ASTEROID));
     if (asteroid == NULL)
 	return;
 
@@ -0,0 +1,1198 @@
+/*
+ * XPilot NG, a multiplayer space war game.
+ *
+ * Copyright (C) 2026 by
+ *
+ *      The XPilot NG Authors, see the AUTHORS file.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Headless benchmark server, built as xpilots-bench from the normal
+ * server sources with SERVER_BENCH defined.  No contact socket is
+ * opened and the meta server is never contacted.  Main_loop is run
+ * back to back for a fixed number of ticks and the time spent in each
+ * phase is reported as JSON.  Client input can be replayed from a
+ * server recording (-recordMode 2 -recordFileName file); a recording
+ * only replays correctly with the options it was made with.  Some
+ * scenarios instead connect loopback clients which log in, acknowledge
+ * the reliable data and the frames and press random keys.  They
+ * decode delta frames and keep reliable data which arrives out of
+ * order like the real client does.  What the server sends them can
+ * go over a simulated slow link, the report then tells how long the
+ * clients took to log in.
+ *
+ * Bench options, all other arguments go to the server:
+ *   -scenario name	add the options of a canned scenario
+ *   -ticks n		number of ticks to time (default 1000)
+ *   -warmup n		untimed ticks to run first, so that all the
+ *			robots of a scenario have joined
+ *   -json file		write the report to file instead of stdout
+ *   -packets n		only time encoding n frames of packets with
+ *			Packet_printf() and with the packet encoders
+ *   -lines n		only check n random moves against the walls of
+ *			the map with each wall line prefilter, exits
+ *			with status 1 if they don't all agree
+ *   -gravs n		only make n random changes to the gravs of the
+ *			map and check the gravity against a full
+ *			recompute after each, exits with status 1 if
+ *			it differs
+ *   -rtt ms		delay what the loopback clients get by ms
+ *			milliseconds of game time
+ *   -loss percent	and lose this many percent of it
+ *   -version n		protocol version of the loopback clients in hex,
+ *			4F16 for clients without selective acks
+ */
+
+#include "xpserver.h"
+
+#define BENCH_TICKS		1000
+
+/* Where the scenario maps are, set to the source tree by the Makefile. */
+#ifndef BENCH_MAPDIR
+#define BENCH_MAPDIR		CONF_MAPDIR
+#endif
+
+/* The generated robot map: 8 x 4 bases among pillars. */
+#define BENCH_MAP_WIDTH		64
+#define BENCH_MAP_HEIGHT	64
+
+/* Bytes of the reliable data a loopback client keeps, for the setup. */
+#define BENCH_HEAD_SIZE		1024
+
+/* Datagrams which can be on the way to a loopback client. */
+#define BENCH_LINK_SLOTS	128
+
+typedef struct {
+    const char	*name;
+    const char	*desc;
+    const char	*map;			/* map in BENCH_MAPDIR */
+    const char	*(*make_map)(void);	/* or generate a map file */
+    const char	*args[16];
+    unsigned long warmup;		/* untimed ticks before the run */
+    void	(*tick)(void);		/* called before each Main_loop */
+    int		clients;		/* loopback clients to connect */
+    int		rtt, loss;		/* link to the clients */
+} bench_scenario_t;
+
+typedef struct {
+    long	due;			/* main_loops when it arrives */
+    int		len;
+    unsigned char buf[CLIENT_RECV_SIZE];
+} bench_datagram_t;
+
+typedef struct {
+    sock_t	sock;
+    sockbuf_t	w;
+    bool	playing;		/* frames are arriving */
+    long	connected;		/* main_loops when connecting */
+    long	joined;			/* main_loops of the first frame */
+    long	rel_next;		/* reliable data received in order */
+    long	setup_end;		/* where the setup ends, 0 if unknown */
+    long	play_sent;		/* main_loops of the last play packet */
+    long	key_change;
+    bitv_t	keyv[KEYBOARD_SIZE];
+    char	head[BENCH_HEAD_SIZE];	/* start of the reliable data */
+    delta_history_t delta;		/* frames for delta frames */
+    sack_receiver_t sack;		/* reliable data out of order */
+    sockbuf_t	c;			/* reliable data now in order */
+    bench_datagram_t *link;		/* datagrams on the way */
+    int		link_first, link_num;
+} bench_client_t;
+
+static const char *Bench_robot_map(void);
+static void Bench_nukes_tick(void);
+static void Bench_missiles_tick(void);
+static void Bench_detonation_tick(void);
+static void Bench_clients_tick(void);
+
+static bench_scenario_t scenarios[] = {
+    {
+	"nukes",
+	"8 robots and four cluster nukes every 20 ticks on blood-music",
+	"blood-music.xp2",
+	NULL,
+	{ "-minRobots", "8", "-maxRobots", "8", "+restrictRobots",
+	  "-allowNukes", "-allowClusters", "-nukeDebrisLife", "120",
+	  NULL },
+	1000,
+	Bench_nukes_tick
+    },
+    {
+	"robots",
+	"32 robots on a generated 64x64 block map",
+	NULL,
+	Bench_robot_map,
+	{ "-minRobots", "32", "-maxRobots", "32", "+robotsLeave", NULL },
+	3500,
+	NULL
+    },
+    {
+	"missiles",
+	"16 robots and about 400 smart missiles and heat seekers "
+	"on the generated block map",
+	NULL,
+	Bench_robot_map,
+	{ "-minRobots", "16", "-maxRobots", "16", "+restrictRobots",
+	  "-missileLife", "200", NULL },
+	1000,
+	Bench_missiles_tick
+    },
+    {
+	"detonation",
+	"4 robots and a nuke of about 14000 debris every 50 ticks "
+	"on the generated block map",
+	NULL,
+	Bench_robot_map,
+	{ "-minRobots", "4", "-maxRobots", "4", "+restrictRobots",
+	  "-allowNukes", "-nukeMinMines", "36", "-nukeDebrisLife", "40",
+	  "-maxObjectMemory", "32", NULL },
+	500,
+	Bench_detonation_tick
+    },
+    {
+	"polygon",
+	"12 robots on tourmination (1459 polygons)",
+	"tourmination.xp2",
+	NULL,
+	{ "-minRobots", "12", "-maxRobots", "12", NULL },
+	1500,
+	NULL
+    },
+    {
+	"clients",
+	"24 loopback clients and 8 robots on the generated block map",
+	NULL,
+	Bench_robot_map,
+	{ "-minRobots", "8", "-maxRobots", "8", "+restrictRobots", NULL },
+	1000,
+	Bench_clients_tick,
+	24
+    },
+    {
+	"polyclients",
+	"24 loopback clients and 4 robots on polyfishtank3",
+	"polyfishtank3.xp2",
+	NULL,
+	{ "-minRobots", "4", "-maxRobots", "4", "+restrictRobots", NULL },
+	1000,
+	Bench_clients_tick,
+	24
+    },
+    {
+	"join",
+	"8 loopback clients log in on tourmination over a 200 ms link "
+	"which loses 2%",
+	"tourmination.xp2",
+	NULL,
+	{ "-minRobots", "2", "-maxRobots", "2", "+restrictRobots", NULL },
+	0,
+	Bench_clients_tick,
+	8,
+	200,
+	2
+    },
+};
+
+static const char *phase_names[NUM_BENCH_PHASES] = {
+    "Input",
+    "Update_objects",
+    "Robot_update",
+    "Check_collision",
+    "Frame_update"
+};
+
+static bench_scenario_t *scenario;
+static unsigned long bench_ticks = BENCH_TICKS;
+static long bench_warmup = -1;
+static const char *bench_json;
+static unsigned long bench_packets;
+static long bench_lines;
+static long bench_gravs;
+static const char *bench_map;
+static int bench_rtt = -1, bench_loss = -1;
+static unsigned bench_version;
+static long link_delay;
+static unsigned link_seed = 1;
+
+static struct timespec phase_start[NUM_BENCH_PHASES];
+static double phase_time[NUM_BENCH_PHASES];
+static bool phase_ran[NUM_BENCH_PHASES];
+
+/* Per tick samples in microseconds, the last row is the whole tick. */
+static double *samples[NUM_BENCH_PHASES + 1];
+static unsigned long num_samples[NUM_BENCH_PHASES + 1];
+static double bench_seconds;
+static char bench_map_name[MAX_CHARS];
+static int bench_players, bench_objects;
+
+static bench_client_t *clients;
+static int num_clients;
+static unsigned long bench_send_calls, bench_recv_calls;
+static unsigned long client_sent, client_datagrams, client_bytes;
+static unsigned long client_frames, client_delta_frames, client_bad_frames;
+static unsigned long client_lost;
+static unsigned long objects_examined, objects_sent;
+
+static double Bench_elapsed(const struct timespec *t0)
+{
+    struct timespec t1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec - t0->tv_sec) * 1e6
+	+ (t1.tv_nsec - t0->tv_nsec) * 1e-3;
+}
+
+void Bench_start(int phase)
+{
+    clock_gettime(CLOCK_MONOTONIC, &phase_start[phase]);
+}
+
+void Bench_stop(int phase)
+{
+    phase_time[phase] += Bench_elapsed(&phase_start[phase]);
+    phase_ran[phase] = true;
+}
+
+/*
+ * Write an .xp map with 32 bases on a grid of wall pillars,
+ * no shipped map has room for that many robots.
+ */
+static const char *Bench_robot_map(void)
+{
+    static char name[] = "/tmp/xpilots-benchXXXXXX";
+    int fd, x, y;
+    FILE *fp;
+
+    if ((fd = mkstemp(name)) == -1
+	|| (fp = fdopen(fd, "w")) == NULL) {
+	error("Can't create benchmark map %s", name);
+	exit(1);
+    }
+
+    fprintf(fp,
+	    "mapName: Bench robots\n"
+	    "mapAuthor: xpilots-bench\n"
+	    "mapWidth: %d\n"
+	    "mapHeight: %d\n"
+	    "edgeWrap: yes\n"
+	    "mapData: \\multiline: EndOfMapdata\n",
+	    BENCH_MAP_WIDTH, BENCH_MAP_HEIGHT);
+    for (y = 0; y < BENCH_MAP_HEIGHT; y++) {
+	for (x = 0; x < BENCH_MAP_WIDTH; x++) {
+	    char c = ' ';
+
+	    if (x % 8 == 4 && y % 16 == 6)
+		c = '_';
+	    else if (x % 8 == 0 && y % 8 == 0)
+		c = 'x';
+	    putc(c, fp);
+	}
+	putc('\n', fp);
+    }
+    fprintf(fp, "EndOfMapdata\n");
+
+    if (fclose(fp) != 0) {
+	error("Can't write benchmark map %s", name);
+	exit(1);
+    }
+
+    return name;
+}
+
+/*
+ * Detonate four cluster nukes every 20 ticks, next to the
+ * players if there are any so the debris has something to hit.
+ */
+static void Bench_nukes_tick(void)
+{
+    static int next;
+    int i;
+    modifiers_t mods;
+    vector_t zero = { 0.0, 0.0 };
+
+    if (main_loops < 50 || main_loops % 20 != 0)
+	return;
+
+    Mods_clear(&mods);
+    Mods_set(&mods, ModsNuclear, MODS_NUCLEAR);
+    Mods_set(&mods, ModsCluster, 1);
+
+    for (i = 0; i < 4; i++) {
+	clpos_t pos;
+	int count = ObjCount;
+
+	if (NumPlayers > 0) {
+	    player_t *pl = Player_by_index(next++ % NumPlayers);
+
+	    pos.cx = pl->pos.cx + (int)((rfrac() - 0.5) * 8 * BLOCK_CLICKS);
+	    pos.cy = pl->pos.cy + (int)((rfrac() - 0.5) * 8 * BLOCK_CLICKS);
+	} else {
+	    pos.cx = (int)(rfrac() * world->cwidth);
+	    pos.cy = (int)(rfrac() * world->cheight);
+	}
+
+	Place_general_mine(NO_ID, TEAM_NOT_SET, 0, pos, zero, mods);
+
+	/* Make it go off on the next tick. */
+	if (ObjCount > count)
+	    Obj[ObjCount - 1]->life = timeStep;
+    }
+}
+
+/*
+ * Every 50 ticks drop one big nuclear mine a few blocks from a player,
+ * with -nukeMinMines 36 its explosion makes about 14000 debris.
+ */
+static void Bench_detonation_tick(void)
+{
+    static int next;
+    int count = ObjCount;
+    clpos_t pos;
+    modifiers_t mods;
+    vector_t zero = { 0.0, 0.0 };
+
+    if (main_loops < 50 || main_loops % 50 != 0)
+	return;
+
+    Mods_clear(&mods);
+    Mods_set(&mods, ModsNuclear, MODS_NUCLEAR);
+
+    if (NumPlayers > 0) {
+	player_t *pl = Player_by_index(next++ % NumPlayers);
+
+	pos.cx = pl->pos.cx + (int)((rfrac() - 0.5) * 8 * BLOCK_CLICKS);
+	pos.cy = pl->pos.cy + (int)((rfrac() - 0.5) * 8 * BLOCK_CLICKS);
+    } else {
+	pos.cx = (int)(rfrac() * world->cwidth);
+	pos.cy = (int)(rfrac() * world->cheight);
+    }
+
+    Place_general_mine(NO_ID, TEAM_NOT_SET, 0, pos, zero, mods);
+
+    /* Make it go off on the next tick. */
+    if (ObjCount > count)
+	Obj[ObjCount - 1]->life = timeStep;
+}
+
+/*
+ * Launch four missiles every other tick, smart missiles locked on a
+ * player and heat seekers which have to find one, a few blocks from
+ * the players.
+ */
+static void Bench_missiles_tick(void)
+{
+    static int next;
+    int i;
+    modifiers_t mods;
+
+    if (main_loops < 50 || main_loops % 2 != 0 || NumPlayers == 0)
+	return;
+
+    Mods_clear(&mods);
+
+    for (i = 0; i < 4; i++) {
+	player_t *pl = Player_by_index(next++ % NumPlayers);
+	clpos_t pos;
+
+	pos.cx = pl->pos.cx + (int)((rfrac() - 0.5) * 16 * BLOCK_CLICKS);
+	pos.cy = pl->pos.cy + (int)((rfrac() - 0.5) * 16 * BLOCK_CLICKS);
+	pos = World_wrap_clpos(pos);
+
+	Fire_general_shot(NO_ID, TEAM_NOT_SET, pos,
+			  (i & 1) ? OBJ_HEAT_SHOT : OBJ_SMART_SHOT,
+			  (int)(rfrac() * RES), mods, pl->id);
+    }
+}
+
+static long Bench_get_long(const unsigned char *p)
+{
+    return (long)(int32_t)(((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16)
+			   | ((uint32_t)p[2] << 8) | (uint32_t)p[3]);
+}
+
+/*
+ * Connect the loopback clients.  The server side is set up the way
+ * the contact socket would do it, then the clients verify.
+ */
+static void Bench_clients_connect(int n)
+{
+    int i, port;
+    char nick[MAX_CHARS];
+    bench_client_t *bc;
+    unsigned version = MY_VERSION;
+
+    /*
+     * Like Contact(), never hand out a version the map can't serve.
+     */
+    if (bench_version)
+	version = MAX(MIN(bench_version, MY_VERSION), MIN_CLIENT_VERSION);
+
+    if ((clients = XCALLOC(bench_client_t, n)) == NULL) {
+	error("Can't allocate benchmark clients");
+	exit(1);
+    }
+    if (bench_rtt < 0)
+	bench_rtt = scenario->rtt;
+    if (bench_loss < 0)
+	bench_loss = scenario->loss;
+    link_delay = bench_rtt * FPS / 1000;
+
+    for (i = 0; i < n; i++) {
+	bc = &clients[i];
+	snprintf(nick, sizeof(nick), "Bench%d", i + 1);
+	port = Setup_connection((char *)"bench", nick, (char *)":0",
+				TEAM_NOT_SET, (char *)"127.0.0.1",
+				(char *)"localhost", version);
+	if (port == -1
+	    || sock_open_udp(&bc->sock, (char *)"127.0.0.1", 0) == SOCK_IS_ERROR
+	    || sock_connect(&bc->sock, (char *)"127.0.0.1", port) == -1
+	    || sock_set_non_blocking(&bc->sock, 1) == -1
+	    || Sockbuf_init(&bc->w, &bc->sock, CLIENT_SEND_SIZE,
+			    SOCKBUF_WRITE | SOCKBUF_DGRAM) == -1) {
+	    error("Can't connect benchmark client %s", nick);
+	    exit(1);
+	}
+	if ((version >= 0x4F16 && Delta_init(&bc->delta) == -1)
+	    || (version >= 0x4F17
+		&& (Sack_init(&bc->sack) == -1
+		    || Sockbuf_init(&bc->c, NULL,
+				    RELIABLE_WINDOW + CLIENT_RECV_SIZE,
+				    SOCKBUF_WRITE | SOCKBUF_READ
+				    | SOCKBUF_LOCK) == -1))
+	    || ((bench_rtt > 0 || bench_loss > 0)
+		&& (bc->link = XMALLOC(bench_datagram_t,
+				       BENCH_LINK_SLOTS)) == NULL)) {
+	    error("Can't allocate benchmark client buffers");
+	    exit(1);
+	}
+	bc->connected = main_loops;
+	Packet_printf(&bc->w, "%c%s%s", PKT_VERIFY, "bench", nick);
+	Sockbuf_flush(&bc->w);
+	num_clients++;
+    }
+}
+
+/*
+ * The reliable data is at the end of a datagram, acknowledge it
+ * and keep the start of it, which has the setup header.
+ */
+static int Bench_reliable_offset(const unsigned char *buf, int n)
+{
+    int i, len;
+
+    for (i = n - 11; i >= 0; i--) {
+	if (buf[i] != PKT_RELIABLE)
+	    continue;
+	len = (buf[i + 1] << 8) | buf[i + 2];
+	if (i + 11 + len == n)
+	    break;
+    }
+    return i;
+}
+
+static void Bench_client_reliable(bench_client_t *bc, unsigned char *buf,
+				  int n)
+{
+    int i, len;
+    long off, loops;
+
+    if ((i = Bench_reliable_offset(buf, n)) < 0)
+	return;
+    len = (buf[i + 1] << 8) | buf[i + 2];
+
+    off = Bench_get_long(&buf[i + 3]);
+    loops = Bench_get_long(&buf[i + 7]);
+    if (bc->sack.buf != NULL) {
+	Sockbuf_clear(&bc->c);
+	if (Sack_receive(&bc->sack, off, (char *)&buf[i + 11], len,
+			 &bc->c) > 0 && bc->rel_next < BENCH_HEAD_SIZE)
+	    memcpy(&bc->head[bc->rel_next], bc->c.buf,
+		   (size_t)MIN(bc->c.len, BENCH_HEAD_SIZE - bc->rel_next));
+	bc->rel_next = bc->sack.offset;
+	Sack_put_ack(&bc->sack, &bc->w, loops);
+    } else {
+	if (off <= bc->rel_next && off + len > bc->rel_next) {
+	    if (bc->rel_next < BENCH_HEAD_SIZE)
+		memcpy(&bc->head[off], &buf[i + 11],
+		       (size_t)MIN(len, BENCH_HEAD_SIZE - off));
+	    bc->rel_next = off + len;
+	}
+	Packet_printf(&bc->w, "%c%ld%ld", PKT_ACK, bc->rel_next, loops);
+    }
+    Sockbuf_flush(&bc->w);
+    client_sent++;
+
+    /*
+     * The verify reply and magic come first, then the setup header,
+     * which ends with some strings, and the map data.
+     */
+    if (bc->setup_end == 0) {
+	long pos = is_polygon_map ? 8 + 16 : 8 + 18,
+	    end = MIN(bc->rel_next, BENCH_HEAD_SIZE);
+	char *nul;
+
+	for (i = is_polygon_map ? 3 : 2; i > 0 && pos < end; i--) {
+	    if ((nul = memchr(&bc->head[pos], '\0', end - pos)) == NULL)
+		break;
+	    pos = nul - bc->head + 1;
+	}
+	if (i == 0)
+	    bc->setup_end = pos + Bench_get_long((unsigned char *)&bc->head[8]);
+    }
+}
+
+/*
+ * Make the packets of a frame from a delta frame if it is one,
+ * remember them and acknowledge the frame.
+ */
+static void Bench_client_frame(bench_client_t *bc, unsigned char *buf,
+			       int n)
+{
+    const int start = 1 PF_START(PF_SIZE), end = 1 PF_END(PF_SIZE),
+	delta = 1 PF_DELTA(PF_SIZE);
+    unsigned char frame[DELTA_FRAME_SIZE], *p = buf + start;
+    const unsigned char *base;
+    long loops = Bench_get_long(&buf[1]);
+    int i, len, base_len;
+
+    if (bc->delta.buf == NULL)
+	return;
+    client_frames++;
+    if (n >= start + delta && p[0] == PKT_DELTA_FRAME)
+	n = start + delta + ((p[5] << 8) | p[6]) + end;
+    else if ((i = Bench_reliable_offset(buf, n)) >= 0)
+	n = i;
+    if (n < start + end
+	|| buf[n - end] != PKT_END
+	|| Bench_get_long(&buf[n - end + 1]) != loops) {
+	client_bad_frames++;
+	return;
+    }
+    len = n - end - start;
+    if (p[0] == PKT_DELTA_FRAME) {
+	client_delta_frames++;
+	base = Delta_find(&bc->delta, Bench_get_long(&p[1]), &base_len);
+	if (base == NULL
+	    || (len = Delta_decode(base, base_len, p + delta, len - delta,
+				   frame, sizeof(frame))) < 0) {
+	    client_bad_frames++;
+	    return;
+	}
+	p = frame;
+    }
+    Delta_store(&bc->delta, loops, p, len);
+    Packet_put_ack_frame(&bc->w, loops);
+    Sockbuf_flush(&bc->w);
+    client_sent++;
+}
+
+static void Bench_client_datagram(bench_client_t *bc, unsigned char *buf,
+				  int n)
+{
+    if (buf[0] == PKT_START) {
+	if (!bc->playing)
+	    bc->joined = main_loops;
+	bc->playing = true;
+	Bench_client_frame(bc, buf, n);
+    }
+    Bench_client_reliable(bc, buf, n);
+}
+
+/*
+ * Put a datagram from the server on the slow link to a client,
+ * unless it gets lost or the link is full.
+ */
+static void Bench_link_send(bench_client_t *bc, const unsigned char *buf,
+			    int n)
+{
+    bench_datagram_t *d;
+
+    link_seed = link_seed * 1103515245 + 12345;
+    if ((int)((link_seed >> 16) % 100) < bench_loss
+	|| bc->link_num == BENCH_LINK_SLOTS) {
+	client_lost++;
+	return;
+    }
+    d = &bc->link[(bc->link_first + bc->link_num++) % BENCH_LINK_SLOTS];
+    d->due = main_loops + link_delay;
+    d->len = n;
+    memcpy(d->buf, buf, (size_t)n);
+}
+
+/*
+ * Take a datagram which has arrived over the slow link.
+ */
+static int Bench_link_receive(bench_client_t *bc, unsigned char *buf)
+{
+    bench_datagram_t *d = &bc->link[bc->link_first];
+    int n;
+
+    if (bc->link == NULL || bc->link_num == 0 || d->due > main_loops)
+	return 0;
+    n = d->len;
+    memcpy(buf, d->buf, (size_t)n);
+    bc->link_first = (bc->link_first + 1) % BENCH_LINK_SLOTS;
+    bc->link_num--;
+    return n;
+}
+
+/*
+ * Read what the server sent the clients, ask to play once the setup
+ * has arrived, and press some keys.
+ */
+static void Bench_clients_tick(void)
+{
+    static unsigned seed = 1;
+    unsigned char buf[CLIENT_RECV_SIZE];
+    bench_client_t *bc;
+    int i, n;
+
+    /* Played back connections come from the recording. */
+    if (clients == NULL && !rplayback)
+	Bench_clients_connect(scenario->clients);
+
+    for (i = 0; i < num_clients; i++) {
+	bc = &clients[i];
+	while ((n = sock_read(&bc->sock, (char *)buf, sizeof(buf))) > 0) {
+	    client_datagrams++;
+	    client_bytes += n;
+	    if (bc->link != NULL)
+		Bench_link_send(bc, buf, n);
+	    else
+		Bench_client_datagram(bc, buf, n);
+	}
+	while ((n = Bench_link_receive(bc, buf)) > 0)
+	    Bench_client_datagram(bc, buf, n);
+
+	if (!bc->playing) {
+	    if (bc->setup_end > 0 && bc->rel_next >= bc->setup_end
+		&& bc->play_sent + FPS <= main_loops) {
+		Packet_printf(&bc->w, "%c", PKT_PLAY);
+		Sockbuf_flush(&bc->w);
+		client_sent++;
+		bc->play_sent = main_loops;
+	    }
+	    continue;
+	}
+
+	if ((main_loops + i) % 4 != 0)
+	    continue;
+	seed = seed * 1103515245 + 12345;
+	memset(bc->keyv, 0, sizeof(bc->keyv));
+	if (seed & (1 << 16))
+	    BITV_SET(bc->keyv, KEY_THRUST);
+	if (seed & (1 << 17))
+	    BITV_SET(bc->keyv, KEY_FIRE_SHOT);
+	if (seed & (1 << 18))
+	    BITV_SET(bc->keyv, (seed & (1 << 19))
+		     ? KEY_TURN_LEFT : KEY_TURN_RIGHT);
+	Packet_printf(&bc->w, "%c%ld", PKT_KEYBOARD, ++bc->key_change);
+	Sockbuf_write(&bc->w, (char *)bc->keyv, KEYBOARD_SIZE);
+	Sockbuf_flush(&bc->w);
+	client_sent++;
+    }
+}
+
+/*
+ * A frame of the packets that are sent the most, made up from i.
+ */
+static void Bench_frame_printf(sockbuf_t *sb, int i)
+{
+    int j;
+
+    Packet_printf(sb, "%c%ld%ld", PKT_START, (long)i, (long)i);
+    Packet_printf(sb, "%c%hd%hd%hd%hd%c%c%c%c%hd%hd%c%c%c%hd%hd%hd%hd%c%c%c",
+		  PKT_SELF, i, i + 1, 3, -4, 5, 6, 7, 8, 9, 10, 11, 12,
+		  13, 14, 15, 16, 17, 18, 19, 20);
+    for (j = 0; j < 16; j++)
+	Packet_printf(sb, "%c%hd%hd%hd%c%c", PKT_SHIP, i + j, i - j, j,
+		      j & 127, j & 31);
+    for (j = 0; j < 48; j++)
+	Packet_printf(sb, "%c%hd%hd%c", PKT_RADAR, i + j, i - j, j & 3);
+    for (j = 0; j < 8; j++) {
+	Packet_printf(sb, "%c%hd%hd%c", PKT_ITEM, i + j, i - j, j);
+	Packet_printf(sb, "%c%hd%hd%c%hd", PKT_MINE, i + j, i - j, 0, j);
+	Packet_printf(sb, "%c%hd%hd%c%c", PKT_MISSILE, i + j, i - j, 15, j);
+	Packet_printf(sb, "%c%hd%hd%hd", PKT_ECM, i + j, i - j, 30);
+	Packet_printf(sb, "%c%hd%hd%hd%hd%c", PKT_CONNECTOR,
+		      i, j, i + j, i - j, 0);
+    }
+    Packet_printf(sb, "%c%ld", PKT_END, (long)i);
+}
+
+static void Bench_frame_put(sockbuf_t *sb, int i)
+{
+    int j;
+
+    Packet_put_start(sb, (long)i, (long)i);
+    Packet_put_self(sb, i, i + 1, 3, -4, 5, 6, 7, 8, 9, 10, 11, 12,
+		    13, 14, 15, 16, 17, 18, 19, 20);
+    for (j = 0; j < 16; j++)
+	Packet_put_ship(sb, i + j, i - j, j, j & 127, j & 31);
+    for (j = 0; j < 48; j++)
+	Packet_put_radar(sb, i + j, i - j, j & 3);
+    for (j = 0; j < 8; j++) {
+	Packet_put_item(sb, i + j, i - j, j);
+	Packet_put_mine(sb, i + j, i - j, 0, j);
+	Packet_put_missile(sb, i + j, i - j, 15, j);
+	Packet_put_ecm(sb, i + j, i - j, 30);
+	Packet_put_connector(sb, i, j, i + j, i - j, 0);
+    }
+    Packet_put_end(sb, (long)i);
+}
+
+/*
+ * Encode n frames with Packet_printf() and with the encoders from
+ * packetfmt.h, check that they give the same bytes and report how
+ * many bytes per second each of them encodes.
+ */
+static void Bench_packets(unsigned long n)
+{
+    sockbuf_t sb[2];
+    struct timespec t0;
+    double t[2], bytes = 0.0;
+    bool same = true;
+    unsigned long i;
+    int k;
+    FILE *fp = stdout;
+
+    for (k = 0; k < 2; k++) {
+	if (Sockbuf_init(&sb[k], NULL, SERVER_SEND_SIZE,
+			 SOCKBUF_WRITE | SOCKBUF_DGRAM) == -1) {
+	    error("Can't allocate benchmark socket buffers");
+	    exit(1);
+	}
+    }
+    for (i = 0; i < 100; i++) {
+	Sockbuf_clear(&sb[0]);
+	Sockbuf_clear(&sb[1]);
+	Bench_frame_printf(&sb[0], (int)i * 997);
+	Bench_frame_put(&sb[1], (int)i * 997);
+	if (sb[0].len != sb[1].len
+	    || memcmp(sb[0].buf, sb[1].buf, (size_t)sb[0].len))
+	    same = false;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < n; i++) {
+	Sockbuf_clear(&sb[0]);
+	Bench_frame_printf(&sb[0], (int)i);
+	bytes += sb[0].len;
+    }
+    t[0] = Bench_elapsed(&t0) * 1e-6;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < n; i++) {
+	Sockbuf_clear(&sb[1]);
+	Bench_frame_put(&sb[1], (int)i);
+    }
+    t[1] = Bench_elapsed(&t0) * 1e-6;
+
+    if (bench_json && (fp = fopen(bench_json, "w")) == NULL) {
+	error("Can't open %s", bench_json);
+	fp = stdout;
+    }
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"frames\": %lu,\n", n);
+    fprintf(fp, "  \"frame_bytes\": %d,\n", sb[1].len);
+    fprintf(fp, "  \"same_bytes\": %s,\n", same ? "true" : "false");
+    fprintf(fp, "  \"Packet_printf\": { \"seconds\": %.3f, "
+	    "\"mbytes_per_s\": %.1f },\n",
+	    t[0], t[0] > 0 ? bytes / t[0] * 1e-6 : 0.0);
+    fprintf(fp, "  \"encoders\": { \"seconds\": %.3f, "
+	    "\"mbytes_per_s\": %.1f }\n",
+	    t[1], t[1] > 0 ? bytes / t[1] * 1e-6 : 0.0);
+    fprintf(fp, "}\n");
+    if (fp != stdout)
+	fclose(fp);
+
+    Sockbuf_cleanup(&sb[0]);
+    Sockbuf_cleanup(&sb[1]);
+}
+
+/*
+ * Move points along n random paths with every wall line prefilter,
+ * see Lines_prefilter_check(), and report whether they all agree.
+ */
+static void Bench_lines(long n)
+{
+    struct timespec t0;
+    long bad, tested;
+    double t;
+    FILE *fp = stdout;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    bad = Lines_prefilter_check(n, &tested);
+    t = Bench_elapsed(&t0) * 1e-6;
+
+    if (bench_json && (fp = fopen(bench_json, "w")) == NULL) {
+	error("Can't open %s", bench_json);
+	fp = stdout;
+    }
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"map\": \"%s\",\n", bench_map_name);
+    fprintf(fp, "  \"prefilter\": \"%s\",\n",
+#if defined(__AVX2__)
+	    "avx2"
+#elif defined(__SSE2__)
+	    "sse2"
+#else
+	    "c"
+#endif
+	    );
+    fprintf(fp, "  \"moves\": %ld,\n", n);
+    fprintf(fp, "  \"moves_with_lines\": %ld,\n", tested);
+    fprintf(fp, "  \"mismatches\": %ld,\n", bad);
+    fprintf(fp, "  \"seconds\": %.3f\n", t);
+    fprintf(fp, "}\n");
+    if (fp != stdout)
+	fclose(fp);
+
+    if (bad > 0) {
+	error("%ld of %ld moves differ between the line prefilters",
+	      bad, n);
+	exit(1);
+    }
+}
+
+/*
+ * Make n random grav changes, see Gravity_check(), and report whether
+ * recomputing only the blocks around the changed grav always gives
+ * the same gravity as a full recompute.
+ */
+static void Bench_gravs(long n)
+{
+    long bad;
+    double changed_us, full_us;
+    FILE *fp = stdout;
+
+    bad = Gravity_check(n, &changed_us, &full_us);
+
+    if (bench_json && (fp = fopen(bench_json, "w")) == NULL) {
+	error("Can't open %s", bench_json);
+	fp = stdout;
+    }
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"map\": \"%s\",\n", bench_map_name);
+    fprintf(fp, "  \"gravs\": %d,\n", Num_gravs());
+    fprintf(fp, "  \"compact\": %s,\n",
+	    world->gravity16 ? "true" : "false");
+    fprintf(fp, "  \"changes\": %ld,\n", n);
+    fprintf(fp, "  \"mismatches\": %ld,\n", bad);
+    fprintf(fp, "  \"changed_seconds\": %.6f,\n", changed_us * 1e-6);
+    fprintf(fp, "  \"full_seconds\": %.6f\n", full_us * 1e-6);
+    fprintf(fp, "}\n");
+    if (fp != stdout)
+	fclose(fp);
+
+    if (bad > 0) {
+	error("%ld of %ld grav changes differ from a full recompute",
+	      bad, n);
+	exit(1);
+    }
+}
+
+/*
+ * Strip the bench options and put the options of the scenario
+ * in front of the remaining arguments, so that those can still
+ * override them.
+ */
+void Bench_init(int *argcp, char ***argvp)
+{
+    int argc = *argcp, i, j, n = 0;
+    char **argv = *argvp, **nargv;
+
+    nargv = XMALLOC(char *, argc + NELEM(scenarios[0].args) + 8);
+    if (nargv == NULL) {
+	error("Can't allocate benchmark arguments");
+	exit(1);
+    }
+    nargv[n++] = argv[0];
+
+    for (i = 1; i < argc; i++) {
+	if (i + 1 < argc && !strcmp(argv[i], "-scenario")) {
+	    i++;
+	    for (j = 0; j < NELEM(scenarios); j++) {
+		if (!strcasecmp(argv[i], scenarios[j].name))
+		    scenario = &scenarios[j];
+	    }
+	    if (scenario == NULL) {
+		warn("Unknown scenario \"%s\", known scenarios are:", argv[i]);
+		for (j = 0; j < NELEM(scenarios); j++)
+		    warn("    %-10s %s", scenarios[j].name, scenarios[j].desc);
+		exit(1);
+	    }
+	}
+	else if (i + 1 < argc && !strcmp(argv[i], "-ticks"))
+	    bench_ticks = strtoul(argv[++i], NULL, 10);
+	else if (i + 1 < argc && !strcmp(argv[i], "-warmup"))
+	    bench_warmup = atol(argv[++i]);
+	else if (i + 1 < argc && !strcmp(argv[i], "-json"))
+	    bench_json = argv[++i];
+	else if (i + 1 < argc && !strcmp(argv[i], "-packets"))
+	    bench_packets = strtoul(argv[++i], NULL, 10);
+	else if (i + 1 < argc && !strcmp(argv[i], "-lines"))
+	    bench_lines = atol(argv[++i]);
+	else if (i + 1 < argc && !strcmp(argv[i], "-gravs"))
+	    bench_gravs = atol(argv[++i]);
+	else if (i + 1 < argc && !strcmp(argv[i], "-rtt"))
+	    bench_rtt = atoi(argv[++i]);
+	else if (i + 1 < argc && !strcmp(argv[i], "-loss"))
+	    bench_loss = atoi(argv[++i]);
+	else if (i + 1 < argc && !strcmp(argv[i], "-version"))
+	    bench_version = strtoul(argv[++i], NULL, 16);
+    }
+
+    if (bench_packets > 0) {
+	Bench_packets(bench_packets);
+	exit(0);
+    }
+
+    if (scenario) {
+	for (j = 0; scenario->args[j]; j++)
+	    nargv[n++] = (char *)scenario->args[j];
+	nargv[n++] = (char *)"-map";
+	if (scenario->make_map)
+	    nargv[n++] = (char *)(bench_map = scenario->make_map());
+	else {
+	    static char path[PATH_MAX];
+
+	    snprintf(path, sizeof(path), "%s%s", BENCH_MAPDIR, scenario->map);
+	    nargv[n++] = path;
+	}
+    }
+
+    for (i = 1; i < argc; i++) {
+	if (i + 1 < argc
+	    && (!strcmp(argv[i], "-scenario")
+		|| !strcmp(argv[i], "-ticks")
+		|| !strcmp(argv[i], "-warmup")
+		|| !strcmp(argv[i], "-json")
+		|| !strcmp(argv[i], "-lines")
+		|| !strcmp(argv[i], "-gravs")
+		|| !strcmp(argv[i], "-rtt")
+		|| !strcmp(argv[i], "-loss")
+		|| !strcmp(argv[i], "-version"))) {
+	    i++;
+	    continue;
+	}
+	nargv[n++] = argv[i];
+    }
+    nargv[n] = NULL;
+
+    *argcp = n;
+    *argvp = nargv;
+}
+
+static int Bench_cmp(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void Bench_print_phase(FILE *fp, const char *name, double *v,
+			      unsigned long n, bool last)
+{
+    double p50 = 0.0, p99 = 0.0, max = 0.0;
+
+    if (n > 0) {
+	qsort(v, n, sizeof(double), Bench_cmp);
+	p50 = v[(unsigned long)(0.50 * (n - 1) + 0.5)];
+	p99 = v[(unsigned long)(0.99 * (n - 1) + 0.5)];
+	max = v[n - 1];
+    }
+    fprintf(fp, "    \"%s\": { \"count\": %lu, \"p50_us\": %.2f, "
+	    "\"p99_us\": %.2f, \"max_us\": %.2f }%s\n",
+	    name, n, p50, p99, max, last ? "" : ",");
+}
+
+static void Bench_report(void)
+{
+    FILE *fp = stdout;
+    int i, joined = 0;
+    double t, join_mean = 0.0, join_max = 0.0;
+
+    for (i = 0; i < num_clients; i++) {
+	if (clients[i].joined == 0)
+	    continue;
+	t = (clients[i].joined - clients[i].connected) * 1000.0 / FPS;
+	join_mean += t;
+	join_max = MAX(join_max, t);
+	joined++;
+    }
+    if (joined > 0)
+	join_mean /= joined;
+
+    if (bench_json && (fp = fopen(bench_json, "w")) == NULL) {
+	error("Can't open %s", bench_json);
+	fp = stdout;
+    }
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"scenario\": \"%s\",\n", scenario ? scenario->name : "");
+    fprintf(fp, "  \"map\": \"%s\",\n", bench_map_name);
+    fprintf(fp, "  \"ticks\": %lu,\n", num_samples[NUM_BENCH_PHASES]);
+    fprintf(fp, "  \"players\": %d,\n", bench_players);
+    fprintf(fp, "  \"objects\": %d,\n", bench_objects);
+    fprintf(fp, "  \"clients\": %d,\n", num_clients);
+    fprintf(fp, "  \"seconds\": %.3f,\n", bench_seconds);
+    fprintf(fp, "  \"network\": { \"send_calls\": %lu, "
+	    "\"recv_calls\": %lu, \"client_sent\": %lu, "
+	    "\"client_datagrams\": %lu, \"client_bytes\": %lu, "
+	    "\"client_frames\": %lu, \"client_delta_frames\": %lu, "
+	    "\"client_bad_frames\": %lu, \"client_lost\": %lu },\n",
+	    bench_send_calls, sock_recv_calls - bench_recv_calls,
+	    client_sent, client_datagrams, client_bytes,
+	    client_frames, client_delta_frames, client_bad_frames,
+	    client_lost);
+    fprintf(fp, "  \"join\": { \"rtt_ms\": %d, \"loss_percent\": %d, "
+	    "\"joined\": %d, \"mean_ms\": %.0f, \"max_ms\": %.0f },\n",
+	    MAX(bench_rtt, 0), MAX(bench_loss, 0), joined,
+	    join_mean, join_max);
+    fprintf(fp, "  \"frames\": { \"objects_examined\": %lu, "
+	    "\"objects_sent\": %lu },\n", objects_examined, objects_sent);
+    fprintf(fp, "  \"phases\": {\n");
+    for (i = 0; i < NUM_BENCH_PHASES; i++)
+	Bench_print_phase(fp, phase_names[i], samples[i], num_samples[i],
+			  false);
+    Bench_print_phase(fp, "Main_loop", samples[NUM_BENCH_PHASES],
+		      num_samples[NUM_BENCH_PHASES], true);
+    fprintf(fp, "  }\n");
+    fprintf(fp, "}\n");
+
+    if (fp != stdout)
+	fclose(fp);
+}
+
+/*
+ * Objects looked at and put in frames for all connections so far.
+ */
+static void Bench_objects(long *examined, long *sent)
+{
+    int i;
+
+    *examined = *sent = 0;
+    for (i = 0; i < NumPlayers; i++) {
+	player_t *pl = Player_by_index(i);
+
+	if (pl->conn != NULL) {
+	    *examined += pl->conn->objects_examined;
+	    *sent += pl->conn->objects_sent;
+	}
+    }
+}
+
+static void Bench_warmup_tick(void)
+{
+    if (scenario && scenario->tick)
+	scenario->tick();
+    Main_loop();
+}
+
+static void Bench_tick(void)
+{
+    struct timespec t0;
+    unsigned long calls;
+    long examined0, sent0, examined1, sent1;
+    double t;
+    int i;
+
+    if (scenario && scenario->tick)
+	scenario->tick();
+
+    calls = sock_send_calls;
+    Bench_objects(&examined0, &sent0);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    Main_loop();
+    t = Bench_elapsed(&t0);
+    bench_send_calls += sock_send_calls - calls;
+    Bench_objects(&examined1, &sent1);
+    objects_examined += examined1 - examined0;
+    objects_sent += sent1 - sent0;
+
+    bench_seconds += t * 1e-6;
+    for (i = 0; i < NUM_BENCH_PHASES; i++) {
+	if (phase_ran[i])
+	    samples[i][num_samples[i]++] = phase_time[i];
+	phase_time[i] = 0.0;
+	phase_ran[i] = false;
+    }
+    samples[i][num_samples[i]++] = t;
+
+    bench_players = NumPlayers;
+    bench_objects = ObjCount;
+}
+
+/*
+ * Run the game loop for the requested number of ticks and report.
+ * If a recording ends first the server exits through End_game(),
+ * the report is still written from the exit handler.
+ */
+void Bench_run(void)
+{
+    int i;
+
+    if (bench_map)
+	unlink(bench_map);
+    strlcpy(bench_map_name, world->name, sizeof(bench_map_name));
+
+    if (bench_lines > 0) {
+	Bench_lines(bench_lines);
+	exit(0);
+    }
+    if (bench_gravs > 0) {
+	Bench_gravs(bench_gravs);
+	exit(0);
+    }
+
+    for (i = 0; i <= NUM_BENCH_PHASES; i++) {
+	if ((samples[i] = XCALLOC(double, bench_ticks + 1)) == NULL) {
+	    error("Can't allocate benchmark samples");
+	    exit(1);
+	}
+    }
+
+    /* Keep the game going without human players. */
+    options.RawMode = true;
+    options.NoQuit = true;
+    options.reportToMetaServer = false;
+
+    if (bench_warmup < 0)
+	bench_warmup = scenario ? scenario->warmup : 0;
+    sched_ticks(Bench_warmup_tick, bench_warmup);
+    memset(phase_time, 0, sizeof(phase_time));
+    memset(phase_ran, 0, sizeof(phase_ran));
+    bench_recv_calls = sock_recv_calls;
+    client_sent = 0;
+    client_datagrams = 0;
+    client_bytes = 0;
+    client_frames = 0;
+    client_delta_frames = 0;
+    client_bad_frames = 0;
+    client_lost = 0;
+    objects_examined = 0;
+    objects_sent = 0;
+
+    xpprintf("%s Running %lu ticks%s%s\n", showtime(), bench_ticks,
+	     scenario ? " of scenario " : "", scenario ? scenario->name : "");
+
+    atexit(Bench_report);
+    sched_ticks(Bench_tick, bench_ticks);
+
+    exit(0);
+}
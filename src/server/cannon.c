@@ -176,7 +176,7 @@ void Cannon_throw_items(cannon_t *c)
 					    - world->items[i].min_per_pack));
 	    LIMIT(amount, 0, c->item[i]);
 	    if (rfrac() < (options.dropItemOnKillProb * CANNON_DROP_ITEM_PROB)
-		&& (item = ITEM_PTR(Object_allocate())) != NULL) {
+		&& (item = ITEM_PTR(Object_allocate(OBJ_ITEM))) != NULL) {
 
 		item->type = OBJ_ITEM;
 		item->item_type = i;
@@ -284,8 +284,7 @@ static int Cannon_in_danger(cannon_t *c)
     const uint32_t kill_shots = (KILLING_SHOTS) | OBJ_MINE_BIT | OBJ_SHOT_BIT
 	| OBJ_PULSE_BIT | OBJ_SMART_SHOT_BIT | OBJ_HEAT_SHOT_BIT
 	| OBJ_TORPEDO_BIT | OBJ_ASTEROID_BIT;
-    object_t *shot, **obj_list;
-    const int max_objs = 100;
+    object_t *shot, **obj_list, *obj_buf[100];
     int obj_count, i, danger = false;
     int npx, npy, tdx, tdy;
     int cpx = CLICK_TO_PIXEL(c->pos.cx), cpy = CLICK_TO_PIXEL(c->pos.cy);
@@ -294,10 +293,11 @@ static int Cannon_in_danger(cannon_t *c)
     if (smartness == 0)
 	return false;
 
-    if (NumObjs >= options.cellGetObjectsThreshold)
-	Cell_get_objects(c->pos, range, max_objs,
-			 &obj_list, &obj_count);
-    else {
+    if (NumObjs >= options.cellGetObjectsThreshold) {
+	obj_list = obj_buf;
+	obj_count = Cell_get_objects(c->pos, range, NELEM(obj_buf),
+				     obj_list);
+    } else {
 	obj_list = Obj;
 	obj_count = NumObjs;
     }
@@ -858,16 +858,17 @@ void World_restore_cannon(cannon_t *cannon)
 
 	if (poly->group == cannon->group) {
 	    poly->current_style = poly->style;
-	    poly->update_mask = ~0;
+	    Conn_mask_fill(poly->update_mask);
 	    poly->last_change = frame_loops;
 	}
     }
 
-    cannon->conn_mask = 0;
+    Conn_mask_clear(cannon->conn_mask);
     cannon->last_change = frame_loops;
     cannon->dead_ticks = 0;
 
     P_set_hitmask(cannon->group, Cannon_hitmask(cannon));
+    Nav_cannon_changed(cannon);
 }
 
 void World_remove_cannon(cannon_t *cannon)
@@ -876,7 +877,7 @@ void World_remove_cannon(cannon_t *cannon)
     int i;
 
     cannon->dead_ticks = options.cannonDeadTicks;
-    cannon->conn_mask = 0;
+    Conn_mask_clear(cannon->conn_mask);
 
     World_set_block(blk, SPACE);
 
@@ -885,12 +886,13 @@ void World_remove_cannon(cannon_t *cannon)
 
 	if (poly->group == cannon->group) {
 	    poly->current_style = poly->destroyed_style;
-	    poly->update_mask = ~0;
+	    Conn_mask_fill(poly->update_mask);
 	    poly->last_change = frame_loops;
 	}
     }
 
     P_set_hitmask(cannon->group, Cannon_hitmask(cannon));
+    Nav_cannon_changed(cannon);
 }
 
 
@@ -32,6 +32,19 @@
 #undef SQRT2
 #define SQRT2	1.41421356237309504880
 
+/*
+ * Values of object_t cell_ind when cellGrid is on.  Non-negative values
+ * are slots in cell_grid, CELL_PENDING objects are on the cell lists.
+ */
+#define CELL_NONE		(-1)
+#define CELL_PENDING		(-2)
+
+/*
+ * Rebuild the grid when this many objects have changed block since
+ * the last rebuild.
+ */
+#define CELL_PENDING_LIMIT	(64 + NumObjs / 32)
+
 
 typedef struct cell_dist cell_dist_t;
 struct cell_dist {
@@ -51,6 +64,24 @@ static cell_node_t **Cells;
 static int object_node_offset;
 static cell_dist_t *cell_dist;
 static size_t cell_dist_size;
+static int cell_max_left;
+static int cell_max_right;
+static int cell_max_up;
+static int cell_max_down;
+
+/*
+ * Grid mode: objects are counting sorted by block into cell_grid,
+ * with the objects of block b in slots cell_grid_start[b] up to
+ * cell_grid_start[b + 1].  Objects which change block after a rebuild
+ * are put on the cell list of their new block, as in list mode, until
+ * the next rebuild, which in practice happens once per tick after all
+ * objects have moved.
+ */
+static bool cell_grid_mode;
+static object_t **cell_grid;
+static int *cell_grid_block;
+static int *cell_grid_start;
+static int cell_pending_count;
 
 
 static void Free_cell_dist(void)
@@ -89,10 +120,6 @@ static void Init_cell_dist(void)
     int x, y;
     int cell_dist_width;
     int cell_dist_height;
-    int cell_max_left;
-    int cell_max_right;
-    int cell_max_up;
-    int cell_max_down;
 
     Free_cell_dist();
 
@@ -132,10 +159,190 @@ static void Init_cell_dist(void)
 }
 
 
+static inline int Cell_block_index(clpos_t pos)
+{
+    blkpos_t bpos = Clpos_to_blkpos(pos);
+
+    return bpos.bx * world->y + bpos.by;
+}
+
+
+static void Free_cell_grid(void)
+{
+    XFREE(cell_grid);
+    XFREE(cell_grid_block);
+    XFREE(cell_grid_start);
+    cell_pending_count = 0;
+}
+
+
+static void Alloc_cell_grid(void)
+{
+    Free_cell_grid();
+
+    cell_grid = XMALLOC(object_t *, ObjMax);
+    cell_grid_block = XMALLOC(int, ObjMax);
+    cell_grid_start = XCALLOC(int, world->x * world->y + 1);
+    if (cell_grid == NULL || cell_grid_block == NULL
+	|| cell_grid_start == NULL) {
+	error("No cell grid mem");
+	End_game();
+    }
+}
+
+
+/*
+ * Take obj off the cell list it is on, if any.
+ */
+static inline void Cell_unlink_object(object_t *obj)
+{
+    cell_node_t *obj_node_ptr = &(obj->cell);
+    cell_node_t *next = obj_node_ptr->next;
+    cell_node_t *prev = obj_node_ptr->prev;
+
+    next->prev = prev;
+    prev->next = next;
+    obj_node_ptr->next = obj_node_ptr;
+    obj_node_ptr->prev = obj_node_ptr;
+}
+
+
+/*
+ * Counting sort of all objects which are in the cell structure
+ * into cell_grid by block index.
+ */
+static void Cell_grid_rebuild(void)
+{
+    int i, b, slot, num_blocks = world->x * world->y;
+    int *start = cell_grid_start;
+    object_t *obj;
+
+    memset(start, 0, (num_blocks + 1) * sizeof(int));
+
+    for (i = 0; i < NumObjs; i++) {
+	obj = Obj[i];
+	if (obj->cell_ind == CELL_NONE)
+	    continue;
+	start[Cell_block_index(obj->pos) + 1]++;
+    }
+    for (b = 0; b < num_blocks; b++)
+	start[b + 1] += start[b];
+
+    /* start[b] is used as insert position, afterwards it is end of b. */
+    for (i = 0; i < NumObjs; i++) {
+	obj = Obj[i];
+	if (obj->cell_ind == CELL_NONE)
+	    continue;
+	if (obj->cell_ind == CELL_PENDING)
+	    Cell_unlink_object(obj);
+	b = Cell_block_index(obj->pos);
+	slot = start[b]++;
+	cell_grid[slot] = obj;
+	cell_grid_block[slot] = b;
+	obj->cell_ind = slot;
+    }
+    memmove(&start[1], &start[0], num_blocks * sizeof(int));
+    start[0] = 0;
+
+    cell_pending_count = 0;
+}
+
+
+static void Cell_grid_add_object(object_t *obj)
+{
+    int ind = obj->cell_ind;
+    blkpos_t bpos;
+    cell_node_t *obj_node_ptr, *cell_node_ptr;
+
+    if (ind == CELL_PENDING)
+	Cell_unlink_object(obj);
+
+    if (!World_contains_clpos(obj->pos)) {
+	obj->cell_ind = CELL_NONE;
+	return;
+    }
+
+    /* still in the same block as in the last rebuild? */
+    if (ind >= 0 && cell_grid_block[ind] == Cell_block_index(obj->pos))
+	return;
+
+    if (ind != CELL_PENDING)
+	cell_pending_count++;
+    obj->cell_ind = CELL_PENDING;
+
+    /* put obj in cell list, Cell_get_objects() looks there too. */
+    bpos = Clpos_to_blkpos(obj->pos);
+    obj_node_ptr = &(obj->cell);
+    cell_node_ptr = &Cells[bpos.bx][bpos.by];
+    obj_node_ptr->next = cell_node_ptr->next;
+    obj_node_ptr->prev = cell_node_ptr;
+    cell_node_ptr->next->prev = obj_node_ptr;
+    cell_node_ptr->next = obj_node_ptr;
+}
+
+
+/*
+ * Switch between linked cell lists and the cell grid, moving the
+ * objects which are currently in the cell structure over.
+ */
+static void Cell_set_grid_mode(bool on)
+{
+    int i, x, y;
+    object_t *obj;
+    bool in_cell;
+
+    if (on == cell_grid_mode)
+	return;
+
+    if (on)
+	Alloc_cell_grid();
+
+    for (x = 0; x < world->x; x++) {
+	for (y = 0; y < world->y; y++) {
+	    Cells[x][y].next = &Cells[x][y];
+	    Cells[x][y].prev = &Cells[x][y];
+	}
+    }
+
+    cell_grid_mode = on;
+
+    for (i = 0; i < NumObjs; i++) {
+	obj = Obj[i];
+	if (on)
+	    in_cell = (obj->cell.next != &(obj->cell));
+	else
+	    in_cell = (obj->cell_ind != CELL_NONE);
+	obj->cell.next = &(obj->cell);
+	obj->cell.prev = &(obj->cell);
+	obj->cell_ind = CELL_NONE;
+	if (!in_cell)
+	    continue;
+	if (on)
+	    /* anything but CELL_NONE gets picked up by the rebuild */
+	    obj->cell_ind = CELL_PENDING;
+	else
+	    Cell_add_object(obj);
+    }
+
+    if (on)
+	Cell_grid_rebuild();
+    else
+	Free_cell_grid();
+}
+
+
+void Cell_tune_grid(void)
+{
+    Cell_set_grid_mode(options.cellGrid);
+}
+
+
 void Free_cells(void)
 {
     XFREE(Cells);
     Free_cell_dist();
+    Free_cell_grid();
+    cell_grid_mode = false;
 }
 
 
@@ -165,6 +372,22 @@ void Alloc_cells(void)
     }
 
     Init_cell_dist();
+
+    if (options.cellGrid)
+	Cell_set_grid_mode(true);
+}
+
+
+/*
+ * Rebuild the cell grid now if Cell_get_objects() would otherwise
+ * do it.  After this Cell_get_objects() doesn't modify anything
+ * until objects are added or moved, so it can be called from
+ * several threads at once.
+ */
+void Cell_flush_pending(void)
+{
+    if (cell_grid_mode && cell_pending_count > CELL_PENDING_LIMIT)
+	Cell_grid_rebuild();
 }
 
 
@@ -173,6 +396,7 @@ void Cell_init_object(object_t *obj)
     /* put obj on list with only itself. */
     obj->cell.next = &(obj->cell);
     obj->cell.prev = &(obj->cell);
+    obj->cell_ind = CELL_NONE;
 
     if (object_node_offset == 0)
 	object_node_offset = ((char *) &(obj->cell) - (char *) obj);
@@ -185,6 +409,11 @@ void Cell_add_object(object_t *obj)
     cell_node_t *obj_node_ptr, *cell_node_ptr;
     cell_node_t *prev, *next;
 
+    if (cell_grid_mode) {
+	Cell_grid_add_object(obj);
+	return;
+    }
+
     obj_node_ptr = &(obj->cell);
     next = obj_node_ptr->next;
     prev = obj_node_ptr->prev;
@@ -211,11 +440,90 @@ void Cell_add_object(object_t *obj)
 }
 
 
+/*
+ * Add num objects to the cell structure, with the same result as
+ * calling Cell_add_object() for each in turn.  A run of objects in
+ * the same block, like the debris of one explosion, is linked up
+ * first and then spliced in front of the cell list in one go.
+ */
+void Cell_add_objects(object_t **objs, int num)
+{
+    int i, j, bx = 0, by = 0;
+    blkpos_t bpos;
+    cell_node_t *obj_node_ptr, *cell_node_ptr, *first, *last;
+    cell_node_t *prev, *next;
+
+    if (cell_grid_mode) {
+	for (i = 0; i < num; i++)
+	    Cell_grid_add_object(objs[i]);
+	return;
+    }
+
+    for (i = 0; i < num; i = j) {
+	first = last = NULL;
+	for (j = i; j < num; j++) {
+	    obj_node_ptr = &(objs[j]->cell);
+	    if (!World_contains_clpos(objs[j]->pos)) {
+		if (first != NULL)
+		    break;
+		next = obj_node_ptr->next;
+		prev = obj_node_ptr->prev;
+		next->prev = prev;
+		prev->next = next;
+		obj_node_ptr->next = obj_node_ptr;
+		obj_node_ptr->prev = obj_node_ptr;
+		continue;
+	    }
+	    bpos = Clpos_to_blkpos(objs[j]->pos);
+	    if (first == NULL) {
+		bx = bpos.bx;
+		by = bpos.by;
+	    } else if (bpos.bx != bx || bpos.by != by)
+		break;
+
+	    next = obj_node_ptr->next;
+	    prev = obj_node_ptr->prev;
+
+	    assert(next->prev == obj_node_ptr);
+	    assert(prev->next == obj_node_ptr);
+
+	    /* remove obj from current list */
+	    next->prev = prev;
+	    prev->next = next;
+
+	    /* later objects go in front, as Cell_add_object() would do */
+	    if (first == NULL)
+		last = obj_node_ptr;
+	    else {
+		obj_node_ptr->next = first;
+		first->prev = obj_node_ptr;
+	    }
+	    first = obj_node_ptr;
+	}
+	if (first == NULL)
+	    continue;
+
+	cell_node_ptr = &Cells[bx][by];
+	first->prev = cell_node_ptr;
+	last->next = cell_node_ptr->next;
+	cell_node_ptr->next->prev = last;
+	cell_node_ptr->next = first;
+    }
+}
+
+
 void Cell_remove_object(object_t *obj)
 {
     cell_node_t *obj_node_ptr;
     cell_node_t *next, *prev;
 
+    if (cell_grid_mode) {
+	if (obj->cell_ind == CELL_PENDING)
+	    Cell_unlink_object(obj);
+	obj->cell_ind = CELL_NONE;
+	return;
+    }
+
     obj_node_ptr = &(obj->cell);
     next = obj_node_ptr->next;
     prev = obj_node_ptr->prev;
@@ -233,13 +541,18 @@ void Cell_remove_object(object_t *obj)
 }
 
 
-void Cell_get_objects(clpos_t pos,
-		      int range,
-		      int max_obj_count,
-		      object_t *** obj_list, int *count_ptr)
+/*
+ * Find objects which are at most range blocks away from pos,
+ * objects in the closest blocks first.  The caller provides obj_list,
+ * which must have room for max_obj_count objects.
+ * Returns the number of objects stored in obj_list.
+ */
+int Cell_get_objects(clpos_t pos,
+		     int range,
+		     int max_obj_count,
+		     object_t **obj_list)
 {
-    static object_t *ObjectList[MAX_TOTAL_SHOTS + 1];
-    int i, count, x, y, xw, yw, wrap;
+    int i, j, count, x, y, xw, yw, wrap, b;
     object_t *obj;
     cell_node_t *cell_node_ptr, *next;
     double dist;
@@ -248,6 +561,8 @@ void Cell_get_objects(clpos_t pos,
     x = bpos.bx;
     y = bpos.by;
 
+    Cell_flush_pending();
+
     wrap = (BIT(world->rules->mode, WRAP_PLAY) != 0);
     dist = (double) (range * SQRT2);
     count = 0;
@@ -279,18 +594,27 @@ void Cell_get_objects(clpos_t pos,
 		else
 		    continue;
 	    }
+	    if (cell_grid_mode) {
+		b = xw * world->y + yw;
+		for (j = cell_grid_start[b];
+		     j < cell_grid_start[b + 1] && count < max_obj_count;
+		     j++) {
+		    obj = cell_grid[j];
+		    /* skip objects which have moved or been removed */
+		    if (obj->cell_ind == j)
+			obj_list[count++] = obj;
+		}
+	    }
+	    /* in grid mode these are the objects which changed block */
 	    cell_node_ptr = &Cells[xw][yw];
 	    next = cell_node_ptr->next;
 	    while (next != cell_node_ptr && count < max_obj_count) {
 		obj = (object_t *) ((char *) next - object_node_offset);
-		ObjectList[count++] = obj;
+		obj_list[count++] = obj;
 		next = next->next;
 	    }
 	}
     }
 
-    ObjectList[count] = NULL;
-    *obj_list = &ObjectList[0];
-    if (count_ptr != NULL)
-	*count_ptr = count;
+    return count;
 }
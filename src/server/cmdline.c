@@ -3941,6 +3941,126 @@ static option_desc opts[] = {
 	"Use Cell_get_objects if there is this many objects or more.\n",
 	OPT_ORIGIN_ANY | OPT_VISIBLE
     },
+    {
+	"cellGrid",
+	"cellGrid",
+	"false",
+	&options.cellGrid,
+	valBool,
+	Cell_tune_grid,
+	"Keep objects in a block sorted array which is rebuilt once per\n"
+	"frame instead of in linked lists per block. This makes object\n"
+	"lookups faster on maps with very many objects.\n",
+	OPT_ORIGIN_ANY | OPT_VISIBLE
+    },
+    {
+	"frameThreads",
+	"frameThreads",
+	"0",
+	&options.frameThreads,
+	valInt,
+	tuner_dummy,
+	"Number of extra threads used to build the frames sent to the\n"
+	"clients.  Zero builds all frames in the main thread.  The frames\n"
+	"sent are the same regardless of this setting.\n",
+	OPT_ORIGIN_ANY | OPT_VISIBLE
+    },
+    {
+	"maxObjectMemory",
+	"maxObjectMemory",
+	"8",
+	&options.maxObjectMemory,
+	valInt,
+	tuner_none,
+	"Megabytes of memory which may be used for shots, debris and\n"
+	"other objects.  Memory is taken only when needed, and no more\n"
+	"objects are made once this much is in use.\n",
+	OPT_ORIGIN_ANY | OPT_VISIBLE
+    },
+    {
+	"collisionSweep",
+	"collisionSweep",
+	"false",
+	&options.collisionSweep,
+	valBool,
+	tuner_dummy,
+	"Find the objects that may collide by sorting their bounding boxes\n"
+	"once per frame, instead of looking at all objects near each player,\n"
+	"ball, mine and asteroid.  This is faster with many players.\n",
+	OPT_ORIGIN_ANY | OPT_VISIBLE
+    },
+    {
+	"compactGravity",
+	"compactGravity",
+	"false",
+	&options.compactGravity,
+	valBool,
+	tuner_none,
+	"Store the gravity of each map block as two 16 bit floats.\n"
+	"This halves the memory the gravity needs on huge maps, but\n"
+	"the gravity is only accurate to about three digits.\n",
+	OPT_ORIGIN_ANY | OPT_VISIBLE
+    },
+    {
+	"deltaFrames",
+	"deltaFrames",
+	"true",
+	&options.deltaFrames,
+	valBool,
+	tuner_dummy,
+	"Send frames to clients which support it as deltas against a\n"
+	"frame the client has acknowledged, when that is smaller.\n",
+	OPT_ORIGIN_ANY | OPT_VISIBLE
+    },
+    {
+	"frameRegions",
+	"frameRegions",
+	"true",
+	&options.frameRegions,
+	valBool,
+	tuner_dummy,
+	"Sort the objects into regions of 8x8 blocks once a frame, so that\n"
+	"a frame only looks at the objects near the view and radar of the\n"
+	"player.  When this is on cellGetObjectsThreshold isn't used.\n",
+	OPT_ORIGIN_ANY | OPT_VISIBLE
+    },
+    {
+	"frameBandwidth",
+	"frameBandwidth",
+	"0",
+	&options.frameBandwidth,
+	valInt,
+	tuner_dummy,
+	"Bytes per second to send to each player at most.  Players whose\n"
+	"frames would take more, or whose frames get lost, are shown fewer\n"
+	"sparks and radar blips and then sent fewer frames.  Use /governor\n"
+	"to see how it is going.  0 means no limit and no governing.\n",
+	OPT_ORIGIN_ANY | OPT_VISIBLE
+    },
+    {
+	"robotThreads",
+	"robotThreads",
+	"0",
+	&options.robotThreads,
+	valInt,
+	tuner_dummy,
+	"Number of extra threads the robots use to decide what to do.\n"
+	"Zero makes all robots decide in the main thread.  The robots\n"
+	"play the same regardless of this setting.\n",
+	OPT_ORIGIN_ANY | OPT_VISIBLE
+    },
+    {
+	"robotNavigation",
+	"robotNavigation",
+	"yes",
+	&options.robotNavigation,
+	valBool,
+	tuner_none,
+	"Do robots find their way around walls to fuel stations, targets,\n"
+	"treasures and checkpoints using navigation fields made when the\n"
+	"map is loaded?\n",
+	OPT_ORIGIN_ANY | OPT_VISIBLE
+    },
 };
 
 
@@ -159,6 +159,219 @@ static inline bool in_range(object_t *obj1, object_t *obj2, double range)
     return hit;
 }
 
+/*
+ * Sweep and prune broad phase, used if options.collisionSweep is set.
+ *
+ * Once per tick every object and live player gets a box around all the
+ * positions in_range() may look at, which are pos, prevpos and prevpos
+ * plus extmove, widened by the largest range the object is tested
+ * with.  The boxes are sorted along x into map columns, so the boxes
+ * near an actor are found by scanning a few columns, and in_range()
+ * only gets the pairs whose boxes overlap in both x and y.  Like
+ * in_range() the boxes wrap around the map edges.
+ *
+ * The objects found are returned in Obj[] order, followed by objects
+ * made after the boxes were built, so that collisions are handled in
+ * the same order as when all objects are tested.
+ */
+typedef struct {
+    int		cx, cy;		/* center, inside the world */
+    int		hx, hy;		/* half width and height */
+    int		ind;		/* Obj[] index, or -1 - player index */
+} sweep_box_t;
+
+static struct {
+    bool	built;
+    int		num_objs;	/* NumObjs when built */
+    int		num_cols;
+    int		*col_start;	/* first box of each column */
+    sweep_box_t	*boxes;		/* sorted by column */
+    sweep_box_t	*tmp;
+    int		num_boxes, max_boxes;
+    int		max_hx;		/* widest box */
+    int		*found;		/* indexes found by the last query */
+    object_t	**list;		/* objects found by the last query */
+    int		*pl_list;	/* players found by the last query */
+    int		max_found, max_pl;
+} sweep;
+
+int collision_pairs;	/* candidate pairs given to in_range() this tick */
+
+static void Sweep_box(object_t *obj, int range, sweep_box_t *box)
+{
+    int dx = CENTER_XCLICK(obj->pos.cx - obj->prevpos.cx);
+    int dy = CENTER_YCLICK(obj->pos.cy - obj->prevpos.cy);
+    int x0 = MIN(0, MIN(dx, obj->extmove.cx));
+    int x1 = MAX(0, MAX(dx, obj->extmove.cx));
+    int y0 = MIN(0, MIN(dy, obj->extmove.cy));
+    int y1 = MAX(0, MAX(dy, obj->extmove.cy));
+
+    box->cx = obj->prevpos.cx + (x0 + x1) / 2;
+    box->cy = obj->prevpos.cy + (y0 + y1) / 2;
+    box->cx = WRAP_XCLICK(box->cx);
+    box->cy = WRAP_YCLICK(box->cy);
+    /* one extra click for the rounding above and in in_range() */
+    box->hx = (x1 - x0) / 2 + range + 2;
+    box->hy = (y1 - y0) / 2 + range + 2;
+}
+
+static inline bool Sweep_overlap(const sweep_box_t *a, const sweep_box_t *b)
+{
+    return ABS(CENTER_XCLICK(a->cx - b->cx)) <= a->hx + b->hx
+	&& ABS(CENTER_YCLICK(a->cy - b->cy)) <= a->hy + b->hy;
+}
+
+static int Sweep_column(int cx)
+{
+    return MIN(cx / BLOCK_CLICKS, sweep.num_cols - 1);
+}
+
+static void Sweep_build(void)
+{
+    int i, c, n = 0, num_cols = world->x, need = NumObjs + NumPlayers;
+    sweep_box_t *box;
+
+    sweep.built = false;
+    if (sweep.max_boxes < need || sweep.num_cols != num_cols) {
+	XFREE(sweep.boxes);
+	XFREE(sweep.tmp);
+	XFREE(sweep.col_start);
+	sweep.max_boxes = MAX(need, 2 * sweep.max_boxes);
+	sweep.num_cols = num_cols;
+	sweep.boxes = XMALLOC(sweep_box_t, sweep.max_boxes);
+	sweep.tmp = XMALLOC(sweep_box_t, sweep.max_boxes);
+	sweep.col_start = XMALLOC(int, num_cols + 1);
+    }
+    /* objects made during collisions are returned by queries too */
+    if (sweep.max_found < ObjMax + NumPlayers || sweep.max_pl < NumPlayers) {
+	XFREE(sweep.found);
+	XFREE(sweep.list);
+	XFREE(sweep.pl_list);
+	sweep.max_found = ObjMax + NumPlayers;
+	sweep.max_pl = NumPlayers;
+	sweep.found = XMALLOC(int, sweep.max_found);
+	sweep.list = XMALLOC(object_t *, ObjMax);
+	sweep.pl_list = XMALLOC(int, MAX(sweep.max_pl, 1));
+    }
+    if (sweep.boxes == NULL || sweep.tmp == NULL || sweep.col_start == NULL
+	|| sweep.found == NULL || sweep.list == NULL
+	|| sweep.pl_list == NULL) {
+	warn("No memory for collision sweep.");
+	sweep.max_boxes = sweep.max_found = sweep.max_pl = 0;
+	return;
+    }
+
+    sweep.max_hx = 0;
+    for (i = 0; i < NumObjs; i++) {
+	object_t *obj = Obj[i];
+
+	box = &sweep.tmp[n++];
+	Sweep_box(obj, MAX(obj->pl_range, obj->pl_radius) * CLICK, box);
+	box->ind = i;
+	sweep.max_hx = MAX(sweep.max_hx, box->hx);
+    }
+    for (i = 0; i < NumPlayers; i++) {
+	player_t *pl = Player_by_index(i);
+
+	if (!Player_is_alive(pl))
+	    continue;
+	box = &sweep.tmp[n++];
+	Sweep_box(OBJ_PTR(pl), SHIP_SZ * CLICK, box);
+	box->ind = -1 - i;
+	sweep.max_hx = MAX(sweep.max_hx, box->hx);
+    }
+
+    /* counting sort by column keeps Obj[] order within a column */
+    memset(sweep.col_start, 0, (num_cols + 1) * sizeof(int));
+    for (i = 0; i < n; i++)
+	sweep.col_start[Sweep_column(sweep.tmp[i].cx) + 1]++;
+    for (c = 0; c < num_cols; c++)
+	sweep.col_start[c + 1] += sweep.col_start[c];
+    for (i = 0; i < n; i++) {
+	c = Sweep_column(sweep.tmp[i].cx);
+	sweep.boxes[sweep.col_start[c]++] = sweep.tmp[i];
+    }
+    memmove(&sweep.col_start[1], &sweep.col_start[0], num_cols * sizeof(int));
+    sweep.col_start[0] = 0;
+
+    sweep.num_boxes = n;
+    sweep.num_objs = NumObjs;
+    sweep.built = true;
+}
+
+static int Sweep_cmp_ind(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+/*
+ * Find the boxes overlapping the box of 'actor' widened by 'range'.
+ * If obj_list is not NULL the objects go there in Obj[] order and
+ * their count is returned.  If pl_list is not NULL the player indexes
+ * go there in increasing order and their count to *pl_count.
+ */
+static int Sweep_query(object_t *actor, int range,
+		       object_t **obj_list, int *pl_list, int *pl_count)
+{
+    sweep_box_t q;
+    int c, i, r, n = 0, num_obj, num_pl = 0, reach, lo, hi;
+    int from[2], to[2], num_ranges = 1;
+
+    Sweep_box(actor, range, &q);
+    reach = q.hx + sweep.max_hx;
+    lo = q.cx - reach;
+    hi = q.cx + reach;
+    from[0] = lo;
+    to[0] = hi;
+    if (2 * reach >= world->cwidth - 2 * BLOCK_CLICKS) {
+	from[0] = 0;
+	to[0] = world->cwidth - 1;
+    } else if (lo < 0) {
+	from[0] = 0;
+	from[1] = lo + world->cwidth;
+	to[1] = world->cwidth - 1;
+	num_ranges = 2;
+    } else if (hi >= world->cwidth) {
+	to[0] = world->cwidth - 1;
+	from[1] = 0;
+	to[1] = hi - world->cwidth;
+	num_ranges = 2;
+    }
+
+    for (r = 0; r < num_ranges; r++) {
+	for (c = Sweep_column(from[r]); c <= Sweep_column(to[r]); c++) {
+	    for (i = sweep.col_start[c]; i < sweep.col_start[c + 1]; i++) {
+		sweep_box_t *box = &sweep.boxes[i];
+
+		if (box->ind < 0 ? pl_list == NULL : obj_list == NULL)
+		    continue;
+		if (!Sweep_overlap(&q, box))
+		    continue;
+		sweep.found[n++] = box->ind;
+	    }
+	}
+    }
+
+    /* players sort first, the last player first */
+    qsort(sweep.found, (size_t)n, sizeof(int), Sweep_cmp_ind);
+    while (num_pl < n && sweep.found[num_pl] < 0)
+	num_pl++;
+    for (i = 0; i < num_pl; i++)
+	pl_list[i] = -1 - sweep.found[num_pl - 1 - i];
+
+    num_obj = 0;
+    if (obj_list) {
+	for (i = num_pl; i < n; i++)
+	    obj_list[num_obj++] = Obj[sweep.found[i]];
+	for (i = sweep.num_objs; i < NumObjs; i++)
+	    obj_list[num_obj++] = Obj[i];
+    }
+
+    if (pl_count)
+	*pl_count = num_pl;
+    return num_obj;
+}
+
 static void PlayerCollision(void);
 static void PlayerObjectCollision(player_t *pl);
 static void AsteroidCollision(void);
@@ -174,6 +387,11 @@ static void Player_collides_with_killing_shot(player_t *pl, object_t *obj);
 
 void Check_collision(void)
 {
+    collision_pairs = 0;
+    sweep.built = false;
+    if (options.collisionSweep)
+	Sweep_build();
+
     BallCollision();
     MineCollision();
     PlayerCollision();
@@ -183,7 +401,7 @@ void Check_collision(void)
 
 static void PlayerCollision(void)
 {
-    int i, j;
+    int i, j, k, num_pl;
     player_t *pl;
 
     /* Player - player, checkpoint, treasure, object and wall */
@@ -204,10 +422,21 @@ static void PlayerCollision(void)
 
 	/* Player - player */
 	if (BIT(world->rules->mode, CRASH_WITH_PLAYER | BOUNCE_WITH_PLAYER)) {
-	    for (j = i + 1; j < NumPlayers; j++) {
-		player_t *pl_j = Player_by_index(j);
+	    num_pl = NumPlayers;
+	    if (sweep.built)
+		Sweep_query(OBJ_PTR(pl), SHIP_SZ * CLICK,
+			    NULL, sweep.pl_list, &num_pl);
+
+	    for (k = 0; k < num_pl; k++) {
+		player_t *pl_j;
 		double range;
 
+		j = sweep.built ? sweep.pl_list[k] : k;
+		if (j <= i)
+		    continue;
+		pl_j = Player_by_index(j);
+		collision_pairs++;
+
 		if (!Player_is_alive(pl_j))
 		    continue;
 		if (Player_is_phasing(pl_j))
@@ -461,7 +690,7 @@ static void PlayerObjectCollision(player_t *pl)
 {
     int j, obj_count;
     double range, radius;
-    object_t *obj, **obj_list;
+    object_t *obj, **obj_list, *obj_buf[500];
 
     /*
      * Collision between a player and an object.
@@ -469,12 +698,18 @@ static void PlayerObjectCollision(player_t *pl)
     if (!Player_is_alive(pl))
 	return;
 
-    if (NumObjs >= options.cellGetObjectsThreshold)
-	Cell_get_objects(pl->pos, 4, 500, &obj_list, &obj_count);
-    else {
+    if (sweep.built) {
+	obj_list = sweep.list;
+	obj_count = Sweep_query(OBJ_PTR(pl), SHIP_SZ * CLICK,
+				obj_list, NULL, NULL);
+    } else if (NumObjs >= options.cellGetObjectsThreshold) {
+	obj_list = obj_buf;
+	obj_count = Cell_get_objects(pl->pos, 4, NELEM(obj_buf), obj_list);
+    } else {
 	obj_list = Obj;
 	obj_count = NumObjs;
     }
+    collision_pairs += obj_count;
    
     for (j = 0; j < obj_count; j++) {
 	bool hit;
@@ -1201,7 +1436,7 @@ static void AsteroidCollision(void)
 {
     int j, radius, obj_count;
     object_t *ast;
-    object_t *obj = NULL, **obj_list;
+    object_t *obj = NULL, **obj_list, *obj_buf[300];
     list_t list;
     list_iter_t iter;
     double damage = 0.0;
@@ -1221,13 +1456,20 @@ static void AsteroidCollision(void)
 
 	assert(World_contains_clpos(ast->pos));
 
-	if (NumObjs >= options.cellGetObjectsThreshold)
-	    Cell_get_objects(ast->pos, ast->pl_radius / BLOCK_SZ + 1,
-			     300, &obj_list, &obj_count);
-	else {
+	if (sweep.built) {
+	    obj_list = sweep.list;
+	    obj_count = Sweep_query(ast, ast->pl_radius * CLICK,
+				    obj_list, NULL, NULL);
+	} else if (NumObjs >= options.cellGetObjectsThreshold) {
+	    obj_list = obj_buf;
+	    obj_count = Cell_get_objects(ast->pos,
+					 ast->pl_radius / BLOCK_SZ + 1,
+					 NELEM(obj_buf), obj_list);
+	} else {
 	    obj_list = Obj;
 	    obj_count = NumObjs;
 	}
+	collision_pairs += obj_count;
 
 	for (j = 0; j < obj_count; j++) {
 	    obj = obj_list[j];
@@ -1350,7 +1592,7 @@ static void BallCollision(void)
 {
     int i, j, obj_count;
     int	ignored_object_types;
-    object_t **obj_list;
+    object_t **obj_list, *obj_buf[300];
     object_t *obj;
     ballobject_t *ball;
 
@@ -1396,12 +1638,19 @@ static void BallCollision(void)
 	if (!options.ballCollisions)
 	    continue;
 
-	if (NumObjs >= options.cellGetObjectsThreshold)
-	    Cell_get_objects(ball->pos, 4, 300, &obj_list, &obj_count);
-	else {
+	if (sweep.built) {
+	    obj_list = sweep.list;
+	    obj_count = Sweep_query(OBJ_PTR(ball), ball->pl_radius * CLICK,
+				    obj_list, NULL, NULL);
+	} else if (NumObjs >= options.cellGetObjectsThreshold) {
+	    obj_list = obj_buf;
+	    obj_count = Cell_get_objects(ball->pos, 4, NELEM(obj_buf),
+					 obj_list);
+	} else {
 	    obj_list = Obj;
 	    obj_count = NumObjs;
 	}
+	collision_pairs += obj_count;
 	    
 	for (j = 0; j < obj_count; j++) {
 	    int radius;
@@ -1472,7 +1721,7 @@ static void BallCollision(void)
 static void MineCollision(void)
 {
     int i, j, obj_count;
-    object_t **obj_list;
+    object_t **obj_list, *obj_buf[300];
     object_t *obj;
     mineobject_t *mine;
 
@@ -1487,12 +1736,21 @@ static void MineCollision(void)
 	    mine->life <= 0.0)		/* dying mine */
 	    continue;
 
-	if (NumObjs >= options.cellGetObjectsThreshold)
-	    Cell_get_objects(mine->pos, 4, 300, &obj_list, &obj_count);
-	else {
+	if (sweep.built) {
+	    obj_list = sweep.list;
+	    obj_count = Sweep_query(OBJ_PTR(mine),
+				    (int)(options.mineShotDetonateDistance
+					  * CLICK) + 1,
+				    obj_list, NULL, NULL);
+	} else if (NumObjs >= options.cellGetObjectsThreshold) {
+	    obj_list = obj_buf;
+	    obj_count = Cell_get_objects(mine->pos, 4, NELEM(obj_buf),
+					 obj_list);
+	} else {
 	    obj_list = Obj;
 	    obj_count = NumObjs;
 	}
+	collision_pairs += obj_count;
 
 	for (j = 0; j < obj_count; j++) {
 	    double radius;
@@ -179,11 +179,13 @@ static int Cmd_addr(char *arg, player_t *pl, bool oper, char *msg, size_t size);
 static int Cmd_advance(char *arg, player_t *pl, bool oper, char *msg, size_t size);
 static int Cmd_ally(char *arg, player_t *pl, bool oper, char *msg, size_t size);
 static int Cmd_get(char *arg, player_t *pl, bool oper, char *msg, size_t size);
+static int Cmd_governor(char *arg, player_t *pl, bool oper, char *msg, size_t size);
 static int Cmd_help(char *arg, player_t *pl, bool oper, char *msg, size_t size);
 static int Cmd_kick(char *arg, player_t *pl, bool oper, char *msg, size_t size);
 static int Cmd_lock(char *arg, player_t *pl, bool oper, char *msg, size_t size);
 static int Cmd_maxturnsps(char *arg, player_t *pl, bool oper, char *msg, size_t size);
 static int Cmd_mute(char *arg, player_t *pl, bool oper, char *msg, size_t size);
+static int Cmd_objects(char *arg, player_t *pl, bool oper, char *msg, size_t size);
 static int Cmd_op(char *arg, player_t *pl, bool oper, char *msg, size_t size);
 static int Cmd_password(char *arg, player_t *pl, bool oper, char *msg, size_t size);
 static int Cmd_pause(char *arg, player_t *pl, bool oper, char *msg, size_t size);
@@ -241,6 +243,14 @@ static Command_info commands[] = {
 	false,
 	Cmd_get
     },
+    {
+	"governor",
+	"gov",
+	"/governor [player name or ID number].  Show how frames are cut "
+	"down for the player to fit the frameBandwidth option.",
+	false,
+	Cmd_governor
+    },
     {
 	"help",
 	"h",
@@ -280,6 +290,14 @@ static Command_info commands[] = {
 	false,      /* checked in the function */
 	Cmd_mute
     },
+    {
+	"objects",
+	"ob",
+	"/objects.  Show objects in use, the most there has been of "
+	"each kind and the collision pairs tested in the last frame.",
+	false,
+	Cmd_objects
+    },
     {
 	"op",
 	"o",
@@ -832,6 +850,20 @@ static int Cmd_mute(char *arg, player_t *pl, bool oper, char *msg, size_t size)
     return CMD_RESULT_SUCCESS;
 }
 
+static int Cmd_objects(char *arg, player_t *pl, bool oper,
+		       char *msg, size_t size)
+{
+    size_t len;
+
+    UNUSED_PARAM(arg); UNUSED_PARAM(pl); UNUSED_PARAM(oper);
+
+    Object_pool_report(msg, size);
+    len = strlen(msg);
+    snprintf(msg + len, size - len, ", collision pairs %d", collision_pairs);
+
+    return CMD_RESULT_SUCCESS;
+}
+
 /* kps - this one is a bit obscure, maybe clean it up a bit ? */
 static int Cmd_op(char *arg, player_t *pl, bool oper, char *msg, size_t size)
 {
@@ -983,11 +1015,39 @@ static int Cmd_plinfo(char *arg, player_t *pl, bool oper, char *msg, size_t size
 
     snprintf(msg, size,
 	     "%-15s Ver: 0x%x MaxFPS: %d Turnspeed: %.2f Turnres: %.2f "
-	     "RTT: %i ms RTT_dev: %i ms",
+	     "RTT: %i ms RTT_dev: %i ms Objects examined/sent: %ld/%ld",
 	     pl2->name, pl2->version,
 	     pl2->player_fps, pl2->turnspeed, pl2->turnresistance,
 	     (int)((pl2->conn->rtt_smoothed >> 3) * timePerFrame * 1000),
-	     (int)((pl2->conn->rtt_dev >> 2) * timePerFrame * 1000));
+	     (int)((pl2->conn->rtt_dev >> 2) * timePerFrame * 1000),
+	     pl2->conn->objects_examined, pl2->conn->objects_sent);
+
+    return CMD_RESULT_SUCCESS;
+}
+
+static int Cmd_governor(char *arg, player_t *pl, bool oper, char *msg, size_t size)
+{
+    const char *errorstr;
+    player_t *pl2 = pl;
+    char buf[MSG_LEN];
+
+    UNUSED_PARAM(oper);
+
+    if (arg && *arg) {
+	pl2 = Get_player_by_name(arg, NULL, &errorstr);
+	if (!pl2) {
+	    strlcpy(msg, errorstr, size);
+	    return CMD_RESULT_ERROR;
+	}
+    }
+
+    if (pl2->conn == NULL) {
+	snprintf(msg, size, "Robots and tanks don't have a governor.");
+	return CMD_RESULT_ERROR;
+    }
+
+    Governor_status(pl2->conn, buf, sizeof(buf));
+    snprintf(msg, size, "Governor of %s: %s.", pl2->name, buf);
 
     return CMD_RESULT_SUCCESS;
 }
@@ -37,6 +37,11 @@
 #include "net.h"
 #endif
 
+#ifndef DELTA_H
+/* need delta_history_t. */
+#include "delta.h"
+#endif
+
 
 
 /*
@@ -77,6 +82,53 @@
 #define MAX_RETRANSMIT		(FPS + 1)
 #define DEFAULT_RETRANSMIT	(FPS / 2)
 
+/*
+ * Frame governor levels, see Governor_update() in netserver.c.
+ * From GOV_RADAR_LEVEL up shots aren't shown on the radar.
+ */
+#define GOV_LEVELS		9
+#define GOV_RADAR_LEVEL		3
+
+/*
+ * State of the frame governor of a connection.  The counters are
+ * for this second [0] and the one before [1], because the frames
+ * of a second can be acknowledged during the next.
+ */
+typedef struct {
+    int			level;			/* 0 is full detail */
+    int			credit;			/* for spacing frames */
+    long		start[2];		/* frame_loops at start */
+    long		bytes;			/* bytes sent this second */
+    int			frames[2];		/* frames sent */
+    int			acked[2];		/* frames acknowledged */
+    int			lost;			/* reliable data timeouts */
+    int			rate;			/* bytes/s last second */
+    int			loss;			/* percent of frames lost */
+} governor_t;
+
+/*
+ * Reliable data segments sent to a client which acknowledges them
+ * selectively (F_SACK), see Send_reliable_window() in netserver.c.
+ */
+#define SACK_SEGMENTS		64
+
+typedef struct {
+    long		offset;			/* offset in reliable data */
+    int			len;			/* bytes */
+    long		retransmit_at;		/* when to send it again */
+    bool		sacked;			/* the client has it */
+    bool		resend;			/* lost, send it again now */
+    bool		fast;			/* was resent because lost */
+} sack_segment_t;
+
+typedef struct {
+    sack_segment_t	seg[SACK_SEGMENTS];	/* a ring, oldest first */
+    int			first;			/* oldest segment */
+    int			num;			/* segments not acked */
+    int			cwnd;			/* bytes allowed in flight */
+    int			ssthresh;		/* slow start threshold */
+    long		recover;		/* end of loss recovery */
+} sack_window_t;
 
 /*
  * All the player connection state info.
@@ -123,6 +175,12 @@ typedef struct {
     char		*host;			/* hostname of players host */
     int			rectype;		/* normal/saved/spectator */
     int			features;		/* supported features */
+    long		delta_ack;		/* last frame acked by client */
+    delta_history_t	delta;			/* frames sent for deltas */
+    long		objects_examined;	/* objects looked at for frames */
+    long		objects_sent;		/* objects put in frames */
+    governor_t		gov;			/* frame rate and detail */
+    sack_window_t	sack;			/* reliable data in flight */
 } connection_t;
 
 #endif
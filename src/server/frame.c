@@ -32,6 +32,7 @@
 
 
 #define MAX_SHUFFLE_INDEX	65535
+#define MAX_RADAR_BLIPS		256	/* most a frame can have */
 
 
 typedef unsigned short shuffle_t;
@@ -58,6 +59,60 @@ typedef struct {
     short		x, y, size;
 } radar_t;
 
+/*
+ * State used while building the frame for one connection.
+ * Every frame building thread has its own context, so that
+ * frames for several connections can be built at the same time.
+ */
+typedef struct {
+    click_visibility_t	cv;
+    int			view_width,
+			view_height,
+			view_cwidth,
+			view_cheight,
+			debris_x_areas,
+			debris_y_areas,
+			debris_areas,
+			debris_colors,
+			spark_rand;
+    debris_t		*debris_ptr[DEBRIS_TYPES];
+    unsigned		debris_num[DEBRIS_TYPES],
+			debris_max[DEBRIS_TYPES];
+    debris_t		*fastshot_ptr[DEBRIS_TYPES * 2];
+    unsigned		fastshot_num[DEBRIS_TYPES * 2],
+			fastshot_max[DEBRIS_TYPES * 2];
+    radar_t		radar[MAX_RADAR_BLIPS];
+    shuffle_t		radar_shuffle[MAX_RADAR_BLIPS];
+    int			num_radar;
+    object_t		**object_list_ptr;	/* for Cell_get_objects */
+    int			max_object_list;
+    int			*region_list;		/* for Frame_regions_get */
+    int			max_region_list;
+    int			*map_list;		/* for Frame_map */
+    int			max_map_list;
+    uint32_t		rand_state;
+    long		generation;		/* last batch seen by thread */
+} frame_context_t;
+
+/*
+ * A connection which is sent a frame this update.
+ * Jobs showing the view of the same player are chained
+ * and built one after the other by the same thread,
+ * because building a frame updates the viewed player.
+ */
+typedef struct {
+    connection_t	*conn;
+    player_t		*pl;		/* owner of the connection */
+    player_t		*pl2;		/* whose view is sent */
+    int			next;		/* next job viewing pl2 or -1 */
+    bool		chain_head;
+    bool		build;		/* build the frame contents */
+    bool		end;		/* send the end of frame */
+    uint32_t		seed;		/* for the frame random numbers */
+} frame_job_t;
+
+#define MAX_FRAME_THREADS	64
+
 
 long			frame_loops = 1;
 long			frame_loops_slow = 1;
@@ -69,79 +124,104 @@ static int		max_object_shuffle;
 static shuffle_t	*player_shuffle_ptr;
 static int		num_player_shuffle;
 static int		max_player_shuffle;
-static radar_t		*radar_ptr;
-static int		num_radar, max_radar;
-
-static click_visibility_t cv;
-static int		view_width,
-			view_height,
-			view_cwidth,
-			view_cheight,
-			debris_x_areas,
-			debris_y_areas,
-			debris_areas,
-			debris_colors,
-			spark_rand;
-static debris_t		*debris_ptr[DEBRIS_TYPES];
-static unsigned		debris_num[DEBRIS_TYPES],
-			debris_max[DEBRIS_TYPES];
-static debris_t		*fastshot_ptr[DEBRIS_TYPES * 2];
-static unsigned		fastshot_num[DEBRIS_TYPES * 2],
-			fastshot_max[DEBRIS_TYPES * 2];
 
 /*
- * Macro to make room in a given dynamic array for new elements.
- * P is the pointer to the array memory.
- * N is the current number of elements in the array.
- * M is the current size of the array.
- * T is the type of the elements.
- * E is the number of new elements to store in the array.
- * The goal is to keep the number of malloc/realloc calls low
- * while not wasting too much memory because of over-allocation.
+ * Once a frame the objects are put in buckets by which region of
+ * FRAME_REGION_BLOCKS x FRAME_REGION_BLOCKS blocks they are in.
+ * A frame then only has to look at the objects in the regions which
+ * the view or the radar reaches.  Pulses are in a bucket of their own
+ * after the regions, because their tail may be in another region.
  */
-#define EXPAND(P,N,M,T,E)						\
-    if ((N) + (E) > (M)) {						\
-	if ((M) <= 0) {							\
-	    M = (E) + 2;						\
-	    P = (T *) malloc((M) * sizeof(T));				\
-	    N = 0;							\
-	} else {							\
-	    M = ((M) << 1) + (E);					\
-	    P = (T *) realloc(P, (M) * sizeof(T));			\
-	}								\
-	if (P == NULL) {						\
-	    error("No memory");						\
-	    N = M = 0;							\
-	    return;	/* ! */						\
-	}								\
-    }
+#define FRAME_REGION_BLOCKS	8
+#define FRAME_REGION_CLICKS	(FRAME_REGION_BLOCKS * BLOCK_CLICKS)
+
+static bool		frame_regions;		/* buckets are valid */
+static int		frame_regions_x, frame_regions_y;
+static int		*frame_region_start;	/* first object of bucket */
+static int		max_frame_region_start;
+static int		*frame_region_objs;	/* object indices */
+static int		max_frame_region_objs;
+static int		*frame_object_rank;	/* inverse object shuffle */
+static int		max_frame_object_rank;
 
+/*
+ * The objects shown on radar and the size of their blips, which are
+ * the same for everybody, are found once a frame.  Frame_radar()
+ * then only checks which of them are in range of the player.
+ */
+static bool		frame_radar_objects;	/* lists are valid */
+static int		*frame_radar_size;	/* size of Obj[i] or -1 */
+static int		*frame_radar_objs;	/* in the order of Obj[] */
+static int		num_frame_radar_objs, max_frame_radar_objs;
+static int		*frame_radar_region_start;
+static int		*frame_radar_region_objs; /* by region */
+
+static frame_context_t	*frame_contexts;	/* [0] is the main thread */
+static int		num_frame_contexts;
+static frame_job_t	*frame_jobs;
+static int		num_frame_jobs, max_frame_jobs;
+static int		frame_next_job;
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_t	*frame_threads;
+static int		num_frame_threads;
+static pthread_mutex_t	frame_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	frame_start_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	frame_done_cond = PTHREAD_COND_INITIALIZER;
+static long		frame_generation;
+static int		frame_busy_threads;
+static bool		frame_threads_quit;
+#endif
 
 /*
  * Note - I've changed the block_inview calls to clpos_inview calls,
  * which means that the center of a block has to be visible to be
  * in view.
  */
-static inline bool clpos_inview(click_visibility_t *v, clpos_t pos)
+static inline bool clpos_inview(frame_context_t *fc, clpos_t pos)
 {
-    clpos_t wpos = v->unrealWorld, rwpos = v->realWorld;
+    clpos_t wpos = fc->cv.unrealWorld, rwpos = fc->cv.realWorld;
 
-    if (!((pos.cx > wpos.cx && pos.cx < wpos.cx + view_cwidth)
-	  || (pos.cx > rwpos.cx && pos.cx < rwpos.cx + view_cwidth)))
+    if (!((pos.cx > wpos.cx && pos.cx < wpos.cx + fc->view_cwidth)
+	  || (pos.cx > rwpos.cx && pos.cx < rwpos.cx + fc->view_cwidth)))
 	return false;
-    if (!((pos.cy > wpos.cy && pos.cy < wpos.cy + view_cheight)
-	  || (pos.cy > rwpos.cy && pos.cy < rwpos.cy + view_cheight)))
+    if (!((pos.cy > wpos.cy && pos.cy < wpos.cy + fc->view_cheight)
+	  || (pos.cy > rwpos.cy && pos.cy < rwpos.cy + fc->view_cheight)))
 	return false;
     return true;
 }
 
+/*
+ * Random numbers for frame building come from a small generator
+ * (xorshift32) seeded per connection, instead of randomMT().
+ * This way the frame contents don't depend on which thread builds
+ * them or in which order, and the game itself doesn't depend on
+ * what the players happen to see.
+ */
+static inline unsigned frame_random(frame_context_t *fc)
+{
+    uint32_t x = fc->rand_state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    fc->rand_state = x;
+
+    return x;
+}
+
+static inline double frame_rfrac(frame_context_t *fc)
+{
+    return frame_random(fc) / 4294967296.0;
+}
+
 #define DEBRIS_STORE(xd,yd,color,offset) \
     int			i;						  \
     if (xd < 0)								  \
 	xd += world->width;						  \
     if (yd < 0)								  \
 	yd += world->height;						  \
-    if ((unsigned) xd >= (unsigned)view_width || (unsigned) yd >= (unsigned)view_height) {	  \
+    if ((unsigned) xd >= (unsigned)fc->view_width || (unsigned) yd >= (unsigned)fc->view_height) { \
 	/*								  \
 	 * There's some rounding error or so somewhere.			  \
 	 * Should be possible to resolve it.				  \
@@ -149,9 +229,9 @@ static inline bool clpos_inview(click_visibility_t *v, clpos_t pos)
 	return;								  \
     }									  \
 									  \
-    i = offset + color * debris_areas					  \
-	+ (((yd >> 8) % debris_y_areas) * debris_x_areas)		  \
-	+ ((xd >> 8) % debris_x_areas);					  \
+    i = offset + color * fc->debris_areas				  \
+	+ (((yd >> 8) % fc->debris_y_areas) * fc->debris_x_areas)	  \
+	+ ((xd >> 8) % fc->debris_x_areas);				  \
 									  \
     if (num_ >= 255)							  \
 	return;								  \
@@ -170,98 +250,104 @@ static inline bool clpos_inview(click_visibility_t *v, clpos_t pos)
     ptr_[num_].y = (unsigned char) yd;					  \
     num_++;
 
-static void fastshot_store(int cx, int cy, int color, int offset)
+static void fastshot_store(frame_context_t *fc,
+			   int cx, int cy, int color, int offset)
 {
     int xf = CLICK_TO_PIXEL(cx),
 	yf = CLICK_TO_PIXEL(cy);
-#define ptr_		(fastshot_ptr[i])
-#define num_		(fastshot_num[i])
-#define max_		(fastshot_max[i])
+#define ptr_		(fc->fastshot_ptr[i])
+#define num_		(fc->fastshot_num[i])
+#define max_		(fc->fastshot_max[i])
     DEBRIS_STORE(xf, yf, color, offset);
 #undef ptr_
 #undef num_
 #undef max_
 }
 
-static void debris_store(int cx, int cy, int color)
+static void debris_store(frame_context_t *fc, int cx, int cy, int color)
 {
     int xf = CLICK_TO_PIXEL(cx),
 	yf = CLICK_TO_PIXEL(cy);
-#define ptr_		(debris_ptr[i])
-#define num_		(debris_num[i])
-#define max_		(debris_max[i])
+#define ptr_		(fc->debris_ptr[i])
+#define num_		(fc->debris_num[i])
+#define max_		(fc->debris_max[i])
     DEBRIS_STORE(xf, yf, color, 0);
 #undef ptr_
 #undef num_
 #undef max_
 }
 
-static void fastshot_end(connection_t *conn)
+static void fastshot_end(frame_context_t *fc, connection_t *conn)
 {
     int i;
 
     for (i = 0; i < DEBRIS_TYPES * 2; i++) {
-	if (fastshot_num[i] != 0) {
+	if (fc->fastshot_num[i] != 0) {
 	    Send_fastshot(conn, i,
-			  (unsigned char *) fastshot_ptr[i],
-			  fastshot_num[i]);
-	    fastshot_num[i] = 0;
+			  (unsigned char *) fc->fastshot_ptr[i],
+			  fc->fastshot_num[i]);
+	    fc->fastshot_num[i] = 0;
 	}
     }
 }
 
-static void debris_end(connection_t *conn)
+static void debris_end(frame_context_t *fc, connection_t *conn)
 {
     int			i;
 
     for (i = 0; i < DEBRIS_TYPES; i++) {
-	if (debris_num[i] != 0) {
+	if (fc->debris_num[i] != 0) {
 	    Send_debris(conn, i,
-			(unsigned char *) debris_ptr[i],
-			debris_num[i]);
-	    debris_num[i] = 0;
+			(unsigned char *) fc->debris_ptr[i],
+			fc->debris_num[i]);
+	    fc->debris_num[i] = 0;
 	}
     }
 }
 
-static void Frame_radar_buffer_reset(void)
+static void Frame_radar_buffer_reset(frame_context_t *fc)
 {
-    num_radar = 0;
+    fc->num_radar = 0;
 }
 
-static void Frame_radar_buffer_add(clpos_t pos, int s)
+static void Frame_radar_buffer_add(frame_context_t *fc, clpos_t pos, int s)
 {
     radar_t *p;
 
-    EXPAND(radar_ptr, num_radar, max_radar, radar_t, 1);
-    p = &radar_ptr[num_radar++];
+    /* A frame can't have more, so the rest would be thrown away. */
+    if (fc->num_radar >= MAX_RADAR_BLIPS)
+	return;
+    p = &fc->radar[fc->num_radar++];
     p->x = CLICK_TO_PIXEL(pos.cx);
     p->y = CLICK_TO_PIXEL(pos.cy);
     p->size = s;
 }
 
-static void Frame_radar_buffer_send(connection_t *conn, player_t *pl)
+static int Frame_radar_cmp(const void *a, const void *b)
+{
+    return memcmp(a, b, 3);
+}
+
+static void Frame_radar_buffer_send(frame_context_t *fc,
+				    connection_t *conn, player_t *pl)
 {
-    int i, dest, tmp;
+    int i, dest, tmp, num_radar = fc->num_radar;
     radar_t *p;
     const int radar_width = 256;
     int radar_height, radar_x, radar_y, send_x, send_y;
-    shuffle_t *radar_shuffle;
+    shuffle_t *radar_shuffle = fc->radar_shuffle;
+    bool sorted = (FEATURE(conn, F_FASTRADAR)
+		   && FEATURE(conn, F_DELTAFRAME) && options.deltaFrames);
 
     radar_height = (radar_width * world->height) / world->width;
 
-    if (num_radar > MIN(256, MAX_SHUFFLE_INDEX))
-	num_radar = MIN(256, MAX_SHUFFLE_INDEX);
-    radar_shuffle = XMALLOC(shuffle_t, num_radar);
-    if (radar_shuffle == NULL)
-	return;
     for (i = 0; i < num_radar; i++)
 	radar_shuffle[i] = i;
 
-    if (conn->rectype != 2) {
+    if (conn->rectype != 2 && !sorted) {
 	/* permute. */
 	for (i = 0; i < num_radar; i++) {
-	    dest = (int)(rfrac() * (num_radar - i)) + i;
+	    dest = (int)(frame_rfrac(fc) * (num_radar - i)) + i;
 	    tmp = radar_shuffle[i];
 	    radar_shuffle[i] = radar_shuffle[dest];
 	    radar_shuffle[dest] = tmp;
@@ -270,7 +356,7 @@ static void Frame_radar_buffer_send(connection_t *conn, player_t *pl)
 
     if (!FEATURE(conn, F_FASTRADAR)) {
 	for (i = 0; i < num_radar; i++) {
-	    p = &radar_ptr[radar_shuffle[i]];
+	    p = &fc->radar[radar_shuffle[i]];
 	    radar_x = (radar_width * p->x) / world->width;
 	    radar_y = (radar_height * p->y) / world->height;
 	    send_x = (world->width * radar_x) / radar_width;
@@ -279,14 +365,12 @@ static void Frame_radar_buffer_send(connection_t *conn, player_t *pl)
 	}
     }
     else {
-	unsigned char buf[3*256];
+	unsigned char buf[3*MAX_RADAR_BLIPS];
 	int buf_index = 0;
 	unsigned fast_count = 0;
 
-	if (num_radar > 256)
-	    num_radar = 256;
 	for (i = 0; i < num_radar; i++) {
-	    p = &radar_ptr[radar_shuffle[i]];
+	    p = &fc->radar[radar_shuffle[i]];
 	    radar_x = (radar_width * p->x) / world->width;
 	    radar_y = (radar_height * p->y) / world->height;
 	    if (radar_y >= 1024)
@@ -300,23 +384,21 @@ static void Frame_radar_buffer_send(connection_t *conn, player_t *pl)
 	    buf_index++;
 	    fast_count++;
 	}
+	/*
+	 * The order is random so that the blips can't be told apart,
+	 * but for delta frames it is better if it doesn't change when
+	 * the blips don't move.  Sorting hides who is who just as well.
+	 */
+	if (sorted)
+	    qsort(buf, fast_count, 3, Frame_radar_cmp);
 	if (fast_count > 0)
 	    Send_fastradar(conn, buf, fast_count);
     }
-
-    free(radar_shuffle);
-}
-
-static void Frame_radar_buffer_free(void)
-{
-    XFREE(radar_ptr);
-    num_radar = 0;
-    max_radar = 0;
 }
 
-static int Frame_status(connection_t *conn, player_t *pl)
+static int Frame_status(frame_context_t *fc, connection_t *conn, player_t *pl)
 {
-    static char modsstr[MAX_CHARS];
+    char modsstr[MAX_CHARS];
     int n, lock_ind, lock_id = NO_ID, lock_dist = 0, lock_dir = 0;
     int showautopilot;
 
@@ -346,7 +428,7 @@ static int Frame_status(connection_t *conn, player_t *pl)
 		|| Players_are_allies(pl, lock_pl))
 	    && Player_is_alive(lock_pl)
 	    && (options.playersOnRadar
-		|| clpos_inview(&cv, lock_pl->pos))
+		|| clpos_inview(fc, lock_pl->pos))
 	    && pl->lock.distance != 0) {
 	    double a;
 
@@ -401,14 +483,33 @@ static int Frame_status(connection_t *conn, player_t *pl)
 }
 
 
-static void Frame_map(connection_t *conn, player_t *pl)
+/*
+ * Where in a list of map object indexes, lowest first, to start
+ * so that the one after last comes first and last comes last.
+ */
+static int Frame_map_first(int *list, int n, int last)
+{
+    int first;
+
+    last = MAX(0, last);
+    for (first = 0; first < n; first++) {
+	if (list[first] > last)
+	    break;
+    }
+
+    return n > 0 ? first % n : 0;
+}
+
+static void Frame_map(frame_context_t *fc, connection_t *conn, player_t *pl)
 {
-    int i, k, conn_bit = (1 << conn->ind);
+    int i, k, n, first, dx, dy, *list, conn_word = CONN_MASK_WORD(conn->ind);
+    unsigned conn_bit = CONN_MASK_BIT(conn->ind);
     const int fuel_packet_size = 5;
     const int cannon_packet_size = 5;
     const int target_packet_size = 7;
     const int polystyle_packet_size = 5;
     int bytes_left = 2000, max_packet, packet_count;
+    clpos_t center;
 
     packet_count = 0;
     max_packet = MAX(5, bytes_left / target_packet_size);
@@ -419,9 +520,9 @@ static void Frame_map(connection_t *conn, player_t *pl)
 	if (++i >= Num_targets())
 	    i = 0;
 	targ = Target_by_index(i);
-	if (BIT(targ->update_mask, conn_bit)
-	    || (BIT(targ->conn_mask, conn_bit) == 0
-		&& clpos_inview(&cv, targ->pos))) {
+	if (BIT(targ->update_mask[conn_word], conn_bit)
+	    || (BIT(targ->conn_mask[conn_word], conn_bit) == 0
+		&& clpos_inview(fc, targ->pos))) {
 	    Send_target(conn, i, (int)targ->dead_ticks, targ->damage);
 	    pl->last_target_update = i;
 	    bytes_left -= target_packet_size;
@@ -430,17 +531,37 @@ static void Frame_map(connection_t *conn, player_t *pl)
 	}
     }
 
+    /*
+     * Only the cannons and fuel stations near the view are looked at,
+     * in the same order as if all of them were.
+     */
+    n = MAX(Num_cannons(), Num_fuels());
+    if (fc->max_map_list < n) {
+	XFREE(fc->map_list);
+	fc->max_map_list = n;
+	fc->map_list = XMALLOC(int, fc->max_map_list);
+	if (fc->map_list == NULL) {
+	    fc->max_map_list = 0;
+	    return;
+	}
+    }
+    list = fc->map_list;
+
     packet_count = 0;
     max_packet = MAX(5, bytes_left / cannon_packet_size);
-    i = MAX(0, pl->last_cannon_update);
-    for (k = 0; k < Num_cannons(); k++) {
+    center.cx = fc->cv.realWorld.cx + fc->view_cwidth / 2;
+    center.cy = fc->cv.realWorld.cy + fc->view_cheight / 2;
+    n = World_objects_in_range(CANNON, center,
+			       LENGTH(fc->view_cwidth, fc->view_cheight) / 2
+			       + BLOCK_CLICKS, list, fc->max_map_list);
+    first = Frame_map_first(list, n, pl->last_cannon_update);
+    for (k = 0; k < n; k++) {
 	cannon_t *cannon;
 
-	if (++i >= Num_cannons())
-	    i = 0;
+	i = list[(first + k) % n];
 	cannon = Cannon_by_index(i);
-	if (clpos_inview(&cv, cannon->pos)) {
-	    if (BIT(cannon->conn_mask, conn_bit) == 0) {
+	if (clpos_inview(fc, cannon->pos)) {
+	    if (BIT(cannon->conn_mask[conn_word], conn_bit) == 0) {
 		Send_cannon(conn, i, (int)cannon->dead_ticks);
 		pl->last_cannon_update = i;
 		bytes_left -= max_packet * cannon_packet_size;
@@ -452,19 +573,19 @@ static void Frame_map(connection_t *conn, player_t *pl)
 
     packet_count = 0;
     max_packet = MAX(5, bytes_left / fuel_packet_size);
-    i = MAX(0, pl->last_fuel_update);
-    for (k = 0; k < Num_fuels(); k++) {
+    dx = (fc->view_width << CLICK_SHIFT) + BLOCK_CLICKS;
+    dy = (fc->view_height << CLICK_SHIFT) + BLOCK_CLICKS;
+    n = World_objects_in_range(FUEL, pl->pos, LENGTH(dx, dy),
+			       list, fc->max_map_list);
+    first = Frame_map_first(list, n, pl->last_fuel_update);
+    for (k = 0; k < n; k++) {
 	fuel_t *fs;
 
-	if (++i >= Num_fuels())
-	    i = 0;
-
+	i = list[(first + k) % n];
 	fs = Fuel_by_index(i);
-	if (BIT(fs->conn_mask, conn_bit) == 0) {
-	    if ((CENTER_XCLICK(fs->pos.cx - pl->pos.cx) <
-		 (view_width << CLICK_SHIFT) + BLOCK_CLICKS) &&
-		(CENTER_YCLICK(fs->pos.cy - pl->pos.cy) <
-		 (view_height << CLICK_SHIFT) + BLOCK_CLICKS)) {
+	if (BIT(fs->conn_mask[conn_word], conn_bit) == 0) {
+	    if (ABS(WRAP_DCX(fs->pos.cx - pl->pos.cx)) < dx
+		&& ABS(WRAP_DCY(fs->pos.cy - pl->pos.cy)) < dy) {
 		Send_fuel(conn, i, fs->fuel);
 		pl->last_fuel_update = i;
 		bytes_left -= max_packet * fuel_packet_size;
@@ -484,7 +605,7 @@ static void Frame_map(connection_t *conn, player_t *pl)
 	    i = 0;
 
 	poly = &pdata[i];
-	if (BIT(poly->update_mask, conn_bit)) {
+	if (BIT(poly->update_mask[conn_word], conn_bit)) {
 	    Send_polystyle(conn, i, poly->current_style);
 	    pl->last_polystyle_update = i;
 	    bytes_left -= max_packet * polystyle_packet_size;
@@ -500,6 +621,7 @@ static void Frame_shuffle_objects(void)
     int i;
 
     num_object_shuffle = MIN(NumObjs, options.maxVisibleObject);
+    num_object_shuffle = MIN(num_object_shuffle, MAX_SHUFFLE_INDEX);
 
     if (max_object_shuffle < num_object_shuffle) {
 	XFREE(object_shuffle_ptr);
@@ -565,38 +687,298 @@ static void Frame_shuffle(void)
     }
 }
 
-static void Frame_shots(connection_t *conn, player_t *pl)
+static inline int Frame_region_index(clpos_t pos)
+{
+    int x = pos.cx / FRAME_REGION_CLICKS, y = pos.cy / FRAME_REGION_CLICKS;
+
+    LIMIT(x, 0, frame_regions_x - 1);
+    LIMIT(y, 0, frame_regions_y - 1);
+    return y * frame_regions_x + x;
+}
+
+static inline int Frame_region_bucket(object_t *obj)
+{
+    if (obj->type == OBJ_PULSE)
+	return frame_regions_x * frame_regions_y;
+    return Frame_region_index(obj->pos);
+}
+
+/*
+ * Counting sort of the objects in objs (or of all objects if objs is
+ * NULL) by bucket, in the order they are in objs.  Afterwards the
+ * objects of bucket r are out[start[r]] up to out[start[r + 1]].
+ */
+static void Frame_regions_sort(const int *objs, int num, int *start, int *out)
+{
+    int i, j, r, n = frame_regions_x * frame_regions_y;
+
+    memset(start, 0, (size_t)(n + 3) * sizeof(int));
+    for (j = 0; j < num; j++) {
+	i = (objs != NULL) ? objs[j] : j;
+	start[Frame_region_bucket(Obj[i]) + 2]++;
+    }
+    for (r = 2; r < n + 3; r++)
+	start[r] += start[r - 1];
+    for (j = 0; j < num; j++) {
+	i = (objs != NULL) ? objs[j] : j;
+	out[start[Frame_region_bucket(Obj[i]) + 1]++] = i;
+    }
+}
+
+/*
+ * Put the objects in their buckets.  This is done after the objects
+ * have been shuffled and before the frames are built, which then
+ * only read the buckets.
+ */
+static void Frame_regions_update(void)
+{
+    int i, n;
+
+    frame_regions = false;
+    if (!options.frameRegions)
+	return;
+
+    frame_regions_x = (world->cwidth + FRAME_REGION_CLICKS - 1)
+	/ FRAME_REGION_CLICKS;
+    frame_regions_y = (world->cheight + FRAME_REGION_CLICKS - 1)
+	/ FRAME_REGION_CLICKS;
+    n = frame_regions_x * frame_regions_y;
+
+    if (max_frame_region_start < n + 3) {
+	XFREE(frame_region_start);
+	XFREE(frame_radar_region_start);
+	max_frame_region_start = 0;
+	frame_region_start = XMALLOC(int, n + 3);
+	frame_radar_region_start = XMALLOC(int, n + 3);
+	if (frame_region_start == NULL || frame_radar_region_start == NULL) {
+	    XFREE(frame_region_start);
+	    XFREE(frame_radar_region_start);
+	    return;
+	}
+	max_frame_region_start = n + 3;
+    }
+    if (max_frame_region_objs < NumObjs) {
+	XFREE(frame_region_objs);
+	max_frame_region_objs = NumObjs;
+	frame_region_objs = XMALLOC(int, max_frame_region_objs);
+	if (frame_region_objs == NULL) {
+	    max_frame_region_objs = 0;
+	    return;
+	}
+    }
+    if (max_frame_object_rank < num_object_shuffle) {
+	XFREE(frame_object_rank);
+	max_frame_object_rank = num_object_shuffle;
+	frame_object_rank = XMALLOC(int, max_frame_object_rank);
+	if (frame_object_rank == NULL) {
+	    max_frame_object_rank = 0;
+	    return;
+	}
+    }
+    for (i = 0; i < num_frame_contexts; i++) {
+	frame_context_t *fc = &frame_contexts[i];
+
+	if (fc->max_region_list < NumObjs) {
+	    XFREE(fc->region_list);
+	    fc->max_region_list = NumObjs;
+	    fc->region_list = XMALLOC(int, fc->max_region_list);
+	    if (fc->region_list == NULL) {
+		fc->max_region_list = 0;
+		return;
+	    }
+	}
+    }
+
+    Frame_regions_sort(NULL, NumObjs, frame_region_start, frame_region_objs);
+    if (frame_radar_objects)
+	Frame_regions_sort(frame_radar_objs, num_frame_radar_objs,
+			   frame_radar_region_start, frame_radar_region_objs);
+
+    for (i = 0; i < num_object_shuffle; i++)
+	frame_object_rank[object_shuffle_ptr[i]] = i;
+
+    frame_regions = true;
+}
+
+/*
+ * Find the columns (or rows) of regions which have something at most
+ * dist clicks from c.  They are in one or, if they wrap around the
+ * world edge, two spans.  Returns the number of spans.
+ */
+static int Frame_region_spans(click_t c, click_t dist, click_t size,
+			      int num, int *span)
+{
+    click_t lo, hi;
+
+    if (dist >= size / 2 - FRAME_REGION_CLICKS) {
+	span[0] = 0;
+	span[1] = num - 1;
+	return 1;
+    }
+    lo = c - dist;
+    hi = c + dist;
+    if (!BIT(world->rules->mode, WRAP_PLAY)) {
+	lo = MAX(lo, 0);
+	hi = MIN(hi, size - 1);
+    } else if (lo < 0) {
+	lo += size;
+	hi += size;
+    }
+    span[0] = lo / FRAME_REGION_CLICKS;
+    if (hi < size) {
+	span[1] = hi / FRAME_REGION_CLICKS;
+	return 1;
+    }
+    span[1] = num - 1;
+    span[2] = 0;
+    span[3] = (hi - size) / FRAME_REGION_CLICKS;
+    return 2;
+}
+
+/*
+ * Put in fc->region_list the objects in the regions which have
+ * something at most dx clicks sideways and dy clicks up or down
+ * from pos, and the pulses too if pulses is true.
+ * Returns how many objects there are.
+ */
+static int Frame_regions_get(frame_context_t *fc, const int *start,
+			     const int *objs, clpos_t pos,
+			     click_t dx, click_t dy, bool pulses)
+{
+    int xspan[4], yspan[4], nx, ny, i, j, y, first, last, n = 0;
+
+    nx = Frame_region_spans(pos.cx, dx, world->cwidth,
+			    frame_regions_x, xspan);
+    ny = Frame_region_spans(pos.cy, dy, world->cheight,
+			    frame_regions_y, yspan);
+    for (j = 0; j < ny; j++) {
+	for (y = yspan[2 * j]; y <= yspan[2 * j + 1]; y++) {
+	    for (i = 0; i < nx; i++) {
+		first = start[y * frame_regions_x + xspan[2 * i]];
+		last = start[y * frame_regions_x + xspan[2 * i + 1] + 1];
+		if (last > first) {
+		    memcpy(&fc->region_list[n], &objs[first],
+			   (size_t)(last - first) * sizeof(int));
+		    n += last - first;
+		}
+	    }
+	}
+    }
+    if (pulses) {
+	first = start[frame_regions_x * frame_regions_y];
+	last = start[frame_regions_x * frame_regions_y + 1];
+	if (last > first) {
+	    memcpy(&fc->region_list[n], &objs[first],
+		   (size_t)(last - first) * sizeof(int));
+	    n += last - first;
+	}
+    }
+
+    return n;
+}
+
+static int Frame_cmp_int(const void *a, const void *b)
+{
+    int i = *(const int *)a, j = *(const int *)b;
+
+    return (i > j) - (i < j);
+}
+
+/*
+ * The objects which may be in the view, in the order of the object
+ * shuffle like without regions, so the frames are the same.
+ */
+static int Frame_regions_shots(frame_context_t *fc, player_t *pl,
+			       int *examined)
+{
+    int *list = fc->region_list, i, n, k = 0;
+
+    n = Frame_regions_get(fc, frame_region_start, frame_region_objs,
+			  pl->pos, fc->view_cwidth / 2 + 1,
+			  fc->view_cheight / 2 + 1, true);
+    *examined += n;
+    for (i = 0; i < n; i++) {
+	if (list[i] < num_object_shuffle)
+	    list[k++] = frame_object_rank[list[i]];
+    }
+    if (k > 1)
+	qsort(list, (size_t)k, sizeof(int), Frame_cmp_int);
+    for (i = 0; i < k; i++)
+	list[i] = object_shuffle_ptr[list[i]];
+
+    return k;
+}
+
+/*
+ * The objects shown on radar which may be in radar range,
+ * in the order of Obj[].
+ */
+static int Frame_regions_radar(frame_context_t *fc, player_t *pl)
+{
+    int n;
+    double dist = pl->sensor_range * CLICK;
+
+    dist = MIN(dist, (double)(world->cwidth + world->cheight));
+    n = Frame_regions_get(fc, frame_radar_region_start,
+			  frame_radar_region_objs, pl->pos,
+			  (click_t)dist + 1, (click_t)dist + 1, false);
+    if (n > 1)
+	qsort(fc->region_list, (size_t)n, sizeof(int), Frame_cmp_int);
+
+    return n;
+}
+
+static void Frame_shots(frame_context_t *fc, connection_t *conn, player_t *pl)
 {
     clpos_t pos;
     int ldir = 0, i, k, color, fuzz = 0, teamshot, len, obj_count;
+    int *shot_list = NULL, num_shots = num_object_shuffle;
+    int examined = 0, sent = 0;
     object_t *shot, **obj_list;
     int hori_blocks, vert_blocks;
 
-    hori_blocks = (view_width + (BLOCK_SZ - 1)) / (2 * BLOCK_SZ);
-    vert_blocks = (view_height + (BLOCK_SZ - 1)) / (2 * BLOCK_SZ);
-    if (NumObjs >= options.cellGetObjectsThreshold)
-	Cell_get_objects(pl->pos, MAX(hori_blocks, vert_blocks),
-			 num_object_shuffle, &obj_list, &obj_count);
-    else {
+    hori_blocks = (fc->view_width + (BLOCK_SZ - 1)) / (2 * BLOCK_SZ);
+    vert_blocks = (fc->view_height + (BLOCK_SZ - 1)) / (2 * BLOCK_SZ);
+    if (frame_regions) {
+	num_shots = Frame_regions_shots(fc, pl, &examined);
+	shot_list = fc->region_list;
+	obj_list = Obj;
+	obj_count = NumObjs;
+    } else if (NumObjs >= options.cellGetObjectsThreshold) {
+	if (fc->max_object_list < num_object_shuffle) {
+	    XFREE(fc->object_list_ptr);
+	    fc->max_object_list = num_object_shuffle;
+	    fc->object_list_ptr = XMALLOC(object_t *, fc->max_object_list);
+	    if (fc->object_list_ptr == NULL)
+		fc->max_object_list = 0;
+	}
+	obj_list = fc->object_list_ptr;
+	obj_count = Cell_get_objects(pl->pos, MAX(hori_blocks, vert_blocks),
+				     MIN(num_object_shuffle,
+					 fc->max_object_list),
+				     obj_list);
+    } else {
 	obj_list = Obj;
 	obj_count = NumObjs;
     }
 
-    for (k = 0; k < num_object_shuffle; k++) {
-	i = object_shuffle_ptr[k];
+    for (k = 0; k < num_shots; k++) {
+	i = (shot_list != NULL) ? shot_list[k] : object_shuffle_ptr[k];
 	if (i >= obj_count)
 	    continue;
 	shot = obj_list[i];
 	pos = shot->pos;
+	if (shot_list == NULL)
+	    examined++;
 
 	if (shot->type != OBJ_PULSE) {
-	    if (!clpos_inview(&cv, shot->pos))
+	    if (!clpos_inview(fc, shot->pos))
 		continue;
 	} else {
 	    pulseobject_t *pulse = PULSE_PTR(shot);
 
 	    /* check if either end of laser pulse is in view */
-	    if (clpos_inview(&cv, pos))
+	    if (clpos_inview(fc, pos))
 		ldir = MOD2(pulse->pulse_dir + RES/2, RES);
 	    else {
 		pos.cx = (click_t)(pos.cx
@@ -605,10 +987,11 @@ static void Frame_shots(connection_t *conn, player_t *pl)
 			  - tsin(pulse->pulse_dir) * pulse->pulse_len * CLICK);
 		pos = World_wrap_clpos(pos);
 		ldir = pulse->pulse_dir;
-		if (!clpos_inview(&cv, pos))
+		if (!clpos_inview(fc, pos))
 		    continue;
 	    }
 	}
+	sent++;
 	if ((color = shot->color) == BLACK) {
 	    xpprintf("black %d,%d\n", shot->type, shot->id);
 	    color = WHITE;
@@ -618,11 +1001,11 @@ static void Frame_shots(connection_t *conn, player_t *pl)
 	case OBJ_DEBRIS:
 	    if ((fuzz >>= 7) < 0x40) {
 		if (conn->rectype != 2)
-		    fuzz = randomMT();
+		    fuzz = frame_random(fc);
 		else
 		    fuzz = 0;
 	    }
-	    if ((fuzz & 0x7F) >= spark_rand) {
+	    if ((fuzz & 0x7F) >= fc->spark_rand) {
 		/*
 		 * produce a sparkling effect by not displaying
 		 * particles every frame.
@@ -636,8 +1019,8 @@ static void Frame_shots(connection_t *conn, player_t *pl)
 	     * of the debris particles.
 	     * Higher color number means hotter debris.
 	     */
-	    if (debris_colors >= 3) {
-		if (debris_colors > 4) {
+	    if (fc->debris_colors >= 3) {
+		if (fc->debris_colors > 4) {
 		    if (color == BLUE)
 			color = (int)shot->life / 2;
 		    else
@@ -648,17 +1031,18 @@ static void Frame_shots(connection_t *conn, player_t *pl)
 		    else
 			color = (int)shot->life / 8;
 		}
-		if (color >= debris_colors)
-		    color = debris_colors - 1;
+		if (color >= fc->debris_colors)
+		    color = fc->debris_colors - 1;
 	    }
 
-	    debris_store(shot->pos.cx - cv.unrealWorld.cx,
-			 shot->pos.cy - cv.unrealWorld.cy,
+	    debris_store(fc,
+			 shot->pos.cx - fc->cv.unrealWorld.cx,
+			 shot->pos.cy - fc->cv.unrealWorld.cy,
 			 color);
 	    break;
 
 	case OBJ_WRECKAGE:
-	    if (spark_rand != 0 || options.wreckageCollisionMayKill) {
+	    if (fc->spark_rand != 0 || options.wreckageCollisionMayKill) {
 		wireobject_t *wreck = WIRE_PTR(shot);
 		Send_wreckage(conn, pos, wreck->wire_type,
 			      wreck->wire_size, wreck->wire_rotation);
@@ -693,8 +1077,9 @@ static void Frame_shots(connection_t *conn, player_t *pl)
 	    } else
 		teamshot = 0;
 
-	    fastshot_store(shot->pos.cx - cv.unrealWorld.cx,
-			   shot->pos.cy - cv.unrealWorld.cy,
+	    fastshot_store(fc,
+			   shot->pos.cx - fc->cv.unrealWorld.cx,
+			   shot->pos.cy - fc->cv.unrealWorld.cy,
 			   color, teamshot);
 	    break;
 
@@ -747,7 +1132,7 @@ static void Frame_shots(connection_t *conn, player_t *pl)
 					&& mine->mine_owner == pl->id));
 		    if (confused) {
 			id = 0;
-			laid_by_team = (rfrac() < 0.5);
+			laid_by_team = (frame_rfrac(fc) < 0.5);
 		    }
 		}
 		Send_mine(conn, pos, laid_by_team, id);
@@ -760,7 +1145,7 @@ static void Frame_shots(connection_t *conn, player_t *pl)
 		int item_type = item->item_type;
 
 		if (BIT(item->obj_status, RANDOM_ITEM))
-		    item_type = Choose_random_item();
+		    item_type = Choose_item_by_frac(frame_rfrac(fc));
 
 		Send_item(conn, pos, item_type);
 	    }
@@ -784,16 +1169,19 @@ static void Frame_shots(connection_t *conn, player_t *pl)
 	    break;
 	}
     }
+
+    conn->objects_examined += examined;
+    conn->objects_sent += sent;
 }
 
-static void Frame_ships(connection_t *conn, player_t *pl)
+static void Frame_ships(frame_context_t *fc, connection_t *conn, player_t *pl)
 {
     int i, k;
 
     for (i = 0; i < Num_ecms(); i++) {
 	ecm_t *ecm = Ecm_by_index(i);
 
-	if (clpos_inview(&cv, ecm->pos))
+	if (clpos_inview(fc, ecm->pos))
 	    Send_ecm(conn, ecm->pos, (int)ecm->size);
     }
 
@@ -807,8 +1195,8 @@ static void Frame_ships(connection_t *conn, player_t *pl)
 	if (victim == NULL || tpl == NULL)
 	    continue;
 
-	if (clpos_inview(&cv, victim->pos)
-	    || clpos_inview(&cv, pos))
+	if (clpos_inview(fc, victim->pos)
+	    || clpos_inview(fc, pos))
 	    Send_trans(conn, victim->pos, pos);
     }
 
@@ -822,7 +1210,7 @@ static void Frame_ships(connection_t *conn, player_t *pl)
 	    if (t == NULL)
 		continue;
 
-	    if (clpos_inview(&cv, t->pos)) {
+	    if (clpos_inview(fc, t->pos)) {
 		int j;
 
 		for (j = 0; j < 3; j++) {
@@ -851,7 +1239,7 @@ static void Frame_ships(connection_t *conn, player_t *pl)
 	    || Player_is_appearing(pl_i)) {
 	    if (pl_i->home_base == NULL)
 		continue;
-	    if (!clpos_inview(&cv, pl_i->home_base->pos))
+	    if (!clpos_inview(fc, pl_i->home_base->pos))
 		continue;
 	    if (Player_is_paused(pl_i))
 		Send_paused(conn, pl_i->home_base->pos,
@@ -862,7 +1250,7 @@ static void Frame_ships(connection_t *conn, player_t *pl)
 	    continue;
 	}
 
-	if (!clpos_inview(&cv, pl_i->pos))
+	if (!clpos_inview(fc, pl_i->pos))
 	    continue;
 
 	/* Don't transmit information if fighter is invisible */
@@ -888,14 +1276,14 @@ static void Frame_ships(connection_t *conn, player_t *pl)
 	if (Player_is_refueling(pl_i)) {
 	    fuel_t *fs = Fuel_by_index(pl_i->fs);
 
-	    if (clpos_inview(&cv, fs->pos))
+	    if (clpos_inview(fc, fs->pos))
 		Send_refuel(conn, fs->pos, pl_i->pos);
 	}
 
 	if (Player_is_repairing(pl_i)) {
 	    target_t *targ = Target_by_index(pl_i->repair_target);
 
-	    if (clpos_inview(&cv, targ->pos))
+	    if (clpos_inview(fc, targ->pos))
 		/* same packet as refuel */
 		Send_refuel(conn, pl_i->pos, targ->pos);
 	}
@@ -903,7 +1291,7 @@ static void Frame_ships(connection_t *conn, player_t *pl)
 	if (Player_uses_tractor_beam(pl_i)) {
 	    player_t *t = Player_by_id(pl_i->lock.pl_id);
 
-	    if (clpos_inview(&cv, t->pos)) {
+	    if (clpos_inview(fc, t->pos)) {
 		int j;
 
 		for (j = 0; j < 3; j++) {
@@ -918,18 +1306,21 @@ static void Frame_ships(connection_t *conn, player_t *pl)
 	}
 
 	if (pl_i->ball != NULL
-	    && clpos_inview(&cv, pl_i->ball->pos))
+	    && clpos_inview(fc, pl_i->ball->pos))
 	    Send_connector(conn, pl_i->ball->pos, pl_i->pos, 0);
     }
 }
 
-static void Frame_radar(connection_t *conn, player_t *pl)
+/*
+ * Find the objects shown on radar this frame and their blip sizes.
+ */
+static void Frame_radar_objects_update(void)
 {
-    int i, k, mask, shownuke, size;
+    int i, mask, shownuke, size;
     object_t *shot;
-    clpos_t pos;
 
-    Frame_radar_buffer_reset();
+    frame_radar_objects = false;
+    num_frame_radar_objs = 0;
 
     if (options.nukesOnRadar)
 	mask = OBJ_SMART_SHOT_BIT|OBJ_TORPEDO_BIT|OBJ_HEAT_SHOT_BIT
@@ -944,41 +1335,92 @@ static void Frame_radar(connection_t *conn, player_t *pl)
     if (options.asteroidsOnRadar)
 	mask |= OBJ_ASTEROID_BIT;
 
-    if (mask) {
-	for (i = 0; i < NumObjs; i++) {
-	    shot = Obj[i];
-	    if (!BIT(OBJ_TYPEBIT(shot->type), mask))
+    if (!mask)
+	return;
+
+    if (max_frame_radar_objs < NumObjs) {
+	XFREE(frame_radar_size);
+	XFREE(frame_radar_objs);
+	XFREE(frame_radar_region_objs);
+	max_frame_radar_objs = 0;
+	frame_radar_size = XMALLOC(int, NumObjs);
+	frame_radar_objs = XMALLOC(int, NumObjs);
+	frame_radar_region_objs = XMALLOC(int, NumObjs);
+	if (frame_radar_size == NULL || frame_radar_objs == NULL
+	    || frame_radar_region_objs == NULL) {
+	    error("No memory for radar objects");
+	    XFREE(frame_radar_size);
+	    XFREE(frame_radar_objs);
+	    XFREE(frame_radar_region_objs);
+	    return;
+	}
+	max_frame_radar_objs = NumObjs;
+    }
+
+    for (i = 0; i < NumObjs; i++) {
+	shot = Obj[i];
+	frame_radar_size[i] = -1;
+	if (!BIT(OBJ_TYPEBIT(shot->type), mask))
+	    continue;
+
+	shownuke = (options.nukesOnRadar
+		    && Mods_get(shot->mods, ModsNuclear));
+	if (shownuke && (frame_loops_slow & 2))
+	    size = 3;
+	else
+	    size = 0;
+
+	if (shot->type == OBJ_MINE) {
+	    if (!options.minesOnRadar && !shownuke)
+		continue;
+	    if (frame_loops_slow % 8 >= 6)
+		continue;
+	} else if (shot->type == OBJ_BALL) {
+	    size = 2;
+	} else if (shot->type == OBJ_ASTEROID) {
+	    size = WIRE_PTR(shot)->wire_size + 1;
+	    size |= 0x80;
+	} else {
+	    if (!options.missilesOnRadar && !shownuke)
+		continue;
+	    if (frame_loops_slow & 1)
 		continue;
+	}
 
-	    shownuke = (options.nukesOnRadar
-			&& Mods_get(shot->mods, ModsNuclear));
-	    if (shownuke && (frame_loops_slow & 2))
-		size = 3;
-	    else
-		size = 0;
+	frame_radar_size[i] = size;
+	frame_radar_objs[num_frame_radar_objs++] = i;
+    }
 
-	    if (shot->type == OBJ_MINE) {
-		if (!options.minesOnRadar && !shownuke)
-		    continue;
-		if (frame_loops_slow % 8 >= 6)
-		    continue;
-	    } else if (shot->type == OBJ_BALL) {
-		size = 2;
-	    } else if (shot->type == OBJ_ASTEROID) {
-		size = WIRE_PTR(shot)->wire_size + 1;
-		size |= 0x80;
-	    } else {
-		if (!options.missilesOnRadar && !shownuke)
-		    continue;
-		if (frame_loops_slow & 1)
-		    continue;
-	    }
+    frame_radar_objects = true;
+}
+
+static void Frame_radar(frame_context_t *fc, connection_t *conn, player_t *pl)
+{
+    int i, k, size, num_objs, *objs, examined = 0, sent = 0;
+    clpos_t pos;
 
-	    pos = shot->pos;
+    Frame_radar_buffer_reset(fc);
+
+    if (frame_radar_objects && conn->gov.level < GOV_RADAR_LEVEL) {
+	if (frame_regions) {
+	    num_objs = Frame_regions_radar(fc, pl);
+	    objs = fc->region_list;
+	} else {
+	    num_objs = num_frame_radar_objs;
+	    objs = frame_radar_objs;
+	}
+	examined += num_objs;
+	for (k = 0; k < num_objs; k++) {
+	    i = objs[k];
+	    pos = Obj[i]->pos;
 	    if (Wrap_length(pl->pos.cx - pos.cx,
-			    pl->pos.cy - pos.cy) <= pl->sensor_range * CLICK)
-		Frame_radar_buffer_add(pos, size);
+			    pl->pos.cy - pos.cy) <= pl->sensor_range * CLICK) {
+		Frame_radar_buffer_add(fc, pos, frame_radar_size[i]);
+		sent++;
+	    }
 	}
+	conn->objects_examined += examined;
+	conn->objects_sent += sent;
     }
 
     if (options.playersOnRadar
@@ -1020,11 +1462,11 @@ static void Frame_radar(connection_t *conn, player_t *pl)
 		|| Players_are_allies(pl, pl_i)
 		|| Player_owns_tank(pl, pl_i))
 		size |= 0x80;
-	    Frame_radar_buffer_add(pos, size);
+	    Frame_radar_buffer_add(fc, pos, size);
 	}
     }
 
-    Frame_radar_buffer_send(conn, pl);
+    Frame_radar_buffer_send(fc, conn, pl);
 }
 
 static void Frame_lose_item_state(player_t *pl)
@@ -1038,40 +1480,276 @@ static void Frame_lose_item_state(player_t *pl)
     }
 }
 
-static void Frame_parameters(connection_t *conn, player_t *pl)
+static void Frame_parameters(frame_context_t *fc,
+			     connection_t *conn, player_t *pl)
 {
-    Get_display_parameters(conn, &view_width, &view_height,
-			   &debris_colors, &spark_rand);
-    debris_x_areas = (view_width + 255) >> 8;
-    debris_y_areas = (view_height + 255) >> 8;
-    debris_areas = debris_x_areas * debris_y_areas;
-
-    view_cwidth = view_width * CLICK;
-    view_cheight = view_height * CLICK;
-    cv.unrealWorld.cx = pl->pos.cx - view_cwidth / 2;	/* Scroll */
-    cv.unrealWorld.cy = pl->pos.cy - view_cheight / 2;
-    cv.realWorld = cv.unrealWorld;
+    click_visibility_t *cv = &fc->cv;
+
+    Get_display_parameters(conn, &fc->view_width, &fc->view_height,
+			   &fc->debris_colors, &fc->spark_rand);
+    fc->debris_x_areas = (fc->view_width + 255) >> 8;
+    fc->debris_y_areas = (fc->view_height + 255) >> 8;
+    fc->debris_areas = fc->debris_x_areas * fc->debris_y_areas;
+
+    fc->view_cwidth = fc->view_width * CLICK;
+    fc->view_cheight = fc->view_height * CLICK;
+    cv->unrealWorld.cx = pl->pos.cx - fc->view_cwidth / 2;	/* Scroll */
+    cv->unrealWorld.cy = pl->pos.cy - fc->view_cheight / 2;
+    cv->realWorld = cv->unrealWorld;
     if (BIT (world->rules->mode, WRAP_PLAY)) {
-	if (cv.unrealWorld.cx < 0
-	    && cv.unrealWorld.cx + view_cwidth < world->cwidth)
-	    cv.unrealWorld.cx += world->cwidth;
-	else if (cv.unrealWorld.cx > 0
-		 && cv.unrealWorld.cx + view_cwidth >= world->cwidth)
-	    cv.realWorld.cx -= world->cwidth;
-	if (cv.unrealWorld.cy < 0
-	    && cv.unrealWorld.cy + view_cheight < world->cheight)
-	    cv.unrealWorld.cy += world->cheight;
-	else if (cv.unrealWorld.cy > 0
-		 && cv.unrealWorld.cy + view_cheight >=world->cheight)
-	    cv.realWorld.cy -= world->cheight;
+	if (cv->unrealWorld.cx < 0
+	    && cv->unrealWorld.cx + fc->view_cwidth < world->cwidth)
+	    cv->unrealWorld.cx += world->cwidth;
+	else if (cv->unrealWorld.cx > 0
+		 && cv->unrealWorld.cx + fc->view_cwidth >= world->cwidth)
+	    cv->realWorld.cx -= world->cwidth;
+	if (cv->unrealWorld.cy < 0
+	    && cv->unrealWorld.cy + fc->view_cheight < world->cheight)
+	    cv->unrealWorld.cy += world->cheight;
+	else if (cv->unrealWorld.cy > 0
+		 && cv->unrealWorld.cy + fc->view_cheight >=world->cheight)
+	    cv->realWorld.cy -= world->cheight;
+    }
+}
+
+/*
+ * Build the frame contents for one job.  This may run in any of the
+ * frame building threads, so it must only write to the job's own
+ * connection and to the players of the job, see frame_job_t.
+ */
+static void Frame_build(frame_context_t *fc, frame_job_t *job)
+{
+    connection_t *conn = job->conn;
+    player_t *pl2 = job->pl2;
+
+    fc->rand_state = job->seed;
+
+    Frame_parameters(fc, conn, pl2);
+    if (Frame_status(fc, conn, pl2) <= 0) {
+	job->end = false;
+	return;
+    }
+    Frame_map(fc, conn, pl2);
+    Frame_shots(fc, conn, pl2);
+    Frame_ships(fc, conn, pl2);
+    Frame_radar(fc, conn, pl2);
+    Frame_lose_item_state(job->pl);
+    debris_end(fc, conn);
+    fastshot_end(fc, conn);
+}
+
+/*
+ * Returns the first job of the next chain nobody has taken yet,
+ * or -1 if there are none left.
+ */
+static int Frame_next_chain(void)
+{
+    int j;
+
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_lock(&frame_mutex);
+#endif
+    for (j = frame_next_job; j < num_frame_jobs; j++) {
+	if (frame_jobs[j].chain_head)
+	    break;
+    }
+    frame_next_job = j + 1;
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_unlock(&frame_mutex);
+#endif
+
+    return (j < num_frame_jobs) ? j : -1;
+}
+
+static void Frame_build_jobs(frame_context_t *fc)
+{
+    int j;
+
+    while ((j = Frame_next_chain()) != -1) {
+	for (; j != -1; j = frame_jobs[j].next)
+	    Frame_build(fc, &frame_jobs[j]);
     }
 }
 
+static void Frame_context_free(frame_context_t *fc)
+{
+    int i;
+
+    for (i = 0; i < DEBRIS_TYPES; i++)
+	XFREE(fc->debris_ptr[i]);
+    for (i = 0; i < DEBRIS_TYPES * 2; i++)
+	XFREE(fc->fastshot_ptr[i]);
+    XFREE(fc->object_list_ptr);
+    XFREE(fc->region_list);
+    XFREE(fc->map_list);
+    memset(fc, 0, sizeof(*fc));
+}
+
+#ifdef HAVE_LIBPTHREAD
+static void *Frame_thread(void *arg)
+{
+    frame_context_t *fc = (frame_context_t *) arg;
+
+    pthread_mutex_lock(&frame_mutex);
+    for (;;) {
+	while (fc->generation == frame_generation && !frame_threads_quit)
+	    pthread_cond_wait(&frame_start_cond, &frame_mutex);
+	if (frame_threads_quit)
+	    break;
+	fc->generation = frame_generation;
+	pthread_mutex_unlock(&frame_mutex);
+
+	Frame_build_jobs(fc);
+
+	pthread_mutex_lock(&frame_mutex);
+	if (--frame_busy_threads == 0)
+	    pthread_cond_signal(&frame_done_cond);
+    }
+    pthread_mutex_unlock(&frame_mutex);
+
+    return NULL;
+}
+
+static void Frame_threads_stop(void)
+{
+    int i;
+
+    pthread_mutex_lock(&frame_mutex);
+    frame_threads_quit = true;
+    pthread_cond_broadcast(&frame_start_cond);
+    pthread_mutex_unlock(&frame_mutex);
+
+    for (i = 0; i < num_frame_threads; i++)
+	pthread_join(frame_threads[i], NULL);
+
+    frame_threads_quit = false;
+    num_frame_threads = 0;
+    XFREE(frame_threads);
+}
+#endif
+
+/*
+ * Start or stop frame building threads if options.frameThreads
+ * has changed.  Each thread gets its own frame context.
+ */
+static void Frame_threads_update(void)
+{
+    int i, n = MAX(0, MIN(options.frameThreads, MAX_FRAME_THREADS));
+
+#ifndef HAVE_LIBPTHREAD
+    if (n > 0 && num_frame_contexts == 0)
+	warn("No thread support, frames are built in the main thread.");
+    n = 0;
+#endif
+    if (num_frame_contexts == n + 1)
+	return;
+
+#ifdef HAVE_LIBPTHREAD
+    Frame_threads_stop();
+#endif
+    for (i = 0; i < num_frame_contexts; i++)
+	Frame_context_free(&frame_contexts[i]);
+    XFREE(frame_contexts);
+
+    frame_contexts = XCALLOC(frame_context_t, n + 1);
+    if (frame_contexts == NULL) {
+	error("No memory for frame contexts");
+	exit(1);
+    }
+    num_frame_contexts = n + 1;
+
+#ifdef HAVE_LIBPTHREAD
+    if (n == 0)
+	return;
+    frame_threads = XMALLOC(pthread_t, n);
+    if (frame_threads == NULL) {
+	error("No memory for frame threads");
+	return;
+    }
+    for (i = 0; i < n; i++) {
+	frame_context_t *fc = &frame_contexts[i + 1];
+
+	fc->generation = frame_generation;
+	if (pthread_create(&frame_threads[i], NULL, Frame_thread, fc) != 0) {
+	    error("Can't create frame thread");
+	    break;
+	}
+	num_frame_threads++;
+    }
+#endif
+}
+
+/*
+ * Build the frame contents of all jobs, using the frame building
+ * threads if there are any.
+ */
+static void Frame_build_all(int num_chains)
+{
+    frame_next_job = 0;
+
+#ifdef HAVE_LIBPTHREAD
+    if (num_frame_threads > 0 && num_chains > 1) {
+	pthread_mutex_lock(&frame_mutex);
+	frame_generation++;
+	frame_busy_threads = num_frame_threads;
+	pthread_cond_broadcast(&frame_start_cond);
+	pthread_mutex_unlock(&frame_mutex);
+
+	Frame_build_jobs(&frame_contexts[0]);
+
+	pthread_mutex_lock(&frame_mutex);
+	while (frame_busy_threads > 0)
+	    pthread_cond_wait(&frame_done_cond, &frame_mutex);
+	pthread_mutex_unlock(&frame_mutex);
+	return;
+    }
+#endif
+
+    Frame_build_jobs(&frame_contexts[0]);
+}
+
+/*
+ * Sounds queued for a player are sent to that player's connection,
+ * which isn't the connection of the job if someone is watching the
+ * player.  If that connection gets its own frame later in this update
+ * the start of that frame would have thrown the sounds away, so do
+ * that here instead of adding them to a frame which is already built.
+ */
+static void Frame_sounds(int j)
+{
+    player_t *pl2 = frame_jobs[j].pl2;
+    int k;
+
+    if (options.sound
+	&& pl2->audio != NULL
+	&& pl2->conn != NULL
+	&& pl2->conn != frame_jobs[j].conn) {
+	for (k = j + 1; k < num_frame_jobs; k++) {
+	    if (frame_jobs[k].conn == pl2->conn) {
+		sound_close(pl2);
+		return;
+	    }
+	}
+    }
+    sound_play_queued(pl2);
+}
+
+/*
+ * Frames are made in three steps.  First the start of the frame
+ * is sent to every connection which gets a frame this update.
+ * Then the frame contents are built, in parallel if there are frame
+ * building threads.  Last the frames are ended and sent.  The first
+ * and last steps are done in the main thread in connection order,
+ * so that anything they do with shared state happens in the same
+ * order as before.
+ */
 void Frame_update(void)
 {
-    int i, ind, player_fps;
+    int i, j, k, ind, player_fps, num_chains = 0;
+    uint32_t seed;
     connection_t *conn;
     player_t *pl, *pl2;
+    frame_job_t *job;
     time_t newTimeLeft = 0;
     static time_t oldTimeLeft;
     static bool game_over_called = false;
@@ -1086,6 +1764,7 @@ void Frame_update(void)
     }
 
     Frame_shuffle();
+    Frame_threads_update();
 
     if (options.gameDuration > 0.0
 	&& game_over_called == false
@@ -1100,9 +1779,22 @@ void Frame_update(void)
 	}
     }
 
+    num_frame_jobs = 0;
+    if (max_frame_jobs < num_player_shuffle + NumSpectators) {
+	XFREE(frame_jobs);
+	max_frame_jobs = num_player_shuffle + NumSpectators;
+	frame_jobs = XMALLOC(frame_job_t, max_frame_jobs);
+	if (frame_jobs == NULL) {
+	    error("No memory for frame jobs");
+	    max_frame_jobs = 0;
+	}
+    }
+
     for (i = 0; i < spectatorStart + NumSpectators; i++) {
 	if (i >= num_player_shuffle && i < spectatorStart)
 	    continue;
+	if (num_frame_jobs >= max_frame_jobs)
+	    break;
 	pl = Player_by_index(i);
 	conn = pl->conn;
 	if (conn == NULL)
@@ -1135,6 +1827,12 @@ void Frame_update(void)
  		continue;
 	}
 
+	/*
+	 * And further if the link can't take all frames.
+	 */
+	if (!Governor_frame(conn))
+	    continue;
+
 	if (Send_start_of_frame(conn) == -1)
 	    continue;
 	if (newTimeLeft != oldTimeLeft)
@@ -1169,27 +1867,65 @@ void Frame_update(void)
 	}
 
 	pl2 = Player_by_index(ind);
-	if (pl2->damaged > 0)
+	job = &frame_jobs[num_frame_jobs++];
+	job->conn = conn;
+	job->pl = pl;
+	job->pl2 = pl2;
+	job->next = -1;
+	job->chain_head = false;
+	job->end = true;
+	if (pl2->damaged > 0) {
 	    Send_damaged(conn, (int)pl2->damaged);
-	else {
-	    Frame_parameters(conn, pl2);
-	    if (Frame_status(conn, pl2) <= 0)
-		continue;
-	    Frame_map(conn, pl2);
-	    Frame_shots(conn, pl2);
-	    Frame_ships(conn, pl2);
-	    Frame_radar(conn, pl2);
-	    Frame_lose_item_state(pl);
-	    debris_end(conn);
-	    fastshot_end(conn);
+	    job->build = false;
+	    continue;
+	}
+	job->build = true;
+	for (k = num_frame_jobs - 2; k >= 0; k--) {
+	    if (frame_jobs[k].build && frame_jobs[k].pl2 == pl2) {
+		frame_jobs[k].next = num_frame_jobs - 1;
+		break;
+	    }
+	}
+	if (k < 0) {
+	    job->chain_head = true;
+	    num_chains++;
 	}
-	sound_play_queued(pl2);
-	Send_end_of_frame(conn);
+    }
+
+    if (num_chains > 0) {
+	/*
+	 * Give each job its own random number stream.
+	 */
+	seed = randomMT();
+	for (j = 0; j < num_frame_jobs; j++) {
+	    uint32_t x = seed + (uint32_t)j * 0x9E3779B9U;
+
+	    x ^= x >> 16;
+	    x *= 0x85EBCA6BU;
+	    x ^= x >> 13;
+	    x *= 0xC2B2AE35U;
+	    x ^= x >> 16;
+	    frame_jobs[j].seed = (x != 0) ? x : 1;
+	}
+
+	/* Cell_get_objects() must not modify anything from now on. */
+	Cell_flush_pending();
+	Frame_radar_objects_update();
+	Frame_regions_update();
+
+	Frame_build_all(num_chains);
+    }
+
+    for (j = 0; j < num_frame_jobs; j++) {
+	job = &frame_jobs[j];
+	if (!job->end)
+	    continue;
+	playback = (job->pl->rectype == 1);
+	Frame_sounds(j);
+	Send_end_of_frame(job->conn);
     }
     playback = rplayback;
     oldTimeLeft = newTimeLeft;
-
-    Frame_radar_buffer_free();
 }
 
 void Set_message(const char *message)
@@ -25,54 +25,87 @@
 
 #include "xpserver.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #define GRAV_RANGE  10
+#define GRAV_SIZE   (2 * GRAV_RANGE + 1)
+#define GRAV_TILE   32	/* region size used to fill a compact grid */
+
+static vector_t grav_tab[GRAV_RANGE+1][GRAV_RANGE+1];
+static vector_t uniform_grav;
+
+/*
+ * The gravity of a block is the global gravity plus that of the gravs
+ * around it.  grav_contrib holds what each grav adds to the GRAV_SIZE
+ * * GRAV_SIZE blocks around it, column by column, and grav_local the
+ * sum of that for every block, column by column like world->gravity.
+ * The gravity options only change the global gravity, so then the
+ * gravs don't have to be gone through again, and when a grav changes
+ * only the blocks around it are recomputed, see Grav_changed().
+ * There is no grav_local for a compact grid, which is meant to save
+ * memory.
+ */
+static vector_t *grav_contrib;
+static vector_t *grav_local;
+static bool grav_valid;
+
+/*
+ * Global gravity of block (xi, yi).  Compute_gravity() sets uniform_grav.
+ */
+static inline vector_t Global_gravity_at(int xi, int yi)
+{
+    int dx, dy;
+    double strength;
+    vector_t grav;
+
+    if (options.gravityPointSource == false)
+	return uniform_grav;
 
+    dx = (xi - options.gravityPoint.x) * BLOCK_SZ;
+    dx = WRAP_DX(dx);
+    dy = (yi - options.gravityPoint.y) * BLOCK_SZ;
+    dy = WRAP_DX(dy);
+
+    if (dx == 0 && dy == 0) {
+	grav.x = 0.0;
+	grav.y = 0.0;
+	return grav;
+    }
+    strength = options.gravity / LENGTH(dx, dy);
+    if (options.gravityClockwise) {
+	grav.x =  dy * strength;
+	grav.y = -dx * strength;
+    }
+    else if (options.gravityAnticlockwise) {
+	grav.x = -dy * strength;
+	grav.y =  dx * strength;
+    }
+    else {
+	grav.x =  dx * strength;
+	grav.y =  dy * strength;
+    }
+    return grav;
+}
+
+/*
+ * Set world->gravity to the global gravity plus grav_local.
+ */
 static void Compute_global_gravity(void)
 {
-    int xi, yi, dx, dy;
-    double xforce, yforce, strength, theta;
-    vector_t *grav;
+    int xi, yi;
+    vector_t *grav, *local = grav_local;
 
-    if (options.gravityPointSource == false) {
-	theta = (options.gravityAngle * PI) / 180.0;
-	xforce = cos(theta) * options.gravity;
-	yforce = sin(theta) * options.gravity;
-	for (xi = 0; xi < world->x; xi++) {
-	    grav = world->gravity[xi];
+    for (xi = 0; xi < world->x; xi++) {
+	grav = world->gravity[xi];
 
-	    for (yi = 0; yi < world->y; yi++, grav++) {
-		grav->x = xforce;
-		grav->y = yforce;
-	    }
-	}
-    } else {
-	for (xi = 0; xi < world->x; xi++) {
-	    grav = world->gravity[xi];
-	    dx = (xi - options.gravityPoint.x) * BLOCK_SZ;
-	    dx = WRAP_DX(dx);
-
-	    for (yi = 0; yi < world->y; yi++, grav++) {
-		dy = (yi - options.gravityPoint.y) * BLOCK_SZ;
-		dy = WRAP_DX(dy);
-
-		if (dx == 0 && dy == 0) {
-		    grav->x = 0.0;
-		    grav->y = 0.0;
-		    continue;
-		}
-		strength = options.gravity / LENGTH(dx, dy);
-		if (options.gravityClockwise) {
-		    grav->x =  dy * strength;
-		    grav->y = -dx * strength;
-		}
-		else if (options.gravityAnticlockwise) {
-		    grav->x = -dy * strength;
-		    grav->y =  dx * strength;
-		}
-		else {
-		    grav->x =  dx * strength;
-		    grav->y =  dy * strength;
-		}
+	for (yi = 0; yi < world->y; yi++, grav++) {
+	    *grav = Global_gravity_at(xi, yi);
+	    if (local) {
+		grav->x += local->x;
+		grav->y += local->y;
+		local++;
 	    }
 	}
     }
@@ -95,15 +128,86 @@ static void Compute_grav_tab(vector_t grav_tab[GRAV_RANGE+1][GRAV_RANGE+1])
 }
 
 
-static void Compute_local_gravity(void)
+/*
+ * The gravity of grav g on a block at distance dx, dy (in blocks)
+ * from it, both counted from the block towards the grav.
+ */
+static vector_t Grav_force_at(const grav_t *g, int dx, int dy)
 {
-    int xi, yi, i, gx, gy, ax, ay, dx, dy, gtype;
-    int first_xi, last_xi, first_yi, last_yi, mod_xi, mod_yi;
-    int min_xi, max_xi, min_yi, max_yi;
-    double force, fx, fy;
-    vector_t *v, *grav, *tab, grav_tab[GRAV_RANGE+1][GRAV_RANGE+1];
+    int gtype = g->type;
+    double force = g->force;
+    double fx = dx < 0 ? -force : force, fy = dy < 0 ? -force : force;
+    const vector_t *v;
+    vector_t grav;
+
+    grav.x = grav.y = 0.0;
+    if (!dx && !dy) {
+	if (gtype == UP_GRAV || gtype == DOWN_GRAV)
+	    grav.y = force;
+	else if (gtype == LEFT_GRAV || gtype == RIGHT_GRAV)
+	    grav.x = force;
+	return grav;
+    }
+    v = &grav_tab[ABS(dx)][ABS(dy)];
+
+    if (gtype == CWISE_GRAV || gtype == ACWISE_GRAV) {
+	grav.x = -fy * v->y;
+	grav.y = fx * v->x;
+    } else if (gtype == UP_GRAV || gtype == DOWN_GRAV)
+	grav.y = force * v->x;
+    else if (gtype == RIGHT_GRAV || gtype == LEFT_GRAV)
+	grav.x = force * v->y;
+    else {
+	grav.x = fx * v->x;
+	grav.y = fy * v->y;
+    }
+    return grav;
+}
+
+static void Compute_grav_contrib(int ind)
+{
+    grav_t *g = Grav_by_index(ind);
+    vector_t *c = &grav_contrib[ind * GRAV_SIZE * GRAV_SIZE];
+    int x, y;
+
+    for (x = 0; x < GRAV_SIZE; x++)
+	for (y = 0; y < GRAV_SIZE; y++)
+	    *c++ = Grav_force_at(g, GRAV_RANGE - x, GRAV_RANGE - y);
+}
 
-    Compute_grav_tab(grav_tab);
+
+/*
+ * Add the n vectors in src to those in dst.  The SSE2 version adds two
+ * at a time, in single precision like the plain C version.
+ */
+static inline void Grav_add_run(vector_t *dst, const vector_t *src, int n)
+{
+    int i = 0;
+
+#if defined(__SSE2__)
+    for (; i + 2 <= n; i += 2)
+	_mm_storeu_ps(&dst[i].x, _mm_add_ps(_mm_loadu_ps(&dst[i].x),
+					    _mm_loadu_ps(&src[i].x)));
+#endif
+    for (; i < n; i++) {
+	dst[i].x += src[i].x;
+	dst[i].y += src[i].y;
+    }
+}
+
+
+/*
+ * Add the gravity of grav ind to those of the w * h blocks starting at
+ * block (x0, y0) which buf holds, column by column.  With the whole
+ * world as region buf is laid out like world->gravity.
+ */
+static void Stamp_grav(int ind, int x0, int y0, int w, int h, vector_t *buf)
+{
+    grav_t *g = Grav_by_index(ind);
+    const vector_t *c;
+    int xi, gx, gy, rx, ry, k, n, run;
+    int first_xi, last_xi, first_yi, last_yi, mod_xi;
+    int min_xi, max_xi, min_yi, max_yi;
 
     min_xi = 0;
     max_xi = world->x - 1;
@@ -115,90 +219,329 @@ static void Compute_local_gravity(void)
 	min_yi -= MIN(GRAV_RANGE, world->y);
 	max_yi += MIN(GRAV_RANGE, world->y);
     }
+
+    gx = CLICK_TO_BLOCK(g->pos.cx);
+    gy = CLICK_TO_BLOCK(g->pos.cy);
+
+    if ((first_xi = gx - GRAV_RANGE) < min_xi)
+	first_xi = min_xi;
+    if ((last_xi = gx + GRAV_RANGE) > max_xi)
+	last_xi = max_xi;
+    if ((first_yi = gy - GRAV_RANGE) < min_yi)
+	first_yi = min_yi;
+    if ((last_yi = gy + GRAV_RANGE) > max_yi)
+	last_yi = max_yi;
+
+    n = last_yi - first_yi + 1;
+    mod_xi = (first_xi < 0) ? (first_xi + world->x) : first_xi;
+    for (xi = first_xi; xi <= last_xi; xi++) {
+	rx = mod_xi - x0 + (mod_xi < x0 ? world->x : 0);
+	if (++mod_xi >= world->x)
+	    mod_xi = 0;
+	if (rx >= w)
+	    continue;
+
+	c = &grav_contrib[((ind * GRAV_SIZE) + xi - gx + GRAV_RANGE)
+			  * GRAV_SIZE + first_yi - gy + GRAV_RANGE];
+	/* the runs of blocks in the region, split where it ends or wraps */
+	ry = ((first_yi - y0) % world->y + world->y) % world->y;
+	for (k = 0; k < n; k += run) {
+	    if (ry >= h) {
+		run = world->y - ry;
+		ry = 0;
+		continue;
+	    }
+	    run = MIN(n - k, h - ry);
+	    Grav_add_run(&buf[rx * h + ry], &c[k], run);
+	    if ((ry += run) >= world->y)
+		ry = 0;
+	}
+    }
+}
+
+
+/*
+ * Compute what every grav adds to the blocks around it, and grav_local
+ * unless the grid is compact.
+ */
+static void Compute_local_gravity(void)
+{
+    int i, num = Num_gravs();
+    size_t size = (size_t)world->x * world->y;
+
+    XFREE(grav_contrib);
+    if (num == 0) {
+	XFREE(grav_local);
+	grav_valid = true;
+	return;
+    }
+
+    grav_contrib = XMALLOC(vector_t, num * GRAV_SIZE * GRAV_SIZE);
+    if (grav_contrib == NULL) {
+	error("No gravity mem");
+	End_game();
+    }
+    for (i = 0; i < num; i++)
+	Compute_grav_contrib(i);
+
+    if (world->gravity != NULL && grav_local == NULL
+	&& (grav_local = XMALLOC(vector_t, size)) == NULL)
+	/* Compute_gravity() does it a region at a time instead. */
+	warn("Not enough memory to keep the gravity of the gravs.");
+    if (grav_local != NULL) {
+	memset(grav_local, 0, size * sizeof(vector_t));
+	for (i = 0; i < num; i++)
+	    Stamp_grav(i, 0, 0, world->x, world->y, grav_local);
+    }
+
+    grav_valid = true;
+}
+
+
+void Gravity_free(void)
+{
+    XFREE(grav_contrib);
+    XFREE(grav_local);
+    grav_valid = false;
+}
+
+
+/*
+ * Convert to a 16 bit IEEE half precision float, rounding to nearest.
+ * Values too big for it become the biggest one.
+ */
+static uint16_t Float_to_half(float f)
+{
+    union { float f; uint32_t u; } v;
+    uint32_t sign, mant, half, rem, halfway;
+    int exp, shift;
+
+    v.f = f;
+    sign = (v.u >> 16) & 0x8000;
+    exp = (int)((v.u >> 23) & 0xff) - 127 + 15;
+    mant = v.u & 0x7fffff;
+
+    if (f != f)
+	return 0x7e00;
+    if (exp >= 31)
+	return sign | 0x7bff;
+    if (exp <= 0) {
+	if (exp < -10)
+	    return sign;
+	/* subnormal half */
+	mant |= 0x800000;
+	shift = 14 - exp;
+	half = mant >> shift;
+	rem = mant & ((1u << shift) - 1);
+	halfway = 1u << (shift - 1);
+	if (rem > halfway || (rem == halfway && (half & 1)))
+	    half++;
+	return sign | half;
+    }
+    half = ((uint32_t)exp << 10) | (mant >> 13);
+    rem = mant & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (half & 1)))
+	half++;
+    if (half >= 0x7c00)
+	half = 0x7bff;
+    return sign | half;
+}
+
+/*
+ * Does the cyclic range of len blocks starting at block a overlap the
+ * one of len2 blocks starting at block b, in a dimension of size n ?
+ */
+static inline bool Ranges_overlap(int a, int len, int b, int len2, int n)
+{
+    if (len >= n || len2 >= n)
+	return true;
+    return ((b - a) % n + n) % n < len || ((a - b) % n + n) % n < len2;
+}
+
+/*
+ * Recompute the gravity of the w * h blocks starting at block (x0, y0).
+ * The gravs are added up in the same order as in Compute_local_gravity(),
+ * so the result is the same as that of a full recompute.
+ */
+static void Compute_gravity_region(int x0, int y0, int w, int h)
+{
+    static vector_t buf[GRAV_TILE * GRAV_TILE];
+    int i, rx, ry, xi, yi;
+    vector_t grav;
+
+    assert(w <= GRAV_TILE && h <= GRAV_TILE);
+
+    memset(buf, 0, w * h * sizeof(vector_t));
     for (i = 0; i < Num_gravs(); i++) {
 	grav_t *g = Grav_by_index(i);
+	int gx = CLICK_TO_BLOCK(g->pos.cx), gy = CLICK_TO_BLOCK(g->pos.cy);
 
-	gx = CLICK_TO_BLOCK(g->pos.cx);
-	gy = CLICK_TO_BLOCK(g->pos.cy);
-	force = g->force;
-
-	if ((first_xi = gx - GRAV_RANGE) < min_xi)
-	    first_xi = min_xi;
-	if ((last_xi = gx + GRAV_RANGE) > max_xi)
-	    last_xi = max_xi;
-	if ((first_yi = gy - GRAV_RANGE) < min_yi)
-	    first_yi = min_yi;
-	if ((last_yi = gy + GRAV_RANGE) > max_yi)
-	    last_yi = max_yi;
-
-	gtype = g->type;
-
-	mod_xi = (first_xi < 0) ? (first_xi + world->x) : first_xi;
-	dx = gx - first_xi;
-	fx = force;
-	for (xi = first_xi; xi <= last_xi; xi++, dx--) {
-	    if (dx < 0) {
-		fx = -force;
-		ax = -dx;
+	if (!Ranges_overlap(x0, w, gx - GRAV_RANGE + world->x, GRAV_SIZE,
+			    world->x)
+	    || !Ranges_overlap(y0, h, gy - GRAV_RANGE + world->y, GRAV_SIZE,
+			       world->y))
+	    continue;
+	Stamp_grav(i, x0, y0, w, h, buf);
+    }
+
+    for (rx = 0; rx < w; rx++) {
+	xi = (x0 + rx) % world->x;
+	for (ry = 0; ry < h; ry++) {
+	    yi = (y0 + ry) % world->y;
+	    if (grav_local)
+		grav_local[xi * world->y + yi] = buf[rx * h + ry];
+	    grav = Global_gravity_at(xi, yi);
+	    grav.x += buf[rx * h + ry].x;
+	    grav.y += buf[rx * h + ry].y;
+	    if (world->gravity16) {
+		world->gravity16[2 * (xi * world->y + yi)]
+		    = Float_to_half(grav.x);
+		world->gravity16[2 * (xi * world->y + yi) + 1]
+		    = Float_to_half(grav.y);
 	    } else
-		ax = dx;
-
-	    mod_yi = (first_yi < 0) ? (first_yi + world->y) : first_yi;
-	    dy = gy - first_yi;
-	    grav = &world->gravity[mod_xi][mod_yi];
-	    tab = grav_tab[ax];
-	    fy = force;
-	    for (yi = first_yi; yi <= last_yi; yi++, dy--) {
-		if (dx || dy) {
-		    if (dy < 0) {
-			fy = -force;
-			ay = -dy;
-		    } else
-			ay = dy;
-
-		    v = &tab[ay];
-		    if (gtype == CWISE_GRAV || gtype == ACWISE_GRAV) {
-			grav->x -= fy * v->y;
-			grav->y += fx * v->x;
-		    } else if (gtype == UP_GRAV || gtype == DOWN_GRAV)
-			grav->y += force * v->x;
-		    else if (gtype == RIGHT_GRAV || gtype == LEFT_GRAV)
-			grav->x += force * v->y;
-		    else {
-			grav->x += fx * v->x;
-			grav->y += fy * v->y;
-		    }
-		}
-		else {
-		    if (gtype == UP_GRAV || gtype == DOWN_GRAV)
-			grav->y += force;
-		    else if (gtype == LEFT_GRAV || gtype == RIGHT_GRAV)
-			grav->x += force;
-		}
-		mod_yi++;
-		grav++;
-		if (mod_yi >= world->y) {
-		    mod_yi = 0;
-		    grav = world->gravity[mod_xi];
-		}
-	    }
-	    if (++mod_xi >= world->x)
-		mod_xi = 0;
+		world->gravity[xi][yi] = grav;
 	}
     }
-    /*
-     * We may want to free the world->gravity memory here
-     * as it is not used anywhere else.
-     * e.g.: free(world->gravity);
-     *       world->gravity = NULL;
-     *       world->NumGravs = 0;
-     * Some of the more modern maps have quite a few gravity symbols.
-     */
+}
+
+/*
+ * Recompute the blocks a grav at block (gx, gy) reaches.
+ */
+static void Compute_gravity_around(int gx, int gy)
+{
+    int x0 = gx - GRAV_RANGE, y0 = gy - GRAV_RANGE;
+    int x1 = gx + GRAV_RANGE + 1, y1 = gy + GRAV_RANGE + 1;
+
+    if (BIT(world->rules->mode, WRAP_PLAY)) {
+	x0 = (x0 + world->x) % world->x;
+	y0 = (y0 + world->y) % world->y;
+	Compute_gravity_region(x0, y0, MIN(GRAV_SIZE, world->x),
+			       MIN(GRAV_SIZE, world->y));
+	return;
+    }
+    x0 = MAX(x0, 0);
+    y0 = MAX(y0, 0);
+    x1 = MIN(x1, world->x);
+    y1 = MIN(y1, world->y);
+    if (x0 < x1 && y0 < y1)
+	Compute_gravity_region(x0, y0, x1 - x0, y1 - y0);
+}
+
+/*
+ * Grav ind has moved away from old_pos, or its force or type changed.
+ * Only the blocks around its old and new positions are recomputed.
+ */
+void Grav_changed(int ind, clpos_t old_pos)
+{
+    grav_t *g = Grav_by_index(ind);
+
+    if (!grav_valid) {
+	Compute_gravity();
+	return;
+    }
+    Compute_grav_contrib(ind);
+    Compute_gravity_around(CLICK_TO_BLOCK(old_pos.cx),
+			   CLICK_TO_BLOCK(old_pos.cy));
+    Compute_gravity_around(CLICK_TO_BLOCK(g->pos.cx),
+			   CLICK_TO_BLOCK(g->pos.cy));
 }
 
 
 void Compute_gravity(void)
 {
-    Compute_global_gravity();
-    Compute_local_gravity();
+    int x0, y0;
+    double theta = (options.gravityAngle * PI) / 180.0;
+
+    uniform_grav.x = cos(theta) * options.gravity;
+    uniform_grav.y = sin(theta) * options.gravity;
+    Compute_grav_tab(grav_tab);
+
+    /* After a map change, the gravity options don't change the gravs. */
+    if (!grav_valid)
+	Compute_local_gravity();
+
+    if (world->gravity != NULL && (grav_local != NULL || Num_gravs() == 0)) {
+	Compute_global_gravity();
+	return;
+    }
+
+    /* Compact grid, it can't be used to add up the gravity. */
+    for (x0 = 0; x0 < world->x; x0 += GRAV_TILE)
+	for (y0 = 0; y0 < world->y; y0 += GRAV_TILE)
+	    Compute_gravity_region(x0, y0, MIN(GRAV_TILE, world->x - x0),
+				   MIN(GRAV_TILE, world->y - y0));
+}
+
+
+#ifdef SERVER_BENCH
+/*
+ * Move n randomly chosen gravs around and change their force and type,
+ * recomputing the gravity with Grav_changed(), and compare the result
+ * with a full recompute after each change.  Returns the number of
+ * changes after which they differ, the time both took (in microseconds)
+ * goes to *changed_us and *full_us.
+ */
+long Gravity_check(long n, double *changed_us, double *full_us)
+{
+    static const int types[] = {
+	POS_GRAV, NEG_GRAV, CWISE_GRAV, ACWISE_GRAV,
+	UP_GRAV, DOWN_GRAV, RIGHT_GRAV, LEFT_GRAV
+    };
+    size_t size = world->gravity16
+	? 2 * sizeof(uint16_t) * world->x * world->y
+	: sizeof(vector_t) * world->x * world->y;
+    void *grid = world->gravity16
+	? (void *)world->gravity16 : (void *)world->gravity[0];
+    void *copy;
+    struct timespec t0, t1;
+    long k, bad = 0;
+
+    *changed_us = *full_us = 0.0;
+    if (Num_gravs() == 0)
+	return 0;
+    if ((copy = XMALLOC(char, size)) == NULL) {
+	error("Gravity_check: no mem");
+	return n;
+    }
+
+    for (k = 0; k < n; k++) {
+	int ind = (int)(rfrac() * Num_gravs());
+	grav_t *g = Grav_by_index(ind);
+	clpos_t old_pos = g->pos;
+	int dx = (int)(rfrac() * (4 * GRAV_RANGE + 1)) - 2 * GRAV_RANGE;
+	int dy = (int)(rfrac() * (4 * GRAV_RANGE + 1)) - 2 * GRAV_RANGE;
+
+	g->pos.cx = WRAP_XCLICK(g->pos.cx + dx * BLOCK_CLICKS);
+	g->pos.cy = WRAP_YCLICK(g->pos.cy + dy * BLOCK_CLICKS);
+	LIMIT(g->pos.cx, 0, world->cwidth - 1);
+	LIMIT(g->pos.cy, 0, world->cheight - 1);
+	g->force *= (rfrac() < 0.5 ? -0.5 : 1.5);
+	if (rfrac() < 0.25)
+	    g->type = types[(int)(rfrac() * NELEM(types))];
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	Grav_changed(ind, old_pos);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	*changed_us += (t1.tv_sec - t0.tv_sec) * 1e6
+	    + (t1.tv_nsec - t0.tv_nsec) * 1e-3;
+	memcpy(copy, grid, size);
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	grav_valid = false;
+	Compute_gravity();
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	*full_us += (t1.tv_sec - t0.tv_sec) * 1e6
+	    + (t1.tv_nsec - t0.tv_nsec) * 1e-3;
+
+	if (memcmp(copy, grid, size)) {
+	    warn("Gravity_check: change %ld of grav %d at (%d, %d) differs "
+		 "from a full recompute", k, ind,
+		 CLICK_TO_BLOCK(g->pos.cx), CLICK_TO_BLOCK(g->pos.cy));
+	    bad++;
+	}
+    }
+
+    XFREE(copy);
+    return bad;
 }
+#endif
@@ -102,7 +102,11 @@ void Item_damage(player_t *pl, double prob)
     }
 }
 
-int Choose_random_item(void)
+/*
+ * Choose an item type according to the item probabilities,
+ * using frac, a random number from 0 up to 1.
+ */
+int Choose_item_by_frac(double frac)
 {
     int i;
     double item_prob_sum = 0;
@@ -111,7 +115,7 @@ int Choose_random_item(void)
 	item_prob_sum += world->items[i].prob;
 
     if (item_prob_sum > 0.0) {
-	double sum = item_prob_sum * rfrac();
+	double sum = item_prob_sum * frac;
 
 	for (i = 0; i < NUM_ITEMS; i++) {
 	    sum -= world->items[i].prob;
@@ -125,6 +129,20 @@ int Choose_random_item(void)
     return i;
 }
 
+int Choose_random_item(void)
+{
+    int i;
+    double item_prob_sum = 0;
+
+    for (i = 0; i < NUM_ITEMS; i++)
+	item_prob_sum += world->items[i].prob;
+
+    if (item_prob_sum > 0.0)
+	return Choose_item_by_frac(rfrac());
+
+    return NUM_ITEMS;
+}
+
 void Place_item(player_t *pl, int item)
 {
     int num_lose, num_per_pack, place_count, dist;
@@ -133,7 +151,7 @@ void Place_item(player_t *pl, int item)
     vector_t vel;
     item_concentrator_t	*con;
 
-    if (NumObjs >= MAX_TOTAL_SHOTS) {
+    if (Object_room(OBJ_ITEM) == 0) {
 	if (pl && !Player_is_killed(pl))
 	    pl->item[item]--;
 	return;
@@ -300,7 +318,7 @@ void Make_item(clpos_t pos, vector_t vel,
     if (world->items[type].num >= world->items[type].max)
 	return;
 
-    if ((item = ITEM_PTR(Object_allocate())) == NULL)
+    if ((item = ITEM_PTR(Object_allocate(OBJ_ITEM))) == NULL)
 	return;
 
     item->type = OBJ_ITEM;
@@ -497,7 +515,7 @@ void Do_deflector(player_t *pl)
 {
     double range = (pl->item[ITEM_DEFLECTOR] * 0.5 + 1) * BLOCK_CLICKS;
     double maxforce = pl->item[ITEM_DEFLECTOR] * 0.2;
-    object_t *obj, **obj_list;
+    object_t *obj, **obj_list, *obj_buf[200];
     int i, obj_count;
     double dx, dy, dist;
 
@@ -509,10 +527,11 @@ void Do_deflector(player_t *pl)
     }
     Player_add_fuel(pl, ED_DEFLECTOR);
 
-    if (NumObjs >= options.cellGetObjectsThreshold)
-	Cell_get_objects(pl->pos, (int)(range / BLOCK_CLICKS + 1),
-			 200, &obj_list, &obj_count);
-    else {
+    if (NumObjs >= options.cellGetObjectsThreshold) {
+	obj_list = obj_buf;
+	obj_count = Cell_get_objects(pl->pos, (int)(range / BLOCK_CLICKS + 1),
+				     NELEM(obj_buf), obj_list);
+    } else {
 	obj_list = Obj;
 	obj_count = NumObjs;
     }
@@ -69,10 +69,10 @@ void Fire_general_laser(int id, int team, clpos_t pos, int dir,
 	return;
     }
 
-    if (NumObjs >= MAX_TOTAL_SHOTS)
+    if (Object_room(OBJ_PULSE) == 0)
 	return;
 
-    if ((pulse = PULSE_PTR(Object_allocate())) == NULL)
+    if ((pulse = PULSE_PTR(Object_allocate(OBJ_PULSE))) == NULL)
 	return;
 
     if (pl) {
@@ -37,6 +37,8 @@ world_t World, *world;
 bool is_polygon_map = false;
 
 static void Find_base_direction(void);
+static void World_index_objects(void);
+static void World_free_index(void);
 
 
 static void Check_map_object_counters(void)
@@ -115,7 +117,7 @@ int World_place_cannon(clpos_t pos, int dir, int team)
     t.dir = dir;
     t.team = team;
     t.dead_ticks = 0;
-    t.conn_mask = ~0;
+    t.conn_mask = NULL;
     t.group = NO_GROUP;
     t.score = CANNON_SCORE;
     t.id = ind + MIN_CANNON_ID;
@@ -142,7 +144,7 @@ int World_place_fuel(clpos_t pos, int team)
 
     t.pos = pos;
     t.fuel = START_STATION_FUEL;
-    t.conn_mask = ~0;
+    t.conn_mask = NULL;
     t.last_change = frame_loops;
     t.team = team;
     Arraylist_add(world->fuels, &t);
@@ -226,8 +228,8 @@ int World_place_target(clpos_t pos, int team)
     t.team = team;
     t.dead_ticks = 0;
     t.damage = TARGET_DAMAGE;
-    t.conn_mask = ~0;
-    t.update_mask = 0;
+    t.conn_mask = NULL;
+    t.update_mask = NULL;
     t.last_change = frame_loops;
     t.group = NO_GROUP;
     Arraylist_add(world->targets, &t);
@@ -436,10 +438,14 @@ void World_free(void)
 {
     XFREE(world->block);
     XFREE(world->gravity);
+    XFREE(world->gravity16);
+    Gravity_free();
     /*XFREE(world->gravs);*/
     /*XFREE(world->bases);*/
     /*XFREE(world->cannons);*/
     XFREE(world->checks);
+    World_free_index();
+    Walls_free();
     /*XFREE(world->fuels);*/
     /*XFREE(world->wormholes);*/
     /*XFREE(world->itemConcs);
@@ -457,13 +463,18 @@ static bool World_alloc(void)
 
     assert(world->block == NULL);
     assert(world->gravity == NULL);
+    assert(world->gravity16 == NULL);
 
     world->block = (unsigned char **)
 	malloc(sizeof(unsigned char *) * world->x
 	       + world->x * sizeof(unsigned char) * world->y);
-    world->gravity = (vector_t **)
-	malloc(sizeof(vector_t *) * world->x
-	       + world->x * sizeof(vector_t) * world->y);
+    if (options.compactGravity)
+	world->gravity16 = (uint16_t *)
+	    malloc(world->x * world->y * 2 * sizeof(uint16_t));
+    else
+	world->gravity = (vector_t **)
+	    malloc(sizeof(vector_t *) * world->x
+		   + world->x * sizeof(vector_t) * world->y);
 
     /*assert(world->gravs == NULL);*/
     /*assert(world->bases == NULL);*/
@@ -474,7 +485,8 @@ static bool World_alloc(void)
     /*assert(world->itemConcs == NULL);*/
     /*assert(world->asteroidConcs == NULL);*/
 
-    if (world->block == NULL || world->gravity == NULL) {
+    if (world->block == NULL
+	|| (world->gravity == NULL && world->gravity16 == NULL)) {
 	World_free();
 	error("Couldn't allocate memory for map");
 	return false;
@@ -484,15 +496,18 @@ static bool World_alloc(void)
     map_line = (unsigned char*) ((unsigned char**)map_pointer + world->x);
 
     grav_pointer = world->gravity;
-    grav_line = (vector_t*) ((vector_t**)grav_pointer + world->x);
+    grav_line = grav_pointer ?
+	(vector_t*) ((vector_t**)grav_pointer + world->x) : NULL;
 
     for (x = 0; x < world->x; x++) {
 	*map_pointer = map_line;
 	map_pointer += 1;
 	map_line += world->y;
-	*grav_pointer = grav_line;
-	grav_pointer += 1;
-	grav_line += world->y;
+	if (grav_pointer) {
+	    *grav_pointer = grav_line;
+	    grav_pointer += 1;
+	    grav_line += world->y;
+	}
     }
 
     return true;
@@ -631,32 +646,377 @@ bool Grok_map(void)
 
     Compute_gravity();
     Find_base_direction();
+    World_index_objects();
 
     return true;
 }
 
 /*
- * Return the team that is closest to this click position.
+ * Index of the fuel stations, cannons, targets and bases.
+ *
+ * The objects of each kind are put in buckets of MAP_INDEX_BLOCKS
+ * by MAP_INDEX_BLOCKS map blocks, so the ones near a position can
+ * be found without looking at all of them.  Map objects don't move,
+ * so the buckets are made when the map has been read, and again if
+ * the number of objects of that kind has changed.
  */
-int Find_closest_team(clpos_t pos)
+#define MAP_INDEX_BLOCKS	8
+
+typedef struct {
+    int		num;		/* objects in the index */
+    int		cols, rows;	/* number of buckets */
+    int		*start;		/* first object of each bucket */
+    int		*objs;		/* object indexes by bucket */
+} map_index_t;
+
+static map_index_t map_index[4];
+
+static map_index_t *Map_index_by_type(int type)
+{
+    switch (type) {
+    case BASE:		return &map_index[0];
+    case CANNON:	return &map_index[1];
+    case FUEL:		return &map_index[2];
+    case TARGET:	return &map_index[3];
+    default:		return NULL;
+    }
+}
+
+static int Map_object_count(int type)
+{
+    switch (type) {
+    case BASE:		return Num_bases();
+    case CANNON:	return Num_cannons();
+    case FUEL:		return Num_fuels();
+    case TARGET:	return Num_targets();
+    default:		return 0;
+    }
+}
+
+static clpos_t Map_object_pos(int type, int ind)
+{
+    switch (type) {
+    case BASE:		return Base_by_index(ind)->pos;
+    case CANNON:	return Cannon_by_index(ind)->pos;
+    case FUEL:		return Fuel_by_index(ind)->pos;
+    default:		return Target_by_index(ind)->pos;
+    }
+}
+
+static double Map_object_dist2(int type, int ind, clpos_t pos)
+{
+    clpos_t opos = Map_object_pos(type, ind);
+    double dcx = WRAP_DCX(opos.cx - pos.cx);
+    double dcy = WRAP_DCY(opos.cy - pos.cy);
+
+    return dcx * dcx + dcy * dcy;
+}
+
+static void Map_index_free(map_index_t *mi)
+{
+    XFREE(mi->start);
+    XFREE(mi->objs);
+    memset(mi, 0, sizeof(*mi));
+}
+
+static int Map_index_bucket(map_index_t *mi, clpos_t pos)
+{
+    int bx = pos.cx / (MAP_INDEX_BLOCKS * BLOCK_CLICKS);
+    int by = pos.cy / (MAP_INDEX_BLOCKS * BLOCK_CLICKS);
+
+    LIMIT(bx, 0, mi->cols - 1);
+    LIMIT(by, 0, mi->rows - 1);
+
+    return by * mi->cols + bx;
+}
+
+/*
+ * Return the index of the objects of this type, making it first
+ * if needed.  Returns NULL if there is no memory for it.
+ */
+static map_index_t *Map_index_get(int type)
+{
+    map_index_t *mi = Map_index_by_type(type);
+    int i, b, num = Map_object_count(type), num_buckets, *fill;
+    const int bucket_clicks = MAP_INDEX_BLOCKS * BLOCK_CLICKS;
+
+    if (mi == NULL)
+	return NULL;
+    if (mi->start != NULL && mi->num == num)
+	return mi;
+
+    Map_index_free(mi);
+    mi->cols = MAX(1, (world->cwidth + bucket_clicks - 1) / bucket_clicks);
+    mi->rows = MAX(1, (world->cheight + bucket_clicks - 1) / bucket_clicks);
+    num_buckets = mi->cols * mi->rows;
+    mi->start = XCALLOC(int, num_buckets + 1);
+    mi->objs = XMALLOC(int, MAX(num, 1));
+    fill = XMALLOC(int, num_buckets);
+    if (mi->start == NULL || mi->objs == NULL || fill == NULL) {
+	XFREE(fill);
+	Map_index_free(mi);
+	return NULL;
+    }
+
+    for (i = 0; i < num; i++)
+	mi->start[Map_index_bucket(mi, Map_object_pos(type, i)) + 1]++;
+    for (b = 0; b < num_buckets; b++) {
+	mi->start[b + 1] += mi->start[b];
+	fill[b] = mi->start[b];
+    }
+    for (i = 0; i < num; i++)
+	mi->objs[fill[Map_index_bucket(mi, Map_object_pos(type, i))]++] = i;
+    mi->num = num;
+
+    free(fill);
+
+    return mi;
+}
+
+/*
+ * Make the indexes now, so that they are ready before they are
+ * used from several threads at the same time.
+ */
+static void World_index_objects(void)
+{
+    Map_index_get(BASE);
+    Map_index_get(CANNON);
+    Map_index_get(FUEL);
+    Map_index_get(TARGET);
+}
+
+static void World_free_index(void)
+{
+    int i;
+
+    for (i = 0; i < NELEM(map_index); i++)
+	Map_index_free(&map_index[i]);
+}
+
+/*
+ * Find the buckets covering clicks lo to hi on one axis.
+ * With wrap play the clicks may be outside the map and then
+ * there can be two spans of buckets, one at each edge.
+ */
+static int Map_index_spans(int lo, int hi, int size, int num_buckets,
+			   bool wrap, int spans[2][2])
 {
-    int team = TEAM_NOT_SET, i;
-    double closest = FLT_MAX, l;
+    const int bucket_clicks = MAP_INDEX_BLOCKS * BLOCK_CLICKS;
+    int n = 0;
+
+    if (wrap && hi - lo + 1 >= size) {
+	lo = 0;
+	hi = size - 1;
+    } else if (wrap && lo < 0) {
+	spans[n][0] = (lo + size) / bucket_clicks;
+	spans[n++][1] = num_buckets - 1;
+	lo = 0;
+    } else if (wrap && hi >= size) {
+	spans[n][0] = 0;
+	spans[n++][1] = (hi - size) / bucket_clicks;
+	hi = size - 1;
+    }
+    lo = MAX(lo, 0);
+    hi = MIN(hi, size - 1);
+    if (lo > hi)
+	return n;
+    spans[n][0] = MIN(lo / bucket_clicks, num_buckets - 1);
+    spans[n][1] = MIN(hi / bucket_clicks, num_buckets - 1);
+
+    /* The spans at the two edges can meet in the same bucket. */
+    if (n == 1 && spans[0][0] <= spans[1][1] && spans[1][0] <= spans[0][1]) {
+	spans[0][0] = 0;
+	spans[0][1] = num_buckets - 1;
+	return 1;
+    }
 
-    for (i = 0; i < Num_bases(); i++) {
-	base_t *base = Base_by_index(i);
+    return n + 1;
+}
 
-	if (base->team == TEAM_NOT_SET)
-	    continue;
+/*
+ * Call func for every object in the buckets which cover the
+ * square of side 2 * range around pos.  Returns false if func did.
+ */
+static bool Map_index_visit(int type, clpos_t pos, double range,
+			    bool (*func)(int ind, void *arg), void *arg)
+{
+    map_index_t *mi = Map_index_get(type);
+    bool wrap = BIT(world->rules->mode, WRAP_PLAY) ? true : false;
+    int xspans[2][2], yspans[2][2], nx, ny, sx, sy, bx, by, b, i, r;
+
+    if (mi == NULL) {
+	for (i = 0; i < Map_object_count(type); i++) {
+	    if (!func(i, arg))
+		return false;
+	}
+	return true;
+    }
 
-	l = Wrap_length(pos.cx - base->pos.cx, pos.cy - base->pos.cy);
-	if (l < closest) {
-	    team = base->team;
-	    closest = l;
+    r = (int)MIN(range, (double)(world->cwidth + world->cheight)) + 1;
+    nx = Map_index_spans(pos.cx - r, pos.cx + r, world->cwidth,
+			 mi->cols, wrap, xspans);
+    ny = Map_index_spans(pos.cy - r, pos.cy + r, world->cheight,
+			 mi->rows, wrap, yspans);
+
+    for (sy = 0; sy < ny; sy++) {
+	for (by = yspans[sy][0]; by <= yspans[sy][1]; by++) {
+	    for (sx = 0; sx < nx; sx++) {
+		for (bx = xspans[sx][0]; bx <= xspans[sx][1]; bx++) {
+		    b = by * mi->cols + bx;
+		    for (i = mi->start[b]; i < mi->start[b + 1]; i++) {
+			if (!func(mi->objs[i], arg))
+			    return false;
+		    }
+		}
+	    }
 	}
     }
 
-    return team;
+    return true;
+}
+
+typedef struct {
+    int		type;
+    clpos_t	pos;
+    double	range2;
+    int		num, max;
+    int		*list;
+    double	*dist2;
+    bool	(*accept)(int ind, void *arg);
+    void	*arg;
+} map_query_t;
+
+static bool Map_query_in_range(int ind, void *arg)
+{
+    map_query_t *q = (map_query_t *) arg;
+
+    if (Map_object_dist2(q->type, ind, q->pos) <= q->range2
+	&& q->num < q->max)
+	q->list[q->num++] = ind;
+
+    return true;
+}
+
+static int Map_cmp_int(const void *a, const void *b)
+{
+    int i = *(const int *)a, j = *(const int *)b;
+
+    return (i > j) - (i < j);
+}
+
+/*
+ * Put in list the indexes of the objects of this type (BASE, CANNON,
+ * FUEL or TARGET) at most range clicks from pos, lowest index first.
+ * At most max objects are returned.  Returns the number of objects.
+ */
+int World_objects_in_range(int type, clpos_t pos, double range,
+			   int *list, int max)
+{
+    map_query_t q;
+
+    q.type = type;
+    q.pos = pos;
+    q.range2 = range * range;
+    q.num = 0;
+    q.max = max;
+    q.list = list;
+
+    Map_index_visit(type, pos, range, Map_query_in_range, &q);
+    if (q.num > 1)
+	qsort(list, (size_t)q.num, sizeof(int), Map_cmp_int);
+
+    return q.num;
+}
+
+static bool Map_query_nearest(int ind, void *arg)
+{
+    map_query_t *q = (map_query_t *) arg;
+    double d2 = Map_object_dist2(q->type, ind, q->pos);
+    int i;
+
+    if (d2 > q->range2)
+	return true;
+    if (q->num == q->max
+	&& (d2 > q->dist2[q->num - 1]
+	    || (d2 == q->dist2[q->num - 1] && ind > q->list[q->num - 1])))
+	return true;
+    if (q->accept != NULL && !q->accept(ind, q->arg))
+	return true;
+
+    /* Keep the list sorted by distance, then by index. */
+    if (q->num < q->max)
+	q->num++;
+    for (i = q->num - 1; i > 0; i--) {
+	if (q->dist2[i - 1] < d2
+	    || (q->dist2[i - 1] == d2 && q->list[i - 1] < ind))
+	    break;
+	q->dist2[i] = q->dist2[i - 1];
+	q->list[i] = q->list[i - 1];
+    }
+    q->dist2[i] = d2;
+    q->list[i] = ind;
+
+    return true;
+}
+
+/*
+ * Put in list the k objects of this type nearest to pos, which are
+ * at most range clicks away and for which accept returns true,
+ * nearest first.  Objects at the same distance are in index order.
+ * accept may be NULL.  Returns the number of objects found.
+ */
+int World_nearest_objects(int type, clpos_t pos, double range, int k,
+			  int *list, bool (*accept)(int ind, void *arg),
+			  void *arg)
+{
+    map_query_t q;
+    double dist2[MAP_NEAREST_MAX], r;
+
+    assert(k <= MAP_NEAREST_MAX);
+
+    q.type = type;
+    q.pos = pos;
+    q.max = k;
+    q.list = list;
+    q.dist2 = dist2;
+    q.accept = accept;
+    q.arg = arg;
+
+    /*
+     * Look in a growing circle around pos, until there are k objects
+     * in it, or it is as big as needed or covers the whole map.
+     */
+    range = MIN(range, LENGTH(world->cwidth, world->cheight));
+    for (r = MAP_INDEX_BLOCKS * BLOCK_CLICKS; ; r *= 2) {
+	r = MIN(r, range);
+	q.range2 = r * r;
+	q.num = 0;
+	Map_index_visit(type, pos, r, Map_query_nearest, &q);
+	if (q.num == k || r >= range)
+	    break;
+    }
+
+    return q.num;
+}
+
+static bool Base_has_team(int ind, void *arg)
+{
+    UNUSED_PARAM(arg);
+    return Base_by_index(ind)->team != TEAM_NOT_SET;
+}
+
+/*
+ * Return the team that is closest to this click position.
+ */
+int Find_closest_team(clpos_t pos)
+{
+    int i;
+
+    if (World_nearest_objects(BASE, pos, FLT_MAX, 1, &i,
+			      Base_has_team, NULL) == 0)
+	return TEAM_NOT_SET;
+
+    return Base_by_index(i)->team;
 }
 
 
@@ -681,6 +1041,20 @@ double Wrap_cfindDir(int dcx, int dcy)
     return findDir((double)dcx, (double)dcy);
 }
 
+int Wrap_findDir_rounded(double dx, double dy)
+{
+    dx = WRAP_DX(dx);
+    dy = WRAP_DY(dy);
+    return findDir_rounded(dx, dy);
+}
+
+int Wrap_cfindDir_rounded(int dcx, int dcy)
+{
+    dcx = WRAP_DCX(dcx);
+    dcy = WRAP_DCY(dcy);
+    return findDir_rounded((double)dcx, (double)dcy);
+}
+
 double Wrap_length(int dcx, int dcy)
 {
     dcx = WRAP_DCX(dcx);
@@ -80,10 +80,41 @@
 typedef struct world world_t;
 extern world_t		World, *world;
 
+/*
+ * Map objects remember per connection whether the client has their
+ * current state.  Connection N owns bit N of a connection mask, which
+ * is conn_mask_words words long.  The masks are allocated by
+ * Conn_masks_init() when the number of connections is known; before
+ * that conn_mask_words is 0 and the masks are not touched.
+ */
+typedef uint32_t conn_mask_t;
+
+#define CONN_MASK_BITS		32
+#define CONN_MASK_WORD(ind)	((ind) / CONN_MASK_BITS)
+#define CONN_MASK_BIT(ind)	(1U << ((ind) % CONN_MASK_BITS))
+
+extern int conn_mask_words;
+
+static inline void Conn_mask_clear(conn_mask_t *mask)
+{
+    int i;
+
+    for (i = 0; i < conn_mask_words; i++)
+	mask[i] = 0;
+}
+
+static inline void Conn_mask_fill(conn_mask_t *mask)
+{
+    int i;
+
+    for (i = 0; i < conn_mask_words; i++)
+	mask[i] = ~0U;
+}
+
 typedef struct fuel {
     clpos_t	pos;
     double	fuel;
-    uint32_t	conn_mask;
+    conn_mask_t	*conn_mask;
     long	last_change;
     int		team;
 } fuel_t;
@@ -106,7 +137,7 @@ typedef struct base {
 typedef struct cannon {
     clpos_t	pos;
     int		dir;
-    uint32_t	conn_mask;
+    conn_mask_t	*conn_mask;
     long	last_change;
     int		item[NUM_ITEMS];
     int		tractor_target_id;
@@ -181,8 +212,8 @@ typedef struct target {
     int		team;
     double	dead_ticks;
     double	damage;
-    uint32_t	conn_mask;
-    uint32_t 	update_mask;
+    conn_mask_t	*conn_mask;
+    conn_mask_t	*update_mask;
     long	last_change;
     int		group;
 } target_t;
@@ -248,6 +279,8 @@ struct world {
 
     u_byte	**block;	/* type of item in each block */
     vector_t	**gravity;
+    uint16_t	*gravity16;	/* gravity as 16 bit floats, x and y
+				   for each block, if compactGravity */
     item_t	items[NUM_ITEMS];
     asteroid_t	asteroids;
     team_t	teams[MAX_TEAMS];
@@ -401,6 +434,9 @@ static inline int WRAP_YCLICK(int cy)
 
 
 
+/* Most objects World_nearest_objects() can return. */
+#define MAP_NEAREST_MAX		16
+
 #define Num_asteroidConcs()	Arraylist_get_num_elements(world->asteroidConcs)
 #define Num_bases()		Arraylist_get_num_elements(world->bases)
 #define Num_cannons()		Arraylist_get_num_elements(world->cannons)
@@ -0,0 +1,627 @@
+/*
+ * XPilot NG, a multiplayer space war game.
+ *
+ * Copyright (C) 2026 by
+ *
+ *      The XPilot NG Authors, see the AUTHORS file.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Navigation fields for the robots.
+ *
+ * When the map is loaded the block map is turned into a grid of open
+ * and closed blocks.  For fuel stations, targets, cannons, treasures
+ * and checkpoints there is then a field which has, for every block,
+ * how many blocks away the nearest of them is along the open blocks
+ * and which one that is.  Finding the nearest one is then a lookup,
+ * and going downhill in the field leads around walls to it.
+ *
+ * Where teams matter there is a field for each team which has bases:
+ * the fuel stations a team may use with teamFuel, the targets and
+ * cannons of the other teams, and the treasures of the team itself.
+ * When a target or cannon is destroyed or comes back, only the part
+ * of the fields which it is the nearest one for is worked out again.
+ */
+
+#include "xpserver.h"
+
+#define NAV_FAR			0xFFFF	/* no way to get there */
+#define NAV_NONE		0xFFFF	/* no nearest map object */
+
+/* don't use more memory than this for the fields */
+#define NAV_MAX_MEMORY		(64 * 1024 * 1024)
+
+/* how far from a map object in a wall its field may start */
+#define NAV_SEED_RADIUS		3
+
+/* how many blocks ahead Nav_waypoint() looks */
+#define NAV_LOOKAHEAD		32
+
+typedef struct {
+    uint16_t	*dist;		/* blocks to the nearest map object */
+    uint16_t	*nearest;	/* index of that map object */
+} nav_field_t;
+
+static bool		nav_ok;
+static int		nav_width, nav_height;
+static unsigned char	*nav_open;	/* can robots fly through block */
+static unsigned char	*nav_queued;	/* block is in nav_queue */
+static int		*nav_queue;	/* ring of blocks to relax */
+static int		nav_queue_first, nav_queue_num;
+static int		*nav_cells;	/* scratch list of blocks */
+
+/*
+ * The field of each kind and team.  Kinds which don't depend on the
+ * team have the same field for all teams.  Checkpoints have one field
+ * each instead.
+ */
+static nav_field_t	*nav_fields[NUM_NAV_KINDS][MAX_TEAMS];
+static nav_field_t	*nav_check_fields;
+
+static bool Nav_team_field(int kind)
+{
+    if (!BIT(world->rules->mode, TEAM_PLAY))
+	return false;
+    if (kind == NAV_FUEL)
+	return options.teamFuel;
+    return true;
+}
+
+static int Nav_num_objects(int kind)
+{
+    switch (kind) {
+    case NAV_FUEL:	return Num_fuels();
+    case NAV_TARGET:	return Num_targets();
+    case NAV_CANNON:	return Num_cannons();
+    case NAV_TREASURE:	return Num_treasures();
+    default:		return 0;
+    }
+}
+
+static clpos_t Nav_object_pos(int kind, int ind)
+{
+    switch (kind) {
+    case NAV_FUEL:	return Fuel_by_index(ind)->pos;
+    case NAV_TARGET:	return Target_by_index(ind)->pos;
+    case NAV_CANNON:	return Cannon_by_index(ind)->pos;
+    default:		return Treasure_by_index(ind)->pos;
+    }
+}
+
+/*
+ * Is map object ind of a kind in the field for team?
+ * Team is TEAM_NOT_SET for fields which are the same for all teams.
+ */
+static bool Nav_in_field(int kind, int team, int ind)
+{
+    switch (kind) {
+    case NAV_FUEL:
+	return team == TEAM_NOT_SET || Fuel_by_index(ind)->team == team;
+    case NAV_TARGET: {
+	target_t *targ = Target_by_index(ind);
+
+	return targ->dead_ticks <= 0
+	    && (team == TEAM_NOT_SET || targ->team != team);
+    }
+    case NAV_CANNON: {
+	cannon_t *cannon = Cannon_by_index(ind);
+
+	return cannon->dead_ticks <= 0
+	    && (team == TEAM_NOT_SET || cannon->team != team);
+    }
+    case NAV_TREASURE:
+	return team == TEAM_NOT_SET || Treasure_by_index(ind)->team == team;
+    default:
+	return false;
+    }
+}
+
+static int Nav_cell(clpos_t pos)
+{
+    blkpos_t blk = Clpos_to_blkpos(World_wrap_clpos(pos));
+
+    LIMIT(blk.bx, 0, nav_width - 1);
+    LIMIT(blk.by, 0, nav_height - 1);
+
+    return blk.bx + blk.by * nav_width;
+}
+
+/*
+ * Returns the block dx, dy blocks from block c, or -1 if there is none.
+ */
+static int Nav_offset(int c, int dx, int dy)
+{
+    int bx = c % nav_width + dx, by = c / nav_width + dy;
+
+    if (BIT(world->rules->mode, WRAP_PLAY)) {
+	bx = (bx + nav_width) % nav_width;
+	by = (by + nav_height) % nav_height;
+    } else if (bx < 0 || bx >= nav_width || by < 0 || by >= nav_height)
+	return -1;
+
+    return bx + by * nav_width;
+}
+
+/*
+ * Returns the block next to block c in direction d, 0 to 7 counter
+ * clockwise starting from the right, or -1 if there is none.
+ */
+static int Nav_neighbour(int c, int d)
+{
+    static const int ddx[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+    static const int ddy[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+
+    return Nav_offset(c, ddx[d], ddy[d]);
+}
+
+static bool Nav_open_towards(int c, int d)
+{
+    int n = Nav_neighbour(c, d);
+
+    return n != -1 && nav_open[n];
+}
+
+static void Nav_push(int c)
+{
+    if (nav_queued[c])
+	return;
+    nav_queued[c] = 1;
+    nav_queue[(nav_queue_first + nav_queue_num++)
+	      % (nav_width * nav_height)] = c;
+}
+
+/*
+ * Lower the distances of the blocks next to the queued blocks until
+ * nothing changes any more.
+ */
+static void Nav_relax(nav_field_t *f)
+{
+    int c, n, d, i, size = nav_width * nav_height;
+
+    while (nav_queue_num > 0) {
+	c = nav_queue[nav_queue_first];
+	nav_queue_first = (nav_queue_first + 1) % size;
+	nav_queue_num--;
+	nav_queued[c] = 0;
+
+	d = f->dist[c] + 1;
+	for (i = 0; i < 8; i += 2) {
+	    if ((n = Nav_neighbour(c, i)) == -1
+		|| !nav_open[n]
+		|| f->dist[n] <= d)
+		continue;
+	    f->dist[n] = d;
+	    f->nearest[n] = f->nearest[c];
+	    Nav_push(n);
+	}
+    }
+}
+
+/*
+ * Start the field from map object ind in block c.  On polygon maps
+ * map objects are often in blocks which the walls next to them fill,
+ * then it also starts from the nearest open blocks around it.
+ */
+static void Nav_seed(nav_field_t *f, int c, int ind)
+{
+    int r, dx, dy, n;
+    bool found = false;
+
+    f->dist[c] = 0;
+    f->nearest[c] = ind;
+    Nav_push(c);
+    if (nav_open[c])
+	return;
+
+    for (r = 1; r <= NAV_SEED_RADIUS && !found; r++) {
+	for (dy = -r; dy <= r; dy++) {
+	    for (dx = -r; dx <= r; dx++) {
+		if (MAX(ABS(dx), ABS(dy)) != r
+		    || (n = Nav_offset(c, dx, dy)) == -1
+		    || !nav_open[n])
+		    continue;
+		found = true;
+		if (f->dist[n] <= r)
+		    continue;
+		f->dist[n] = r;
+		f->nearest[n] = ind;
+		Nav_push(n);
+	    }
+	}
+    }
+}
+
+/*
+ * Make map object ind the nearest one of its own block,
+ * and of all the blocks which it is now closer to.
+ */
+static void Nav_add_object(nav_field_t *f, int kind, int ind)
+{
+    int c = Nav_cell(Nav_object_pos(kind, ind));
+
+    if (f->dist[c] == 0)
+	return;
+    Nav_seed(f, c, ind);
+    Nav_relax(f);
+}
+
+/*
+ * Find new nearest map objects for the blocks which map object ind
+ * was the nearest one for.  The other map objects of the field start
+ * it again, as some of the blocks may have been theirs too.
+ */
+static void Nav_remove_object(nav_field_t *f, int kind, int team, int ind)
+{
+    int c, n, i, j, num = 0, size = nav_width * nav_height;
+
+    for (c = 0; c < size; c++) {
+	if (f->nearest[c] == ind) {
+	    f->dist[c] = NAV_FAR;
+	    f->nearest[c] = NAV_NONE;
+	    nav_cells[num++] = c;
+	}
+    }
+    for (j = 0; j < num; j++) {
+	c = nav_cells[j];
+	if (!nav_open[c])
+	    continue;
+	for (i = 0; i < 8; i += 2) {
+	    if ((n = Nav_neighbour(c, i)) == -1
+		|| f->dist[n] == NAV_FAR
+		|| f->dist[n] + 1 >= f->dist[c])
+		continue;
+	    f->dist[c] = f->dist[n] + 1;
+	    f->nearest[c] = f->nearest[n];
+	}
+	if (f->dist[c] != NAV_FAR)
+	    Nav_push(c);
+    }
+    for (i = 0; i < Nav_num_objects(kind); i++) {
+	if (i != ind && Nav_in_field(kind, team, i))
+	    Nav_seed(f, Nav_cell(Nav_object_pos(kind, i)), i);
+    }
+    Nav_relax(f);
+}
+
+static nav_field_t *Nav_field_alloc(void)
+{
+    int size = nav_width * nav_height;
+    nav_field_t *f = XCALLOC(nav_field_t, 1);
+
+    if (f == NULL)
+	return NULL;
+    f->dist = XMALLOC(uint16_t, size);
+    f->nearest = XMALLOC(uint16_t, size);
+    if (f->dist == NULL || f->nearest == NULL) {
+	XFREE(f->dist);
+	XFREE(f->nearest);
+	XFREE(f);
+	return NULL;
+    }
+    memset(f->dist, 0xFF, size * sizeof(uint16_t));
+    memset(f->nearest, 0xFF, size * sizeof(uint16_t));
+
+    return f;
+}
+
+static nav_field_t *Nav_field_create(int kind, int team)
+{
+    nav_field_t *f = Nav_field_alloc();
+    int i, c;
+
+    if (f == NULL)
+	return NULL;
+    for (i = 0; i < Nav_num_objects(kind); i++) {
+	if (!Nav_in_field(kind, team, i))
+	    continue;
+	c = Nav_cell(Nav_object_pos(kind, i));
+	if (f->dist[c] != 0)
+	    Nav_seed(f, c, i);
+    }
+    Nav_relax(f);
+
+    return f;
+}
+
+/*
+ * Can robots fly through a block of this type?
+ */
+static bool Nav_block_is_open(int type)
+{
+    switch (type) {
+    case FILLED:
+    case REC_LU:
+    case REC_LD:
+    case REC_RU:
+    case REC_RD:
+    case FUEL:
+    case CANNON:
+    case TREASURE:
+    case TARGET:
+	return false;
+    default:
+	return true;
+    }
+}
+
+/*
+ * Make the navigation fields from the block map.
+ */
+void Nav_init(void)
+{
+    int kind, team, i, size, num_fields = 0;
+    blkpos_t blk;
+
+    if (!options.robotNavigation)
+	return;
+
+    nav_width = world->x;
+    nav_height = world->y;
+    size = nav_width * nav_height;
+    if (size <= 0)
+	return;
+    for (kind = 0; kind < NUM_NAV_KINDS; kind++) {
+	if (Nav_num_objects(kind) >= NAV_NONE)
+	    return;
+    }
+
+    for (kind = 0; kind < NUM_NAV_KINDS; kind++) {
+	if (Nav_num_objects(kind) == 0)
+	    continue;
+	if (!Nav_team_field(kind))
+	    num_fields++;
+	else {
+	    for (team = 0; team < MAX_TEAMS; team++) {
+		if (world->teams[team].NumBases > 0)
+		    num_fields++;
+	    }
+	}
+    }
+    if (BIT(world->rules->mode, TIMING))
+	num_fields += world->NumChecks;
+    if ((double)num_fields * size * 2 * sizeof(uint16_t) > NAV_MAX_MEMORY) {
+	warn("The map is too big for robot navigation fields.");
+	return;
+    }
+
+    nav_open = XMALLOC(unsigned char, size);
+    nav_queued = XCALLOC(unsigned char, size);
+    nav_queue = XMALLOC(int, size);
+    nav_cells = XMALLOC(int, size);
+    if (nav_open == NULL || nav_queued == NULL
+	|| nav_queue == NULL || nav_cells == NULL) {
+	error("No memory for robot navigation");
+	exit(1);
+    }
+    for (blk.by = 0; blk.by < nav_height; blk.by++) {
+	for (blk.bx = 0; blk.bx < nav_width; blk.bx++)
+	    nav_open[blk.bx + blk.by * nav_width]
+		= Nav_block_is_open(World_get_block(blk));
+    }
+
+    for (kind = 0; kind < NUM_NAV_KINDS; kind++) {
+	nav_field_t *f = NULL;
+
+	if (Nav_num_objects(kind) == 0)
+	    continue;
+	for (team = 0; team < MAX_TEAMS; team++) {
+	    if (Nav_team_field(kind)) {
+		if (world->teams[team].NumBases == 0)
+		    continue;
+		f = Nav_field_create(kind, team);
+	    } else if (f == NULL)
+		f = Nav_field_create(kind, TEAM_NOT_SET);
+	    if (f == NULL) {
+		error("No memory for robot navigation");
+		exit(1);
+	    }
+	    nav_fields[kind][team] = f;
+	}
+    }
+
+    if (BIT(world->rules->mode, TIMING) && world->NumChecks > 0) {
+	nav_check_fields = XCALLOC(nav_field_t, world->NumChecks);
+	if (nav_check_fields == NULL) {
+	    error("No memory for robot navigation");
+	    exit(1);
+	}
+	for (i = 0; i < world->NumChecks; i++) {
+	    nav_field_t *f = Nav_field_alloc();
+	    int c = Nav_cell(Check_by_index(i)->pos);
+
+	    if (f == NULL) {
+		error("No memory for robot navigation");
+		exit(1);
+	    }
+	    Nav_seed(f, c, i);
+	    Nav_relax(f);
+	    nav_check_fields[i] = *f;
+	    free(f);
+	}
+    }
+
+    nav_ok = true;
+}
+
+static nav_field_t *Nav_field(int kind, int which)
+{
+    if (!nav_ok)
+	return NULL;
+    if (kind == NAV_CHECK) {
+	if (nav_check_fields == NULL || which < 0 || which >= world->NumChecks)
+	    return NULL;
+	return &nav_check_fields[which];
+    }
+    if (kind < 0 || kind >= NUM_NAV_KINDS)
+	return NULL;
+    if (!Nav_team_field(kind))
+	which = 0;
+    else if (which < 0 || which >= MAX_TEAMS)
+	return NULL;
+    return nav_fields[kind][which];
+}
+
+/*
+ * A target or cannon has been destroyed or has come back,
+ * update the fields it is in.
+ */
+static void Nav_object_changed(int kind, int ind)
+{
+    int team, field_team;
+    nav_field_t *f, *done = NULL;
+
+    for (team = 0; team < MAX_TEAMS; team++) {
+	if ((f = Nav_field(kind, team)) == NULL || f == done)
+	    continue;
+	done = f;
+	field_team = Nav_team_field(kind) ? team : TEAM_NOT_SET;
+	if (Nav_in_field(kind, field_team, ind))
+	    Nav_add_object(f, kind, ind);
+	else
+	    Nav_remove_object(f, kind, field_team, ind);
+    }
+}
+
+void Nav_target_changed(target_t *targ)
+{
+    int i;
+
+    if (!nav_ok)
+	return;
+    for (i = 0; i < Num_targets(); i++) {
+	if (Target_by_index(i) == targ) {
+	    Nav_object_changed(NAV_TARGET, i);
+	    break;
+	}
+    }
+}
+
+void Nav_cannon_changed(cannon_t *cannon)
+{
+    int i;
+
+    if (!nav_ok)
+	return;
+    for (i = 0; i < Num_cannons(); i++) {
+	if (Cannon_by_index(i) == cannon) {
+	    Nav_object_changed(NAV_CANNON, i);
+	    break;
+	}
+    }
+}
+
+/*
+ * Find the nearest map object of a kind for a team, or the distance
+ * to checkpoint 'which' if kind is NAV_CHECK.  Returns false if there
+ * are no navigation fields or there is no way to any of them.  The
+ * distance is in pixels along the way.
+ */
+bool Nav_nearest(int kind, int which, clpos_t pos, int *ind, double *dist)
+{
+    nav_field_t *f = Nav_field(kind, which);
+    int c;
+
+    if (f == NULL)
+	return false;
+    c = Nav_cell(pos);
+    if (f->dist[c] == NAV_FAR)
+	return false;
+    *ind = f->nearest[c];
+    *dist = f->dist[c] * (double)BLOCK_SZ;
+
+    return true;
+}
+
+/*
+ * Is the way from pos to the center of block c open?
+ */
+static bool Nav_clear_line(clpos_t pos, int c)
+{
+    double dcx, dcy, len, t;
+    clpos_t p;
+
+    dcx = WRAP_DCX(BLOCK_CENTER(c % nav_width) - pos.cx);
+    dcy = WRAP_DCY(BLOCK_CENTER(c / nav_width) - pos.cy);
+    len = LENGTH(dcx, dcy);
+    for (t = 0; t < len; t += BLOCK_CLICKS / 2) {
+	p.cx = pos.cx + (click_t)(dcx * t / len);
+	p.cy = pos.cy + (click_t)(dcy * t / len);
+	if (!nav_open[Nav_cell(p)])
+	    return false;
+    }
+    return true;
+}
+
+/*
+ * Find the point to head for to get to the nearest map object of a
+ * kind, or to checkpoint 'which' if kind is NAV_CHECK, by following
+ * the field downhill as far as it can be seen from pos.  That is the
+ * map object itself if nothing is in the way or if the way down ends
+ * next to it.  Returns false if there are no navigation fields or
+ * there is no way there.
+ */
+bool Nav_waypoint(int kind, int which, clpos_t pos, clpos_t *wp)
+{
+    nav_field_t *f = Nav_field(kind, which);
+    int c, n, best, i, step;
+    bool there = false;
+
+    if (f == NULL)
+	return false;
+    c = Nav_cell(pos);
+    if (f->dist[c] == NAV_FAR)
+	return false;
+
+    for (step = 0; step < NAV_LOOKAHEAD; step++) {
+	if (f->dist[c] == 0) {
+	    there = true;
+	    break;
+	}
+	best = -1;
+	for (i = 0; i < 8; i++) {
+	    if ((n = Nav_neighbour(c, i)) == -1
+		|| f->dist[n] >= f->dist[c]
+		|| (best != -1 && f->dist[n] >= f->dist[best]))
+		continue;
+	    /* Don't cut corners. */
+	    if ((i & 1)
+		&& (!Nav_open_towards(c, i - 1)
+		    || !Nav_open_towards(c, (i + 1) & 7)))
+		continue;
+	    best = n;
+	}
+	if (best == -1 || !nav_open[best]) {
+	    there = true;
+	    break;
+	}
+	if (step > 0 && !Nav_clear_line(pos, best))
+	    break;
+	c = best;
+    }
+
+    if (there) {
+	if (kind == NAV_CHECK)
+	    *wp = Check_by_index(which)->pos;
+	else
+	    *wp = Nav_object_pos(kind, f->nearest[c]);
+    } else {
+	wp->cx = BLOCK_CENTER(c % nav_width);
+	wp->cy = BLOCK_CENTER(c / nav_width);
+    }
+
+    return true;
+}
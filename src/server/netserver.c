@@ -90,6 +90,11 @@
  * The server maintains an acknowledgement timeout timer for each
  * connection so that it can retransmit a reliable data packet
  * if the acknowledgement timer expires.
+ * Since 4.F.1.7 clients keep reliable data which arrives out of order
+ * and also tell the server which later data they have (see sack.h).
+ * Then the server has up to RELIABLE_WINDOW bytes unacknowledged,
+ * sends again only the segments which were lost and sends as much as
+ * the link takes, which makes logging in over slow links a lot faster.
  */
 
 #include "xpserver.h"
@@ -105,10 +110,12 @@ static int Receive_quit(connection_t *connp);
 static int Receive_play(connection_t *connp);
 static int Receive_power(connection_t *connp);
 static int Receive_ack(connection_t *connp);
+static int Receive_sack(connection_t *connp);
 static int Receive_ack_cannon(connection_t *connp);
 static int Receive_ack_fuel(connection_t *connp);
 static int Receive_ack_target(connection_t *connp);
 static int Receive_ack_polystyle(connection_t *connp);
+static int Receive_ack_frame(connection_t *connp);
 static int Receive_discard(connection_t *connp);
 static int Receive_undefined(connection_t *connp);
 static int Receive_talk(connection_t *connp);
@@ -122,15 +129,35 @@ static int Receive_fps_request(connection_t *connp);
 
 static int Send_motd(connection_t *connp);
 
-#define MAX_SELECT_FD			(sizeof(int) * 8 - 1)
+/*
+ * The scheduler may fall back to select(2), so keep the connection
+ * sockets below FD_SETSIZE.
+ */
+#define MAX_SELECT_FD			(FD_SETSIZE - 1)
 #define MAX_RELIABLE_DATA_PACKET_SIZE	1024
 
+/*
+ * Reliable data sent before the first acknowledgement to a client
+ * which acknowledges selectively, and how many segments sent after
+ * a segment must have arrived before that segment is taken as lost.
+ */
+#define SACK_INITIAL_WINDOW		(4*MAX_RELIABLE_DATA_PACKET_SIZE)
+#define SACK_LOST_AFTER			3
+
+/*
+ * The acknowledgements of the last segments of a window come later
+ * than the roundtrip time, so wait a little longer before resending.
+ */
+#define SACK_RETRANSMIT(connp)	((connp)->rtt_retransmit + MIN_RETRANSMIT)
+
 #define MAX_MOTD_CHUNK			512
 #define MAX_MOTD_SIZE			(30*1024)
 #define MAX_MOTD_LOOPS			(10*FPS)
 
 static connection_t	*Conn = NULL;
+static connection_t	**input_reliable = NULL;
 static int		max_connections = 0;
+int			conn_mask_words = 0;
 static setup_t		*Setup = NULL;
 static setup_t		*Oldsetup = NULL;
 static int		(*playing_receive[256])(connection_t *connp),
@@ -181,6 +208,10 @@ static void Feature_init(connection_t *connp)
 	    SET_BIT(features, F_BALLSTYLE);
 	if (v >= 0x4F15)
 	    SET_BIT(features, F_POLYSTYLE);
+	if (v >= 0x4F16)
+	    SET_BIT(features, F_DELTAFRAME);
+	if (v >= 0x4F17)
+	    SET_BIT(features, F_SACK);
     }
     connp->features = features;
     return;
@@ -247,6 +278,7 @@ static void Init_receive(void)
 
     drain_receive[PKT_QUIT]			= Receive_quit;
     drain_receive[PKT_ACK]			= Receive_ack;
+    drain_receive[PKT_SACK]			= Receive_sack;
     drain_receive[PKT_VERIFY]			= Receive_discard;
     drain_receive[PKT_PLAY]			= Receive_discard;
     drain_receive[PKT_SHAPE]			= Receive_discard;
@@ -254,6 +286,7 @@ static void Init_receive(void)
     login_receive[PKT_PLAY]			= Receive_play;
     login_receive[PKT_QUIT]			= Receive_quit;
     login_receive[PKT_ACK]			= Receive_ack;
+    login_receive[PKT_SACK]			= Receive_sack;
     login_receive[PKT_VERIFY]			= Receive_discard;
     login_receive[PKT_POWER]			= Receive_power;
     login_receive[PKT_POWER_S]			= Receive_power;
@@ -269,6 +302,7 @@ static void Init_receive(void)
     login_receive[PKT_ASYNC_FPS]		= Receive_fps_request;
 
     playing_receive[PKT_ACK]			= Receive_ack;
+    playing_receive[PKT_SACK]			= Receive_sack;
     playing_receive[PKT_VERIFY]			= Receive_discard;
     playing_receive[PKT_PLAY]			= Receive_play;
     playing_receive[PKT_QUIT]			= Receive_quit;
@@ -291,6 +325,61 @@ static void Init_receive(void)
     playing_receive[PKT_POINTER_MOVE]		= Receive_pointer_move;
     playing_receive[PKT_REQUEST_AUDIO]		= Receive_audio_request;
     playing_receive[PKT_ASYNC_FPS]		= Receive_fps_request;
+    playing_receive[PKT_ACK_FRAME]		= Receive_ack_frame;
+}
+
+/*
+ * Give each map object connection masks with room for one bit per
+ * connection.  All masks come from one block, in the order the
+ * objects are stored, so that Frame_map() walks through memory.
+ */
+static int Conn_masks_init(void)
+{
+    int i, num_masks;
+    conn_mask_t *mask;
+    static conn_mask_t *conn_masks = NULL;
+
+    num_masks = Num_cannons() + Num_fuels() + 2 * Num_targets() + num_polys;
+    conn_mask_words = (max_connections + CONN_MASK_BITS - 1) / CONN_MASK_BITS;
+    XFREE(conn_masks);
+    if (num_masks == 0)
+	return 0;
+    conn_masks = XCALLOC(conn_mask_t, num_masks * conn_mask_words);
+    if (conn_masks == NULL) {
+	error("Cannot allocate memory for connection masks");
+	return -1;
+    }
+
+    mask = conn_masks;
+    for (i = 0; i < Num_cannons(); i++) {
+	cannon_t *cannon = Cannon_by_index(i);
+
+	cannon->conn_mask = mask;
+	Conn_mask_fill(mask);
+	mask += conn_mask_words;
+    }
+    for (i = 0; i < Num_fuels(); i++) {
+	fuel_t *fs = Fuel_by_index(i);
+
+	fs->conn_mask = mask;
+	Conn_mask_fill(mask);
+	mask += conn_mask_words;
+    }
+    for (i = 0; i < Num_targets(); i++) {
+	target_t *targ = Target_by_index(i);
+
+	targ->conn_mask = mask;
+	Conn_mask_fill(mask);
+	mask += conn_mask_words;
+	targ->update_mask = mask;
+	mask += conn_mask_words;
+    }
+    for (i = 0; i < num_polys; i++) {
+	pdata[i].update_mask = mask;
+	mask += conn_mask_words;
+    }
+
+    return 0;
 }
 
 /*
@@ -311,12 +400,13 @@ int Setup_net_server(void)
     max_connections
 	= MIN((int)MAX_SELECT_FD - 5,
 	      options.playerLimit_orig + MAX_SPECTATORS * !!rplayback);
-    if ((Conn = XCALLOC(connection_t, max_connections)) == NULL) {
+    if ((Conn = XCALLOC(connection_t, max_connections)) == NULL
+	|| (input_reliable = XCALLOC(connection_t *, max_connections)) == NULL) {
 	error("Cannot allocate memory for connections");
 	return -1;
     }
 
-    return 0;
+    return Conn_masks_init();
 }
 
 static void Conn_set_state(connection_t *connp, int state, int drain_state)
@@ -415,6 +505,7 @@ void Destroy_connection(connection_t *connp, const char *reason)
     Sockbuf_cleanup(&connp->w);
     Sockbuf_cleanup(&connp->r);
     Sockbuf_cleanup(&connp->c);
+    Delta_cleanup(&connp->delta);
 
     num_logouts++;
 
@@ -713,6 +804,25 @@ int Setup_connection(char *user, char *nick, char *dpy, int team,
     connp->team = team;
     connp->version = version;
     Feature_init(connp);
+    if (FEATURE(connp, F_DELTAFRAME))
+	Delta_init(&connp->delta);
+    if (FEATURE(connp, F_SACK) && !playback) {
+	/* A window of data goes out at once and its acks come back. */
+	if (sock_set_send_buffer_size(&sock,
+				      SERVER_SEND_SIZE + RELIABLE_WINDOW) == -1)
+	    error("Cannot set send buffer size to %d",
+		  SERVER_SEND_SIZE + RELIABLE_WINDOW);
+	if (sock_set_receive_buffer_size(&sock,
+					 SERVER_RECV_SIZE + RELIABLE_WINDOW)
+	    == -1)
+	    error("Cannot set receive buffer size to %d",
+		  SERVER_RECV_SIZE + RELIABLE_WINDOW);
+    }
+    connp->delta_ack = 0;
+    connp->objects_examined = 0;
+    connp->objects_sent = 0;
+    memset(&connp->gov, 0, sizeof(connp->gov));
+    connp->gov.start[0] = connp->gov.start[1] = frame_loops;
     connp->start = main_loops;
     connp->magic = /*randomMT() +*/ my_port + sock.fd + team + main_loops;
     connp->id = NO_ID;
@@ -727,6 +837,9 @@ int Setup_connection(char *user, char *nick, char *dpy, int team,
     connp->rtt_dev = 0;
     connp->rtt_timeouts = 0;
     connp->acks = 0;
+    memset(&connp->sack, 0, sizeof(connp->sack));
+    connp->sack.cwnd = SACK_INITIAL_WINDOW;
+    connp->sack.ssthresh = RELIABLE_WINDOW;
     connp->setup = 0;
     connp->motd_offset = -1;
     connp->motd_stop = 0;
@@ -896,7 +1009,9 @@ static int Handle_setup(connection_t *connp)
 	}
     }
     if (connp->setup < S->setup_size) {
-	len = MIN(connp->c.size, 4096) - connp->c.len;
+	len = MIN(connp->c.size,
+		  FEATURE(connp, F_SACK) ? RELIABLE_WINDOW : 4096)
+	    - connp->c.len;
 	if (len <= 0)
 	    /* Wait for acknowledgement of previously transmitted data. */
 	    return 0;
@@ -993,7 +1108,8 @@ static void LegalizeHost(char *string)
 static int Handle_login(connection_t *connp, char *errmsg, size_t errsize)
 {
     player_t *pl;
-    int i, conn_bit;
+    int i, conn_word;
+    unsigned conn_bit;
     const char sender[] = "[*Server notice*]";
 
     if (BIT(world->rules->mode, TEAM_PLAY)) {
@@ -1179,16 +1295,17 @@ static int Handle_login(connection_t *connp, char *errmsg, size_t errsize)
 	}
     }
 
-    conn_bit = (1 << connp->ind);
+    conn_word = CONN_MASK_WORD(connp->ind);
+    conn_bit = CONN_MASK_BIT(connp->ind);
     for (i = 0; i < Num_cannons(); i++) {
 	cannon_t *cannon = Cannon_by_index(i);
 	/*
 	 * The client assumes at startup that all cannons are active.
 	 */
 	if (cannon->dead_ticks == 0)
-	    SET_BIT(cannon->conn_mask, conn_bit);
+	    SET_BIT(cannon->conn_mask[conn_word], conn_bit);
 	else
-	    CLR_BIT(cannon->conn_mask, conn_bit);
+	    CLR_BIT(cannon->conn_mask[conn_word], conn_bit);
     }
     for (i = 0; i < Num_fuels(); i++) {
 	fuel_t *fs = Fuel_by_index(i);
@@ -1196,9 +1313,9 @@ static int Handle_login(connection_t *connp, char *errmsg, size_t errsize)
 	 * The client assumes at startup that all fuelstations are filled.
 	 */
 	if (fs->fuel == MAX_STATION_FUEL)
-	    SET_BIT(fs->conn_mask, conn_bit);
+	    SET_BIT(fs->conn_mask[conn_word], conn_bit);
 	else
-	    CLR_BIT(fs->conn_mask, conn_bit);
+	    CLR_BIT(fs->conn_mask[conn_word], conn_bit);
     }
     for (i = 0; i < Num_targets(); i++) {
 	target_t *targ = Target_by_index(i);
@@ -1207,11 +1324,11 @@ static int Handle_login(connection_t *connp, char *errmsg, size_t errsize)
 	 */
 	if (targ->dead_ticks == 0
 	    && targ->damage == TARGET_DAMAGE) {
-	    SET_BIT(targ->conn_mask, conn_bit);
-	    CLR_BIT(targ->update_mask, conn_bit);
+	    SET_BIT(targ->conn_mask[conn_word], conn_bit);
+	    CLR_BIT(targ->update_mask[conn_word], conn_bit);
 	} else {
-	    CLR_BIT(targ->conn_mask, conn_bit);
-	    SET_BIT(targ->update_mask, conn_bit);
+	    CLR_BIT(targ->conn_mask[conn_word], conn_bit);
+	    SET_BIT(targ->update_mask[conn_word], conn_bit);
 	}
     }
     for (i = 0; i < num_polys; i++) {
@@ -1222,9 +1339,9 @@ static int Handle_login(connection_t *connp, char *errmsg, size_t errsize)
 	 * style.
 	 */
 	if (poly->style == poly->current_style)
-	    CLR_BIT(poly->update_mask, conn_bit);
+	    CLR_BIT(poly->update_mask[conn_word], conn_bit);
 	else
-	    SET_BIT(poly->update_mask, conn_bit);
+	    SET_BIT(poly->update_mask[conn_word], conn_bit);
     }
 
     sound_player_init(pl);
@@ -1267,62 +1384,33 @@ static int bytes[256];
 static int bytes2;
 int recSpecial;
 
-static void Handle_input(int fd, void *arg)
+/*
+ * Decode the datagram in connp->r with the packet handlers for the
+ * state of the connection.  pbdcheck and pbscheck point just past
+ * the datagram in the recording when it was recorded with recOpt.
+ * Returns -1 if the connection was destroyed.
+ */
+static int Handle_datagram(connection_t *connp, char *pbdcheck,
+			   short *pbscheck)
 {
-    connection_t *connp = (connection_t *)arg;
     int type, result, (**receive_tbl)(connection_t *);
-    short *pbscheck = NULL;
-    char *pbdcheck = NULL;
 
-    UNUSED_PARAM(fd);
     if (connp->state & (CONN_PLAYING | CONN_READY))
 	receive_tbl = &playing_receive[0];
     else if (connp->state == CONN_LOGIN)
 	receive_tbl = &login_receive[0];
     else if (connp->state & (CONN_DRAIN | CONN_SETUP))
 	receive_tbl = &drain_receive[0];
-    else if (connp->state == CONN_LISTENING) {
-	Handle_listening(connp);
-	return;
-    } else {
+    else {
 	if (connp->state != CONN_FREE)
 	    Destroy_connection(connp, "not input");
-	return;
+	return -1;
     }
     connp->num_keyboard_updates = 0;
 
-    Sockbuf_clear(&connp->r);
-
-    if (!recOpt || (!record && !playback)) {
-	if (Sockbuf_readRec(&connp->r) == -1) {
-	    Destroy_connection(connp, "input error");
-	    return;
-	}
-    }
-    else if (record) {
-	if (Sockbuf_read(&connp->r) == -1) {
-	    Destroy_connection(connp, "input error");
-	    *playback_shorts++ = (short)0xffff;
-	    return;
-	}
-	*playback_shorts++ = connp->r.len;
-	memcpy(playback_data, connp->r.buf, (size_t)connp->r.len);
-	playback_data += connp->r.len;
-	pbdcheck = playback_data;
-	pbscheck = playback_shorts;
-    }
-    else if (playback) {
-	if ( (connp->r.len = *playback_shorts++) == 0xffff) {
-	    Destroy_connection(connp, "input error");
-	    return;
-	}
-	memcpy(connp->r.buf, playback_data, (size_t)connp->r.len);
-	playback_data += connp->r.len;
-    }
-
     if (connp->r.len <= 0)
 	/* No input. */
-	return;
+	return 0;
 
     while (connp->r.ptr < connp->r.buf + connp->r.len) {
 	char *pkt = connp->r.ptr;
@@ -1335,7 +1423,7 @@ static void Handle_input(int fd, void *arg)
 	     * Unrecoverable error.
 	     * Connection has been destroyed.
 	     */
-	    return;
+	    return -1;
 
 	if (record && recOpt && recSpecial && playback_data == pbdcheck &&
 	    playback_shorts == pbscheck) {
@@ -1370,12 +1458,98 @@ static void Handle_input(int fd, void *arg)
 	if (connp->state == CONN_PLAYING)
 	    connp->start = main_loops;
     }
+
+    return 0;
+}
+
+/*
+ * Handle all the datagrams that are waiting on the socket of connp,
+ * read with as few system calls as possible.  Recordings store one
+ * datagram for each call of an input handler, so while recording or
+ * playing back, and for the calls from Handle_setup() which are not
+ * recorded as input handler calls, only one datagram is read.
+ */
+static bool Handle_input_batch(connection_t *connp)
+{
+    static char data[MAX_MMSG][SERVER_RECV_SIZE];
+    char *bufs[MAX_MMSG];
+    int i, num, lens[MAX_MMSG];
+
+    for (i = 0; i < MAX_MMSG; i++)
+	bufs[i] = data[i];
+    num = sock_read_manyRec(&connp->r.sock, bufs, SERVER_RECV_SIZE,
+			    lens, MAX_MMSG);
+    if (num <= 0)
+	/* Let Sockbuf_readRec() deal with errors. */
+	return false;
+
+    for (i = 0; i < num; i++) {
+	Sockbuf_clear(&connp->r);
+	memcpy(connp->r.buf, data[i], (size_t)lens[i]);
+	connp->r.len = lens[i];
+	if (Handle_datagram(connp, NULL, NULL) == -1)
+	    break;
+    }
+
+    return true;
+}
+
+static void Handle_input(int fd, void *arg)
+{
+    connection_t *connp = (connection_t *)arg;
+    short *pbscheck = NULL;
+    char *pbdcheck = NULL;
+
+    if (connp->state == CONN_LISTENING) {
+	Handle_listening(connp);
+	return;
+    }
+    if (!(connp->state & (CONN_PLAYING | CONN_READY | CONN_LOGIN
+			  | CONN_DRAIN | CONN_SETUP))) {
+	if (connp->state != CONN_FREE)
+	    Destroy_connection(connp, "not input");
+	return;
+    }
+
+    if (fd != -1 && !record && !playback && Handle_input_batch(connp))
+	return;
+
+    Sockbuf_clear(&connp->r);
+
+    if (!recOpt || (!record && !playback)) {
+	if (Sockbuf_readRec(&connp->r) == -1) {
+	    Destroy_connection(connp, "input error");
+	    return;
+	}
+    }
+    else if (record) {
+	if (Sockbuf_read(&connp->r) == -1) {
+	    Destroy_connection(connp, "input error");
+	    *playback_shorts++ = (short)0xffff;
+	    return;
+	}
+	*playback_shorts++ = connp->r.len;
+	memcpy(playback_data, connp->r.buf, (size_t)connp->r.len);
+	playback_data += connp->r.len;
+	pbdcheck = playback_data;
+	pbscheck = playback_shorts;
+    }
+    else if (playback) {
+	if ( (connp->r.len = *playback_shorts++) == 0xffff) {
+	    Destroy_connection(connp, "input error");
+	    return;
+	}
+	memcpy(connp->r.buf, playback_data, (size_t)connp->r.len);
+	playback_data += connp->r.len;
+    }
+
+    Handle_datagram(connp, pbdcheck, pbscheck);
 }
 
 int Input(void)
 {
     int i, num_reliable = 0;
-    connection_t *input_reliable[MAX_SELECT_FD], *connp;
+    connection_t *connp;
     char msg[MSG_LEN];
 
     for (i = 0; i < max_connections; i++) {
@@ -1518,34 +1692,25 @@ int Send_self(connection_t *connp,
     int n;
 
     /* assumes connp->version >= 0x4203 */
-    n = Packet_printf(&connp->w,
-		      "%c"
-		      "%hd%hd%hd%hd%c"
-		      "%c%c%c"
-		      "%hd%hd%c%c"
-		      "%c%hd%hd"
-		      "%hd%hd%c"
-		      "%c%c"
-		      ,
-		      PKT_SELF,
-		      CLICK_TO_PIXEL(pl->pos.cx), CLICK_TO_PIXEL(pl->pos.cy),
-		      (int) pl->vel.x, (int) pl->vel.y,
-		      pl->dir,
-		      (int) (pl->power + 0.5),
-		      (int) (pl->turnspeed + 0.5),
-		      (int) (pl->turnresistance * 255.0 + 0.5),
-		      lock_id, lock_dist, lock_dir,
-		      pl->check,
-
-		      pl->fuel.current,
-		      (int)(pl->fuel.sum + 0.5),
-		      (int)(pl->fuel.max + 0.5),
-
-		      connp->view_width, connp->view_height,
-		      connp->debris_colors,
-
-		      (uint8_t)status,
-		      autopilotlight
+    n = Packet_put_self(&connp->w,
+			CLICK_TO_PIXEL(pl->pos.cx), CLICK_TO_PIXEL(pl->pos.cy),
+			(int) pl->vel.x, (int) pl->vel.y,
+			pl->dir,
+			(int) (pl->power + 0.5),
+			(int) (pl->turnspeed + 0.5),
+			(int) (pl->turnresistance * 255.0 + 0.5),
+			lock_id, lock_dist, lock_dir,
+			pl->check,
+
+			pl->fuel.current,
+			(int)(pl->fuel.sum + 0.5),
+			(int)(pl->fuel.max + 0.5),
+
+			connp->view_width, connp->view_height,
+			connp->debris_colors,
+
+			(uint8_t)status,
+			autopilotlight
 	);
     if (n <= 0)
 	return n;
@@ -1689,8 +1854,7 @@ int Send_base(connection_t *connp, int id, int num)
  */
 int Send_fuel(connection_t *connp, int num, double fuel)
 {
-    return Packet_printf(&connp->w, "%c%hu%hu", PKT_FUEL,
-			 num, (int)(fuel + 0.5));
+    return Packet_put_fuel(&connp->w, num, (int)(fuel + 0.5));
 }
 
 int Send_score_object(connection_t *connp, double score, clpos_t pos,
@@ -1718,33 +1882,32 @@ int Send_cannon(connection_t *connp, int num, int dead_ticks)
 {
     if (FEATURE(connp, F_POLY))
 	return 0;
-    return Packet_printf(&connp->w, "%c%hu%hu", PKT_CANNON, num, dead_ticks);
+    return Packet_put_cannon(&connp->w, num, dead_ticks);
 }
 
 int Send_destruct(connection_t *connp, int count)
 {
-    return Packet_printf(&connp->w, "%c%hd", PKT_DESTRUCT, count);
+    return Packet_put_destruct(&connp->w, count);
 }
 
 int Send_shutdown(connection_t *connp, int count, int delay)
 {
-    return Packet_printf(&connp->w, "%c%hd%hd", PKT_SHUTDOWN,
-			 count, delay);
+    return Packet_put_shutdown(&connp->w, count, delay);
 }
 
 int Send_thrusttime(connection_t *connp, int count, int max)
 {
-    return Packet_printf(&connp->w, "%c%hd%hd", PKT_THRUSTTIME, count, max);
+    return Packet_put_thrusttime(&connp->w, count, max);
 }
 
 int Send_shieldtime(connection_t *connp, int count, int max)
 {
-    return Packet_printf(&connp->w, "%c%hd%hd", PKT_SHIELDTIME, count, max);
+    return Packet_put_shieldtime(&connp->w, count, max);
 }
 
 int Send_phasingtime(connection_t *connp, int count, int max)
 {
-    return Packet_printf(&connp->w, "%c%hd%hd", PKT_PHASINGTIME, count, max);
+    return Packet_put_phasingtime(&connp->w, count, max);
 }
 
 int Send_debris(connection_t *connp, int type, unsigned char *p, unsigned n)
@@ -1780,9 +1943,9 @@ int Send_wreckage(connection_t *connp, clpos_t pos,
     else
 	wrtype &= ~0x80;
 
-    return Packet_printf(&connp->w, "%c%hd%hd%c%c%c", PKT_WRECKAGE,
-			 CLICK_TO_PIXEL(pos.cx), CLICK_TO_PIXEL(pos.cy),
-			 wrtype, size, rot);
+    return Packet_put_wreckage(&connp->w,
+			       CLICK_TO_PIXEL(pos.cx), CLICK_TO_PIXEL(pos.cy),
+			       wrtype, size, rot);
 }
 
 int Send_asteroid(connection_t *connp, clpos_t pos,
@@ -1796,8 +1959,7 @@ int Send_asteroid(connection_t *connp, clpos_t pos,
 
     type_size = ((type & 0x0F) << 4) | (size & 0x0F);
 
-    return Packet_printf(&connp->w, "%c%hd%hd%c%c", PKT_ASTEROID,
-		         x, y, type_size, rot);
+    return Packet_put_asteroid(&connp->w, x, y, type_size, rot);
 }
 
 int Send_fastshot(connection_t *connp, int type, unsigned char *p, unsigned n)
@@ -1827,43 +1989,41 @@ int Send_fastshot(connection_t *connp, int type, unsigned char *p, unsigned n)
 
 int Send_missile(connection_t *connp, clpos_t pos, int len, int dir)
 {
-    return Packet_printf(&connp->w, "%c%hd%hd%c%c", PKT_MISSILE,
-			 CLICK_TO_PIXEL(pos.cx), CLICK_TO_PIXEL(pos.cy),
-			 len, dir);
+    return Packet_put_missile(&connp->w,
+			      CLICK_TO_PIXEL(pos.cx), CLICK_TO_PIXEL(pos.cy),
+			      len, dir);
 }
 
 int Send_ball(connection_t *connp, clpos_t pos, int id, int style)
 {
     if (FEATURE(connp, F_BALLSTYLE))
-	return Packet_printf(&connp->w, "%c%hd%hd%hd%c", PKT_BALL,
-			     CLICK_TO_PIXEL(pos.cx), CLICK_TO_PIXEL(pos.cy),
-			     id, style);
+	return Packet_put_ballstyle(&connp->w, CLICK_TO_PIXEL(pos.cx),
+				    CLICK_TO_PIXEL(pos.cy), id, style);
 
-     return Packet_printf(&connp->w, "%c%hd%hd%hd", PKT_BALL,
- 			 CLICK_TO_PIXEL(pos.cx), CLICK_TO_PIXEL(pos.cy), id);
+    return Packet_put_ball(&connp->w,
+			   CLICK_TO_PIXEL(pos.cx), CLICK_TO_PIXEL(pos.cy), id);
 }
 
 int Send_mine(connection_t *connp, clpos_t pos, int teammine, int id)
 {
-    return Packet_printf(&connp->w, "%c%hd%hd%c%hd", PKT_MINE,
-			 CLICK_TO_PIXEL(pos.cx), CLICK_TO_PIXEL(pos.cy),
-			 teammine, id);
+    return Packet_put_mine(&connp->w,
+			   CLICK_TO_PIXEL(pos.cx), CLICK_TO_PIXEL(pos.cy),
+			   teammine, id);
 }
 
 int Send_target(connection_t *connp, int num, int dead_ticks, double damage)
 {
     if (FEATURE(connp, F_POLY))
 	return 0;
-    return Packet_printf(&connp->w, "%c%hu%hu%hu", PKT_TARGET,
-			 num, dead_ticks, (int)(damage * 256.0));
+    return Packet_put_target(&connp->w,
+			     num, dead_ticks, (int)(damage * 256.0));
 }
 
 int Send_polystyle(connection_t *connp, int polyind, int newstyle)
 {
     if (!FEATURE(connp, F_POLYSTYLE))
 	return 0;
-    return Packet_printf(&connp->w, "%c%hu%hu", PKT_POLYSTYLE,
-			 polyind, newstyle);
+    return Packet_put_polystyle(&connp->w, polyind, newstyle);
 }
 
 int Send_wormhole(connection_t *connp, clpos_t pos)
@@ -1872,20 +2032,20 @@ int Send_wormhole(connection_t *connp, clpos_t pos)
 
     if (!FEATURE(connp, F_TEMPWORM))
 	return Send_ecm(connp, pos, BLOCK_SZ - 2);
-    return Packet_printf(&connp->w, "%c%hd%hd", PKT_WORMHOLE, x, y);
+    return Packet_put_wormhole(&connp->w, x, y);
 }
 
 int Send_item(connection_t *connp, clpos_t pos, int type)
 {
-    return Packet_printf(&connp->w, "%c%hd%hd%c", PKT_ITEM,
-			 CLICK_TO_PIXEL(pos.cx), CLICK_TO_PIXEL(pos.cy), type);
+    return Packet_put_item(&connp->w,
+			   CLICK_TO_PIXEL(pos.cx), CLICK_TO_PIXEL(pos.cy), type);
 }
 
 int Send_paused(connection_t *connp, clpos_t pos, int count)
 {
-    return Packet_printf(&connp->w, "%c%hd%hd%hd", PKT_PAUSED,
-			 CLICK_TO_PIXEL(pos.cx), CLICK_TO_PIXEL(pos.cy),
-			 count);
+    return Packet_put_paused(&connp->w,
+			     CLICK_TO_PIXEL(pos.cx), CLICK_TO_PIXEL(pos.cy),
+			     count);
 }
 
 int Send_appearing(connection_t *connp, clpos_t pos, int id, int count)
@@ -1893,22 +2053,22 @@ int Send_appearing(connection_t *connp, clpos_t pos, int id, int count)
     if (!FEATURE(connp, F_SHOW_APPEARING))
 	return 0;
 
-    return Packet_printf(&connp->w, "%c%hd%hd%hd%hd", PKT_APPEARING,
-			 CLICK_TO_PIXEL(pos.cx), CLICK_TO_PIXEL(pos.cy),
-			 id, count);
+    return Packet_put_appearing(&connp->w,
+				CLICK_TO_PIXEL(pos.cx), CLICK_TO_PIXEL(pos.cy),
+				id, count);
 }
 
 int Send_ecm(connection_t *connp, clpos_t pos, int size)
 {
-    return Packet_printf(&connp->w, "%c%hd%hd%hd", PKT_ECM,
-			 CLICK_TO_PIXEL(pos.cx), CLICK_TO_PIXEL(pos.cy), size);
+    return Packet_put_ecm(&connp->w,
+			  CLICK_TO_PIXEL(pos.cx), CLICK_TO_PIXEL(pos.cy), size);
 }
 
 int Send_trans(connection_t *connp, clpos_t pos1, clpos_t pos2)
 {
-    return Packet_printf(&connp->w,"%c%hd%hd%hd%hd", PKT_TRANS,
-			 CLICK_TO_PIXEL(pos1.cx), CLICK_TO_PIXEL(pos1.cy),
-			 CLICK_TO_PIXEL(pos2.cx), CLICK_TO_PIXEL(pos2.cy));
+    return Packet_put_trans(&connp->w,
+			    CLICK_TO_PIXEL(pos1.cx), CLICK_TO_PIXEL(pos1.cy),
+			    CLICK_TO_PIXEL(pos2.cx), CLICK_TO_PIXEL(pos2.cy));
 }
 
 int Send_ship(connection_t *connp, clpos_t pos, int id, int dir,
@@ -1917,44 +2077,38 @@ int Send_ship(connection_t *connp, clpos_t pos, int id, int dir,
 {
     if (!FEATURE(connp, F_SEPARATEPHASING))
 	cloak |= phased;
-    return Packet_printf(&connp->w,
-			 "%c%hd%hd%hd" "%c" "%c",
-			 PKT_SHIP,
-			 CLICK_TO_PIXEL(pos.cx), CLICK_TO_PIXEL(pos.cy), id,
-			 dir,
-			 (shield != 0)
-			 | ((cloak != 0) << 1)
-			 | ((emergency_shield != 0) << 2)
-			 | ((phased != 0) << 3)
-			 | ((deflector != 0) << 4)
-			);
+    return Packet_put_ship(&connp->w,
+			   CLICK_TO_PIXEL(pos.cx), CLICK_TO_PIXEL(pos.cy), id,
+			   dir,
+			   (shield != 0)
+			   | ((cloak != 0) << 1)
+			   | ((emergency_shield != 0) << 2)
+			   | ((phased != 0) << 3)
+			   | ((deflector != 0) << 4)
+			  );
 }
 
 int Send_refuel(connection_t *connp, clpos_t pos1, clpos_t pos2)
 {
-    return Packet_printf(&connp->w,
-			 "%c%hd%hd%hd%hd",
-			 PKT_REFUEL,
-			 CLICK_TO_PIXEL(pos1.cx), CLICK_TO_PIXEL(pos1.cy),
-			 CLICK_TO_PIXEL(pos2.cx), CLICK_TO_PIXEL(pos2.cy));
+    return Packet_put_refuel(&connp->w,
+			     CLICK_TO_PIXEL(pos1.cx), CLICK_TO_PIXEL(pos1.cy),
+			     CLICK_TO_PIXEL(pos2.cx), CLICK_TO_PIXEL(pos2.cy));
 }
 
 int Send_connector(connection_t *connp, clpos_t pos1, clpos_t pos2,
 		   int tractor)
 {
-    return Packet_printf(&connp->w,
-			 "%c%hd%hd%hd%hd%c",
-			 PKT_CONNECTOR,
-			 CLICK_TO_PIXEL(pos1.cx), CLICK_TO_PIXEL(pos1.cy),
-			 CLICK_TO_PIXEL(pos2.cx), CLICK_TO_PIXEL(pos2.cy),
-			 tractor);
+    return Packet_put_connector(&connp->w,
+				CLICK_TO_PIXEL(pos1.cx), CLICK_TO_PIXEL(pos1.cy),
+				CLICK_TO_PIXEL(pos2.cx), CLICK_TO_PIXEL(pos2.cy),
+				tractor);
 }
 
 int Send_laser(connection_t *connp, int color, clpos_t pos, int len, int dir)
 {
-    return Packet_printf(&connp->w, "%c%c%hd%hd%hd%c", PKT_LASER,
-			 color, CLICK_TO_PIXEL(pos.cx), CLICK_TO_PIXEL(pos.cy),
-			 len, dir);
+    return Packet_put_laser(&connp->w, color,
+			    CLICK_TO_PIXEL(pos.cx), CLICK_TO_PIXEL(pos.cy),
+			    len, dir);
 }
 
 int Send_radar(connection_t *connp, int x, int y, int size)
@@ -1962,7 +2116,7 @@ int Send_radar(connection_t *connp, int x, int y, int size)
     if (!FEATURE(connp, F_TEAMRADAR))
 	size &= ~0x80;
 
-    return Packet_printf(&connp->w, "%c%hd%hd%c", PKT_RADAR, x, y, size);
+    return Packet_put_radar(&connp->w, x, y, size);
 }
 
 int Send_fastradar(connection_t *connp, unsigned char *buf, unsigned n)
@@ -1991,7 +2145,7 @@ int Send_fastradar(connection_t *connp, unsigned char *buf, unsigned n)
 
 int Send_damaged(connection_t *connp, int damaged)
 {
-    return Packet_printf(&connp->w, "%c%c", PKT_DAMAGED, damaged);
+    return Packet_put_damaged(&connp->w, damaged);
 }
 
 int Send_audio(connection_t *connp, int type, int vol)
@@ -2008,7 +2162,7 @@ int Send_time_left(connection_t *connp, long sec)
 
 int Send_eyes(connection_t *connp, int id)
 {
-    return Packet_printf(&connp->w, "%c%hd", PKT_EYES, id);
+    return Packet_put_eyes(&connp->w, id);
 }
 
 int Send_message(connection_t *connp, const char *msg)
@@ -2039,9 +2193,8 @@ int Send_start_of_frame(connection_t *connp)
      * which keyboard update we have last received.
      */
     Sockbuf_clear(&connp->w);
-    if (Packet_printf(&connp->w,
-		      "%c%ld%ld",
-		      PKT_START, frame_loops, connp->last_key_change) <= 0) {
+    if (Packet_put_start(&connp->w,
+			 frame_loops, connp->last_key_change) <= 0) {
 	Destroy_connection(connp, "write error");
 	return -1;
     }
@@ -2050,12 +2203,54 @@ int Send_start_of_frame(connection_t *connp)
     return 0;
 }
 
+/*
+ * Write the datagram in connp->w and count it for the frame governor.
+ * Returns like Sockbuf_flushRec().
+ */
+static int Send_flush(connection_t *connp)
+{
+    connp->gov.bytes += connp->w.len;
+    return Sockbuf_flushRec(&connp->w);
+}
+
+/*
+ * Remember the packets of the frame after the start of frame packet,
+ * and replace them with a delta against the last frame the client
+ * has acknowledged if that is smaller.
+ */
+static void Send_delta_frame(connection_t *connp)
+{
+    static unsigned char delta[DELTA_FRAME_SIZE];
+    const int start = 1 PF_START(PF_SIZE);
+    const unsigned char *base;
+    unsigned char *buf = (unsigned char *)connp->w.buf + start;
+    int n = -1, base_len, len = connp->w.len - start;
+
+    if (len <= 0 || !options.deltaFrames)
+	return;
+
+    base = Delta_find(&connp->delta, connp->delta_ack, &base_len);
+    if (base != NULL)
+	n = Delta_encode(base, base_len, buf, len, delta,
+			 len - (1 PF_DELTA(PF_SIZE)) - 1);
+    Delta_store(&connp->delta, frame_loops, buf, len);
+    if (n < 0)
+	return;
+
+    connp->w.len = start;
+    Packet_put_delta_frame(&connp->w, connp->delta_ack, n);
+    Sockbuf_write(&connp->w, (char *)delta, n);
+}
+
 int Send_end_of_frame(connection_t *connp)
 {
     int			n;
 
+    if (FEATURE(connp, F_DELTAFRAME))
+	Send_delta_frame(connp);
+
     last_packet_of_frame = 1;
-    n = Packet_printf(&connp->w, "%c%ld", PKT_END, frame_loops);
+    n = Packet_put_end(&connp->w, frame_loops);
     last_packet_of_frame = 0;
     if (n == -1) {
 	Destroy_connection(connp, "write error");
@@ -2069,6 +2264,7 @@ int Send_end_of_frame(connection_t *connp)
 	Sockbuf_clear(&connp->w);
 	return 0;
     }
+    connp->gov.frames[0]++;
     while (connp->motd_offset >= 0
 	&& connp->c.len + connp->w.len < MAX_RELIABLE_DATA_PACKET_SIZE)
 	Send_motd(connp);
@@ -2079,7 +2275,7 @@ int Send_end_of_frame(connection_t *connp)
 	if (connp->w.len == 0)
 	    return 1;
     }
-    if (Sockbuf_flushRec(&connp->w) == -1) {
+    if (Send_flush(connp) == -1) {
 	Destroy_connection(connp, "flush error");
 	return -1;
     }
@@ -2091,7 +2287,6 @@ static int Receive_keyboard(connection_t *connp)
 {
     player_t *pl;
     long change;
-    u_byte ch;
     size_t size = KEYBOARD_SIZE;
 
     if (connp->r.ptr - connp->r.buf + (int)size + 1 + 4 > connp->r.len)
@@ -2100,7 +2295,7 @@ static int Receive_keyboard(connection_t *connp)
 	 */
 	return 0;
 
-    Packet_scanf(&connp->r, "%c%ld", &ch, &change);
+    Packet_get_keyboard(&connp->r, &change);
     if (change <= connp->last_key_change)
 	/*
 	 * We already have this key.
@@ -2228,6 +2423,132 @@ static int Receive_power(connection_t *connp)
     return 1;
 }
 
+/*
+ * Send a segment of the reliable data, after the frame update if
+ * there is one and the segment fits with it.  Returns the length,
+ * 0 if the socket is full or -1 if the connection was destroyed.
+ */
+static int Send_reliable_segment(connection_t *connp, long off, int len)
+{
+    int n;
+
+    if (connp->w.len > 0
+	&& connp->w.len + len > MAX_RELIABLE_DATA_PACKET_SIZE) {
+	/* Send the frame update by itself. */
+	if (Send_flush(connp) == -1) {
+	    Destroy_connection(connp, "flush error");
+	    return -1;
+	}
+	Sockbuf_clear(&connp->w);
+    }
+    if (Packet_printf(&connp->w, "%c%hd%ld%ld", PKT_RELIABLE,
+		      len, off, main_loops) <= 0
+	|| Sockbuf_write(&connp->w,
+			 connp->c.buf + (off - connp->reliable_offset),
+			 len) != len) {
+	error("Cannot write reliable data");
+	Destroy_connection(connp, "write error");
+	return -1;
+    }
+    if ((n = Send_flush(connp)) < len) {
+	if (n == 0
+	    && (errno == EWOULDBLOCK
+		|| errno == EAGAIN)) {
+	    Sockbuf_clear(&connp->w);
+	    return 0;
+	}
+	error("Cannot flush reliable data (%d)", n);
+	Destroy_connection(connp, "flush error");
+	return -1;
+    }
+    return len;
+}
+
+/*
+ * Send the reliable data to a client which acknowledges it selectively.
+ * First the segments which were lost or have timed out are sent again,
+ * then new data, as long as the data in flight fits in the congestion
+ * window.  That window grows and shrinks like the one of TCP does,
+ * see Receive_sack().
+ */
+static int Send_reliable_window(connection_t *connp)
+{
+    sack_window_t *sw = &connp->sack;
+    sack_segment_t *s;
+    int i, n, len, flight = 0, sent = 0;
+    long off, end;
+    bool timeout = false;
+
+    /* Data which is neither acknowledged nor taken as lost. */
+    for (i = 0; i < sw->num; i++) {
+	s = &sw->seg[(sw->first + i) % SACK_SEGMENTS];
+	if (!s->sacked && !s->resend && s->retransmit_at > main_loops)
+	    flight += s->len;
+    }
+
+    for (i = 0; i < sw->num; i++) {
+	s = &sw->seg[(sw->first + i) % SACK_SEGMENTS];
+	if (s->sacked || (!s->resend && s->retransmit_at > main_loops))
+	    continue;
+	if (!s->resend && !timeout) {
+	    /*
+	     * Timeout.  Start again from one segment and
+	     * back off the retransmission timer.
+	     */
+	    timeout = true;
+	    sw->ssthresh = MAX(sw->cwnd / 2, 2 * MAX_RELIABLE_DATA_PACKET_SIZE);
+	    sw->cwnd = MAX_RELIABLE_DATA_PACKET_SIZE;
+	    sw->recover = connp->reliable_unsent;
+	    connp->rtt_retransmit <<= 1;
+	    if (connp->rtt_retransmit > MAX_RETRANSMIT)
+		connp->rtt_retransmit = MAX_RETRANSMIT;
+	    connp->rtt_timeouts++;
+	    connp->gov.lost++;
+	}
+	if (flight > 0 && flight + s->len > sw->cwnd)
+	    break;
+	if ((n = Send_reliable_segment(connp, s->offset, s->len)) == -1)
+	    return -1;
+	if (n == 0)
+	    break;
+	s->resend = false;
+	s->retransmit_at = main_loops + SACK_RETRANSMIT(connp);
+	flight += s->len;
+	sent += s->len;
+    }
+
+    off = MAX(connp->reliable_unsent, connp->reliable_offset);
+    end = connp->reliable_offset + MIN(connp->c.len, RELIABLE_WINDOW);
+    while (off < end && sw->num < SACK_SEGMENTS && flight < sw->cwnd) {
+	len = MIN(end - off, MAX_RELIABLE_DATA_PACKET_SIZE);
+	if (connp->w.len > 0
+	    && connp->w.len < MAX_RELIABLE_DATA_PACKET_SIZE - 1)
+	    /* Piggyback on the frame update. */
+	    len = MIN(len, MAX_RELIABLE_DATA_PACKET_SIZE - connp->w.len);
+	if ((n = Send_reliable_segment(connp, off, len)) == -1)
+	    return -1;
+	if (n == 0)
+	    break;
+	s = &sw->seg[(sw->first + sw->num++) % SACK_SEGMENTS];
+	s->offset = off;
+	s->len = len;
+	s->retransmit_at = main_loops + SACK_RETRANSMIT(connp);
+	s->sacked = s->resend = s->fast = false;
+	off += len;
+	flight += len;
+	sent += len;
+    }
+    if (off > connp->reliable_unsent)
+	connp->reliable_unsent = off;
+
+    /* Else the frame update is still to be sent. */
+    if (sent > 0)
+	Sockbuf_clear(&connp->w);
+    connp->last_send_loops = main_loops;
+
+    return sent;
+}
+
 /*
  * Send the reliable data.
  * If the client is in the receive-frame-updates state then
@@ -2239,6 +2560,8 @@ static int Receive_power(connection_t *connp)
  * is no other data to combine it with.
  *
  * This thing still is not finished, but it works better than in 3.0.0 I hope.
+ * Clients which acknowledge selectively get the data through
+ * Send_reliable_window() instead.
  */
 int Send_reliable(connection_t *connp)
 {
@@ -2253,6 +2576,8 @@ int Send_reliable(connection_t *connp)
 	connp->last_send_loops = main_loops;
 	return 0;
     }
+    if (FEATURE(connp, F_SACK))
+	return Send_reliable_window(connp);
     read_buf = connp->c.buf;
     max_todo = connp->c.len;
     rel_off = connp->reliable_offset;
@@ -2279,13 +2604,15 @@ int Send_reliable(connection_t *connp)
 	     */
 	    return 0;
     }
-    else if (connp->retransmit_at_loop != 0)
+    else if (connp->retransmit_at_loop != 0) {
 	/*
 	 * Timeout.
 	 * Either our packet or the acknowledgement got lost,
 	 * so retransmit.
 	 */
 	connp->acks >>= 1;
+	connp->gov.lost++;
+    }
 
     todo = max_todo;
     for (i = 0; i <= connp->acks && todo > 0; i++) {
@@ -2297,7 +2624,7 @@ int Send_reliable(connection_t *connp)
 	    Destroy_connection(connp, "write error");
 	    return -1;
 	}
-	if ((n = Sockbuf_flushRec(&connp->w)) < len) {
+	if ((n = Send_flush(connp)) < len) {
 	    if (n == 0
 		&& (errno == EWOULDBLOCK
 		    || errno == EAGAIN)) {
@@ -2345,24 +2672,14 @@ int Send_reliable(connection_t *connp)
     return (max_todo - todo);
 }
 
-static int Receive_ack(connection_t *connp)
+/*
+ * Update the roundtrip time estimate with an acknowledgement
+ * of a reliable data packet sent at rel_loops.
+ */
+static void Rtt_update(connection_t *connp, long rel_loops)
 {
-    int n;
-    unsigned char ch;
-    long rel, rtt;	/* RoundTrip Time */
-    long diff, delta, rel_loops;
-    
-    if ((n = Packet_scanf(&connp->r, "%c%ld%ld",
-			  &ch, &rel, &rel_loops)) <= 0) {
-	warn("Cannot read ack packet (%d)", n);
-	Destroy_connection(connp, "read error");
-	return -1;
-    }
-    if (ch != PKT_ACK) {
-	warn("Not an ack packet (%d)", ch);
-	Destroy_connection(connp, "not ack");
-	return -1;
-    }
+    long rtt, delta;	/* RoundTrip Time */
+
     rtt = main_loops - rel_loops;
     if (rtt > 0 && rtt <= MAX_RTT) {
 	/*
@@ -2408,6 +2725,16 @@ static int Receive_ack(connection_t *connp)
 	if (connp->rtt_retransmit < MIN_RETRANSMIT)
 	    connp->rtt_retransmit = MIN_RETRANSMIT;
     }
+}
+
+/*
+ * The client has all reliable data before rel.
+ */
+static int Reliable_acked(connection_t *connp, long rel)
+{
+    int n;
+    long diff;
+
     diff = rel - connp->reliable_offset;
     if (diff > connp->c.len) {
 	/* Impossible to ack data that has not been send */
@@ -2447,6 +2774,124 @@ static int Receive_ack(connection_t *connp)
     return 1;
 }
 
+static int Receive_ack(connection_t *connp)
+{
+    int n;
+    unsigned char ch;
+    long rel, rel_loops;
+
+    ch = connp->r.ptr[0];
+    if ((n = Packet_get_ack(&connp->r, &rel, &rel_loops)) <= 0) {
+	warn("Cannot read ack packet (%d)", n);
+	Destroy_connection(connp, "read error");
+	return -1;
+    }
+    if (ch != PKT_ACK) {
+	warn("Not an ack packet (%d)", ch);
+	Destroy_connection(connp, "not ack");
+	return -1;
+    }
+    Rtt_update(connp, rel_loops);
+
+    return Reliable_acked(connp, rel);
+}
+
+/*
+ * Selective acknowledgement, the client has the reliable data before
+ * rel and the blocks of data after it.
+ */
+static int Receive_sack(connection_t *connp)
+{
+    sack_window_t *sw = &connp->sack;
+    sack_segment_t *s;
+    unsigned char ch, num;
+    long rel, rel_loops, start[SACK_BLOCKS], end[SACK_BLOCKS];
+    int i, j, n, later, acked = 0;
+
+    if ((n = Packet_scanf(&connp->r, "%c%ld%ld%c",
+			  &ch, &rel, &rel_loops, &num)) <= 0
+	|| num > SACK_BLOCKS) {
+	warn("Cannot read sack packet (%d)", n);
+	Destroy_connection(connp, "read error");
+	return -1;
+    }
+    for (i = 0; i < num; i++) {
+	if ((n = Packet_scanf(&connp->r, "%ld%ld",
+			      &start[i], &end[i])) <= 0) {
+	    warn("Cannot read sack block (%d)", n);
+	    Destroy_connection(connp, "read error");
+	    return -1;
+	}
+    }
+    if (!FEATURE(connp, F_SACK)) {
+	warn("Sack packet from old client (%04x)", connp->version);
+	Destroy_connection(connp, "not sack");
+	return -1;
+    }
+    Rtt_update(connp, rel_loops);
+
+    /* Forget the segments which the client has in order. */
+    while (sw->num > 0) {
+	s = &sw->seg[sw->first];
+	if (s->offset + s->len > rel) {
+	    if (s->offset < rel) {
+		s->len -= rel - s->offset;
+		s->offset = rel;
+	    }
+	    break;
+	}
+	if (!s->sacked)
+	    acked += s->len;
+	sw->first = (sw->first + 1) % SACK_SEGMENTS;
+	sw->num--;
+    }
+
+    for (i = 0; i < num; i++) {
+	for (j = 0; j < sw->num; j++) {
+	    s = &sw->seg[(sw->first + j) % SACK_SEGMENTS];
+	    if (!s->sacked
+		&& s->offset >= start[i]
+		&& s->offset + s->len <= end[i]) {
+		s->sacked = true;
+		acked += s->len;
+	    }
+	}
+    }
+
+    /*
+     * A segment is lost if SACK_LOST_AFTER segments sent after it
+     * have arrived.  Send it again at once, but only once, and halve
+     * the window unless this loss happened during an earlier one.
+     */
+    for (later = 0, j = sw->num - 1; j >= 0; j--) {
+	s = &sw->seg[(sw->first + j) % SACK_SEGMENTS];
+	if (s->sacked)
+	    later++;
+	else if (later >= SACK_LOST_AFTER && !s->fast) {
+	    s->fast = s->resend = true;
+	    if (rel >= sw->recover) {
+		sw->ssthresh = MAX(sw->cwnd / 2,
+				   2 * MAX_RELIABLE_DATA_PACKET_SIZE);
+		sw->cwnd = sw->ssthresh;
+		sw->recover = connp->reliable_unsent;
+	    }
+	}
+    }
+
+    /* Open the window, by what arrived during slow start. */
+    if (acked > 0) {
+	if (sw->cwnd < sw->ssthresh)
+	    sw->cwnd += acked;
+	else
+	    sw->cwnd += MAX(1, MAX_RELIABLE_DATA_PACKET_SIZE * acked
+			    / sw->cwnd);
+	if (sw->cwnd > RELIABLE_WINDOW)
+	    sw->cwnd = RELIABLE_WINDOW;
+    }
+
+    return Reliable_acked(connp, rel);
+}
+
 static int Receive_discard(connection_t *connp)
 {
     warn("Discarding packet %d while in state %02x",
@@ -2483,7 +2928,8 @@ static int Receive_ack_cannon(connection_t *connp)
     }
     cannon = Cannon_by_index(num);
     if (loops_ack > cannon->last_change)
-	SET_BIT(cannon->conn_mask, 1 << connp->ind);
+	SET_BIT(cannon->conn_mask[CONN_MASK_WORD(connp->ind)],
+		CONN_MASK_BIT(connp->ind));
 
     return 1;
 }
@@ -2508,7 +2954,8 @@ static int Receive_ack_fuel(connection_t *connp)
     }
     fs = Fuel_by_index(num);
     if (loops_ack > fs->last_change)
-	SET_BIT(fs->conn_mask, 1 << connp->ind);
+	SET_BIT(fs->conn_mask[CONN_MASK_WORD(connp->ind)],
+		CONN_MASK_BIT(connp->ind));
     return 1;
 }
 
@@ -2544,8 +2991,10 @@ static int Receive_ack_target(connection_t *connp)
      */
     targ = Target_by_index(num);
     if (loops_ack > targ->last_change) {
-	SET_BIT(targ->conn_mask, 1 << connp->ind);
-	CLR_BIT(targ->update_mask, 1 << connp->ind);
+	SET_BIT(targ->conn_mask[CONN_MASK_WORD(connp->ind)],
+		CONN_MASK_BIT(connp->ind));
+	CLR_BIT(targ->update_mask[CONN_MASK_WORD(connp->ind)],
+		CONN_MASK_BIT(connp->ind));
     }
     return 1;
 }
@@ -2570,7 +3019,34 @@ static int Receive_ack_polystyle(connection_t *connp)
     }
     poly = &pdata[num];
     if (loops_ack > poly->last_change)
-	CLR_BIT(poly->update_mask, 1 << connp->ind);
+	CLR_BIT(poly->update_mask[CONN_MASK_WORD(connp->ind)],
+		CONN_MASK_BIT(connp->ind));
+    return 1;
+}
+
+/*
+ * The client has all of a frame, later frames may be sent
+ * as deltas against it.
+ */
+static int Receive_ack_frame(connection_t *connp)
+{
+    long loops_ack;
+    int n;
+
+    if ((n = Packet_get_ack_frame(&connp->r, &loops_ack)) <= 0) {
+	if (n == -1)
+	    Destroy_connection(connp, "read error");
+	return n;
+    }
+    if (loops_ack > connp->delta_ack && loops_ack <= frame_loops)
+	connp->delta_ack = loops_ack;
+    if (loops_ack <= frame_loops) {
+	if (loops_ack >= connp->gov.start[0])
+	    connp->gov.acked[0]++;
+	else if (loops_ack >= connp->gov.start[1])
+	    connp->gov.acked[1]++;
+    }
+
     return 1;
 }
 
@@ -2744,13 +3220,106 @@ static int Receive_modifier_bank(connection_t *connp)
     return 1;
 }
 
+/*
+ * The frame governor.  Once a second it looks at how many bytes were
+ * sent to a connection and how many of its frames or reliable data
+ * got lost.  Clients with delta frames acknowledge every frame, for
+ * the others only reliable data timeouts tell about losses.  If more
+ * was sent than the frameBandwidth option allows or something was
+ * lost the level goes up, and when there is room below it the level
+ * comes back down one step at a time.  Higher levels show fewer
+ * sparks, leave shots off the radar and then send fewer frames,
+ * spaced evenly, so that a slow link gets a smooth picture instead
+ * of bursts of lost frames.
+ */
+static const int gov_frame_share[GOV_LEVELS] = {	/* in 16ths */
+    16, 16, 16, 14, 12, 10, 8, 6, 4
+};
+static const int gov_spark_share[GOV_LEVELS] = {	/* in 16ths */
+    16, 10, 6, 4, 4, 2, 2, 1, 1
+};
+
+#define GOV_MAX_LOSS		5	/* percent of frames */
+
+static void Governor_update(connection_t *connp)
+{
+    governor_t *gov = &connp->gov;
+    long loops = frame_loops - gov->start[0];
+    bool lossy;
+
+    gov->rate = (int)(gov->bytes * FPS / MAX(loops, 1));
+    if (FEATURE(connp, F_DELTAFRAME) && gov->frames[1] > 0)
+	gov->loss = 100 * MAX(gov->frames[1] - gov->acked[1], 0)
+	    / gov->frames[1];
+    else
+	gov->loss = 0;
+    lossy = (gov->loss >= GOV_MAX_LOSS || gov->lost > 0);
+
+    if (lossy || gov->rate > options.frameBandwidth)
+	gov->level = MIN(gov->level + (lossy ? 2 : 1), GOV_LEVELS - 1);
+    else if (gov->level > 0
+	     && (double)gov->rate * gov_frame_share[gov->level - 1]
+	     < 0.8 * options.frameBandwidth * gov_frame_share[gov->level])
+	gov->level--;
+
+    gov->start[1] = gov->start[0];
+    gov->frames[1] = gov->frames[0];
+    gov->acked[1] = gov->acked[0];
+    gov->start[0] = frame_loops;
+    gov->frames[0] = 0;
+    gov->acked[0] = 0;
+    gov->bytes = 0;
+    gov->lost = 0;
+}
+
+/*
+ * Returns true if a frame should be sent to the connection now.
+ */
+bool Governor_frame(connection_t *connp)
+{
+    governor_t *gov = &connp->gov;
+
+    if (options.frameBandwidth <= 0) {
+	gov->level = 0;
+	return true;
+    }
+    if (frame_loops - gov->start[0] >= FPS)
+	Governor_update(connp);
+    gov->credit += gov_frame_share[gov->level];
+    if (gov->credit < 16)
+	return false;
+    gov->credit -= 16;
+    return true;
+}
+
+void Governor_status(connection_t *connp, char *buf, size_t size)
+{
+    governor_t *gov = &connp->gov;
+
+    if (options.frameBandwidth <= 0) {
+	strlcpy(buf, "off", size);
+	return;
+    }
+    snprintf(buf, size,
+	     "level %d of %d, %d%% of frames, %d%% of sparks, "
+	     "shots %s radar, %d of %d bytes/s, %d%% lost",
+	     gov->level, GOV_LEVELS - 1,
+	     100 * gov_frame_share[gov->level] / 16,
+	     100 * gov_spark_share[gov->level] / 16,
+	     (gov->level < GOV_RADAR_LEVEL) ? "on" : "off",
+	     gov->rate, options.frameBandwidth, gov->loss);
+}
+
 void Get_display_parameters(connection_t *connp, int *width, int *height,
 			    int *debris_colors, int *spark_rand)
 {
     *width = connp->view_width;
     *height = connp->view_height;
     *debris_colors = connp->debris_colors;
-    *spark_rand = connp->spark_rand;
+    *spark_rand = connp->spark_rand * gov_spark_share[connp->gov.level] / 16;
+    /* Zero would also hide wreckage. */
+    if (connp->spark_rand > 0 && *spark_rand == 0)
+	*spark_rand = 1;
 }
 
 int Get_player_id(connection_t *connp)
@@ -2942,12 +3511,11 @@ static int Send_motd(connection_t *connp)
 static int Receive_pointer_move(connection_t *connp)
 {
     player_t *pl;
-    unsigned char ch;
     short movement;
     int n;
     double turnspeed, turndir;
 
-    if ((n = Packet_scanf(&connp->r, "%c%hd", &ch, &movement)) <= 0) {
+    if ((n = Packet_get_pointer_move(&connp->r, &movement)) <= 0) {
 	if (n == -1)
 	    Destroy_connection(connp, "read error");
 	return n;
@@ -93,6 +93,8 @@ int Send_eyes(connection_t *connp, int id);
 int Send_trans(connection_t *connp, clpos_t pos1, clpos_t pos2);
 void Get_display_parameters(connection_t *connp, int *width, int *height,
 			    int *debris_colors, int *spark_rand);
+bool Governor_frame(connection_t *connp);
+void Governor_status(connection_t *connp, char *buf, size_t size);
 int Get_player_id(connection_t *connp);
 const char *Player_get_addr(player_t *pl);
 const char *Player_get_dpy(player_t *pl);
@@ -112,5 +114,7 @@ int Check_max_clients_per_IP(char *host_addr);
 #define F_CUMULATIVETURN	(1 << 9)
 #define F_BALLSTYLE		(1 << 10)
 #define F_POLYSTYLE		(1 << 11)
+#define F_DELTAFRAME		(1 << 12)
+#define F_SACK			(1 << 13)
 
 #endif
@@ -33,44 +33,231 @@
  * Global variables
  */
 int			ObjCount = 0;
-object_t		*Obj[MAX_TOTAL_SHOTS];
+int			ObjMax = 0;
+object_t		**Obj;
 
 
-static void Object_incr_count(void)
+/*
+ * Objects come from one pool per size class, so that a spark doesn't
+ * take as much memory as a ball.  A pool grows a slab at a time when
+ * its free list runs out, until all pools together would use more than
+ * options.maxObjectMemory megabytes.  Freed objects go to the front of
+ * their pool's free list and are used again first, the same way freed
+ * slots at the end of Obj[] used to be.
+ *
+ * Slabs are kept until the game ends, so each pool has a few slabs
+ * reserved which the other pools can't take.  Otherwise a big nuke
+ * could use up all the memory for debris and there would be no room
+ * for a single shot or mine afterwards.
+ */
+#define OBJ_POOL_SLAB	256	/* objects per slab */
+#define OBJ_POOL_RESERVE 8	/* 1/8 of the memory is reserved */
+
+enum {
+    POOL_DEBRIS,
+    POOL_SHOT,
+    POOL_MISSILE,
+    POOL_MINE,
+    POOL_BALL,
+    POOL_WIRE,
+    POOL_PULSE,
+    POOL_ITEM,
+    NUM_OBJ_POOLS
+};
+
+typedef struct {
+    const char	*name;
+    size_t	size;		/* bytes per object */
+    int		num;		/* objects in use */
+    int		high;		/* high-water mark of num */
+    int		total;		/* objects in slabs */
+    object_t	**free;		/* free objects, last one is used next */
+    int		num_free;
+    void	**slabs;
+    int		num_slabs;
+    int		reserve;	/* slabs kept for this pool */
+} obj_pool_t;
+
+#define MAX3(a, b, c)	MAX(MAX(a, b), c)
+
+static obj_pool_t obj_pools[NUM_OBJ_POOLS] = {
+    { "debris",	sizeof(object_t) },
+    { "shot",	sizeof(object_t) },
+    { "missile", MAX3(sizeof(smartobject_t), sizeof(torpobject_t),
+		      sizeof(heatobject_t)) },
+    { "mine",	sizeof(mineobject_t) },
+    { "ball",	sizeof(ballobject_t) },
+    { "wire",	sizeof(wireobject_t) },
+    { "pulse",	sizeof(pulseobject_t) },
+    { "item",	sizeof(itemobject_t) },
+};
+
+static size_t obj_pool_bytes;	/* memory in all slabs */
+static size_t obj_pool_limit;	/* options.maxObjectMemory in bytes */
+static size_t obj_pool_reserved; /* reserved memory not in slabs yet */
+
+static int Object_pool_by_type(int type)
 {
-    ObjCount++;
+    switch (type) {
+    case OBJ_DEBRIS:
+    case OBJ_SPARK:
+	return POOL_DEBRIS;
+    case OBJ_SHOT:
+    case OBJ_CANNON_SHOT:
+	return POOL_SHOT;
+    case OBJ_SMART_SHOT:
+    case OBJ_HEAT_SHOT:
+    case OBJ_TORPEDO:
+	return POOL_MISSILE;
+    case OBJ_MINE:
+	return POOL_MINE;
+    case OBJ_BALL:
+	return POOL_BALL;
+    case OBJ_WRECKAGE:
+    case OBJ_ASTEROID:
+	return POOL_WIRE;
+    case OBJ_PULSE:
+	return POOL_PULSE;
+    case OBJ_ITEM:
+	return POOL_ITEM;
+    default:
+	warn("Object_pool_by_type: unknown object type %d.", type);
+	return POOL_DEBRIS;
+    }
+}
+
+static bool Object_pool_grow(obj_pool_t *pool)
+{
+    size_t bytes = pool->size * OBJ_POOL_SLAB;
+    char *slab;
+    void **slabs;
+    object_t **free_objs;
+    int i;
+
+    if (pool->num_slabs >= pool->reserve
+	&& obj_pool_bytes + obj_pool_reserved + bytes > obj_pool_limit)
+	return false;
+
+    slabs = (void **) realloc(pool->slabs,
+			      (pool->num_slabs + 1) * sizeof(void *));
+    if (slabs == NULL)
+	return false;
+    pool->slabs = slabs;
+
+    free_objs = (object_t **) realloc(pool->free,
+				      (pool->total + OBJ_POOL_SLAB)
+				      * sizeof(object_t *));
+    if (free_objs == NULL)
+	return false;
+    pool->free = free_objs;
+
+    if ((slab = (char *) calloc(OBJ_POOL_SLAB, pool->size)) == NULL)
+	return false;
+    if (pool->num_slabs < pool->reserve)
+	obj_pool_reserved -= bytes;
+    pool->slabs[pool->num_slabs++] = slab;
+    pool->total += OBJ_POOL_SLAB;
+    obj_pool_bytes += bytes;
+
+    /* lowest address on top, so that a new slab is used front to back */
+    for (i = OBJ_POOL_SLAB - 1; i >= 0; i--) {
+	object_t *obj = (object_t *) (slab + i * pool->size);
+
+	obj->pool = pool - obj_pools;
+	Cell_init_object(obj);
+	pool->free[pool->num_free++] = obj;
+    }
+
+    return true;
 }
 
-static void Object_decr_count(void)
+/*
+ * How many more objects of this type can be allocated right now.
+ */
+int Object_room(int type)
 {
-    ObjCount--;
+    obj_pool_t *pool = &obj_pools[Object_pool_by_type(type)];
+    size_t used = obj_pool_bytes + obj_pool_reserved;
+    int slabs = MAX(pool->reserve - pool->num_slabs, 0);
+    int room = pool->num_free;
+
+    if (used < obj_pool_limit)
+	slabs += (int)((obj_pool_limit - used)
+		       / (pool->size * OBJ_POOL_SLAB));
+    room += slabs * OBJ_POOL_SLAB;
+
+    return MIN(room, ObjMax - ObjCount);
 }
 
-object_t *Object_allocate(void)
+object_t *Object_allocate(int type)
 {
-    object_t	*obj = OBJ_PTR(NULL);
+    obj_pool_t *pool = &obj_pools[Object_pool_by_type(type)];
+    object_t *obj;
 
-    if (ObjCount < MAX_TOTAL_SHOTS) {
-	obj = Obj[ObjCount];
-	Object_incr_count();
+    if (ObjCount >= ObjMax)
+	return NULL;
+    if (pool->num_free == 0 && !Object_pool_grow(pool))
+	return NULL;
 
-	obj->type = OBJ_DEBRIS;
-	obj->life = 0;
-    }
+    obj = pool->free[--pool->num_free];
+    if (++pool->num > pool->high)
+	pool->high = pool->num;
+    Obj[ObjCount++] = obj;
+
+    obj->type = type;
+    obj->life = 0;
 
     return obj;
 }
 
+/*
+ * Allocate up to num objects of one type into objs, in the same order
+ * and from the same slots as that many Object_allocate() calls.
+ * Unlike Object_allocate() the objects are not touched at all, the
+ * caller sets type and life along with everything else, so a big
+ * batch is only brought into the cache once.
+ * Returns how many were allocated.
+ */
+int Object_allocate_many(int type, object_t **objs, int num)
+{
+    obj_pool_t *pool = &obj_pools[Object_pool_by_type(type)];
+    object_t *obj;
+    int i, k, done = 0;
+
+    num = MIN(num, ObjMax - ObjCount);
+
+    while (done < num) {
+	if (pool->num_free == 0 && !Object_pool_grow(pool))
+	    break;
+
+	k = MIN(num - done, pool->num_free);
+	for (i = 0; i < k; i++) {
+	    obj = pool->free[--pool->num_free];
+	    objs[done + i] = obj;
+	    Obj[ObjCount + i] = obj;
+	}
+	ObjCount += k;
+	done += k;
+    }
+
+    pool->num += done;
+    if (pool->num > pool->high)
+	pool->high = pool->num;
+
+    return done;
+}
+
 void Object_free_ind(int ind)
 {
-    if ((0 <= ind) && (ind < ObjCount) && (ObjCount <= MAX_TOTAL_SHOTS)) {
+    if ((0 <= ind) && (ind < ObjCount)) {
 	object_t *obj = Obj[ind];
-	Object_decr_count();
-	Obj[ind] = Obj[ObjCount];
-	Obj[ObjCount] = obj;
+	obj_pool_t *pool = &obj_pools[obj->pool];
+
+	Obj[ind] = Obj[--ObjCount];
+	pool->num--;
+	pool->free[pool->num_free++] = obj;
     } else
-	warn("Cannot free object %d, when count = %d, and total = %d !",
-	     ind, ObjCount, MAX_TOTAL_SHOTS);
+	warn("Cannot free object %d, when count = %d !", ind, ObjCount);
 }
 
 void Object_free_ptr(object_t *obj)
@@ -87,49 +274,74 @@ void Object_free_ptr(object_t *obj)
 	warn("Could NOT free object!");
 }
 
-static anyobject_t *objArray;
+/*
+ * Obj[] has room for as many of the smallest objects as fit in the
+ * memory limit.  It is never reallocated because many loops walk it
+ * directly while objects are being made.
+ */
+void Alloc_shots(void)
+{
+    int i;
+
+    obj_pool_limit = (size_t) MAX(options.maxObjectMemory, 1) << 20;
+    ObjMax = (int) MIN(obj_pool_limit / sizeof(object_t), INT_MAX / 2);
 
-#define SHOWTYPESIZE(T) warn("sizeof(" #T ") = %d", sizeof(T))
+    obj_pool_reserved = 0;
+    for (i = 0; i < NUM_OBJ_POOLS; i++) {
+	obj_pool_t *pool = &obj_pools[i];
+	size_t bytes = pool->size * OBJ_POOL_SLAB;
 
-void Alloc_shots(int number)
-{
-    anyobject_t		*x;
-    int			i;
-
-#if 0
-    SHOWTYPESIZE(object_t);
-    SHOWTYPESIZE(ballobject_t);
-    SHOWTYPESIZE(mineobject_t);
-    SHOWTYPESIZE(missileobject_t);
-    SHOWTYPESIZE(smartobject_t);
-    SHOWTYPESIZE(torpobject_t);
-    SHOWTYPESIZE(heatobject_t);
-    SHOWTYPESIZE(wireobject_t);
-    SHOWTYPESIZE(pulseobject_t);
-    SHOWTYPESIZE(itemobject_t);
-    SHOWTYPESIZE(anyobject_t);
-    SHOWTYPESIZE(player_t);
-#endif
-
-    x = (anyobject_t *) calloc((size_t)number, sizeof(anyobject_t));
-    if (!x) {
+	pool->reserve = (int)MAX(obj_pool_limit / OBJ_POOL_RESERVE
+				 / NUM_OBJ_POOLS / bytes, 1);
+	obj_pool_reserved += pool->reserve * bytes;
+    }
+
+    if ((Obj = XMALLOC(object_t *, ObjMax)) == NULL) {
 	error("Not enough memory for shots.");
 	exit(1);
     }
+}
 
-    objArray = x;
-    for (i = 0; i < number; i++) {
-	Obj[i] = &(x->obj);
-	/* kps - shouldn't be necessary */
-	/*MINE_PTR(Obj[i])->mine_owner = NO_ID;*/
-	Cell_init_object(Obj[i]);
-	x++;
+void Object_pool_report(char *buf, size_t size)
+{
+    int i;
+    size_t len;
+
+    snprintf(buf, size, "Objects %d, %.1f of %d MB:",
+	     ObjCount, obj_pool_bytes / 1048576.0,
+	     (int)(obj_pool_limit >> 20));
+    for (i = 0; i < NUM_OBJ_POOLS; i++) {
+	obj_pool_t *pool = &obj_pools[i];
+
+	if (pool->total == 0)
+	    continue;
+	len = strlen(buf);
+	snprintf(buf + len, size - len, " %s %d/%d",
+		 pool->name, pool->num, pool->high);
     }
 }
 
 void Free_shots(void)
 {
-    XFREE(objArray);
+    int i, j;
+    char buf[MSG_LEN];
+
+    Object_pool_report(buf, sizeof(buf));
+    xpprintf("%s %s (in use/high-water mark)\n", showtime(), buf);
+
+    for (i = 0; i < NUM_OBJ_POOLS; i++) {
+	obj_pool_t *pool = &obj_pools[i];
+
+	for (j = 0; j < pool->num_slabs; j++)
+	    free(pool->slabs[j]);
+	XFREE(pool->slabs);
+	XFREE(pool->free);
+	pool->num_slabs = pool->total = pool->num_free = pool->num = 0;
+	pool->reserve = 0;
+    }
+    obj_pool_bytes = obj_pool_reserved = 0;
+    XFREE(Obj);
+    ObjCount = ObjMax = 0;
 }
 
 
@@ -130,6 +130,8 @@ struct cell_node {
 
 #define OBJECT_EXTEND	\
     cell_node_t		cell;		/* node in cell linked list */	\
+    int			cell_ind;	/* slot in cell grid */		\
+    uint8_t		pool;		/* pool it was allocated from */ \
     short		pl_range;	/* distance for collision */	\
     short		pl_radius;	/* distance for hit */		\
     float		fuse;		/* ticks until fused */ \
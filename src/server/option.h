@@ -326,6 +326,16 @@ extern struct options {
 
     double	mainLoopTime;
     int		cellGetObjectsThreshold;  
+    bool	cellGrid;
+    int		frameThreads;
+    int		maxObjectMemory;
+    bool	collisionSweep;
+    bool	compactGravity;
+    bool	deltaFrames;
+    bool	frameRegions;
+    int		frameBandwidth;
+    int		robotThreads;
+    bool	robotNavigation;
 } options;
 
 /*
@@ -24,6 +24,9 @@
  * errno = WSAGetLastError();
  */
 
+/* Number of system calls made to write and read datagrams. */
+unsigned long sock_send_calls, sock_recv_calls;
+
 int sock_closeRec(sock_t *sock)
 {
     if (playback)
@@ -107,6 +110,7 @@ int sock_readRec(sock_t *sock, char *rbuf, int size)
 	    errno = *playback_errnos++;
 	return i;
     }
+    sock_recv_calls++;
     i = sock_read(sock, rbuf, size);
     if (record) {
 	*(playback_shorts++) = i;
@@ -121,6 +125,44 @@ int sock_readRec(sock_t *sock, char *rbuf, int size)
 }
 
 
+/*
+ * Read up to num datagrams of at most size bytes, with one recvmmsg(2)
+ * call where it is available.  Nothing is recorded, so this must not
+ * be used when recording or playing back.  Returns the number of
+ * datagrams read, or -1 with errno set like sock_read().
+ */
+int sock_read_manyRec(sock_t *sock, char **bufs, int size, int *lens,
+		      int num)
+{
+#ifdef HAVE_RECVMMSG
+    struct mmsghdr msgs[MAX_MMSG];
+    struct iovec iov[MAX_MMSG];
+    int i, n;
+
+    num = MIN(num, MAX_MMSG);
+    memset(msgs, 0, num * sizeof(msgs[0]));
+    for (i = 0; i < num; i++) {
+	iov[i].iov_base = bufs[i];
+	iov[i].iov_len = size;
+	msgs[i].msg_hdr.msg_iov = &iov[i];
+	msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    sock_recv_calls++;
+    if ((n = recvmmsg(sock->fd, msgs, num, MSG_DONTWAIT, NULL)) <= 0)
+	return n;
+    for (i = 0; i < n; i++)
+	lens[i] = msgs[i].msg_len;
+    return n;
+#else
+    UNUSED_PARAM(num);
+    sock_recv_calls++;
+    if ((lens[0] = sock_read(sock, bufs[0], size)) < 0)
+	return -1;
+    return 1;
+#endif
+}
+
+
 int sock_writeRec(sock_t *sock, char *wbuf, int size)
 {
     int i;
@@ -132,6 +174,7 @@ int sock_writeRec(sock_t *sock, char *wbuf, int size)
   return *(playback_ints++);
 */
     }
+    sock_send_calls++;
     i = sock_write(sock, wbuf, size);
     if (record) {
 	/*
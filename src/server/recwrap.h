@@ -23,15 +23,21 @@
 
 #include "net.h"
 
+/* Most datagrams read by one recvmmsg(2) call. */
+#define MAX_MMSG	16
+
 int sock_closeRec(sock_t *sock);
 int sock_connectRec(sock_t *sock, char *host, int port);
 int sock_get_last_portRec(sock_t *sock);
 int sock_receive_anyRec(sock_t *sock, char *rbuf, int size);
 int sock_readRec(sock_t *sock, char *rbuf, int size);
+int sock_read_manyRec(sock_t *sock, char **bufs, int size, int *lens, int num);
 int sock_writeRec(sock_t *sock, char *wbuf, int size);
 int sock_get_errorRec(sock_t *sock);
 int Sockbuf_flushRec(sockbuf_t *sbuf);
 int Sockbuf_writeRec(sockbuf_t *sbuf, char *buf, int len);
 int Sockbuf_readRec(sockbuf_t *sbuf);
 
+extern unsigned long sock_send_calls, sock_recv_calls;
+
 #endif  /* RECWRAP_H */
@@ -28,6 +28,7 @@
 #include "xpserver.h"
 
 #define DEFAULT_ROBOT_TYPE	"default"
+#define MAX_ROBOT_THREADS	64
 
 /*
  * Array of different robots which are used
@@ -681,6 +682,7 @@ static void Robot_create(void)
     robot_t *rob;
     team_t *teamp = NULL;
     int i, num, most_used, least_used;
+    uint32_t seed;
     robot_data_t *data, *new_data;
     robot_type_t *rob_type;
 
@@ -734,6 +736,10 @@ static void Robot_create(void)
     robot = Player_by_index(NumPlayers);
     robot->robot_data_ptr = new_data;
 
+    /* The robot's own random numbers, see Robot_rfrac(). */
+    seed = randomMT();
+    new_data->rand_state = (seed != 0) ? seed : 1;
+
     strlcpy(robot->name, rob->name, MAX_CHARS);
     strlcpy(robot->username, options.robotUserName, MAX_CHARS);
     strlcpy(robot->hostname, options.robotHostName, MAX_CHARS);
@@ -943,6 +949,229 @@ void Robot_message(player_t *pl, const char *message)
 }
 
 
+/*
+ * Robots play in two steps.  First every robot which is alive decides
+ * what to do, in parallel if there are robot threads.  Then they play
+ * one at a time in player order in the main thread, which is when
+ * they thrust, fire and so on.  While deciding a robot only looks at
+ * the world and uses its own random numbers, so what it decides
+ * doesn't depend on the threads or on the order of the robots.
+ */
+static player_t		**robot_decide_list;
+static int		num_robot_decide, max_robot_decide;
+static int		robot_next_decide;
+
+#ifdef HAVE_LIBPTHREAD
+typedef struct {
+    pthread_t		thread;
+    long		generation;	/* last decide round done */
+} robot_thread_t;
+
+static robot_thread_t	*robot_threads;
+static int		num_robot_threads;
+static pthread_mutex_t	robot_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	robot_start_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	robot_done_cond = PTHREAD_COND_INITIALIZER;
+static long		robot_generation;
+static int		robot_busy_threads;
+static bool		robot_threads_quit;
+#endif
+
+/*
+ * Random numbers for robots which are deciding.  Each robot has
+ * its own generator (xorshift32) seeded from randomMT() when it is
+ * created, so the numbers it gets don't depend on the other robots.
+ */
+double Robot_rfrac(player_t *pl)
+{
+    uint32_t x = pl->robot_data_ptr->rand_state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    pl->robot_data_ptr->rand_state = x;
+
+    return x / 4294967296.0;
+}
+
+/*
+ * Returns the next robot which should decide,
+ * or NULL if they all have.
+ */
+static player_t *Robot_next_decide(void)
+{
+    player_t *pl = NULL;
+
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_lock(&robot_mutex);
+#endif
+    if (robot_next_decide < num_robot_decide)
+	pl = robot_decide_list[robot_next_decide++];
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_unlock(&robot_mutex);
+#endif
+
+    return pl;
+}
+
+static void Robot_decide_robots(void)
+{
+    player_t *pl;
+
+    while ((pl = Robot_next_decide()) != NULL) {
+	robot_type_t *rob_type
+	    = &robot_types[pl->robot_data_ptr->robot_types_ind];
+
+	(*rob_type->robot_decide)(pl);
+    }
+}
+
+#ifdef HAVE_LIBPTHREAD
+static void *Robot_thread(void *arg)
+{
+    robot_thread_t *rt = (robot_thread_t *) arg;
+
+    pthread_mutex_lock(&robot_mutex);
+    for (;;) {
+	while (rt->generation == robot_generation && !robot_threads_quit)
+	    pthread_cond_wait(&robot_start_cond, &robot_mutex);
+	if (robot_threads_quit)
+	    break;
+	rt->generation = robot_generation;
+	pthread_mutex_unlock(&robot_mutex);
+
+	Robot_decide_robots();
+
+	pthread_mutex_lock(&robot_mutex);
+	if (--robot_busy_threads == 0)
+	    pthread_cond_signal(&robot_done_cond);
+    }
+    pthread_mutex_unlock(&robot_mutex);
+
+    return NULL;
+}
+
+static void Robot_threads_stop(void)
+{
+    int i;
+
+    pthread_mutex_lock(&robot_mutex);
+    robot_threads_quit = true;
+    pthread_cond_broadcast(&robot_start_cond);
+    pthread_mutex_unlock(&robot_mutex);
+
+    for (i = 0; i < num_robot_threads; i++)
+	pthread_join(robot_threads[i].thread, NULL);
+
+    robot_threads_quit = false;
+    num_robot_threads = 0;
+    XFREE(robot_threads);
+}
+#endif
+
+/*
+ * Start or stop robot threads if options.robotThreads has changed.
+ */
+static void Robot_threads_update(void)
+{
+    static int old_n = -1;
+    int n = MAX(0, MIN(options.robotThreads, MAX_ROBOT_THREADS));
+
+#ifndef HAVE_LIBPTHREAD
+    if (n > 0 && old_n == -1)
+	warn("No thread support, robots decide in the main thread.");
+    n = 0;
+#endif
+    if (n == old_n)
+	return;
+    old_n = n;
+
+#ifdef HAVE_LIBPTHREAD
+    {
+	int i;
+
+	Robot_threads_stop();
+	if (n == 0)
+	    return;
+	robot_threads = XCALLOC(robot_thread_t, n);
+	if (robot_threads == NULL) {
+	    error("No memory for robot threads");
+	    return;
+	}
+	for (i = 0; i < n; i++) {
+	    robot_thread_t *rt = &robot_threads[i];
+
+	    rt->generation = robot_generation;
+	    if (pthread_create(&rt->thread, NULL, Robot_thread, rt) != 0) {
+		error("Can't create robot thread");
+		break;
+	    }
+	    num_robot_threads++;
+	}
+    }
+#endif
+}
+
+/*
+ * Let every robot which is alive and has a decide function decide
+ * what to do, using the robot threads if there are any.
+ */
+static void Robot_decide(void)
+{
+    int i;
+
+    num_robot_decide = 0;
+    for (i = 0; i < NumPlayers; i++) {
+	player_t *pl = Player_by_index(i);
+
+	if (!Player_is_robot(pl)
+	    || !Player_is_alive(pl)
+	    || robot_types[pl->robot_data_ptr->robot_types_ind]
+		.robot_decide == NULL)
+	    continue;
+
+	if (num_robot_decide >= max_robot_decide) {
+	    int n = MAX(16, 2 * max_robot_decide);
+	    player_t **list = XREALLOC(player_t *, robot_decide_list, n);
+
+	    if (list == NULL) {
+		error("No memory for robots");
+		break;
+	    }
+	    robot_decide_list = list;
+	    max_robot_decide = n;
+	}
+	robot_decide_list[num_robot_decide++] = pl;
+    }
+    if (num_robot_decide == 0)
+	return;
+
+    /* Deciding robots look up objects from several threads. */
+    Cell_flush_pending();
+    Robot_threads_update();
+    robot_next_decide = 0;
+
+#ifdef HAVE_LIBPTHREAD
+    if (num_robot_threads > 0 && num_robot_decide > 1) {
+	pthread_mutex_lock(&robot_mutex);
+	robot_generation++;
+	robot_busy_threads = num_robot_threads;
+	pthread_cond_broadcast(&robot_start_cond);
+	pthread_mutex_unlock(&robot_mutex);
+
+	Robot_decide_robots();
+
+	pthread_mutex_lock(&robot_mutex);
+	while (robot_busy_threads > 0)
+	    pthread_cond_wait(&robot_done_cond, &robot_mutex);
+	pthread_mutex_unlock(&robot_mutex);
+	return;
+    }
+#endif
+
+    Robot_decide_robots();
+}
+
 /*
  * A robot plays this frame.
  */
@@ -1057,6 +1286,21 @@ void Robot_update(bool tick)
 
     Robot_round_tick();
 
+    /*
+     * Robots which leave do so before the others decide, so that
+     * the players don't move around in Players[] after that.
+     */
+    for (i = 0; i < NumPlayers; i++) {
+	player_t *pl = Player_by_index(i);
+
+	if (Player_is_robot(pl)
+	    && !Player_is_alive(pl)
+	    && Robot_check_leave(pl))
+	    i--;
+    }
+
+    Robot_decide();
+
     for (i = 0; i < NumPlayers; i++) {
 	player_t *pl = Player_by_index(i);
 
@@ -1065,16 +1309,10 @@ void Robot_update(bool tick)
 	    continue;
 	}
 
-	if (!Player_is_robot(pl))
-	    /* Ignore non-robots. */
+	if (!Player_is_robot(pl) || !Player_is_alive(pl))
+	    /* Ignore non-robots and dead robots. */
 	    continue;
 
-	if (!Player_is_alive(pl)) {
-	    if (Robot_check_leave(pl))
-		i--;
-	    continue;
-	}
-
 	/*
 	 * Let the robot code control this robot.
 	 */
@@ -87,6 +87,14 @@
  *    9) The cleanup function should free any allocated resources
  *       for this specific robot instance.
  *
+ *   10) The decide function, which may be NULL, is called each loop
+ *       for every robot which is alive before any of them plays.
+ *       It is called for several robots at once from different
+ *       threads, so it may only look at the world and write into
+ *       the robot's own private data, and it must use Robot_rfrac()
+ *       for its random numbers.  The playing function can then act
+ *       on what was decided.
+ *
  * The recommended practice is to define your new robot types
  * in a separate file and to only declare your robot type
  * specific initialisation function prototype in robot.c and add one
@@ -103,6 +111,7 @@ typedef struct {
     void		(*robot_message)(player_t *robot, const char *str);
     void		(*robot_destroy)(player_t *robot);
     void		(*robot_invite)(player_t *robot, player_t *inviter);
+    void		(*robot_decide)(player_t *robot);
 } robot_type_t;
 
 /*
@@ -136,8 +145,35 @@ typedef struct robot_data {
     int		robots_ind;		/* index into Robots[] */
     int		robot_types_ind;	/* index into robot_types[] */
     void	*private_data;		/* robot type private data */
+    uint32_t	rand_state;		/* see Robot_rfrac() */
 } robot_data_t;
 
+/*
+ * What the default robot has decided to do this loop, before it plays.
+ * The commands are what it does about the objects near it, in order.
+ */
+#define ROBOT_COMMANDS		64
+
+typedef struct robot_default_decision {
+    bool	decided;		/* not yet played on */
+    int		num_commands;
+    unsigned char commands[ROBOT_COMMANDS];
+    object_t	*item;			/* item to fetch, or NULL */
+    double	item_dist;
+    int		item_imp;
+    object_t	*mine;			/* nearest danger, or NULL */
+    double	mine_dist;
+    int		ship_i;			/* nearest ship to avoid */
+    double	ship_dist;
+    int		enemy_i;		/* nearest enemy to lock on */
+    double	enemy_dist;
+    int		fuel_i;			/* nearest fuel station */
+    double	fuel_dist;
+    int		target_i;		/* nearest target to kill */
+    double	target_dist;
+    int		cannon_i;		/* nearest cannon to kill */
+} robot_default_decision_t;
+
 /*
  * The private robot instance data for the default robot.
  */
@@ -158,6 +194,7 @@ typedef struct robot_default_data {
     double	fuel_l1;		/* Fuel critical level */
     double	fuel_l2;		/* Fuel warning level */
     double	fuel_l3;		/* Fuel notify level */
+    robot_default_decision_t decision;	/* made before playing */
 } robot_default_data_t;
 
 /*
@@ -192,5 +229,6 @@ int Robot_war_on_player(player_t *robot);
 void Robot_go_home(player_t *robot);
 void Robot_program(player_t *robot, int victim_id);
 void Robot_message(player_t *robot, const char *message);
+double Robot_rfrac(player_t *robot);
 
 #endif
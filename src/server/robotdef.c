@@ -50,6 +50,18 @@
 #define TARGET_KILL		(1 << 1)
 #define NEED_FUEL		(1 << 2)
 
+/*
+ * Commands decided by the default robots, see Robot_default_decide().
+ */
+#define RC_SHIELD		1
+#define RC_THRUST		2
+#define RC_NO_THRUST		3
+#define RC_HYPERJUMP		4
+#define RC_ECM			5
+#define RC_DETACH_TANK		6
+#define RC_CONNECTOR		7
+#define RC_SHOT			8
+
 static bool Empty_space_for_ball(int bx, int by)
 {
     int group;
@@ -169,6 +181,7 @@ static int Robot_default_war_on_player(player_t *pl);
 static void Robot_default_message(player_t *pl, const char *str);
 static void Robot_default_destroy(player_t *pl);
 static void Robot_default_invite(player_t *pl, player_t *inviter);
+static void Robot_default_decide(player_t *pl);
        int Robot_default_setup(robot_type_t *type_ptr);
 
 
@@ -192,7 +205,8 @@ static robot_type_t robot_default_type = {
     Robot_default_war_on_player,
     Robot_default_message,
     Robot_default_destroy,
-    Robot_default_invite
+    Robot_default_invite,
+    Robot_default_decide
 };
 
 
@@ -216,7 +230,7 @@ int Robot_default_setup(robot_type_t *type_ptr)
 /*
  * Private functions.
  */
-static bool Check_robot_evade(player_t *pl, int mine_i, int ship_i);
+static bool Check_robot_evade(player_t *pl, object_t *mine, int ship_i);
 static bool Check_robot_target(player_t *pl, clpos_t item_pos, int new_mode);
 static bool Detect_ship(player_t *pl, player_t *ship);
 static int Rank_item_value(player_t *pl, enum Item itemtype);
@@ -287,6 +301,8 @@ static void Robot_default_create(player_t *pl, char *str)
 
     my_data->longterm_mode	= 0;
 
+    my_data->decision.decided	= false;
+
     pl->robot_data_ptr->private_data = (void *)my_data;
 }
 
@@ -425,7 +441,7 @@ static inline int decide_travel_dir(player_t *pl)
 }
 
 
-static bool Check_robot_evade(player_t *pl, int mine_i, int ship_i)
+static bool Check_robot_evade(player_t *pl, object_t *mine, int ship_i)
 {
     object_t *shot;
     player_t *ship;
@@ -502,10 +518,10 @@ static bool Check_robot_evade(player_t *pl, int mine_i, int ship_i)
 	}
     }
 
-    if (mine_i >= 0) {
+    if (mine != NULL) {
 	double adir;
 
-	shot = Obj[mine_i];
+	shot = mine;
 	adir = Wrap_cfindDir(shot->pos.cx + PIXEL_TO_CLICK(shot->vel.x)
 			     - pl->pos.cx,
 			     shot->pos.cy + PIXEL_TO_CLICK(shot->vel.y)
@@ -1323,6 +1339,25 @@ static int Rank_item_value(player_t *pl, enum Item itemtype)
     return ROBOT_HANDY_ITEM;
 }
 
+/*
+ * Find the point to head for to get around walls to map object ind of
+ * a kind, see Nav_waypoint().  Returns false if there are no navigation
+ * fields or if map object ind is not the nearest one the way is known to.
+ * Ind is NO_IND for checkpoints.
+ */
+static bool Robot_default_waypoint(player_t *pl, int kind, int which,
+				   int ind, clpos_t *wp)
+{
+    int nearest;
+    double dist;
+
+    if (!Nav_nearest(kind, which, pl->pos, &nearest, &dist)
+	|| (ind != NO_IND && nearest != ind))
+	return false;
+
+    return Nav_waypoint(kind, which, pl->pos, wp);
+}
+
 static bool Ball_handler(player_t *pl)
 {
     int i, closest_tr = NO_IND, closest_ntr = NO_IND;
@@ -1421,10 +1456,11 @@ static bool Ball_handler(player_t *pl)
 	    my_data->last_thrown_ball = my_data->robot_count;
 	    CLR_BIT(my_data->longterm_mode, FETCH_TREASURE);
 	} else {
+	    clpos_t d = closest_treasure->pos;
+
 	    SET_BIT(my_data->longterm_mode, FETCH_TREASURE);
-	    return Check_robot_target(pl,
-				      Treasure_by_index(closest_tr)->pos,
-				      RM_NAVIGATE);
+	    Robot_default_waypoint(pl, NAV_TREASURE, pl->team, closest_tr, &d);
+	    return Check_robot_target(pl, d, RM_NAVIGATE);
 	}
     } else {
 	double ball_dist, closest_ball_dist = closest_ntr_dist;
@@ -1465,107 +1501,42 @@ static bool Ball_handler(player_t *pl)
 
 static int Robot_default_play_check_map(player_t *pl)
 {
-    int j, cannon_i = NO_IND, fuel_i = NO_IND, target_i = NO_IND;
-    double cannon_dist = Visibility_distance;
-    double fuel_dist = Visibility_distance;
-    double target_dist = Visibility_distance;
-    double dcx, dcy, distance;
     bool fuel_checked = false;
     robot_default_data_t *my_data = Robot_default_get_data(pl);
+    robot_default_decision_t *dec = &my_data->decision;
+    clpos_t wp;
 
-    for (j = 0; j < Num_fuels(); j++) {
-	fuel_t *fs = Fuel_by_index(j);
-
-	if (fs->fuel < 100.0)
-	    continue;
-
-	if (BIT(world->rules->mode, TEAM_PLAY)
-	    && options.teamFuel
-	    && fs->team != pl->team)
-	    continue;
-
-	dcx = fs->pos.cx - pl->pos.cx;
-	dcy = fs->pos.cy - pl->pos.cy;
-	distance = Wrap_length_min(dcx, dcy, fuel_dist * CLICK) / CLICK;
-	if (distance < fuel_dist) {
-	    fuel_i = j;
-	    fuel_dist = distance;
-	}
-    }
-
-    for (j = 0; j < Num_targets(); j++) {
-	target_t *targ = Target_by_index(j);
-
-	/* Ignore dead or owned targets */
-	if (targ->dead_ticks > 0
-	    || pl->team == targ->team
-	    || Team_by_index(targ->team)->NumMembers == 0)
-	    continue;
-
-	dcx = targ->pos.cx - pl->pos.cx;
-	dcy = targ->pos.cy - pl->pos.cy;
-	distance = Wrap_length_min(dcx, dcy, target_dist * CLICK) / CLICK;
-	if (distance < target_dist) {
-	    target_i = j;
-	    target_dist = distance;
-	}
-    }
-
-#if 0
-    if (fuel_i != NO_IND)
-	warn("Closest fuel   = %d, distance = %.2f", fuel_i, fuel_dist);
-    if (target_i != NO_IND)
-	warn("Closest target = %d, distance = %.2f", target_i, target_dist);
-#endif
-
-    if (fuel_i != NO_IND
-	&& (target_dist > fuel_dist
+    if (dec->fuel_i != NO_IND
+	&& (dec->target_dist > dec->fuel_dist
 	    || !BIT(world->rules->mode, TEAM_PLAY))
 	&& BIT(my_data->longterm_mode, NEED_FUEL)) {
 
 	fuel_checked = true;
 	SET_BIT(pl->used, USES_REFUEL);
-	pl->fs = fuel_i;
+	pl->fs = dec->fuel_i;
 
-	if (Check_robot_target(pl, Fuel_by_index(fuel_i)->pos,
+	if (Check_robot_target(pl, Fuel_by_index(dec->fuel_i)->pos,
 			       RM_REFUEL))
 	    return 1;
+	if (Robot_default_waypoint(pl, NAV_FUEL, pl->team, dec->fuel_i, &wp)
+	    && Check_robot_target(pl, wp, RM_NAVIGATE))
+	    return 1;
     }
-    if (target_i != NO_IND) {
+    if (dec->target_i != NO_IND) {
 	SET_BIT(my_data->longterm_mode, TARGET_KILL);
-	if (Check_robot_target(pl, Target_by_index(target_i)->pos,
+	if (Check_robot_target(pl, Target_by_index(dec->target_i)->pos,
 			       RM_CANNON_KILL))
 	    return 1;
+	if (Robot_default_waypoint(pl, NAV_TARGET, pl->team, dec->target_i,
+				   &wp)
+	    && Check_robot_target(pl, wp, RM_NAVIGATE))
+	    return 1;
 
 	CLR_BIT(my_data->longterm_mode, TARGET_KILL);
     }
 
-    for (j = 0; j < Num_cannons(); j++) {
-	cannon_t *cannon = Cannon_by_index(j);
-
-	if (cannon->dead_ticks > 0)
-	    continue;
-
-	if (BIT(world->rules->mode, TEAM_PLAY)
-	    && cannon->team == pl->team)
-	    continue;
-
-	dcx = cannon->pos.cx - pl->pos.cx;
-	dcy = cannon->pos.cy - pl->pos.cy;
-	distance = Wrap_length_min(dcx, dcy, cannon_dist * CLICK) / CLICK;
-	if (distance  < cannon_dist) {
-	    cannon_i = j;
-	    cannon_dist = distance;
-	}
-    }
-
-#if 0
-    if (cannon_i != NO_IND)
-	warn("Closest cannon = %d, distance = %.2f", cannon_i, cannon_dist);
-#endif
-
-    if (cannon_i != NO_IND) {
-	cannon_t *cannon = Cannon_by_index(cannon_i);
+    if (dec->cannon_i != NO_IND) {
+	cannon_t *cannon = Cannon_by_index(dec->cannon_i);
 	clpos_t d = cannon->pos;
 
 	d.cx += (click_t)(BLOCK_CLICKS * 0.1 * tcos(cannon->dir));
@@ -1573,36 +1544,203 @@ static int Robot_default_play_check_map(player_t *pl)
 
 	if (Check_robot_target(pl, d, RM_CANNON_KILL))
 	    return 1;
+	if (Robot_default_waypoint(pl, NAV_CANNON, pl->team, dec->cannon_i,
+				   &wp)
+	    && Check_robot_target(pl, wp, RM_NAVIGATE))
+	    return 1;
     }
 
-    if (fuel_i != NO_IND
+    if (dec->fuel_i != NO_IND
 	&& !fuel_checked
 	&& BIT(my_data->longterm_mode, NEED_FUEL)) {
 
 	SET_BIT(pl->used, USES_REFUEL);
-	pl->fs = fuel_i;
+	pl->fs = dec->fuel_i;
 
-	if (Check_robot_target(pl, Fuel_by_index(fuel_i)->pos,
+	if (Check_robot_target(pl, Fuel_by_index(dec->fuel_i)->pos,
 			       RM_REFUEL))
 	    return 1;
+	if (Robot_default_waypoint(pl, NAV_FUEL, pl->team, dec->fuel_i, &wp)
+	    && Check_robot_target(pl, wp, RM_NAVIGATE))
+	    return 1;
     }
 
     return 0;
 }
 
-static void Robot_default_play_check_objects(player_t *pl,
-					     int *item_i, double *item_dist,
-					     int *item_imp,
-					     int *mine_i, double *mine_dist)
+/*
+ * Add a command to the decision.  Only the last of several thrust
+ * commands in a row matters, so it replaces the ones before it.
+ */
+static void Robot_default_command(robot_default_decision_t *dec, int cmd)
 {
-    int j, obj_count;
+    int n = dec->num_commands;
+
+    if ((cmd == RC_THRUST || cmd == RC_NO_THRUST)
+	&& n > 0
+	&& (dec->commands[n - 1] == RC_THRUST
+	    || dec->commands[n - 1] == RC_NO_THRUST))
+	n--;
+    if (n < ROBOT_COMMANDS)
+	dec->commands[n++] = cmd;
+    dec->num_commands = n;
+}
+
+static bool Robot_default_fuel_ok(player_t *pl, fuel_t *fs)
+{
+    if (fs->fuel < 100.0)
+	return false;
+
+    if (BIT(world->rules->mode, TEAM_PLAY)
+	&& options.teamFuel
+	&& fs->team != pl->team)
+	return false;
+
+    return true;
+}
+
+static bool Robot_default_target_ok(player_t *pl, target_t *targ)
+{
+    /* Ignore dead or owned targets */
+    if (targ->dead_ticks > 0
+	|| pl->team == targ->team
+	|| Team_by_index(targ->team)->NumMembers == 0)
+	return false;
+
+    return true;
+}
+
+static bool Robot_default_cannon_ok(player_t *pl, cannon_t *cannon)
+{
+    if (cannon->dead_ticks > 0)
+	return false;
+
+    if (BIT(world->rules->mode, TEAM_PLAY)
+	&& cannon->team == pl->team)
+	return false;
+
+    return true;
+}
+
+static bool Robot_default_fuel_accept(int ind, void *arg)
+{
+    return Robot_default_fuel_ok((player_t *) arg, Fuel_by_index(ind));
+}
+
+static bool Robot_default_target_accept(int ind, void *arg)
+{
+    return Robot_default_target_ok((player_t *) arg, Target_by_index(ind));
+}
+
+static bool Robot_default_cannon_accept(int ind, void *arg)
+{
+    return Robot_default_cannon_ok((player_t *) arg, Cannon_by_index(ind));
+}
+
+/*
+ * Is pos close enough for the robot to know about it?
+ */
+static bool Robot_default_visible(player_t *pl, clpos_t pos)
+{
+    return Wrap_length_min(pos.cx - pl->pos.cx, pos.cy - pl->pos.cy,
+			   Visibility_distance * CLICK) / CLICK
+	< Visibility_distance;
+}
+
+/*
+ * Find the nearest fuel station, target and cannon,
+ * for Robot_default_play_check_map().  When there are navigation
+ * fields the nearest one is the one with the shortest way there,
+ * unless it is empty or can't be used now, and the distance is the
+ * length of the way.
+ */
+static void Robot_default_decide_map(player_t *pl,
+				     robot_default_decision_t *dec)
+{
+    int j;
+    double distance;
+
+    dec->fuel_i = NO_IND;
+    dec->fuel_dist = Visibility_distance;
+    dec->target_i = NO_IND;
+    dec->target_dist = Visibility_distance;
+    dec->cannon_i = NO_IND;
+
+    if (Nav_nearest(NAV_FUEL, pl->team, pl->pos, &j, &distance)
+	&& Robot_default_fuel_ok(pl, Fuel_by_index(j))) {
+	if (Robot_default_visible(pl, Fuel_by_index(j)->pos)) {
+	    dec->fuel_i = j;
+	    dec->fuel_dist = distance;
+	}
+    } else if (World_nearest_objects(FUEL, pl->pos,
+				     Visibility_distance * CLICK, 1, &j,
+				     Robot_default_fuel_accept, pl) > 0
+	       && Robot_default_visible(pl, Fuel_by_index(j)->pos)) {
+	fuel_t *fs = Fuel_by_index(j);
+
+	dec->fuel_i = j;
+	dec->fuel_dist = Wrap_length(fs->pos.cx - pl->pos.cx,
+				     fs->pos.cy - pl->pos.cy) / CLICK;
+    }
+
+    if (Nav_nearest(NAV_TARGET, pl->team, pl->pos, &j, &distance)
+	&& Robot_default_target_ok(pl, Target_by_index(j))) {
+	if (Robot_default_visible(pl, Target_by_index(j)->pos)) {
+	    dec->target_i = j;
+	    dec->target_dist = distance;
+	}
+    } else if (World_nearest_objects(TARGET, pl->pos,
+				     Visibility_distance * CLICK, 1, &j,
+				     Robot_default_target_accept, pl) > 0
+	       && Robot_default_visible(pl, Target_by_index(j)->pos)) {
+	target_t *targ = Target_by_index(j);
+
+	dec->target_i = j;
+	dec->target_dist = Wrap_length(targ->pos.cx - pl->pos.cx,
+				       targ->pos.cy - pl->pos.cy) / CLICK;
+    }
+
+    if (Nav_nearest(NAV_CANNON, pl->team, pl->pos, &j, &distance)) {
+	if (Robot_default_visible(pl, Cannon_by_index(j)->pos)) {
+	    dec->cannon_i = j;
+	}
+    } else if (World_nearest_objects(CANNON, pl->pos,
+				     Visibility_distance * CLICK, 1, &j,
+				     Robot_default_cannon_accept, pl) > 0
+	       && Robot_default_visible(pl, Cannon_by_index(j)->pos))
+	dec->cannon_i = j;
+
+#if 0
+    if (dec->fuel_i != NO_IND)
+	warn("Closest fuel   = %d, distance = %.2f",
+	     dec->fuel_i, dec->fuel_dist);
+    if (dec->target_i != NO_IND)
+	warn("Closest target = %d, distance = %.2f",
+	     dec->target_i, dec->target_dist);
+    if (dec->cannon_i != NO_IND)
+	warn("Closest cannon = %d", dec->cannon_i);
+#endif
+}
+
+/*
+ * Find the nearest item and danger, and decide what to do about
+ * the objects which are about to hit us.  Returns true if the
+ * shields should go up.
+ */
+static bool Robot_default_decide_objects(player_t *pl,
+					 robot_default_decision_t *dec)
+{
+    int j, obj_count, ecms = 0, tanks = 0;
     object_t *shot, **obj_list;
     double distance, shield_range;
     long killing_shots;
+    bool shielded = false, connector = false, shooting = false;
+    bool hyperjump = false;
     robot_default_data_t *my_data = Robot_default_get_data(pl);
 
     /*-BA Neural overload - if NumObjs too high, only consider
-     *-BA max_objs many objects - improves performance under nukes
+     *-BA as many objects as fit in obj_buf - improves performance
+     *-BA under nukes.
      *-BA 1000 is a fairly arbitrary choice.  If you wish to tune it,
      *-BA take into account the following.  A 4 mine cluster nuke produces
      *-BA about 4000 short lived objects.  An 8 mine cluster nuke produces
@@ -1614,7 +1752,7 @@ static void Robot_default_play_check_objects(player_t *pl,
      *-BA much.  If too high, your system will slow down too much when
      *-BA the cluster nukes start going off.
      */
-    const int                   max_objs = 1000;
+    object_t			*obj_buf[1000];
 
     killing_shots = KILLING_SHOTS;
     if (options.treasureCollisionMayKill)
@@ -1624,10 +1762,12 @@ static void Robot_default_play_check_objects(player_t *pl,
     if (options.asteroidCollisionMayKill)
 	killing_shots |= OBJ_ASTEROID_BIT;
 
-    if (NumObjs >= options.cellGetObjectsThreshold)
-	Cell_get_objects(pl->pos, (int)(Visibility_distance / BLOCK_SZ),
-			 max_objs, &obj_list, &obj_count);
-    else {
+    if (NumObjs >= options.cellGetObjectsThreshold) {
+	obj_list = obj_buf;
+	obj_count = Cell_get_objects(pl->pos,
+				     (int)(Visibility_distance / BLOCK_SZ),
+				     NELEM(obj_buf), obj_list);
+    } else {
 	obj_list = Obj;
 	obj_count = NumObjs;
     }
@@ -1645,15 +1785,18 @@ static void Robot_default_play_check_objects(player_t *pl,
 	if (shot->type == OBJ_BALL
 	    && !WITHIN(my_data->last_thrown_ball,
 		       my_data->robot_count,
-		       3 * FPS))
-	    SET_BIT(pl->used, USES_CONNECTOR);
+		       3 * FPS)
+	    && !connector) {
+	    connector = true;
+	    Robot_default_command(dec, RC_CONNECTOR);
+	}
 
 	/* Ignore shots and laser pulses if shields already up
 	   - nothing else to do anyway */
 	if ((shot->type == OBJ_SHOT
 	     || shot->type == OBJ_CANNON_SHOT
 	     || shot->type == OBJ_PULSE)
-	    && BIT(pl->used, HAS_SHIELD))
+	    && shielded)
 	    continue;
 
 	dx = CLICK_TO_PIXEL(shot->pos.cx - pl->pos.cx);
@@ -1671,8 +1814,8 @@ static void Robot_default_play_check_objects(player_t *pl,
 	    if (shot->type == OBJ_ITEM) {
 		itemobject_t *item = ITEM_PTR(shot);
 
-		if (ABS(dx) < *item_dist
-		    && ABS(dy) < *item_dist) {
+		if (ABS(dx) < dec->item_dist
+		    && ABS(dy) < dec->item_dist) {
 		    int imp;
 
 		    if (BIT(item->obj_status, RANDOM_ITEM))
@@ -1681,10 +1824,10 @@ static void Robot_default_play_check_objects(player_t *pl,
 		    else
 			imp = Rank_item_value(pl, (enum Item)item->item_type);
 
-		    if (imp > ROBOT_IGNORE_ITEM && imp >= *item_imp) {
-			*item_imp = imp;
-			*item_dist = LENGTH(dx, dy);
-			*item_i = j;
+		    if (imp > ROBOT_IGNORE_ITEM && imp >= dec->item_imp) {
+			dec->item_imp = imp;
+			dec->item_dist = LENGTH(dx, dy);
+			dec->item = shot;
 		    }
 		}
 	    }
@@ -1725,21 +1868,21 @@ static void Robot_default_play_check_objects(player_t *pl,
 		&& shot->id != pl->id)
 	    || (shot->type == OBJ_WRECKAGE
 		&& !BIT(world->rules->mode, TIMING))) {
-	    if (ABS(dx) < *mine_dist
-		&&  ABS(dy) < *mine_dist
-		&& (distance = LENGTH(dx, dy)) < *mine_dist) {
-		*mine_i = j;
-		*mine_dist = distance;
+	    if (ABS(dx) < dec->mine_dist
+		&&  ABS(dy) < dec->mine_dist
+		&& (distance = LENGTH(dx, dy)) < dec->mine_dist) {
+		dec->mine = shot;
+		dec->mine_dist = distance;
 	    }
 	    if ((dx = (int)((CLICK_TO_PIXEL(shot->pos.cx - pl->pos.cx))
 			     + (shot->vel.x - pl->vel.x)),
-		    dx = (int)WRAP_DX(dx), ABS(dx)) < *mine_dist
+		    dx = (int)WRAP_DX(dx), ABS(dx)) < dec->mine_dist
 		&& (dy = (int)((CLICK_TO_PIXEL(shot->pos.cy - pl->pos.cy))
 				 + (shot->vel.y - pl->vel.y)),
-		    dy = (int)WRAP_DY(dy), ABS(dy)) < *mine_dist
-		&& (distance = LENGTH(dx, dy)) < *mine_dist) {
-		*mine_i = j;
-		*mine_dist = distance;
+		    dy = (int)WRAP_DY(dy), ABS(dy)) < dec->mine_dist
+		&& (distance = LENGTH(dx, dy)) < dec->mine_dist) {
+		dec->mine = shot;
+		dec->mine_dist = distance;
 	    }
 	}
 
@@ -1755,10 +1898,13 @@ static void Robot_default_play_check_objects(player_t *pl,
 		dy = WRAP_DY(dy),
 		ABS(dy)) < shield_range
 	    && sqr(dx) + sqr(dy) <= sqr(shield_range)
-	    && (int)(rfrac() * 100) <
+	    && (int)(Robot_rfrac(pl) * 100) <
 	       (85 + (my_data->defense / 7) - (my_data->attack / 50))) {
-	    SET_BIT(pl->used, HAS_SHIELD);
-	    Thrust(pl, true);
+	    if (!shielded) {
+		shielded = true;
+		Robot_default_command(dec, RC_SHIELD);
+	    }
+	    Robot_default_command(dec, RC_THRUST);
 
 	    if ((shot->type == OBJ_TORPEDO
 		 || shot->type == OBJ_SMART_SHOT
@@ -1766,71 +1912,220 @@ static void Robot_default_play_check_objects(player_t *pl,
 		 || shot->type == OBJ_HEAT_SHOT
 		 || shot->type == OBJ_MINE)
 		&& (pl->fuel.sum < my_data->fuel_l3
-		    || !BIT(pl->have, HAS_SHIELD))) {
-	      if (Initiate_hyperjump(pl))
-		  break;
+		    || !BIT(pl->have, HAS_SHIELD))
+		&& !hyperjump) {
+		hyperjump = true;
+		Robot_default_command(dec, RC_HYPERJUMP);
 	    }
 	}
 	if (shot->type == OBJ_SMART_SHOT) {
-	    if (*mine_dist < ECM_DISTANCE / 4)
-		Fire_ecm(pl);
+	    if (dec->mine_dist < ECM_DISTANCE / 4
+		&& ecms++ < MAX_PLAYER_ECMS)
+		Robot_default_command(dec, RC_ECM);
 	}
 	if (shot->type == OBJ_MINE) {
-	    if (*mine_dist < ECM_DISTANCE / 2)
-		Fire_ecm(pl);
+	    if (dec->mine_dist < ECM_DISTANCE / 2
+		&& ecms++ < MAX_PLAYER_ECMS)
+		Robot_default_command(dec, RC_ECM);
 	}
 	if (shot->type == OBJ_HEAT_SHOT) {
-	    Thrust(pl, false);
+	    Robot_default_command(dec, RC_NO_THRUST);
 	    if (pl->fuel.sum < my_data->fuel_l3
 		&& pl->fuel.sum > my_data->fuel_l1
-		&& pl->fuel.num_tanks > 0)
-		Tank_handle_detach(pl);
+		&& tanks < pl->fuel.num_tanks) {
+		tanks++;
+		Robot_default_command(dec, RC_DETACH_TANK);
+	    }
 	}
-	if (shot->type == OBJ_ASTEROID) {
+	if (shot->type == OBJ_ASTEROID && !shooting) {
 	    int delta_dir = 0;
 	    wireobject_t *wire = WIRE_PTR(shot);
 
-	    if (*mine_dist
+	    if (dec->mine_dist
 		> (wire->wire_size == 1 ? 2 : 4) * BLOCK_SZ
-		&& *mine_dist < 8 * BLOCK_SZ
+		&& dec->mine_dist < 8 * BLOCK_SZ
 		&& (delta_dir = (pl->dir
 				 - Wrap_cfindDir(shot->pos.cx - pl->pos.cx,
 						 shot->pos.cy - pl->pos.cy))
 		    < wire->wire_size * (RES / 10)
-		    || delta_dir > RES - wire->wire_size * (RES / 10)))
-		SET_BIT(pl->used, HAS_SHOT);
+		    || delta_dir > RES - wire->wire_size * (RES / 10))) {
+		shooting = true;
+		Robot_default_command(dec, RC_SHOT);
+	    }
 	}
     }
 
-    /* Convert *item_i from index in local obj_list[] to index in Obj[] */
-    if (*item_i >= 0) {
-	for (j = 0;
-	     (j < NumObjs) && (Obj[j]->id != obj_list[*item_i]->id);
-	     j++);
-	if (j >= NumObjs)
-	    /* Perhaps an error should be printed, too? */
-	    *item_i = NO_IND;
-	else
-	    *item_i = j;
+    return shielded;
+}
+
+/*
+ * Find the nearest ship to stay away from and the nearest enemy.
+ */
+static void Robot_default_decide_ships(player_t *pl,
+				       robot_default_decision_t *dec,
+				       bool shielded)
+{
+    player_t *ship;
+    double distance;
+    int j;
+    robot_default_data_t *my_data = Robot_default_get_data(pl);
+
+    dec->ship_i = NO_IND;
+    dec->ship_dist = SHIP_SZ * 6;
+    dec->enemy_i = NO_IND;
+    if (pl->fuel.sum > my_data->fuel_l3)
+	dec->enemy_dist = (BIT(world->rules->mode, LIMITED_VISIBILITY) ?
+			   MAX(pl->fuel.sum * ENERGY_RANGE_FACTOR,
+			       Visibility_distance)
+			   : Max_enemy_distance);
+    else
+	dec->enemy_dist = Visibility_distance;
+
+    if (shielded)
+	dec->ship_dist = 0;
+
+    if (BIT(my_data->robot_lock, LOCK_PLAYER)) {
+	ship = Player_by_id(my_data->robot_lock_id);
+	j = GetInd(ship->id);
+
+	if (Detect_ship(pl, ship)) {
+	    distance = Wrap_length(ship->pos.cx - pl->pos.cx,
+				   ship->pos.cy - pl->pos.cy) / CLICK;
+	    if (distance < dec->ship_dist) {
+		dec->ship_i = GetInd(my_data->robot_lock_id);
+		dec->ship_dist = distance;
+	    }
+	    if (distance < dec->enemy_dist) {
+		dec->enemy_i = j;
+		dec->enemy_dist = distance;
+	    }
+	}
+    }
+
+    if (dec->ship_i == NO_IND || dec->enemy_i == NO_IND) {
+
+	for (j = 0; j < NumPlayers; j++) {
+
+	    ship = Player_by_index(j);
+	    if (j == GetInd(pl->id)
+		|| !Player_is_active(ship)
+		|| Team_immune(pl->id, ship->id))
+		continue;
+
+	    if (!Detect_ship(pl, ship))
+		continue;
+
+	    distance = Wrap_length(ship->pos.cx - pl->pos.cx,
+				   ship->pos.cy - pl->pos.cy) / CLICK;
+
+	    if (distance < dec->ship_dist) {
+		dec->ship_i = j;
+		dec->ship_dist = distance;
+	    }
+
+	    if (!BIT(my_data->robot_lock, LOCK_PLAYER)) {
+		if ((my_data->robot_count % 3) == 0
+		    && ((my_data->robot_count % 100) < my_data->attack)
+		    && distance < dec->enemy_dist) {
+		    dec->enemy_i    = j;
+		    dec->enemy_dist = distance;
+		}
+	    }
+	}
     }
+}
 
+/*
+ * Decide what to do this loop, before playing.  This looks at all
+ * objects, ships, fuel stations, targets and cannons near us, which
+ * is most of the work a default robot does.  It is called for several
+ * robots at once, so it may only change what is in my_data.
+ */
+static void Robot_default_decide(player_t *pl)
+{
+    bool shielded;
+    robot_default_data_t *my_data = Robot_default_get_data(pl);
+    robot_default_decision_t *dec = &my_data->decision;
+
+    if (my_data->robot_count <= 0)
+	my_data->robot_count = 1000 + (int)(Robot_rfrac(pl) * 32);
+
+    my_data->robot_count--;
+
+    dec->decided = true;
+    dec->num_commands = 0;
+    dec->item = NULL;
+    dec->item_dist = Visibility_distance;
+    dec->item_imp = ROBOT_IGNORE_ITEM;
+    dec->mine = NULL;
+    dec->mine_dist = SHIP_SZ + 200;
+
+    /* Robot_default_play() doesn't look any further when blinded. */
+    if (pl->damaged > 0)
+	return;
+
+    shielded = Robot_default_decide_objects(pl, dec);
+    Robot_default_decide_ships(pl, dec, shielded);
+    Robot_default_decide_map(pl, dec);
+}
+
+/*
+ * Carry out the commands of the decision in order.  A hyperjump
+ * ends them, since the robot won't be where it decided them.
+ */
+static void Robot_default_commands(player_t *pl,
+				   robot_default_decision_t *dec)
+{
+    int i;
+
+    for (i = 0; i < dec->num_commands; i++) {
+	switch (dec->commands[i]) {
+	case RC_SHIELD:
+	    SET_BIT(pl->used, HAS_SHIELD);
+	    break;
+	case RC_THRUST:
+	    Thrust(pl, true);
+	    break;
+	case RC_NO_THRUST:
+	    Thrust(pl, false);
+	    break;
+	case RC_HYPERJUMP:
+	    if (Initiate_hyperjump(pl))
+		return;
+	    break;
+	case RC_ECM:
+	    Fire_ecm(pl);
+	    break;
+	case RC_DETACH_TANK:
+	    Tank_handle_detach(pl);
+	    break;
+	case RC_CONNECTOR:
+	    SET_BIT(pl->used, USES_CONNECTOR);
+	    break;
+	case RC_SHOT:
+	    SET_BIT(pl->used, HAS_SHOT);
+	    break;
+	default:
+	    break;
+	}
+    }
 }
 
 
 static void Robot_default_play(player_t *pl)
 {
     player_t *ship;
-    double distance, ship_dist, enemy_dist, speed, x_speed, y_speed;
-    double item_dist, mine_dist, shoot_time;
-    int j, ship_i, item_imp, enemy_i, item_i, mine_i;
+    double ship_dist, enemy_dist, speed, x_speed, y_speed;
+    double item_dist, shoot_time;
+    int k, n, list[MAP_NEAREST_MAX], ship_i, item_imp, enemy_i;
     bool harvest_checked, evade_checked, navigate_checked;
     robot_default_data_t *my_data = Robot_default_get_data(pl);
+    robot_default_decision_t *dec = &my_data->decision;
     itemobject_t *item = NULL;
 
-    if (my_data->robot_count <= 0)
-	my_data->robot_count = 1000 + (int)(rfrac() * 32);
-
-    my_data->robot_count--;
+    if (!dec->decided)
+	Robot_default_decide(pl);
+    dec->decided = false;
 
     CLR_BIT(pl->used, USES_SHOT|USES_SHIELD|USES_CLOAKING_DEVICE|USES_LASER);
     if (BIT(pl->have, HAS_EMERGENCY_SHIELD)
@@ -1841,12 +2136,6 @@ static void Robot_default_play(player_t *pl)
     evade_checked = false;
     navigate_checked = false;
 
-    mine_i = NO_IND;
-    mine_dist = SHIP_SZ + 200;
-    item_i = NO_IND;
-    item_dist = Visibility_distance;
-    item_imp = ROBOT_IGNORE_ITEM;
-
     if (Player_has_cloaking_device(pl)
 	&& pl->fuel.sum > my_data->fuel_l2)
 	SET_BIT(pl->used, USES_CLOAKING_DEVICE);
@@ -1873,22 +2162,22 @@ static void Robot_default_play(player_t *pl)
     }
 
     if (pl->fuel.sum < pl->fuel.max * 0.80) {
-	for (j = 0; j < Num_fuels(); j++) {
-	    fuel_t *fs = Fuel_by_index(j);
+	n = World_objects_in_range(FUEL, pl->pos, 90.0 * CLICK,
+				   list, NELEM(list));
+	CLR_BIT(pl->used, USES_REFUEL);
+	for (k = 0; k < n; k++) {
+	    fuel_t *fs = Fuel_by_index(list[k]);
 
 	    if (BIT(world->rules->mode, TEAM_PLAY)
 		&& options.teamFuel
 		&& fs->team != pl->team)
 		continue;
 
-	    if ((Wrap_length(pl->pos.cx - fs->pos.cx,
-			     pl->pos.cy - fs->pos.cy) <= 90.0 * CLICK)
-		&& fs->fuel > REFUEL_RATE * timeStep) {
-		pl->fs = j;
+	    if (fs->fuel > REFUEL_RATE * timeStep) {
+		pl->fs = list[k];
 		SET_BIT(pl->used, USES_REFUEL);
 		break;
-	    } else
-		CLR_BIT(pl->used, USES_REFUEL);
+	    }
 	}
     }
 
@@ -1900,98 +2189,37 @@ static void Robot_default_play(player_t *pl)
 	CLR_BIT(my_data->longterm_mode, NEED_FUEL);
 
     if (BIT(world->rules->mode, TEAM_PLAY)) {
-	for (j = 0; j < Num_targets(); j++) {
-	    target_t *targ = Target_by_index(j);
+	n = World_objects_in_range(TARGET, pl->pos, 90.0 * CLICK,
+				   list, NELEM(list));
+	for (k = 0; k < n; k++) {
+	    target_t *targ = Target_by_index(list[k]);
 
 	    if (targ->team == pl->team
 		&& targ->damage < TARGET_DAMAGE
 		&& targ->dead_ticks >= 0) {
-
-		if (Wrap_length(pl->pos.cx - targ->pos.cx,
-				pl->pos.cy - targ->pos.cy) <= 90.0 * CLICK) {
-		    pl->repair_target = j;
-		    SET_BIT(pl->used, USES_REPAIR);
-		    break;
-		}
+		pl->repair_target = list[k];
+		SET_BIT(pl->used, USES_REPAIR);
+		break;
 	    }
 	}
     }
 
-    Robot_default_play_check_objects(pl,
-				     &item_i, &item_dist, &item_imp,
-				     &mine_i, &mine_dist);
+    Robot_default_commands(pl, dec);
 
-    if (item_i >= 0)
-	item = ITEM_PTR(Obj[item_i]);
+    if (dec->item != NULL)
+	item = ITEM_PTR(dec->item);
+    item_dist = dec->item_dist;
+    item_imp = dec->item_imp;
 
     /* make sure robots take off from their bases */
     if (QUICK_LENGTH(pl->pos.cx - pl->home_base->pos.cx,
 		     pl->pos.cy - pl->home_base->pos.cy) < BLOCK_CLICKS)
 	Thrust(pl, true);
 
-    ship_i = NO_IND;
-    ship_dist = SHIP_SZ * 6;
-    enemy_i = NO_IND;
-    if (pl->fuel.sum > my_data->fuel_l3)
-	enemy_dist = (BIT(world->rules->mode, LIMITED_VISIBILITY) ?
-		      MAX(pl->fuel.sum * ENERGY_RANGE_FACTOR,
-			  Visibility_distance)
-		      : Max_enemy_distance);
-    else
-	enemy_dist = Visibility_distance;
-
-    if (BIT(pl->used, HAS_SHIELD))
-	ship_dist = 0;
-
-    if (BIT(my_data->robot_lock, LOCK_PLAYER)) {
-	ship = Player_by_id(my_data->robot_lock_id);
-	j = GetInd(ship->id);
-
-	if (Detect_ship(pl, ship)) {
-	    distance = Wrap_length(ship->pos.cx - pl->pos.cx,
-				   ship->pos.cy - pl->pos.cy) / CLICK;
-	    if (distance < ship_dist) {
-		ship_i = GetInd(my_data->robot_lock_id);
-		ship_dist = distance;
-	    }
-	    if (distance < enemy_dist) {
-		enemy_i = j;
-		enemy_dist = distance;
-	    }
-	}
-    }
-
-    if (ship_i == NO_IND || enemy_i == NO_IND) {
-
-	for (j = 0; j < NumPlayers; j++) {
-
-	    ship = Player_by_index(j);
-	    if (j == GetInd(pl->id)
-		|| !Player_is_active(ship)
-		|| Team_immune(pl->id, ship->id))
-		continue;
-
-	    if (!Detect_ship(pl, ship))
-		continue;
-
-	    distance = Wrap_length(ship->pos.cx - pl->pos.cx,
-				   ship->pos.cy - pl->pos.cy) / CLICK;
-
-	    if (distance < ship_dist) {
-		ship_i = j;
-		ship_dist = distance;
-	    }
-
-	    if (!BIT(my_data->robot_lock, LOCK_PLAYER)) {
-		if ((my_data->robot_count % 3) == 0
-		    && ((my_data->robot_count % 100) < my_data->attack)
-		    && distance < enemy_dist) {
-		    enemy_i    = j;
-		    enemy_dist = distance;
-		}
-	    }
-	}
-    }
+    ship_i = dec->ship_i;
+    ship_dist = dec->ship_dist;
+    enemy_i = dec->enemy_i;
+    enemy_dist = dec->enemy_dist;
 
     if (ship_dist < 3*SHIP_SZ && BIT(pl->have, HAS_SHIELD))
 	SET_BIT(pl->used, HAS_SHIELD);
@@ -2049,7 +2277,7 @@ static void Robot_default_play(player_t *pl)
 	}
     }
     if (!evade_checked) {
-	if (Check_robot_evade(pl, mine_i, ship_i)) {
+	if (Check_robot_evade(pl, dec->mine, ship_i)) {
 	    if (!options.allowShields
 		&& options.playerStartsShielded
 		&& BIT(pl->have, HAS_SHIELD))
@@ -2078,9 +2306,11 @@ static void Robot_default_play(player_t *pl)
 	    || (item_imp == ROBOT_HANDY_ITEM && item_dist > 2 * BLOCK_SZ)
 	    || (item_imp == ROBOT_IGNORE_ITEM)
 	    || (delta_dir < 3 * RES / 4 && delta_dir > RES / 4)) {
+	    clpos_t d = Check_by_index(pl->check)->pos;
+
 	    navigate_checked = true;
-	    if (Check_robot_target(pl, Check_by_index(pl->check)->pos,
-				   RM_NAVIGATE))
+	    Robot_default_waypoint(pl, NAV_CHECK, pl->check, NO_IND, &d);
+	    if (Check_robot_target(pl, d, RM_NAVIGATE))
 		return;
 	}
     }
@@ -2133,17 +2363,17 @@ static void Robot_default_play(player_t *pl)
 	if (Ball_handler(pl))
 	    return;
     }
-    if (item_i >= 0
+    if (item != NULL
 	&& !harvest_checked
 	&& item_dist < 12*BLOCK_SZ) {
 
 	if (item_imp != ROBOT_IGNORE_ITEM) {
-	    clpos_t d = Obj[item_i]->pos;
+	    clpos_t d = item->pos;
 
-	    d.cx += (int)(Obj[item_i]->vel.x
+	    d.cx += (int)(item->vel.x
 			  * (ABS(d.cx - pl->pos.cx) /
 			     my_data->robot_normal_speed));
-	    d.cy += (int)(Obj[item_i]->vel.y
+	    d.cy += (int)(item->vel.y
 			  * (ABS(d.cy - pl->pos.cy) /
 			     my_data->robot_normal_speed));
 
@@ -28,6 +28,17 @@
 
 #include "xpserver.h"
 
+/*
+ * On Linux the descriptors are waited for with epoll(7) and the frame
+ * timer is a timerfd, otherwise select(2) and SIGALRM are used.
+ * Configure with ac_cv_header_sys_epoll_h=no to get the latter on Linux.
+ */
+#if !defined(_WINDOWS) && defined(HAVE_SYS_EPOLL_H) && defined(HAVE_SYS_TIMERFD_H)
+# define EPOLL_SCHED
+# include <sys/epoll.h>
+# include <sys/timerfd.h>
+#endif
+
 /* Windows incorrectly uses u_int in FD_CLR */
 #ifdef _WINDOWS
 typedef	u_int	FDTYPE;
@@ -36,7 +47,7 @@ typedef	int	FDTYPE;
 #endif
 
 #ifndef _WINDOWS
-#define NUM_SELECT_FD		((int)sizeof(int) * 8)
+#define NUM_SELECT_FD		FD_SETSIZE
 #else
 /*
     Windoze:
@@ -52,17 +63,27 @@ typedef	int	FDTYPE;
 #define	NUM_SELECT_FD		2000
 #endif
 
+/* Recordings store descriptors as 1 - 126, 127 is reserved. */
+#define NUM_RECORD_FD		127
+
+#define EPOLL_EVENTS		64
+
 struct io_handler {
     int			fd;
     void		(*func)(int, void *);
     void		*arg;
 };
 
-static struct io_handler	input_handlers[NUM_SELECT_FD];
-static struct io_handler	record_handlers[NUM_SELECT_FD];
+static struct io_handler	*input_handlers;	/* by fd - min_fd */
+static int			num_input_handlers;
+static struct io_handler	record_handlers[NUM_RECORD_FD];
 static fd_set			input_mask;
 int				max_fd, min_fd;
 static int			input_inited = false;
+#ifdef EPOLL_SCHED
+static int			epoll_fd = -1;
+static int			timer_fd = -1;
+#endif
 
 #if !defined(_WINDOWS)
 static volatile bool sched_running = false;
@@ -78,6 +99,79 @@ static void io_dummy(int fd, void *arg)
     xpprintf("io_dummy called!  (%d, %p)\n", fd, arg);
 }
 
+#ifdef EPOLL_SCHED
+/*
+ * Create the epoll instance and the frame timer.  If that fails
+ * the server falls back to select() and SIGALRM.
+ */
+static void sched_init_epoll(void)
+{
+    static bool inited = false;
+    struct epoll_event ev;
+
+    if (inited)
+	return;
+    inited = true;
+
+    if ((epoll_fd = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+	error("epoll_create1");
+	return;
+    }
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd == -1) {
+	error("timerfd_create");
+	close(epoll_fd);
+	epoll_fd = -1;
+	return;
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = timer_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev) == -1) {
+	error("epoll_ctl timer");
+	close(timer_fd);
+	close(epoll_fd);
+	timer_fd = epoll_fd = -1;
+    }
+}
+#endif
+
+/*
+ * Can we wait for input on fd?
+ */
+static bool sched_fd_ok(int fd)
+{
+    if (fd < min_fd)
+	return false;
+#ifdef EPOLL_SCHED
+    if (epoll_fd != -1)
+	return true;
+#endif
+#ifndef _WINDOWS
+    return fd < NUM_SELECT_FD;
+#else
+    return fd < min_fd + NUM_SELECT_FD;
+#endif
+}
+
+static void grow_input_handlers(int num)
+{
+    int i, n = MAX(num, 2 * num_input_handlers);
+    struct io_handler *ioh;
+
+    if ((ioh = XREALLOC(struct io_handler, input_handlers, n)) == NULL) {
+	error("Not enough memory for input handlers");
+	exit(1);
+    }
+    for (i = num_input_handlers; i < n; i++) {
+	ioh[i].fd = -1;
+	ioh[i].func = io_dummy;
+	ioh[i].arg = 0;
+    }
+    input_handlers = ioh;
+    num_input_handlers = n;
+}
+
 void install_input(void (*func)(int, void *), int fd, void *arg)
 {
     int i;
@@ -94,31 +188,65 @@ void install_input(void (*func)(int, void *), int fd, void *arg)
 	input_inited = true;
 	FD_ZERO(&input_mask);
 #ifndef _WINDOWS
-	min_fd = fd;
+	/*
+	 * Recorded descriptors are relative to the contact socket,
+	 * which the benchmark server never opens.
+	 */
+	min_fd = playback ? 0 : fd;
 #else
 	min_fd = 0;
 #endif
 	max_fd = fd;
-	for (i = 0; i < NELEM(input_handlers); i++) {
-	    input_handlers[i].fd = -1;
-	    input_handlers[i].func = io_dummy;
-	    input_handlers[i].arg = 0;
+	for (i = 0; i < NELEM(record_handlers); i++) {
+	    record_handlers[i].fd = -1;
+	    record_handlers[i].func = io_dummy;
+	    record_handlers[i].arg = 0;
 	}
+#ifdef EPOLL_SCHED
+	sched_init_epoll();
+#endif
     }
     /* IFWINDOWS(xpprintf("install_input: fd %d min_fd=%d\n", fd, min_fd)); */
-    if (!playback && (fd < min_fd || fd >= min_fd + NUM_SELECT_FD)) {
-	error("install illegal input handler fd %d (%d)", fd, min_fd);
-	exit(1);
+    if (playback) {
+	if (fd < min_fd || fd - min_fd >= NUM_RECORD_FD) {
+	    error("install illegal recorded input handler fd %d", fd);
+	    exit(1);
+	}
     }
-    if (!playback && FD_ISSET(fd, &input_mask)) {
-	error("input handler %d busy", fd);
-	exit(1);
+    else {
+	if (!sched_fd_ok(fd)) {
+	    error("install illegal input handler fd %d (%d)", fd, min_fd);
+	    exit(1);
+	}
+	if (fd - min_fd >= num_input_handlers)
+	    grow_input_handlers(fd - min_fd + 1);
+	handlers = input_handlers;
+	if (handlers[fd - min_fd].fd != -1) {
+	    error("input handler %d busy", fd);
+	    exit(1);
+	}
     }
     handlers[fd - min_fd].fd = fd;
     handlers[fd - min_fd].func = func;
     handlers[fd - min_fd].arg = arg;
     if (playback)
 	return;
+#ifdef EPOLL_SCHED
+    if (epoll_fd != -1) {
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+	    error("epoll_ctl add %d", fd);
+	    exit(1);
+	}
+	if (fd > max_fd)
+	    max_fd = fd;
+	return;
+    }
+#endif
     FD_SET(fd, &input_mask);
     if (fd > max_fd) {
 	max_fd = fd;
@@ -128,14 +256,22 @@ void install_input(void (*func)(int, void *), int fd, void *arg)
 void remove_input(int fd)
 {
     if (!playback) {
-	if (fd < min_fd || fd >= min_fd + NUM_SELECT_FD) {
+	if (!sched_fd_ok(fd)) {
 	    error("remove illegal input handler fd %d (%d)", fd, min_fd);
 	    exit(1);
 	}
-	if (FD_ISSET(fd, &input_mask) || playback) {
+	if (fd - min_fd < num_input_handlers
+	    && input_handlers[fd - min_fd].fd == fd) {
 	    input_handlers[fd - min_fd].fd = -1;
 	    input_handlers[fd - min_fd].func = io_dummy;
 	    input_handlers[fd - min_fd].arg = 0;
+#ifdef EPOLL_SCHED
+	    if (epoll_fd != -1) {
+		/* Fails harmlessly if fd was closed already. */
+		epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+		return;
+	    }
+#endif
 	    FD_CLR((FDTYPE)fd, &input_mask);
 	    if (fd == max_fd) {
 		int i = fd;
@@ -149,7 +285,7 @@ void remove_input(int fd)
 	    }
 	}
     }
-    else {
+    else if (fd >= 0 && fd < NUM_RECORD_FD) {
 	record_handlers[fd].fd = -1;
 	record_handlers[fd].func = io_dummy;
 	record_handlers[fd].arg = 0;
@@ -163,6 +299,216 @@ static void sched_select_error(void)
     End_game();
 }
 
+#ifndef _WINDOWS
+
+/*
+ * Call the input handler of fd, which select or epoll found readable.
+ */
+static void sched_dispatch(int fd)
+{
+    struct io_handler *ioh;
+    int i = fd - min_fd;
+
+    /* An earlier handler may have removed this one. */
+    if (i >= num_input_handlers || input_handlers[i].fd != fd)
+	return;
+
+    /* RECORDING STUFF */
+    record = playback = 0;
+    if (rrecord && i > 0) {
+	if (i + 1 >= NUM_RECORD_FD) { /* 127 reserved */
+	    warn("recording: this shouldn't happen");
+	    exit(1);
+	}
+	*playback_sched++ = i + 1;
+	record = 1;
+    }
+    /* RECORDING STUFF END */
+
+    ioh = &input_handlers[i];
+    (*(ioh->func))(ioh->fd, ioh->arg);
+
+    /* RECORDING STUFF */
+    record = rrecord;
+    playback = rplayback;
+    /* RECORDING STUFF END */
+}
+
+#ifndef SELECT_SCHED
+static void catch_timer(int signum);
+#endif
+
+#ifdef EPOLL_SCHED
+static int sched_epoll(struct timeval *tvp)
+{
+    struct epoll_event events[EPOLL_EVENTS];
+    int i, n, timeout = -1, num_called = 0;
+#ifdef SELECT_SCHED
+    static bool timer_armed = false;
+    struct itimerspec its;
+
+    /*
+     * The frame timer is armed to go off when the wait is over,
+     * epoll_wait() itself only has millisecond resolution.
+     */
+    memset(&its, 0, sizeof(its));
+    if (tvp != NULL && (tvp->tv_sec > 0 || tvp->tv_usec > 0)) {
+	its.it_value.tv_sec = tvp->tv_sec;
+	its.it_value.tv_nsec = tvp->tv_usec * 1000;
+	timerfd_settime(timer_fd, 0, &its, NULL);
+	timer_armed = true;
+    } else {
+	if (timer_armed) {
+	    timerfd_settime(timer_fd, 0, &its, NULL);
+	    timer_armed = false;
+	}
+	if (tvp != NULL)
+	    timeout = 0;
+    }
+#else
+    /* The timer runs all the time, see setup_timer(). */
+    if (tvp != NULL)
+	timeout = tvp->tv_sec * 1000 + tvp->tv_usec / 1000;
+#endif
+
+    n = epoll_wait(epoll_fd, events, EPOLL_EVENTS, timeout);
+    if (n <= 0)
+	return n;
+
+    for (i = 0; i < n; i++) {
+	int fd = events[i].data.fd;
+
+	if (fd == timer_fd) {
+	    uint64_t expirations;
+
+	    if (read(timer_fd, &expirations, sizeof(expirations))
+		!= sizeof(expirations))
+		continue;
+#ifdef SELECT_SCHED
+	    timer_armed = false;
+#else
+	    while (expirations-- > 0)
+		catch_timer(SIGALRM);
+#endif
+	    continue;
+	}
+	sched_dispatch(fd);
+	num_called++;
+    }
+
+    return num_called;
+}
+#endif
+
+static int sched_select(struct timeval *tvp)
+{
+    fd_set readmask = input_mask;
+    int i, n, num_called = 0;
+
+    n = select(max_fd + 1, &readmask, NULL, NULL, tvp);
+    if (n <= 0)
+	return n;
+
+    for (i = max_fd; i >= min_fd; i--) {
+	if (FD_ISSET(i, &readmask)) {
+	    sched_dispatch(i);
+	    num_called++;
+	    if (--n == 0)
+		break;
+	}
+    }
+
+    return num_called;
+}
+
+/*
+ * Wait at most *tvp for input, forever if tvp is NULL, and call
+ * the handlers of the descriptors that are readable.  Returns the
+ * number of handlers called, 0 on timeout and -1 on error like select.
+ */
+static int sched_poll(struct timeval *tvp)
+{
+#ifdef EPOLL_SCHED
+    if (epoll_fd != -1)
+	return sched_epoll(tvp);
+#endif
+    return sched_select(tvp);
+}
+
+#endif /* _WINDOWS */
+
+/*
+ * Replay the input recorded for the coming frame,
+ * or mark the frame boundary when recording.
+ */
+static void playback_tick(void)
+{
+    if (playback) {
+	while (*playback_sched) {
+	    if (*playback_sched == 127) {
+		playback_sched++;
+		Get_recording_data();
+	    }
+	    else {
+		struct io_handler *ioh;
+		ioh = &record_handlers[*playback_sched++ - 1];
+		(*(ioh->func))(ioh->fd, ioh->arg);
+	    }
+	}
+	playback_sched++;
+    }
+    else if (record)
+	*playback_sched++ = 0;
+}
+
+/*
+ * Handle the input which is waiting on any descriptor right now,
+ * without waiting for more.  Main_loop() calls this just before
+ * Input(), so that all client input which has arrived by then is
+ * used in the coming frame.  Not while recording or playing back,
+ * the recorded input has to stay between the same frames.
+ */
+void sched_drain(void)
+{
+#ifndef _WINDOWS
+    struct timeval tv;
+
+    if (!input_inited || rrecord || rplayback)
+	return;
+
+    tv.tv_sec = 0;
+    tv.tv_usec = 0;
+    if (sched_poll(&tv) == -1 && errno != EINTR)
+	sched_select_error();
+#endif
+}
+
+/*
+ * Run func for n frames back to back without waiting for
+ * the timer.  Input that is already there is handled before
+ * each frame, recorded input is replayed as usual.  Used by
+ * the benchmark server.
+ */
+void sched_ticks(void (*func)(void), unsigned long n)
+{
+    playback = rplayback;
+
+    while (n-- > 0) {
+	Handle_recording_buffers();
+	playback_tick();
+#ifndef _WINDOWS
+	if (input_inited && !playback) {
+	    struct timeval tv;
+
+	    tv.tv_sec = 0;
+	    tv.tv_usec = 0;
+	    sched_poll(&tv);
+	}
+#endif
+	(*func)();
+    }
+}
+
 #ifdef SELECT_SCHED
 
 static long	timer_freq;
@@ -212,7 +558,7 @@ unsigned long skip_to = 0;
  */
 void sched(void)
 {
-    int i, n;
+    int n;
     double t_now, t_wait;
     struct timeval tv, wait_tv;
 
@@ -228,8 +574,6 @@ void sched(void)
     t_nextframe = t_now + frametime;
 
     while (sched_running) {
-	fd_set readmask = input_mask;
-
 	gettimeofday(&tv, NULL);
 	t_now = timeval_to_seconds(&tv);
 	t_wait = t_nextframe - t_now;
@@ -260,29 +604,14 @@ void sched(void)
 	/* RECORDING STUFF END */
 
 	wait_tv = seconds_to_timeval(t_wait);
-	n = select(max_fd + 1, &readmask, NULL, NULL, &wait_tv);
+	n = sched_poll(&wait_tv);
 
 	if (n <= 0) {
 	    if (n == -1 && errno != EINTR)
 		sched_select_error();
 
 	    /* RECORDING STUFF */
-	    if (playback) {
-		while (*playback_sched) {
-		    if (*playback_sched == 127) {
-			playback_sched++;
-			Get_recording_data();
-		    }
-		    else {
-			struct io_handler *ioh;
-			ioh = &record_handlers[*playback_sched++ - 1];
-			(*(ioh->func))(ioh->fd, ioh->arg);
-		    }
-		}
-		playback_sched++;
-	    }
-	    else if (record)
-		*playback_sched++ = 0;
+	    playback_tick();
 	    /* RECORDING STUFF END */
 
 	    if (timer_handler)
@@ -295,36 +624,6 @@ void sched(void)
 	    t_nextframe += frametime;
 #endif
 	}
-	else {
-	    for (i = max_fd; i >= min_fd; i--) {
-		if (FD_ISSET(i, &readmask)) {
-		    struct io_handler *ioh;
-
-		    /* RECORDING STUFF */
-		    record = playback = 0;
-		    if (rrecord && (i - min_fd > 0)) {
-			if (i - min_fd + 1 > 126) { /* 127 reserved */
-			    warn("recording: this shouldn't happen");
-			    exit(1);
-			}
-			*playback_sched++ = i - min_fd + 1;
-			record = 1;
-		    }
-		    /* RECORDING STUFF END */
-
-		    ioh = &input_handlers[i - min_fd];
-		    (*(ioh->func))(ioh->fd, ioh->arg);
-
-		    /* RECORDING STUFF */
-		    record = rrecord;
-		    playback = rplayback;
-		    /* RECORDING STUFF END */
-
-		    if (--n == 0)
-			break;
-		}
-	    }
-	}
     }
 }
 
@@ -414,6 +713,34 @@ static void setup_timer(void)
     struct itimerval itv;
     struct sigaction act;
 
+    if (timer_freq <= 0 || timer_freq > MAX_SERVER_FPS) {
+	error("illegal timer frequency: %ld", timer_freq);
+	exit(1);
+    }
+
+#ifdef EPOLL_SCHED
+    /*
+     * The timerfd is read by sched_epoll(), which counts the
+     * expirations with catch_timer() as if they were SIGALRMs.
+     */
+    sched_init_epoll();
+    if (epoll_fd != -1) {
+	struct itimerspec its;
+
+	its.it_interval.tv_sec = 0;
+	its.it_interval.tv_nsec = 1000000000 / timer_freq;
+	its.it_value = its.it_interval;
+	if (timerfd_settime(timer_fd, 0, &its, NULL) == -1) {
+	    error("timerfd_settime");
+	    exit(1);
+	}
+	timers_used = timer_ticks;
+	time(&current_time);
+	ticks_till_second = timer_freq;
+	return;
+    }
+#endif
+
     /*
      * Prevent SIGALRMs from disturbing the initialization.
      */
@@ -434,11 +761,6 @@ static void setup_timer(void)
     /*
      * Install a real-time timer.
      */
-    if (timer_freq <= 0 || timer_freq > MAX_SERVER_FPS) {
-	error("illegal timer frequency: %ld", timer_freq);
-	exit(1);
-    }
-
     itv.it_interval.tv_sec = 0;
     itv.it_interval.tv_usec = 1000000 / timer_freq;
     itv.it_value = itv.it_interval;
@@ -619,7 +941,7 @@ long skip_to = 0;
 #ifndef _WINDOWS
 void sched(void)
 {
-    int			i, n, io_todo = 3;
+    int			n, io_todo = 3;
     struct timeval	tv, *tvp = &tv;
 
     playback = rplayback;
@@ -639,22 +961,7 @@ void sched(void)
 	if (io_todo == 0 && timers_used < timer_ticks) {
 	    io_todo = 1 + (timer_ticks - timers_used);
 	    tvp = &tv;
-	    if (playback) {
-		while (*playback_sched) {
-		    if (*playback_sched == 127) {
-			playback_sched++;
-			Get_recording_data();
-		    }
-		    else {
-			struct io_handler *ioh;
-			ioh = &record_handlers[*playback_sched++ - 1];
-			(*(ioh->func))(ioh->fd, ioh->arg);
-		    }
-		}
-		playback_sched++;
-	    }
-	    else if (record)
-		*playback_sched++ = 0;
+	    playback_tick();
 
 	    if (timer_handler)
 		(*timer_handler)();
@@ -669,37 +976,14 @@ void sched(void)
 	    } while (timers_used + 1 < timer_ticks);
 	}
 	else {
-	    fd_set readmask;
-	    readmask = input_mask;
 	    Handle_recording_buffers();
-	    n = select(max_fd + 1, &readmask, 0, 0, tvp);
+	    n = sched_poll(tvp);
 	    if (n <= 0) {
 		if (n == -1 && errno != EINTR)
 		    sched_select_error();
 		io_todo = 0;
 	    }
 	    else {
-		for (i = max_fd; i >= min_fd; i--) {
-		    if (FD_ISSET(i, &readmask)) {
-			struct io_handler *ioh;
-
-			record = playback = 0;
-			if (rrecord && (i - min_fd > 0)) {
-			    if (i - min_fd + 1 > 126) { /* 127 reserved */
-				warn("recording: this shouldn't happen");
-				exit(1);
-			    }
-			    *playback_sched++ = i - min_fd + 1;
-			    record = 1;
-			}
-			ioh = &input_handlers[i - min_fd];
-			(*(ioh->func))(ioh->fd, ioh->arg);
-			record = rrecord;
-			playback = rplayback;
-			if (--n == 0)
-			    break;
-		    }
-		}
 		if (io_todo > 0)
 		    io_todo--;
 	    }
@@ -33,6 +33,8 @@ void install_input(void (*func)(int, void *), int fd, void *arg);
 void remove_input(int fd);
 void sched(void);
 void stop_sched(void);
+void sched_drain(void);
+void sched_ticks(void (*func)(void), unsigned long n);
 
 #ifdef SELECT_SCHED
 
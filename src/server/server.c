@@ -110,6 +110,10 @@ int main(int argc, char **argv)
     /* Make trigonometric tables */
     Make_table();
 
+#ifdef SERVER_BENCH
+    Bench_init(&argc, &argv);
+#endif
+
     if (!Parser(argc, argv))
 	exit(1);
 
@@ -124,8 +128,9 @@ int main(int argc, char **argv)
     /* Allocate memory for players, shots and messages */
     Alloc_players(Num_bases() + MAX_PSEUDO_PLAYERS + MAX_SPECTATORS);
     spectatorStart = Num_bases() + MAX_PSEUDO_PLAYERS;
-    Alloc_shots(MAX_TOTAL_SHOTS);
+    Alloc_shots();
     Alloc_cells();
+    Nav_init();
 
     Move_init();
     Robot_init();
@@ -155,10 +160,12 @@ int main(int argc, char **argv)
     /* Log, if enabled. */
     Log_game("START");
 
+#ifndef SERVER_BENCH
     if (!Contact_init())
 	End_game();
 
     Meta_init();
+#endif
 
     Timing_setup();
     Check_playerlimit();
@@ -189,6 +196,10 @@ int main(int argc, char **argv)
 
     teamcup_init();
 
+#ifdef SERVER_BENCH
+    Bench_run();
+#endif
+
 #ifdef SELECT_SCHED
     install_timer_tick(Main_loop, FPS);
 #else
@@ -237,7 +248,10 @@ void Main_loop(void)
 	    ShutdownServer--;
     }
 
+    Bench_start(BENCH_INPUT);
+    sched_drain();
     Input();
+    Bench_stop(BENCH_INPUT);
 
     if (NumPlayers > NumRobots + NumPseudoPlayers || options.RawMode) {
 
@@ -253,10 +267,15 @@ void Main_loop(void)
 	    }
 	}
 
+	Bench_start(BENCH_UPDATE);
 	Update_objects();
+	Bench_stop(BENCH_UPDATE);
 
-	if ((main_loops % CONF_UPDATES_PR_FRAME) == 0)
+	if ((main_loops % CONF_UPDATES_PR_FRAME) == 0) {
+	    Bench_start(BENCH_FRAME);
 	    Frame_update();
+	    Bench_stop(BENCH_FRAME);
+	}
     }
 
     if (!options.NoQuit
@@ -59,7 +59,7 @@ typedef struct
 #define NumObjs (ObjCount + 0)
 #define MAX_SPECTATORS 8
 
-extern object_t *Obj[];
+extern object_t **Obj;
 extern long frame_loops;
 extern long frame_loops_slow;
 extern double frame_time;
@@ -70,6 +70,7 @@ extern int NumOperators;
 extern int NumPseudoPlayers;
 extern int NumQueuedPlayers;
 extern int ObjCount;
+extern int ObjMax;
 extern int NumAlliances;
 extern int NumRobots;
 extern int login_in_progress;
@@ -100,9 +101,39 @@ extern double coriolisCosine, coriolisSine;
 
 extern shape_t ball_wire, wormhole_wire, filled_wire;
 
+/* 16 bit IEEE half precision float, as stored by the compactGravity grid. */
+static inline float Half_to_float(uint16_t h)
+{
+	union { float f; uint32_t u; } v;
+	uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+	uint32_t exp = (h >> 10) & 0x1f, mant = h & 0x3ff;
+
+	if (exp == 0)
+	{
+		v.f = mant * (1.0f / 16777216.0f);
+		v.u |= sign;
+	}
+	else if (exp == 31)
+		v.u = sign | 0x7f800000 | (mant << 13);
+	else
+		v.u = sign | ((exp + 112) << 23) | (mant << 13);
+	return v.f;
+}
+
 static inline vector_t World_gravity(clpos_t pos)
 {
-	return world->gravity[CLICK_TO_BLOCK(pos.cx)][CLICK_TO_BLOCK(pos.cy)];
+	int bx = CLICK_TO_BLOCK(pos.cx), by = CLICK_TO_BLOCK(pos.cy);
+
+	if (world->gravity16)
+	{
+		const uint16_t *h = &world->gravity16[2 * (bx * world->y + by)];
+		vector_t grav;
+
+		grav.x = Half_to_float(h[0]);
+		grav.y = Half_to_float(h[1]);
+		return grav;
+	}
+	return world->gravity[bx][by];
 }
 
 static inline double SHOT_MULT(object_t *obj)
@@ -123,14 +154,18 @@ static inline double SHOT_MULT(object_t *obj)
  */
 void Free_cells(void);
 void Alloc_cells(void);
+void Cell_tune_grid(void);
+void Cell_flush_pending(void);
 void Cell_init_object(object_t *obj);
 void Cell_add_object(object_t *obj);
+void Cell_add_objects(object_t **objs, int num);
 void Cell_remove_object(object_t *obj);
-void Cell_get_objects(clpos_t pos, int r, int max, object_t ***list, int *count);
+int Cell_get_objects(clpos_t pos, int r, int max, object_t **list);
 
 /*
  * Prototypes for collision.c
  */
+extern int collision_pairs;
 void Check_collision(void);
 int IsOffensiveItem(enum Item i);
 int IsDefensiveItem(enum Item i);
@@ -152,6 +187,7 @@ void Walls_init(void);
 void Treasure_init(void);
 void Move_init(void);
 void Move_object(object_t *obj);
+bool Move_object_unobstructed(object_t *obj, clvec_t delta);
 void Move_player(player_t *pl);
 void Turn_player(player_t *pl, bool push);
 int is_inside(int x, int y, hitmask_t hitmask, const object_t *obj);
@@ -162,6 +198,10 @@ void Ball_line_init(void);
 void Player_crash(player_t *pl, int crashtype, int mapobj_ind, int pt);
 void Object_crash(object_t *obj, int crashtype, int mapobj_ind);
 void Move_point(const move_t *move, struct collans *answer);
+void Walls_free(void);
+#ifdef SERVER_BENCH
+long Lines_prefilter_check(long n, long *tested);
+#endif
 
 /*
  * Prototypes for event.c
@@ -194,9 +234,21 @@ int World_place_friction_area(clpos_t pos, double fric);
 void Wormhole_line_init(void);
 
 void Compute_gravity(void);
+void Grav_changed(int ind, clpos_t old_pos);
+void Gravity_free(void);
+#ifdef SERVER_BENCH
+long Gravity_check(long n, double *changed_us, double *full_us);
+#endif
 double Wrap_findDir(double dx, double dy);
 double Wrap_cfindDir(int dx, int dy);
+int Wrap_findDir_rounded(double dx, double dy);
+int Wrap_cfindDir_rounded(int dx, int dy);
 double Wrap_length(int dx, int dy);
+int World_objects_in_range(int type, clpos_t pos, double range,
+			   int *list, int max);
+int World_nearest_objects(int type, clpos_t pos, double range, int k,
+			  int *list, bool (*accept)(int ind, void *arg),
+			  void *arg);
 int Find_closest_team(clpos_t pos);
 
 /*
@@ -242,6 +294,7 @@ static inline void Player_add_fuel(player_t *pl, double amount)
 
 void Place_item(player_t *pl, int type);
 int Choose_random_item(void);
+int Choose_item_by_frac(double frac);
 void Tractor_beam(player_t *pl);
 void General_tractor_beam(int id, clpos_t pos,
 						  int items, player_t *victim, bool pressor);
@@ -277,6 +330,7 @@ void Do_general_transporter(int id, clpos_t pos,
 							player_t *victim, int *item, double *amount);
 void do_lose_item(player_t *pl);
 void Update_torpedo(torpobject_t *torp);
+void Missile_guidance_update(void);
 void Update_missile(missileobject_t *shot);
 void Update_mine(mineobject_t *mine);
 void Make_item(clpos_t pos,
@@ -377,6 +431,27 @@ void Server_log_admin_message(player_t *pl, const char *str);
 int plock_server(bool on);
 void Main_loop(void);
 
+/*
+ * Prototypes for bench.c
+ */
+#ifdef SERVER_BENCH
+enum bench_phase {
+	BENCH_INPUT,
+	BENCH_UPDATE,
+	BENCH_ROBOT,
+	BENCH_COLLISION,
+	BENCH_FRAME,
+	NUM_BENCH_PHASES
+};
+void Bench_init(int *argcp, char ***argvp);
+void Bench_run(void);
+void Bench_start(int phase);
+void Bench_stop(int phase);
+#else
+#define Bench_start(phase)	((void)0)
+#define Bench_stop(phase)	((void)0)
+#endif
+
 /*
  * Prototypes for contact.c
  */
@@ -399,6 +474,15 @@ void Meta_init(void);
 void Meta_update(bool change);
 void Meta_update_max_size_tuner(void);
 
+/*
+ * Prototypes for nav.c
+ */
+void Nav_init(void);
+void Nav_target_changed(target_t *targ);
+void Nav_cannon_changed(cannon_t *cannon);
+bool Nav_nearest(int kind, int which, clpos_t pos, int *ind, double *dist);
+bool Nav_waypoint(int kind, int which, clpos_t pos, clpos_t *wp);
+
 /*
  * Prototypes for frame.c
  */
@@ -462,11 +546,14 @@ void Alliance_player_list(player_t *pl);
 /*
  * Prototypes for object.c
  */
-object_t *Object_allocate(void);
+object_t *Object_allocate(int type);
+int Object_allocate_many(int type, object_t **objs, int num);
+int Object_room(int type);
 void Object_free_ind(int ind);
 void Object_free_ptr(object_t *obj);
-void Alloc_shots(int number);
+void Alloc_shots(void);
 void Free_shots(void);
+void Object_pool_report(char *buf, size_t size);
 const char *Object_typename(object_t *obj);
 
 /*
@@ -103,8 +103,6 @@
 #define MIN_CANNON_ID		(EXPIRED_MINE_ID + 1)
 #define MAX_CANNON_ID		(EXPIRED_MINE_ID + NUM_CANNON_IDS)
 
-#define MAX_TOTAL_SHOTS		16384	/* must be <= 65536 */
-
 /*
  * Energy drainage
  */
@@ -252,4 +250,12 @@
 /* Maximum frames per second the server code supports. */
 #define MAX_SERVER_FPS		255
 
+/* Kinds of map objects robots can navigate to, see nav.c. */
+#define NAV_FUEL		0
+#define NAV_TARGET		1
+#define NAV_CANNON		2
+#define NAV_TREASURE		3
+#define NUM_NAV_KINDS		4
+#define NAV_CHECK		NUM_NAV_KINDS
+
 #endif
@@ -526,7 +526,45 @@ void Tank_handle_detach(player_t *pl)
  * Functions for explosions.
  */
 
-/* Create debris particles */
+/*
+ * Scratch space for Make_debris(), grown to the largest burst so far.
+ * rnd holds the four random numbers each particle uses, in the order
+ * the particle would have drawn them.
+ */
+static struct {
+    int		max;
+    object_t	**obj;
+    double	*rnd;
+} debris_buf;
+
+static bool Debris_buf_grow(int num)
+{
+    object_t **obj;
+    double *rnd;
+
+    if (num <= debris_buf.max)
+	return true;
+
+    num = MAX(num, 2 * debris_buf.max);
+    obj = XREALLOC(object_t *, debris_buf.obj, num);
+    if (obj == NULL)
+	return false;
+    debris_buf.obj = obj;
+    rnd = XREALLOC(double, debris_buf.rnd, 4 * num);
+    if (rnd == NULL)
+	return false;
+    debris_buf.rnd = rnd;
+    debris_buf.max = num;
+
+    return true;
+}
+
+/*
+ * Create debris particles.  The objects are allocated, given their
+ * random numbers and put in the cell structure all at once, which
+ * matters for big nukes, but the result is the same as making them
+ * one by one.
+ */
 void Make_debris(clpos_t  pos,
 		 vector_t vel,
 		 int      owner_id,
@@ -541,9 +579,10 @@ void Make_debris(clpos_t  pos,
 		 double   min_speed, double  max_speed,
 		 double   min_life,  double  max_life)
 {
-    object_t *debris;
+    object_t *debris, **objs;
     int i;
-    double life;
+    double *r;
+    bool ke_mass;
     modifiers_t mods;
 
     if (!options.useDebris)
@@ -567,48 +606,57 @@ void Make_debris(clpos_t  pos,
 	    CLR_BIT(status, GRAVITY);
     }
 
-    if (num_debris > MAX_TOTAL_SHOTS - NumObjs)
-	num_debris = MAX_TOTAL_SHOTS - NumObjs;
+    if (num_debris > Object_room(type))
+	num_debris = Object_room(type);
+    if (num_debris <= 0)
+	return;
+
+    if (!Debris_buf_grow(num_debris)) {
+	error("No memory for debris");
+	return;
+    }
+    objs = debris_buf.obj;
+    num_debris = Object_allocate_many(type, objs, num_debris);
+    rfrac_fill(debris_buf.rnd, 4 * num_debris);
+
+    ke_mass = (options.shotHitFuelDrainUsesKineticEnergy && type == OBJ_SHOT);
 
-    for (i = 0; i < num_debris; i++) {
+    for (i = 0, r = debris_buf.rnd; i < num_debris; i++, r += 4) {
 	double speed, dx, dy, diroff;
 	int dir, dirplus;
 
-	if ((debris = Object_allocate()) == NULL)
-	    break;
-
+	debris = objs[i];
+	debris->type = type;
 	debris->color = color;
 	debris->id = owner_id;
 	debris->team = owner_team;
 	Object_position_init_clpos(debris, pos);
-	dir = MOD2(min_dir + (int)(rfrac() * (max_dir - min_dir)), RES);
+	dir = MOD2(min_dir + (int)(r[0] * (max_dir - min_dir)), RES);
 	dirplus = MOD2(dir + 1, RES);
-	diroff = rfrac();
+	diroff = r[1];
 	dx = tcos(dir) + (tcos(dirplus) - tcos(dir)) * diroff;
 	dy = tsin(dir) + (tsin(dirplus) - tsin(dir)) * diroff;
-	speed = min_speed + rfrac() * (max_speed - min_speed);
+	speed = min_speed + r[2] * (max_speed - min_speed);
 	debris->vel.x = vel.x + dx * speed;
 	debris->vel.y = vel.y + dy * speed;
 	debris->acc.x = 0;
 	debris->acc.y = 0;
-	if (options.shotHitFuelDrainUsesKineticEnergy
-	    && type == OBJ_SHOT) {
+	if (ke_mass) {
 	    /* compensate so that m*v^2 is constant */
 	    double sp_shotsp = speed / options.shotSpeed;
 
 	    debris->mass = mass / (sp_shotsp * sp_shotsp);
 	} else
 	    debris->mass = mass;
-	debris->type = type;
-	life = min_life + rfrac() * (max_life - min_life);
-	debris->life = life;
+	debris->life = min_life + r[3] * (max_life - min_life);
 	debris->fuse = 0;
 	debris->pl_range = radius;
 	debris->pl_radius = radius;
 	debris->obj_status = status;
 	debris->mods = mods;
-	Cell_add_object(debris);
     }
+
+    Cell_add_objects(objs, num_debris);
 }
 
 
@@ -642,8 +690,8 @@ void Make_wreckage(clpos_t  pos,
     if (max_speed < min_speed)
 	max_speed = min_speed;
 
-    if (max_wreckage > MAX_TOTAL_SHOTS - NumObjs)
-	max_wreckage = MAX_TOTAL_SHOTS - NumObjs;
+    if (max_wreckage > Object_room(OBJ_WRECKAGE))
+	max_wreckage = Object_room(OBJ_WRECKAGE);
 
     Mods_clear(&mods);
 
@@ -662,7 +710,7 @@ void Make_wreckage(clpos_t  pos,
 	    break;
 
 	/* Allocate object */
-	if ((wreckage = WIRE_PTR(Object_allocate())) == NULL)
+	if ((wreckage = WIRE_PTR(Object_allocate(OBJ_WRECKAGE))) == NULL)
 	    break;
 
 	wreckage->color = WHITE;
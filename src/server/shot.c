@@ -107,7 +107,7 @@ void Place_general_mine(int id, int team, int status,
     player_t *pl = Player_by_id(id);
     cannon_t *cannon = Cannon_by_id(id);
 
-    if (NumObjs + Mods_get(mods, ModsMini) >= MAX_TOTAL_SHOTS)
+    if (Mods_get(mods, ModsMini) >= Object_room(OBJ_MINE))
 	return;
 
     pos = World_wrap_clpos(pos);
@@ -196,7 +196,7 @@ void Place_general_mine(int id, int team, int status,
     for (i = 0; i < minis; i++) {
 	mineobject_t *mine;
 
-	if ((mine = MINE_PTR(Object_allocate())) == NULL)
+	if ((mine = MINE_PTR(Object_allocate(OBJ_MINE))) == NULL)
 	    break;
 
 	mine->type = OBJ_MINE;
@@ -464,7 +464,7 @@ void Fire_general_shot(int id, int team,
     player_t *pl = Player_by_id(id);
     cannon_t *cannon = Cannon_by_id(id);
 
-    if (NumObjs >= MAX_TOTAL_SHOTS)
+    if (Object_room(type) == 0)
 	return;
 
     if (!Mods_get(mods, ModsCluster))
@@ -513,7 +513,7 @@ void Fire_general_shot(int id, int team,
 	/*
 	 * Make sure there are enough object entries for the mini shots.
 	 */
-	if (NumObjs + Mods_get(mods, ModsMini) >= MAX_TOTAL_SHOTS)
+	if (Mods_get(mods, ModsMini) >= Object_room(type))
 	    return;
 
 	if (pl && pl->item[ITEM_MISSILE] <= 0)
@@ -854,7 +854,7 @@ void Fire_general_shot(int id, int team,
     for (r = 0, i = 0; i < minis; i++, r++) {
 	object_t *shot;
 
-	if ((shot = Object_allocate()) == NULL)
+	if ((shot = Object_allocate(type)) == NULL)
 	    break;
 
 	shot->life 	= life / minis;
@@ -1504,12 +1504,165 @@ void Update_torpedo(torpobject_t *torp)
     torp->vel.y += acc * tsin(torp->missile_dir);
 }
 
+/*
+ * Missile guidance is done in two steps.  Before the objects are
+ * updated, Missile_guidance_update() goes through all the smart and
+ * heat missiles at once and works out what doesn't need random
+ * numbers: the speed of the missile, the range to the player it is
+ * locked on and, for smart missiles, the direction to fly to.
+ * Update_missile() uses these unless the missile has changed target,
+ * so random numbers are still drawn in the same order.  The thrusting
+ * players which heat seekers can find are listed only once, when the
+ * first heat seeker looks for a target.
+ */
+static struct {
+    int			num, max;
+    int			next;		/* next one for Update_missile() */
+    missileobject_t	**obj;
+    int			*lock_id;	/* player the values are for */
+    double		*speed;		/* length of velocity, at least 1 */
+    double		*range;		/* to the player, in pixels */
+    double		*heat_range;	/* to the engine, heat seekers */
+    int			*theta;		/* where to fly, smart missiles */
+} guide;
+
+static struct {
+    int			num, max;
+    bool		ready;		/* listed this update */
+    player_t		**pl;
+    clpos_t		*engine;	/* position + engine, not wrapped */
+} heat_src;
+
+static void Missile_guidance_alloc(void)
+{
+    XFREE(guide.obj);
+    XFREE(guide.lock_id);
+    XFREE(guide.speed);
+    XFREE(guide.range);
+    XFREE(guide.heat_range);
+    XFREE(guide.theta);
+    guide.max = ObjMax;
+    guide.obj = XMALLOC(missileobject_t *, guide.max);
+    guide.lock_id = XMALLOC(int, guide.max);
+    guide.speed = XMALLOC(double, guide.max);
+    guide.range = XMALLOC(double, guide.max);
+    guide.heat_range = XMALLOC(double, guide.max);
+    guide.theta = XMALLOC(int, guide.max);
+    if (!guide.obj || !guide.lock_id || !guide.speed || !guide.range
+	|| !guide.heat_range || !guide.theta) {
+	error("No memory for missile guidance");
+	End_game();
+    }
+}
+
+static void Missile_heat_sources(void)
+{
+    int i;
+
+    if (heat_src.max < NumPlayers) {
+	XFREE(heat_src.pl);
+	XFREE(heat_src.engine);
+	heat_src.max = NumPlayers;
+	heat_src.pl = XMALLOC(player_t *, heat_src.max);
+	heat_src.engine = XMALLOC(clpos_t, heat_src.max);
+	if (!heat_src.pl || !heat_src.engine) {
+	    error("No memory for missile guidance");
+	    End_game();
+	}
+    }
+
+    heat_src.num = 0;
+    for (i = 0; i < NumPlayers; i++) {
+	player_t *pl = Player_by_index(i);
+	clpos_t engine;
+
+	if (!Player_is_thrusting(pl))
+	    continue;
+
+	engine = Ship_get_engine_clpos(pl->ship, pl->dir);
+	heat_src.pl[heat_src.num] = pl;
+	heat_src.engine[heat_src.num].cx = pl->pos.cx + engine.cx;
+	heat_src.engine[heat_src.num].cy = pl->pos.cy + engine.cy;
+	heat_src.num++;
+    }
+    heat_src.ready = true;
+}
+
+void Missile_guidance_update(void)
+{
+    int i, k, n = 0;
+
+    if (guide.max != ObjMax)
+	Missile_guidance_alloc();
+
+    /* Missiles which warp this update are left to Update_missile(). */
+    for (i = 0; i < NumObjs; i++) {
+	object_t *obj = Obj[i];
+	player_t *pl;
+	int id;
+
+	if (obj->type == OBJ_SMART_SHOT)
+	    id = SMART_PTR(obj)->smart_lock_id;
+	else if (obj->type == OBJ_HEAT_SHOT)
+	    id = HEAT_PTR(obj)->heat_lock_id;
+	else
+	    continue;
+	if (BIT(obj->obj_status, WARPING|WARPED)
+	    || id < 0
+	    || (pl = Player_by_id(id)) == NULL)
+	    continue;
+
+	guide.obj[n] = MISSILE_PTR(obj);
+	guide.lock_id[n] = id;
+	n++;
+    }
+    guide.num = n;
+    guide.next = 0;
+    heat_src.ready = false;
+
+    /* Same arithmetic as in Update_missile(). */
+    for (k = 0; k < n; k++) {
+	missileobject_t *missile = guide.obj[k];
+	player_t *pl = Player_by_id(guide.lock_id[k]);
+	double speed, range, x_dif, y_dif;
+
+	if ((speed = VECTOR_LENGTH(missile->vel)) < 1)
+	    speed = 1;
+	range = Wrap_length(pl->pos.cx - missile->pos.cx,
+			    pl->pos.cy - missile->pos.cy) / CLICK;
+	guide.speed[k] = speed;
+	guide.range[k] = range;
+
+	if (missile->type == OBJ_HEAT_SHOT) {
+	    clpos_t engine = Ship_get_engine_clpos(pl->ship, pl->dir);
+
+	    guide.heat_range[k]
+		= Wrap_length(pl->pos.cx + engine.cx - missile->pos.cx,
+			      pl->pos.cy + engine.cy - missile->pos.cy)
+		/ CLICK;
+	    continue;
+	}
+
+	x_dif = pl->vel.x * (range / speed);
+	y_dif = pl->vel.y * (range / speed);
+	guide.theta[k]
+	    = Wrap_cfindDir_rounded(pl->pos.cx + PIXEL_TO_CLICK(x_dif)
+				    - missile->pos.cx,
+				    pl->pos.cy + PIXEL_TO_CLICK(y_dif)
+				    - missile->pos.cy);
+    }
+}
+
 void Update_missile(missileobject_t *missile)
 {
     player_t *pl;
-    int angle, theta;
+    int angle, theta, g = -1;
     double range = 0.0, acc = SMART_SHOT_ACC;
-    double x_dif = 0.0, y_dif = 0.0, shot_speed, a;
+    double x_dif = 0.0, y_dif = 0.0, shot_speed;
+
+    /* Called in Obj[] order, so the values are the next ones, if any. */
+    if (guide.next < guide.num && guide.obj[guide.next] == missile)
+	g = guide.next++;
 
     if (missile->type == OBJ_HEAT_SHOT) {
 	heatobject_t *heat = HEAT_PTR(missile);
@@ -1523,10 +1676,14 @@ void Update_missile(missileobject_t *missile)
 	    /* kps - bandaid since Player_by_id can return NULL. */
 	    if (!pl)
 		return;
-	    engine = Ship_get_engine_clpos(pl->ship, pl->dir);
-	    range = Wrap_length(pl->pos.cx + engine.cx - heat->pos.cx,
-				pl->pos.cy + engine.cy - heat->pos.cy)
-		/ CLICK;
+	    if (g >= 0)
+		range = guide.heat_range[g];
+	    else {
+		engine = Ship_get_engine_clpos(pl->ship, pl->dir);
+		range = Wrap_length(pl->pos.cx + engine.cx - heat->pos.cx,
+				    pl->pos.cy + engine.cy - heat->pos.cy)
+		    / CLICK;
+	    }
 	} else {
 	    /* No player. Number of moves so that new target is searched */
 	    pl = NULL;
@@ -1555,16 +1712,13 @@ void Update_missile(missileobject_t *missile)
 		int i;
 
 		range = HEAT_RANGE * (heat->heat_count / HEAT_CLOSE_TIMEOUT);
-		for (i = 0; i < NumPlayers; i++) {
-		    player_t *pl_i = Player_by_index(i);
-		    clpos_t engine;
-
-		    if (!Player_is_thrusting(pl_i))
-			continue;
+		if (!heat_src.ready)
+		    Missile_heat_sources();
+		for (i = 0; i < heat_src.num; i++) {
+		    player_t *pl_i = heat_src.pl[i];
 
-		    engine = Ship_get_engine_clpos(pl_i->ship, pl_i->dir);
-		    l = Wrap_length(pl_i->pos.cx + engine.cx - heat->pos.cx,
-				    pl_i->pos.cy + engine.cy - heat->pos.cy)
+		    l = Wrap_length(heat_src.engine[i].cx - heat->pos.cx,
+				    heat_src.engine[i].cy - heat->pos.cy)
 			/ CLICK;
 		    /*
 		     * After burners can be detected easier;
@@ -1652,15 +1806,26 @@ void Update_missile(missileobject_t *missile)
      */
     acc *= (1 + (Mods_get(missile->mods, ModsPower)
 		 * MISSILE_POWER_SPEED_FACT));
-    if ((shot_speed = VECTOR_LENGTH(missile->vel)) < 1)
-	shot_speed = 1;
-    range = Wrap_length(pl->pos.cx - missile->pos.cx,
-			pl->pos.cy - missile->pos.cy) / CLICK;
-    x_dif += pl->vel.x * (range / shot_speed);
-    y_dif += pl->vel.y * (range / shot_speed);
-    a = Wrap_cfindDir(pl->pos.cx + PIXEL_TO_CLICK(x_dif) - missile->pos.cx,
-		      pl->pos.cy + PIXEL_TO_CLICK(y_dif) - missile->pos.cy);
-    theta = MOD2((int) (a + 0.5), RES);
+    if (g >= 0 && guide.lock_id[g] == pl->id) {
+	shot_speed = guide.speed[g];
+	range = guide.range[g];
+    } else {
+	g = -1;
+	if ((shot_speed = VECTOR_LENGTH(missile->vel)) < 1)
+	    shot_speed = 1;
+	range = Wrap_length(pl->pos.cx - missile->pos.cx,
+			    pl->pos.cy - missile->pos.cy) / CLICK;
+    }
+    if (g >= 0 && missile->type == OBJ_SMART_SHOT)
+	theta = guide.theta[g];
+    else {
+	x_dif += pl->vel.x * (range / shot_speed);
+	y_dif += pl->vel.y * (range / shot_speed);
+	theta = Wrap_cfindDir_rounded(pl->pos.cx + PIXEL_TO_CLICK(x_dif)
+				      - missile->pos.cx,
+				      pl->pos.cy + PIXEL_TO_CLICK(y_dif)
+				      - missile->pos.cy);
+    }
 
     {
 	double x, y, vx, vy;
@@ -1768,12 +1933,11 @@ void Update_missile(missileobject_t *missile)
 
 	if (angle >= 0) {
 	    i = angle&7;
-	    a = Wrap_findDir(
+	    theta = Wrap_findDir_rounded(
 		(yi + sur[i].dy) * BLOCK_SZ - (CLICK_TO_PIXEL(missile->pos.cy)
 					       + 2 * missile->vel.y),
 		(xi + sur[i].dx) * BLOCK_SZ - (CLICK_TO_PIXEL(missile->pos.cx)
 					       - 2 * missile->vel.x));
-	    theta = MOD2((int) (a + 0.5), RES);
 #ifdef SHOT_EXTRA_SLOWDOWN
 	    if (!foundw && range > (SHOT_LOOK_AH-i) * BLOCK_SZ) {
 		if (shot_speed
@@ -444,13 +444,15 @@ bool Robot_evade_shot(player_t *pl)
 
     robot_default_data_t *my_data = Robot_suibot_get_data(pl);
 
-    const int max_objs = 1000;
+    object_t *obj_buf[1000];
     int shot_dist;
     double time_shot_closest, shortest_hit_time;
     double delta_velx, delta_vely, delta_x, delta_y, sqdistance;
     double sqship_sz;
-    Cell_get_objects(pl->pos, (int)(Visibility_distance / BLOCK_SZ),
-                     max_objs, &obj_list, &obj_count);
+    obj_list = obj_buf;
+    obj_count = Cell_get_objects(pl->pos,
+                                 (int)(Visibility_distance / BLOCK_SZ),
+                                 NELEM(obj_buf), obj_list);
 
     /*This is the viewable area for players:
     #include "connection.h"
@@ -458,8 +460,8 @@ bool Robot_evade_shot(player_t *pl)
     hori_blocks = (view_width + (BLOCK_SZ - 1)) / (2 * BLOCK_SZ);
     vert_blocks = (view_height + (BLOCK_SZ - 1)) / (2 * BLOCK_SZ);
     if (NumObjs >= options.cellGetObjectsThreshold)
-        Cell_get_objects(pl->pos, MAX(hori_blocks, vert_blocks),
-                         num_object_shuffle, &obj_list, &obj_count);*/
+        obj_count = Cell_get_objects(pl->pos, MAX(hori_blocks, vert_blocks),
+                                     num_object_shuffle, obj_list);*/
 
     shortest_hit_time = 10000;
     int closest_shot = -1;
@@ -1199,14 +1201,16 @@ static void Robot_suibot_play(player_t *pl)
     double closest_ball_dist;
     int i;
     int obj_count;
-    const int max_objs = 1000;
+    object_t *obj_buf[1000];
 
     ball_dist = 2 * maxdist;
     closest_ball_dist = 2 * maxdist;
     closest_ball = NULL;
 
-    Cell_get_objects(pl->pos, (int)(Visibility_distance / BLOCK_SZ),
-                     max_objs, &obj_list, &obj_count);
+    obj_list = obj_buf;
+    obj_count = Cell_get_objects(pl->pos,
+                                 (int)(Visibility_distance / BLOCK_SZ),
+                                 NELEM(obj_buf), obj_list);
 
     for (i = 0; i < obj_count; i++)
     { /*for .. obj_count*/
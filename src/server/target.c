@@ -60,7 +60,7 @@ void Target_update(void)
 	     */
 	    continue;
 
-	targ->conn_mask = 0;
+	Conn_mask_clear(targ->conn_mask);
 	targ->last_change = frame_loops;
     }
 }
@@ -134,7 +134,7 @@ void Object_hits_target(object_t *obj, target_t *targ, double player_cost)
 	break;
     }
 
-    targ->conn_mask = 0;
+    Conn_mask_clear(targ->conn_mask);
     targ->last_change = frame_loops;
     if (targ->damage > 0.0)
 	return;
@@ -256,12 +256,13 @@ void World_restore_target(target_t *targ)
     int i;
 
 #if 0
-    object_t *obj, **obj_list;
+    object_t *obj, *obj_buf[300], **obj_list = obj_buf;
     int obj_count, i;
 
     /* check for objects that are where the target appears */
-    Cell_get_objects(targ->pos, 4, /* should depend on target size */
-		     300, &obj_list, &obj_count);
+    obj_count = Cell_get_objects(targ->pos,
+				 4, /* should depend on target size */
+				 NELEM(obj_buf), obj_list);
     warn("obj_count = %d", obj_count);
     for (i = 0; i < obj_count; i++) {
 	obj = obj_list[i];
@@ -275,18 +276,19 @@ void World_restore_target(target_t *targ)
 
 	if (poly->group == targ->group) {
 	    poly->current_style = poly->style;
-	    poly->update_mask = ~0;
+	    Conn_mask_fill(poly->update_mask);
 	    poly->last_change = frame_loops;
 	}
     }
 
-    targ->conn_mask = 0;
-    targ->update_mask = ~0;
+    Conn_mask_clear(targ->conn_mask);
+    Conn_mask_fill(targ->update_mask);
     targ->last_change = frame_loops;
     targ->dead_ticks = 0;
     targ->damage = TARGET_DAMAGE;
 
     P_set_hitmask(targ->group, Target_hitmask(targ));
+    Nav_target_changed(targ);
 }
 
 void World_remove_target(target_t *targ)
@@ -294,7 +296,7 @@ void World_remove_target(target_t *targ)
     blkpos_t blk = Clpos_to_blkpos(targ->pos);
     int i;
 
-    targ->update_mask = ~0;
+    Conn_mask_fill(targ->update_mask);
     /* is this necessary? (done also in Target_restore_on_map() ) */
     targ->damage = TARGET_DAMAGE;
     targ->dead_ticks = options.targetDeadTicks;
@@ -310,12 +312,13 @@ void World_remove_target(target_t *targ)
 
 	if (poly->group == targ->group) {
 	    poly->current_style = poly->destroyed_style;
-	    poly->update_mask = ~0;
+	    Conn_mask_fill(poly->update_mask);
 	    poly->last_change = frame_loops;
 	}
     }
 
     /*P_set_hitmask(targ->group, ALL_BITS);*/
     P_set_hitmask(targ->group, Target_hitmask(targ));
+    Nav_target_changed(targ);
 }
 
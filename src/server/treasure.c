@@ -43,7 +43,7 @@ void Make_treasure_ball(treasure_t *t)
 	return;
     }
 
-    if ((ball = BALL_PTR(Object_allocate())) == NULL)
+    if ((ball = BALL_PTR(Object_allocate(OBJ_BALL))) == NULL)
 	return;
 
     ball->life = 1;  	  	/* doesn't matter, as long as it is > 0 */
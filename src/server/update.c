@@ -451,7 +451,7 @@ static void Fuel_update(void)
 	     */
 	    continue;
 
-	fs->conn_mask = 0;
+	Conn_mask_clear(fs->conn_mask);
 	fs->last_change = frame_loops;
     }
 }
@@ -482,14 +482,122 @@ static void legacy_mode_ball_hack(ballobject_t *ball)
     /*warn("set loose ticks to 0 for ball %p", ball);*/
 }
 
+/*
+ * Hot kinematic state of the debris and sparks as a structure of arrays.
+ * Explosions make thousands of these and all they need each tick is
+ * their fuse, speed and move updated, which is done here in one loop the
+ * compiler can vectorize instead of going through the whole object.
+ * Entries are in Obj[] order; ind[] tells which object each one is.
+ */
+static struct {
+    int		num, max;
+    int		*ind;
+    double	*fuse;
+    double	*vx, *vy;
+    double	*ax, *ay;	/* incl. gravity */
+    int		*dx, *dy;	/* move in clicks */
+} kin;
+
+static void Kinematics_alloc(void)
+{
+    XFREE(kin.ind);
+    XFREE(kin.fuse);
+    XFREE(kin.vx);
+    XFREE(kin.vy);
+    XFREE(kin.ax);
+    XFREE(kin.ay);
+    XFREE(kin.dx);
+    XFREE(kin.dy);
+    kin.max = ObjMax;
+    kin.ind = XMALLOC(int, kin.max);
+    kin.fuse = XMALLOC(double, kin.max);
+    kin.vx = XMALLOC(double, kin.max);
+    kin.vy = XMALLOC(double, kin.max);
+    kin.ax = XMALLOC(double, kin.max);
+    kin.ay = XMALLOC(double, kin.max);
+    kin.dx = XMALLOC(int, kin.max);
+    kin.dy = XMALLOC(int, kin.max);
+    if (!kin.ind || !kin.fuse || !kin.vx || !kin.vy
+	|| !kin.ax || !kin.ay || !kin.dx || !kin.dy) {
+	error("No memory for object kinematics");
+	End_game();
+    }
+}
+
+static void Kinematics_update(void)
+{
+    int i, k, n = 0;
+    double dt = timeStep;
+    object_t *obj;
+
+    if (kin.max != ObjMax)
+	Kinematics_alloc();
+
+    for (i = 0; i < NumObjs; i++) {
+	obj = Obj[i];
+	if ((obj->type != OBJ_DEBRIS && obj->type != OBJ_SPARK)
+	    || BIT(obj->obj_status, WARPING|WARPED))
+	    continue;
+
+	kin.ind[n] = i;
+	kin.fuse[n] = obj->fuse;
+	kin.vx[n] = obj->vel.x;
+	kin.vy[n] = obj->vel.y;
+	if (BIT(obj->obj_status, GRAVITY)) {
+	    vector_t gravity = World_gravity(obj->pos);
+
+	    kin.ax[n] = obj->acc.x + gravity.x;
+	    kin.ay[n] = obj->acc.y + gravity.y;
+	} else {
+	    kin.ax[n] = obj->acc.x;
+	    kin.ay[n] = obj->acc.y;
+	}
+	n++;
+    }
+    kin.num = n;
+
+    /* Same arithmetic as in Misc_object_update() and Move_object(). */
+    for (k = 0; k < n; k++) {
+	double fuse = kin.fuse[k] - dt;
+
+	kin.fuse[k] = kin.fuse[k] > 0 ? (fuse > 0 ? fuse : 0) : kin.fuse[k];
+	kin.vx[k] += kin.ax[k] * dt;
+	kin.vy[k] += kin.ay[k] * dt;
+	kin.dx[k] = FLOAT_TO_CLICK(kin.vx[k] * dt);
+	kin.dy[k] = FLOAT_TO_CLICK(kin.vy[k] * dt);
+    }
+}
+
 static void Misc_object_update(void)
 {
-    int i;
+    int i, k = 0;
     object_t *obj;
 
+    Kinematics_update();
+    Missile_guidance_update();
+
     for (i = 0; i < NumObjs; i++) {
 	obj = Obj[i];
 
+	/*
+	 * Debris and sparks only need their results stored and a move.
+	 * Objects made during this loop are not in kin, they are handled
+	 * below like everything else.
+	 */
+	if (k < kin.num && kin.ind[k] == i) {
+	    clvec_t delta;
+
+	    obj->fuse = kin.fuse[k];
+	    obj->vel.x = kin.vx[k];
+	    obj->vel.y = kin.vy[k];
+	    delta.cx = kin.dx[k];
+	    delta.cy = kin.dy[k];
+	    k++;
+	    if (!Move_object_unobstructed(obj, delta))
+		Move_object(obj);
+	    continue;
+	}
+
 	if (BIT(obj->obj_status, WARPING))
 	    Object_warp(obj);
 
@@ -738,13 +846,13 @@ static void Do_refuel(player_t *pl)
 	do {
 	    if (fs->fuel > REFUEL_RATE * timeStep) {
 		fs->fuel -= REFUEL_RATE * timeStep;
-		fs->conn_mask = 0;
+		Conn_mask_clear(fs->conn_mask);
 		fs->last_change = frame_loops;
 		Player_add_fuel(pl, REFUEL_RATE * timeStep);
 	    } else {
 		Player_add_fuel(pl, fs->fuel);
 		fs->fuel = 0;
-		fs->conn_mask = 0;
+		Conn_mask_clear(fs->conn_mask);
 		fs->last_change = frame_loops;
 		CLR_BIT(pl->used, USES_REFUEL);
 		break;
@@ -779,7 +887,7 @@ static void Do_repair(player_t *pl)
 	    if (pl->fuel.tank[pl->fuel.current]
 		> REFUEL_RATE * timeStep) {
 		targ->damage += TARGET_FUEL_REPAIR_PER_FRAME * timeStep;
-		targ->conn_mask = 0;
+		Conn_mask_clear(targ->conn_mask);
 		targ->last_change = frame_loops;
 		Player_add_fuel(pl, -REFUEL_RATE * timeStep);
 		if (targ->damage > TARGET_DAMAGE) {
@@ -1143,7 +1251,9 @@ void Update_objects(void)
 	time_to_tick += 1.0;
     }
 
+    Bench_start(BENCH_ROBOT);
     Robot_update(tick);
+    Bench_stop(BENCH_ROBOT);
 
     /*
      * Fast aim:
@@ -1257,7 +1367,9 @@ void Update_objects(void)
     /*
      * Checking for collision, updating score etc. (see collision.c)
      */
+    Bench_start(BENCH_COLLISION);
     Check_collision();
+    Bench_stop(BENCH_COLLISION);
 
     /*
      * Update tanks, Kill players that ought to be killed.
@@ -27,6 +27,12 @@
 
 #include "xpserver.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 struct move_parameters mp;
 static char msg[MSG_LEN];
 
@@ -112,6 +118,32 @@ int num_groups = 0, max_groups = 0;
 
 struct blockinfo *blockline;
 unsigned short *llist;
+
+/*
+ * Start and delta of the lines in llist, stored in separate arrays at
+ * the same index as the line number is in llist.  Lines_check() uses
+ * them to reject most lines of a block list several lines at a time.
+ * LPACK_WIDTH entries of padding at the end keep the last loads inside
+ * the arrays.
+ */
+#if defined(__AVX2__)
+#define LPACK_WIDTH 8
+#else
+#define LPACK_WIDTH 4
+#endif
+static int *lpack_sx, *lpack_sy, *lpack_dx, *lpack_dy;
+static int llist_size;
+
+#ifdef SERVER_BENCH
+/* Which prefilter Lines_check() uses, xpilots-bench -lines compares them. */
+enum {
+	LINES_PREFILTER,		/* as built, SIMD if available */
+	LINES_PREFILTER_C,		/* the plain C loop */
+	LINES_NO_PREFILTER,		/* only the per-line tests */
+	NUM_LINES_MODES
+};
+static int lines_mode = LINES_PREFILTER;
+#endif
 unsigned short *plist;
 int num_lines = 0;
 int num_polys = 0;
@@ -800,6 +832,138 @@ static void Bounce_player(player_t *pl, move_t *move, int line, int point)
 	}
 }
 
+/* The first tests Lines_check() does for each line, for the LPACK_WIDTH
+ * lines of llist starting at index 'off'.  Returns a bit mask of the
+ * lines which these tests don't reject.  *mindone and *height only get
+ * smaller during Lines_check(), so a line rejected here with their
+ * current values would be rejected there too. */
+static unsigned Lines_prefilter(int off, int msx, int msy, int mindone,
+								int height, int chx, int chy, int chxy)
+{
+	const int *xs, *ys, *xd, *yd;
+	int negx, negy, wx, wy;
+
+	/* the same mirroring as in Lines_check() */
+	if (chxy)
+	{
+		xs = lpack_sy + off;
+		ys = lpack_sx + off;
+		xd = lpack_dy + off;
+		yd = lpack_dx + off;
+		negx = chy;
+		negy = chx;
+		wx = world->cheight;
+		wy = world->cwidth;
+	}
+	else
+	{
+		xs = lpack_sx + off;
+		ys = lpack_sy + off;
+		xd = lpack_dx + off;
+		yd = lpack_dy + off;
+		negx = chx;
+		negy = chy;
+		wx = world->cwidth;
+		wy = world->cheight;
+	}
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#ifdef SERVER_BENCH
+	if (lines_mode != LINES_PREFILTER_C)
+#endif
+	{
+#if defined(__AVX2__)
+#define V __m256i
+#define VLOAD(P) _mm256_loadu_si256((const __m256i *)(P))
+#define VSET1 _mm256_set1_epi32
+#define VADD _mm256_add_epi32
+#define VSUB _mm256_sub_epi32
+#define VAND _mm256_and_si256
+#define VANDNOT _mm256_andnot_si256
+#define VOR _mm256_or_si256
+#define VXOR _mm256_xor_si256
+#define VGT _mm256_cmpgt_epi32
+#define VSRA _mm256_srai_epi32
+#define VMASK(A) _mm256_movemask_ps(_mm256_castsi256_ps(A))
+#else
+#define V __m128i
+#define VLOAD(P) _mm_loadu_si128((const __m128i *)(P))
+#define VSET1 _mm_set1_epi32
+#define VADD _mm_add_epi32
+#define VSUB _mm_sub_epi32
+#define VAND _mm_and_si128
+#define VANDNOT _mm_andnot_si128
+#define VOR _mm_or_si128
+#define VXOR _mm_xor_si128
+#define VGT _mm_cmpgt_epi32
+#define VSRA _mm_srai_epi32
+#define VMASK(A) _mm_movemask_ps(_mm_castsi128_ps(A))
+#endif
+		V nx = VSET1(negx ? -1 : 0), ny = VSET1(negy ? -1 : 0);
+		V zero = VSET1(0);
+		V lsx, lsy, ldx, ldy, c1, c2, lo, hi, rej;
+
+		lsx = VSUB(VSUB(VXOR(VLOAD(xs), nx), nx), VSET1(msx));
+		lsy = VSUB(VSUB(VXOR(VLOAD(ys), ny), ny), VSET1(msy));
+		ldx = VSUB(VXOR(VLOAD(xd), nx), nx);
+		ldy = VSUB(VXOR(VLOAD(yd), ny), ny);
+
+		/* CENTER_XCLICK() and CENTER_YCLICK() */
+		c1 = VGT(VSET1(-(wx >> 1)), lsx);
+		c2 = VGT(lsx, VSET1((wx >> 1) - 1));
+		lsx = VSUB(VADD(lsx, VAND(c1, VSET1(wx))), VAND(c2, VSET1(wx)));
+		c1 = VGT(VSET1(-(wy >> 1)), lsy);
+		c2 = VGT(lsy, VSET1((wy >> 1) - 1));
+		lsy = VSUB(VADD(lsy, VAND(c1, VSET1(wy))), VAND(c2, VSET1(wy)));
+
+		lo = VADD(lsy, VAND(ldy, VSRA(ldy, 31)));
+		hi = VADD(lsy, VANDNOT(VSRA(ldy, 31), ldy));
+		rej = VOR(VGT(lo, VSET1(height)), VGT(zero, hi));
+		lo = VADD(lsx, VAND(ldx, VSRA(ldx, 31)));
+		hi = VADD(lsx, VANDNOT(VSRA(ldx, 31), ldx));
+		rej = VOR(rej, VOR(VGT(zero, hi), VGT(lo, VSET1(mindone + 1))));
+
+		return ~(unsigned)VMASK(rej) & ((1u << LPACK_WIDTH) - 1);
+#undef V
+#undef VLOAD
+#undef VSET1
+#undef VADD
+#undef VSUB
+#undef VAND
+#undef VANDNOT
+#undef VOR
+#undef VXOR
+#undef VGT
+#undef VSRA
+#undef VMASK
+	}
+#endif
+#if !(defined(__AVX2__) || defined(__SSE2__)) || defined(SERVER_BENCH)
+	{
+		unsigned keep = 0;
+		int k, lsx, lsy, ldx, ldy;
+
+		for (k = 0; k < LPACK_WIDTH; k++)
+		{
+			lsx = (negx ? -xs[k] : xs[k]) - msx;
+			lsy = (negy ? -ys[k] : ys[k]) - msy;
+			ldx = negx ? -xd[k] : xd[k];
+			ldy = negy ? -yd[k] : yd[k];
+			lsx = lsx < -(wx >> 1) ? lsx + wx
+				: lsx >= (wx >> 1) ? lsx - wx : lsx;
+			lsy = lsy < -(wy >> 1) ? lsy + wy
+				: lsy >= (wy >> 1) ? lsy - wy : lsy;
+			if (height < lsy + MIN(ldy, 0) || 0 > lsy + MAX(ldy, 0))
+				continue;
+			if (lsx + MAX(ldx, 0) < 0 || lsx + MIN(ldx, 0) > mindone + 1)
+				continue;
+			keep |= 1u << k;
+		}
+		return keep;
+	}
+#endif
+}
+
 /* Used internally by the movement routines to find the first line
  * (in the list given by *lines) that the given trajectory hits. */
 static int Lines_check(int msx, int msy, int mdx, int mdy, int *mindone,
@@ -808,10 +972,27 @@ static int Lines_check(int msx, int msy, int mdx, int mdy, int *mindone,
 					   int *height)
 {
 	int lsx, lsy, ldx, ldy, temp, mirror, start, end, i, x, sy, ey, prod;
-	int mbase = mdy >> 1, hit = 0;
+	int mbase = mdy >> 1, hit = 0, k, off = -1;
+	unsigned keep = 0;
+
+	/* block lists from llist can be prefiltered, Shape_lines() can't */
+	if (lines >= llist && lines < llist + llist_size)
+		off = lines - llist;
+#ifdef SERVER_BENCH
+	if (lines_mode == LINES_NO_PREFILTER)
+		off = -1;
+#endif
 
-	while ((i = *lines++) != 65535)
+	for (k = 0; (i = lines[k]) != 65535; k++)
 	{
+		if (off >= 0)
+		{
+			if (k % LPACK_WIDTH == 0)
+				keep = Lines_prefilter(off + k, msx, msy, *mindone,
+									   *height, chx, chy, chxy);
+			if (!(keep & (1u << (k % LPACK_WIDTH))))
+				continue;
+		}
 		if (linet[i].group && (!can_hit(&groups[linet[i].group], move)))
 			continue;
 		lsx = linet[i].start.cx;
@@ -1055,6 +1236,17 @@ void Move_point(const move_t *move, struct collans *answer)
 	return;
 }
 
+/* Returns true if nothing within 'reach' clicks (measured as the MAX of
+ * x and y distance) of the block containing (cx, cy) can be hit.  The
+ * lines listed for a block are closer than blockline[].distance, all
+ * others (and their corners) are at least that far from it. */
+static bool Shape_far_from_walls(int cx, int cy, int reach)
+{
+	struct blockinfo *bi = &blockline[(cx >> B_SHIFT) + mapx * (cy >> B_SHIFT)];
+
+	return bi->lines[0] == 65535 && reach < bi->distance;
+}
+
 /* Similar to Move_point above, except that it gets the shape parameter
  * (and direction of that shape), and in case of collision, the 'point'
  * field in struct collans is used. A corner in the shape can hit a map
@@ -1067,10 +1259,9 @@ void Move_point(const move_t *move, struct collans *answer)
 /* May not be called with point already on top of line.
    maybe I should change that to allow lines which could be
    crossed. */
-/* This could be sped up by a lot in several ways if needed.
- * For example, there's no need to consider all the points
- * separately if the shape is not close to a wall.
- */
+/* Shapes whose block has no lines listed and which stay closer than
+ * blockline[].distance to their center are moved as a single point,
+ * without considering all the points separately. */
 static void Shape_move(const move_t *move, shape_t *s,
 					   int dir, struct collans *answer)
 {
@@ -1085,6 +1276,15 @@ static void Shape_move(const move_t *move, shape_t *s,
 	unsigned short *points;
 	clpos_t *pts;
 
+	if (Shape_far_from_walls(msx, msy,
+							 MAX_SHAPE_OFFSET + MAX(ABS(mdx), ABS(mdy))))
+	{
+		answer->line = -1;
+		answer->point = -1;
+		answer->moved = move->delta;
+		return;
+	}
+
 	if (mdx < 0)
 	{
 		mdx = -mdx;
@@ -1241,6 +1441,10 @@ static int Shape_morph(shape_t *shape1, int dir1,
 
 	num_points = shape1->num_points;
 
+	/* no point moves further than MAX_SHAPE_OFFSET from (x, y) */
+	if (Shape_far_from_walls(x, y, MAX_SHAPE_OFFSET))
+		return NO_GROUP;
+
 	for (i = 0; i < num_points; i++)
 	{
 		clpos_t pt1, pt2;
@@ -2395,8 +2599,127 @@ static void Distance_init(void)
 		}
 	free(lineno);
 	free(dis);
+
+	llist_size = size;
+	lpack_sx = (int *)ralloc(NULL, (size + LPACK_WIDTH) * sizeof(int));
+	lpack_sy = (int *)ralloc(NULL, (size + LPACK_WIDTH) * sizeof(int));
+	lpack_dx = (int *)ralloc(NULL, (size + LPACK_WIDTH) * sizeof(int));
+	lpack_dy = (int *)ralloc(NULL, (size + LPACK_WIDTH) * sizeof(int));
+	for (j = 0; j < size + LPACK_WIDTH; j++)
+	{
+		if (j >= size || llist[j] == 65535)
+		{
+			lpack_sx[j] = lpack_sy[j] = lpack_dx[j] = lpack_dy[j] = 0;
+			continue;
+		}
+		i = llist[j];
+		lpack_sx[j] = linet[i].start.cx;
+		lpack_sy[j] = linet[i].start.cy;
+		lpack_dx[j] = linet[i].delta.cx;
+		lpack_dy[j] = linet[i].delta.cy;
+	}
 }
 
+/* Free the packed line arrays made by Distance_init(). */
+void Walls_free(void)
+{
+	llist_size = 0;
+	XFREE(lpack_sx);
+	XFREE(lpack_sy);
+	XFREE(lpack_dx);
+	XFREE(lpack_dy);
+}
+
+#ifdef SERVER_BENCH
+/* For xpilots-bench -lines.  Make n random moves from blocks which have
+ * lines listed in blockline[] and check that Move_point() gives the same
+ * answer with the prefilter as built (SSE2 or AVX2 if available), with
+ * the plain C prefilter and with only the per-line tests, which is what
+ * Lines_check() did before there was a prefilter.  *tested is set to the
+ * number of moves which had lines to test.  Returns the number of moves
+ * for which the answers differ. */
+long Lines_prefilter_check(long n, long *tested)
+{
+	struct collans ans[NUM_LINES_MODES];
+	move_t mv;
+	long k, bad = 0;
+	int block, tries, mode, dir, len;
+
+	*tested = 0;
+	mv.obj = NULL;
+
+	for (k = 0; k < n; k++)
+	{
+		/* a block with lines if one turns up in 16 tries */
+		for (tries = 0; tries < 16; tries++)
+		{
+			block = (int)(rfrac() * mapx * mapy);
+			if (blockline[block].lines[0] != 65535)
+				break;
+		}
+		mv.start.cx = (block % mapx) * B_CLICKS + (int)(rfrac() * B_CLICKS);
+		mv.start.cy = (block / mapx) * B_CLICKS + (int)(rfrac() * B_CLICKS);
+		mv.start.cx = MIN(mv.start.cx, world->cwidth - 1);
+		mv.start.cy = MIN(mv.start.cy, world->cheight - 1);
+
+		/* short moves, and now and then one longer than Move_point()
+		 * takes in one step */
+		dir = (int)(rfrac() * RES);
+		if (rfrac() < 0.05)
+			len = (int)(rfrac() * 60000);
+		else
+			len = (int)(rfrac() * 4 * B_CLICKS);
+		mv.delta.cx = (int)(tcos(dir) * len);
+		mv.delta.cy = (int)(tsin(dir) * len);
+		if (mv.delta.cx == 0 && mv.delta.cy == 0)
+			mv.delta.cx = 1;
+
+		switch ((int)(rfrac() * 4))
+		{
+		case 0:
+			mv.hitmask = BALL_BIT;
+			break;
+		case 1:
+			mv.hitmask = BALL_BIT | NOTEAM_BIT;
+			break;
+		default:
+			mv.hitmask = NONBALL_BIT;
+			break;
+		}
+
+		for (mode = 0; mode < NUM_LINES_MODES; mode++)
+		{
+			lines_mode = mode;
+			Move_point(&mv, &ans[mode]);
+		}
+		lines_mode = LINES_PREFILTER;
+
+		if (blockline[(mv.start.cx >> B_SHIFT)
+					  + mapx * (mv.start.cy >> B_SHIFT)].lines[0] != 65535)
+			(*tested)++;
+		for (mode = 1; mode < NUM_LINES_MODES; mode++)
+		{
+			if (ans[mode].line != ans[0].line
+				|| ans[mode].moved.cx != ans[0].moved.cx
+				|| ans[mode].moved.cy != ans[0].moved.cy)
+			{
+				warn("Lines_prefilter_check: move (%d, %d) + (%d, %d): "
+					 "line %d moved (%d, %d) as built, "
+					 "line %d moved (%d, %d) in mode %d",
+					 mv.start.cx, mv.start.cy, mv.delta.cx, mv.delta.cy,
+					 ans[0].line, ans[0].moved.cx, ans[0].moved.cy,
+					 ans[mode].line, ans[mode].moved.cx,
+					 ans[mode].moved.cy, mode);
+				bad++;
+				break;
+			}
+		}
+	}
+
+	return bad;
+}
+#endif
+
 /*
   cut and paste from #xpilot irc channel:
 
@@ -2846,6 +3169,36 @@ void Move_object(object_t *obj)
 	return;
 }
 
+/*
+ * Move an object whose whole move stays within the distance for which
+ * its block lists no lines at all.  Nothing can be hit on the way, so
+ * this does what Move_object() would do without looking at any lines.
+ * Returns false, leaving the object alone, if Move_object() is needed.
+ */
+bool Move_object_unobstructed(object_t *obj, clvec_t delta)
+{
+	int block, dist;
+	clvec_t pos;
+
+	block = (obj->pos.cx >> B_SHIFT) + mapx * (obj->pos.cy >> B_SHIFT);
+	if (blockline[block].lines[0] != 65535)
+		return false;
+	/* Move_point() takes at most 45000 clicks in one step */
+	dist = MIN(blockline[block].distance, 45000);
+	if (ABS(delta.cx) > dist || ABS(delta.cy) > dist)
+		return false;
+
+	Object_position_remember(obj);
+	obj->collmode = 1;
+	obj->extmove.cx = delta.cx;
+	obj->extmove.cy = delta.cy;
+	pos.cx = WRAP_XCLICK(obj->pos.cx + delta.cx);
+	pos.cy = WRAP_YCLICK(obj->pos.cy + delta.cy);
+	Object_position_set_clvec(obj, pos);
+	Cell_add_object(obj);
+	return true;
+}
+
 bool in_move_player = false;
 
 void Move_player(player_t *pl)
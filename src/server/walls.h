@@ -148,7 +148,7 @@ typedef struct
     int estyles_start;
     int num_echanges;
     int is_decor;
-    unsigned update_mask;
+    conn_mask_t *update_mask;
     long last_change;
 } poly_t;
 
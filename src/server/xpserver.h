@@ -45,6 +45,10 @@
 #  endif
 #endif
 
+#ifdef HAVE_LIBPTHREAD
+#  include <pthread.h>
+#endif
+
 #include "serverconst.h"
 #include "object.h"
 #include "player.h"